@@ -245,6 +245,7 @@ static btITaskScheduler* gBtTaskScheduler=0;
 static int gThreadsRunningCounter = 0;  // useful for detecting if we are trying to do nested parallel-for calls
 static btSpinMutex gThreadsRunningCounterMutex;
 static ThreadsafeCounter gThreadCounter;
+static btThreadIndexFunc gThreadIndexFunc = 0;
 
 //
 // BT_DETECT_BAD_THREAD_INDEX tries to detect when there are multiple threads assigned the same thread index.
@@ -289,6 +290,10 @@ static ThreadId_t getDebugThreadId()
 // return a unique index per thread, main thread is 0, worker threads are in [1, BT_MAX_THREAD_COUNT)
 unsigned int btGetCurrentThreadIndex()
 {
+	if (gThreadIndexFunc)
+	{
+		return gThreadIndexFunc();
+	}
 	const unsigned int kNullIndex = ~0U;
 	THREAD_LOCAL_STATIC unsigned int sThreadIndex = kNullIndex;
 	if (sThreadIndex == kNullIndex)
@@ -326,6 +331,11 @@ bool btIsMainThread()
 	return btGetCurrentThreadIndex() == 0;
 }
 
+void btSetThreadIndexFunc(btThreadIndexFunc func)
+{
+	gThreadIndexFunc = func;
+}
+
 void btResetThreadIndexCounter()
 {
 	// for when all current worker threads are destroyed
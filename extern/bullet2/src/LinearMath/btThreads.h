@@ -36,6 +36,12 @@ bool btThreadsAreRunning();
 unsigned int btGetCurrentThreadIndex();
 void btResetThreadIndexCounter();  // notify that all worker threads have been destroyed
 
+// set a function that returns the thread-index of the calling thread, for task schedulers
+// that run tasks on threads not managed by Bullet. The index must be unique amongst the
+// threads running tasks at the same time, and less than the number of threads of the task scheduler.
+typedef unsigned int (*btThreadIndexFunc)();
+void btSetThreadIndexFunc(btThreadIndexFunc func);
+
 ///
 /// btSpinMutex -- lightweight spin-mutex implemented with atomic ops, never puts
 ///               a thread to sleep because it is designed to be used with a task scheduler
@@ -66,6 +66,28 @@ void *safeGzopen(const char *filename, const char *mode)
 #endif  // NO_ZLIB != 1
 }
 
+static FileCacheAcquireFunc fileCacheAcquire = nullptr;
+static FileCacheReleaseFunc fileCacheRelease = nullptr;
+
+void setFileCache(FileCacheAcquireFunc acquire, FileCacheReleaseFunc release)
+{
+  fileCacheAcquire = acquire;
+  fileCacheRelease = release;
+}
+
+const void *acquireCachedFile(const std::string &filename, size_t *size, void **handle)
+{
+  if (fileCacheAcquire == nullptr) {
+    return nullptr;
+  }
+  return fileCacheAcquire(filename.c_str(), size, handle);
+}
+
+void releaseCachedFile(void *handle)
+{
+  fileCacheRelease(handle);
+}
+
 #if defined(OPENVDB)
 // Convert from OpenVDB value to Manta value.
 template<class S, class T> void convertFrom(S &in, T *out)
@@ -31,6 +31,7 @@
 #  include "openvdb/openvdb.h"
 #  include <openvdb/points/PointConversion.h>
 #  include <openvdb/points/PointCount.h>
+#  include <openvdb/io/Stream.h>
 #endif
 
 #define POSITION_NAME "P"
@@ -461,6 +462,64 @@ int writeObjectsVDB(const string &filename,
   return 1;
 }
 
+// Read only stream buffer over memory owned by someone else, avoids copying cached files.
+class MemoryStreamBuf : public std::streambuf {
+ public:
+  MemoryStreamBuf(const void *data, size_t size)
+  {
+    char *begin = (char *)data;
+    setg(begin, begin, begin + size);
+  }
+
+ protected:
+  pos_type seekoff(off_type off,
+                   std::ios_base::seekdir dir,
+                   std::ios_base::openmode which) override
+  {
+    char *pos = (dir == std::ios_base::beg) ? eback() : (dir == std::ios_base::cur) ? gptr() :
+                                                                                      egptr();
+    pos += off;
+    if (!(which & std::ios_base::in) || pos < eback() || pos > egptr()) {
+      return pos_type(off_type(-1));
+    }
+    setg(eback(), pos, egptr());
+    return pos_type(pos - eback());
+  }
+
+  pos_type seekpos(pos_type pos, std::ios_base::openmode which) override
+  {
+    return seekoff(off_type(pos), std::ios_base::beg, which);
+  }
+};
+
+// Read the grids from a copy of the file in memory, if the host application has one.
+static bool readCachedGridsVDB(const string &filename, openvdb::GridPtrVec &gridsVDB)
+{
+  size_t size = 0;
+  void *handle = nullptr;
+  const void *data = acquireCachedFile(filename, &size, &handle);
+  if (data == nullptr) {
+    return false;
+  }
+
+  bool success = true;
+  try {
+    MemoryStreamBuf buf(data, size);
+    std::istream is(&buf);
+    // No delayed loading, the grids must not reference the memory after it is released.
+    openvdb::io::Stream stream(is, false);
+    gridsVDB = *(stream.getGrids());
+  }
+  catch (const openvdb::Exception &e) {
+    unusedParameter(e);  // Unused for now
+    debMsg("readObjectsVDB: Could not read cached vdb file " << filename, 1);
+    gridsVDB.clear();
+    success = false;
+  }
+  releaseCachedFile(handle);
+  return success;
+}
+
 int readObjectsVDB(const string &filename, std::vector<PbClass *> *objects, float worldSize)
 {
 
@@ -471,20 +530,22 @@ int readObjectsVDB(const string &filename, std::vector<PbClass *> *objects, floa
   // Register custom codecs, this makes sure custom attributes can be read
   registerCustomCodecs();
 
-  try {
-    file.setCopyMaxBytes(0);
-    file.open();
-    gridsVDB = *(file.getGrids());
-    openvdb::MetaMap::Ptr metadata = file.getMetadata();
-    unusedParameter(metadata);  // Unused for now
-  }
-  catch (const openvdb::IoError &e) {
-    unusedParameter(e);  // Unused for now
-    debMsg("readObjectsVDB: Could not open vdb file " << filename, 1);
+  if (!readCachedGridsVDB(filename, gridsVDB)) {
+    try {
+      file.setCopyMaxBytes(0);
+      file.open();
+      gridsVDB = *(file.getGrids());
+      openvdb::MetaMap::Ptr metadata = file.getMetadata();
+      unusedParameter(metadata);  // Unused for now
+    }
+    catch (const openvdb::IoError &e) {
+      unusedParameter(e);  // Unused for now
+      debMsg("readObjectsVDB: Could not open vdb file " << filename, 1);
+      file.close();
+      return 0;
+    }
     file.close();
-    return 0;
   }
-  file.close();
 
   // A buffer to store a handle to pData objects. These will be read alongside a particle system.
   std::vector<ParticleDataBase *> pdbBuffer;
@@ -114,6 +114,14 @@ template<class T> int readMdataUni(const std::string &name, MeshDataImpl<T> *mda
 void getUniFileSize(
     const std::string &name, int &x, int &y, int &z, int *t = NULL, std::string *info = NULL);
 void *safeGzopen(const char *filename, const char *mode);
+
+// Files kept in memory by the host application, read from there instead of from disk. Acquire
+// returns nullptr when the file is not in memory, the data stays valid until it is released.
+typedef const void *(*FileCacheAcquireFunc)(const char *filename, size_t *size, void **handle);
+typedef void (*FileCacheReleaseFunc)(void *handle);
+void setFileCache(FileCacheAcquireFunc acquire, FileCacheReleaseFunc release);
+const void *acquireCachedFile(const std::string &filename, size_t *size, void **handle);
+void releaseCachedFile(void *handle);
 #if OPENVDB == 1
 template<class S, class T> void convertFrom(S &in, T *out);
 template<class S, class T> void convertTo(S *out, T &in);
@@ -832,6 +832,11 @@ class CyclesRenderSettings(bpy.types.PropertyGroup):
         default='EMBREE',
     )
     debug_use_cpu_split_kernel: BoolProperty(name="Split Kernel", default=False)
+    debug_cpu_split_kernel_batch_size: IntProperty(
+        name="Split Kernel Batch Size",
+        description="Number of paths traced together by each thread with the split kernel",
+        default=2048, min=1, max=65536,
+    )
 
     debug_use_cuda_adaptive_compile: BoolProperty(name="Adaptive Compile", default=False)
     debug_use_cuda_split_kernel: BoolProperty(name="Split Kernel", default=False)
@@ -2024,6 +2024,9 @@ class CYCLES_RENDER_PT_debug(CyclesButtonsPanel, Panel):
         row.prop(cscene, "debug_use_cpu_avx2", toggle=True)
         col.prop(cscene, "debug_bvh_layout")
         col.prop(cscene, "debug_use_cpu_split_kernel")
+        sub = col.column()
+        sub.active = cscene.debug_use_cpu_split_kernel
+        sub.prop(cscene, "debug_cpu_split_kernel_batch_size")
 
         col.separator()
 
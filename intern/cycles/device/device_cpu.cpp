@@ -1460,6 +1460,7 @@ class CPUDevice : public Device {
     }
     kg.decoupled_volume_steps_index = 0;
     kg.coverage_asset = kg.coverage_object = kg.coverage_material = NULL;
+    kg.coverage_capacity = 0;
 #ifdef WITH_OSL
     OSLShader::thread_init(&kg, &kernel_globals, &osl_globals);
 #endif
@@ -1602,7 +1603,15 @@ int2 CPUSplitKernel::split_kernel_global_size(device_memory & /*kg*/,
                                               device_memory & /*data*/,
                                               DeviceTask & /*task*/)
 {
-  return make_int2(1, 1);
+  /* Each thread traces a batch of paths stage by stage, with every kernel
+   * looping over all paths of the batch before the next one runs. */
+  const int batch_size = max(DebugFlags().cpu.split_kernel_batch_size, 1);
+  const int width = min(batch_size, SHADER_SORT_BLOCK_SIZE);
+  const int height = divide_up(batch_size, width);
+
+  VLOG(1) << "CPU split kernel batch size: " << width * height << " paths.";
+
+  return make_int2(width, height);
 }
 
 uint64_t CPUSplitKernel::state_buffer_size(device_memory &kernel_globals,
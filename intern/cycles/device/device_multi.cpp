@@ -27,6 +27,7 @@
 #include "util/util_list.h"
 #include "util/util_logging.h"
 #include "util/util_map.h"
+#include "util/util_string.h"
 #include "util/util_time.h"
 
 CCL_NAMESPACE_BEGIN
@@ -73,6 +74,48 @@ class MultiDevice : public Device {
       sub->device = Device::create(subinfo, sub->stats, profiler, background);
     }
 
+#ifdef WITH_NETWORK
+    /* Try to add network devices. Servers can be listed explicitly as
+     * comma separated host:port pairs, otherwise they are discovered by
+     * broadcasting on the local network. */
+    vector<string> servers;
+    const char *server_list = getenv("CYCLES_NETWORK_SERVERS");
+
+    if (server_list) {
+      string_split(servers, server_list, ",");
+    }
+    else {
+      ServerDiscovery discovery(true);
+      time_sleep(1.0);
+
+      servers = discovery.get_server_list();
+    }
+
+    /* Network devices have their own type, so that local devices can steal their tiles when
+     * they run out of work at the end of a render. */
+    DeviceInfo network_info = info;
+    network_info.type = DEVICE_NETWORK;
+    network_info.multi_devices.clear();
+    network_info.denoising_devices.clear();
+
+    foreach (string &server, servers) {
+      string host;
+      int port;
+      if (!network_address_split(server, host, port)) {
+        LOG(ERROR) << "Invalid network render server address \"" << server
+                   << "\", expected host or host:port.";
+        continue;
+      }
+
+      network_info.id = "NETWORK_" + server;
+      network_info.description = "Network Device " + server;
+
+      devices.emplace_front();
+      SubDevice *sub = &devices.front();
+      sub->device = device_network_create(network_info, sub->stats, profiler, server.c_str());
+    }
+#endif
+
     /* Build a list of peer islands for the available render devices */
     foreach (SubDevice &sub, devices) {
       /* First ensure that every device is in at least once peer island */
@@ -117,20 +160,6 @@ class MultiDevice : public Device {
         }
       }
     }
-
-#ifdef WITH_NETWORK
-    /* try to add network devices */
-    ServerDiscovery discovery(true);
-    time_sleep(1.0);
-
-    vector<string> servers = discovery.get_server_list();
-
-    foreach (string &server, servers) {
-      Device *device = device_network_create(info, stats, profiler, server.c_str());
-      if (device)
-        devices.push_back(SubDevice(device));
-    }
-#endif
   }
 
   ~MultiDevice()
@@ -20,6 +20,8 @@
 
 #include "util/util_foreach.h"
 #include "util/util_logging.h"
+#include "util/util_set.h"
+#include "util/util_time.h"
 
 #if defined(WITH_NETWORK)
 
@@ -59,11 +61,21 @@ class NetworkDevice : public Device {
       : Device(info, stats, profiler, true), socket(io_service)
   {
     error_func = NetworkError();
+
+    mem_counter = 0;
+
+    string host;
+    int port;
+    if (!network_address_split(address, host, port)) {
+      error_func.network_error(string_printf("Invalid server address \"%s\"", address));
+      return;
+    }
+
     stringstream portstr;
-    portstr << SERVER_PORT;
+    portstr << port;
 
     tcp::resolver resolver(io_service);
-    tcp::resolver::query query(address, portstr.str());
+    tcp::resolver::query query(host, portstr.str());
     tcp::resolver::iterator endpoint_iterator = resolver.resolve(query);
     tcp::resolver::iterator end;
 
@@ -75,14 +87,14 @@ class NetworkDevice : public Device {
 
     if (error)
       error_func.network_error(error.message());
-
-    mem_counter = 0;
   }
 
   ~NetworkDevice()
   {
-    RPCSend snd(socket, &error_func, "stop");
-    snd.write();
+    if (socket.is_open()) {
+      RPCSend snd(socket, &error_func, "stop");
+      snd.write();
+    }
   }
 
   virtual BVHLayoutMask get_bvh_layout_mask() const
@@ -111,6 +123,11 @@ class NetworkDevice : public Device {
   {
     thread_scoped_lock lock(rpc_lock);
 
+    /* Textures and constant memory are allocated by the first copy. */
+    if (!mem.device_pointer) {
+      mem.device_pointer = ++mem_counter;
+    }
+
     RPCSend snd(socket, &error_func, "mem_copy_to");
 
     snd.add(mem);
@@ -120,6 +137,14 @@ class NetworkDevice : public Device {
 
   void mem_copy_from(device_memory &mem, int y, int w, int h, int elem)
   {
+    {
+      /* Render buffers of stolen tiles were received with the tile already. */
+      thread_scoped_lock copied_lock(copied_mutex);
+      if (copied_from_device.erase(mem.device_pointer)) {
+        return;
+      }
+    }
+
     thread_scoped_lock lock(rpc_lock);
 
     size_t data_size = mem.memory_size();
@@ -141,6 +166,10 @@ class NetworkDevice : public Device {
   {
     thread_scoped_lock lock(rpc_lock);
 
+    if (!mem.device_pointer) {
+      mem.device_pointer = ++mem_counter;
+    }
+
     RPCSend snd(socket, &error_func, "mem_zero");
 
     snd.add(mem);
@@ -157,6 +186,9 @@ class NetworkDevice : public Device {
       snd.add(mem);
       snd.write();
 
+      thread_scoped_lock copied_lock(copied_mutex);
+      copied_from_device.erase(mem.device_pointer);
+
       mem.device_pointer = 0;
     }
   }
@@ -183,10 +215,7 @@ class NetworkDevice : public Device {
     thread_scoped_lock lock(rpc_lock);
 
     RPCSend snd(socket, &error_func, "load_kernels");
-    snd.add(requested_features.experimental);
-    snd.add(requested_features.max_closure);
-    snd.add(requested_features.max_nodes_group);
-    snd.add(requested_features.nodes_features);
+    snd.add(requested_features);
     snd.write();
 
     bool result;
@@ -232,7 +261,7 @@ class NetworkDevice : public Device {
         lock.unlock();
 
         /* todo: watch out for recursive calls! */
-        if (the_task.acquire_tile(this, tile)) { /* write return as bool */
+        if (the_task.acquire_tile(this, tile, the_task.tile_types)) { /* write return as bool */
           the_tiles.push_back(tile);
 
           lock.lock();
@@ -250,7 +279,6 @@ class NetworkDevice : public Device {
       }
       else if (rcv.name == "release_tile") {
         rcv.read(tile);
-        lock.unlock();
 
         TileList::iterator it = tile_list_find(the_tiles, tile);
         if (it != the_tiles.end()) {
@@ -260,6 +288,17 @@ class NetworkDevice : public Device {
 
         assert(tile.buffers != NULL);
 
+        if (tile.stealing_state == RenderTile::WAS_STOLEN) {
+          /* The render buffer of a stolen tile follows it, so the device which stole the tile
+           * can move it without another call while the server keeps rendering. */
+          device_vector<float> &buffer = tile.buffers->buffer;
+          rcv.read_buffer(buffer.host_pointer, buffer.memory_size());
+
+          thread_scoped_lock copied_lock(copied_mutex);
+          copied_from_device.insert(buffer.device_pointer);
+        }
+        lock.unlock();
+
         the_task.release_tile(tile);
 
         lock.lock();
@@ -267,6 +306,17 @@ class NetworkDevice : public Device {
         snd.write();
         lock.unlock();
       }
+      else if (rcv.name == "get_tile_stolen") {
+        lock.unlock();
+
+        bool stolen = the_task.get_tile_stolen();
+
+        lock.lock();
+        RPCSend snd(socket, &error_func, "tile_stolen");
+        snd.add(stolen);
+        snd.write();
+        lock.unlock();
+      }
       else if (rcv.name == "task_wait_done") {
         lock.unlock();
         break;
@@ -290,6 +340,10 @@ class NetworkDevice : public Device {
 
  private:
   NetworkError error_func;
+
+  /* Memory of which the host copy was received already. */
+  thread_mutex copied_mutex;
+  set<device_ptr> copied_from_device;
 };
 
 Device *device_network_create(DeviceInfo &info,
@@ -333,7 +387,11 @@ class DeviceServer {
   }
 
   DeviceServer(Device *device_, tcp::socket &socket_)
-      : device(device_), socket(socket_), stop(false), blocked_waiting(false)
+      : device(device_),
+        socket(socket_),
+        tile_stolen_time(0.0),
+        stop(false),
+        blocked_waiting(false)
   {
     error_func = NetworkError();
   }
@@ -401,6 +459,11 @@ class DeviceServer {
     assert(mapins.second);
   }
 
+  bool client_pointer_exists(device_ptr client_pointer)
+  {
+    return ptr_map.find(client_pointer) != ptr_map.end();
+  }
+
   device_ptr device_ptr_from_client_pointer(device_ptr client_pointer)
   {
     PtrMap::iterator i = ptr_map.find(client_pointer);
@@ -465,8 +528,9 @@ class DeviceServer {
 
       size_t data_size = mem.memory_size();
       device_ptr client_pointer = mem.device_pointer;
+      const bool allocated = client_pointer_exists(client_pointer);
 
-      if (client_pointer) {
+      if (allocated) {
         /* Lookup existing host side data buffer. */
         DataVector &data_v = data_vector_find(client_pointer);
         mem.host_pointer = (void *)&data_v[0];
@@ -478,6 +542,7 @@ class DeviceServer {
         /* Allocate host side data buffer. */
         DataVector &data_v = data_vector_insert(client_pointer, data_size);
         mem.host_pointer = (data_size) ? (void *)&(data_v[0]) : 0;
+        mem.device_pointer = 0;
       }
 
       /* Copy data from network into memory buffer. */
@@ -486,7 +551,7 @@ class DeviceServer {
       /* Copy the data from the memory buffer to the device buffer. */
       device->mem_copy_to(mem);
 
-      if (!client_pointer) {
+      if (!allocated) {
         /* Store a mapping to/from client_pointer and real device pointer. */
         pointer_mapping_insert(client_pointer, mem.device_pointer);
       }
@@ -507,7 +572,7 @@ class DeviceServer {
 
       DataVector &data_v = data_vector_find(client_pointer);
 
-      mem.host_pointer = (device_ptr) & (data_v[0]);
+      mem.host_pointer = (void *)&data_v[0];
 
       device->mem_copy_from(mem, y, w, h, elem);
 
@@ -526,8 +591,9 @@ class DeviceServer {
 
       size_t data_size = mem.memory_size();
       device_ptr client_pointer = mem.device_pointer;
+      const bool allocated = client_pointer_exists(client_pointer);
 
-      if (client_pointer) {
+      if (allocated) {
         /* Lookup existing host side data buffer. */
         DataVector &data_v = data_vector_find(client_pointer);
         mem.host_pointer = (void *)&data_v[0];
@@ -538,13 +604,14 @@ class DeviceServer {
       else {
         /* Allocate host side data buffer. */
         DataVector &data_v = data_vector_insert(client_pointer, data_size);
-        mem.host_pointer = (void *) ? (device_ptr) & (data_v[0]) : 0;
+        mem.host_pointer = (data_size) ? (void *)&(data_v[0]) : 0;
+        mem.device_pointer = 0;
       }
 
       /* Zero memory. */
       device->mem_zero(mem);
 
-      if (!client_pointer) {
+      if (!allocated) {
         /* Store a mapping to/from client_pointer and real device pointer. */
         pointer_mapping_insert(client_pointer, mem.device_pointer);
       }
@@ -577,10 +644,7 @@ class DeviceServer {
     }
     else if (rcv.name == "load_kernels") {
       DeviceRequestedFeatures requested_features;
-      rcv.read(requested_features.experimental);
-      rcv.read(requested_features.max_closure);
-      rcv.read(requested_features.max_nodes_group);
-      rcv.read(requested_features.nodes_features);
+      rcv.read(requested_features);
 
       bool result;
       result = device->load_kernels(requested_features);
@@ -616,6 +680,7 @@ class DeviceServer {
                                                   this);
       task.update_tile_sample = function_bind(&DeviceServer::task_update_tile_sample, this, _1);
       task.get_cancel = function_bind(&DeviceServer::task_get_cancel, this);
+      task.get_tile_stolen = function_bind(&DeviceServer::task_get_tile_stolen, this);
 
       device->task_add(task);
     }
@@ -654,6 +719,13 @@ class DeviceServer {
       acquire_queue.push_back(entry);
       lock.unlock();
     }
+    else if (rcv.name == "tile_stolen") {
+      AcquireEntry entry;
+      entry.name = rcv.name;
+      rcv.read(entry.stolen);
+      acquire_queue.push_back(entry);
+      lock.unlock();
+    }
     else {
       cout << "Error: unexpected RPC receive call \"" + rcv.name + "\"\n";
       lock.unlock();
@@ -715,6 +787,8 @@ class DeviceServer {
   {
     thread_scoped_lock acquire_lock(acquire_mutex);
 
+    device_ptr real_pointer = tile.buffer;
+
     if (tile.buffer)
       tile.buffer = ptr_imap[tile.buffer];
 
@@ -723,6 +797,23 @@ class DeviceServer {
       RPCSend snd(socket, &error_func, "release_tile");
       snd.add(tile);
       snd.write();
+
+      if (tile.stealing_state == RenderTile::WAS_STOLEN) {
+        /* Send the render buffer of a stolen tile along, see NetworkDevice::task_wait. */
+        DataVector &data_v = data_vector_find(tile.buffer);
+
+        network_device_memory mem(device);
+        mem.type = MEM_READ_WRITE;
+        mem.data_type = TYPE_UCHAR;
+        mem.data_elements = 1;
+        mem.data_size = mem.data_width = data_v.size();
+        mem.data_height = 1;
+        mem.host_pointer = (void *)&data_v[0];
+        mem.device_pointer = real_pointer;
+
+        device->mem_copy_from(mem, 0, data_v.size(), 1, 1);
+        snd.write_buffer(&data_v[0], data_v.size());
+      }
       lock.unlock();
     }
 
@@ -753,6 +844,51 @@ class DeviceServer {
     return false;
   }
 
+  bool task_get_tile_stolen()
+  {
+    thread_scoped_lock acquire_lock(acquire_mutex);
+
+    /* Tiles are only stolen at the end of a render by devices of the client that ran out of
+     * tiles, so asking once in a while is enough and avoids a round trip for every sample. */
+    const double time = time_dt();
+    if (time - tile_stolen_time < TILE_STOLEN_INTERVAL) {
+      return false;
+    }
+
+    bool result = false;
+
+    {
+      thread_scoped_lock lock(rpc_lock);
+      RPCSend snd(socket, &error_func, "get_tile_stolen");
+      snd.write();
+    }
+
+    do {
+      if (blocked_waiting)
+        listen_step();
+
+      /* todo: avoid busy wait loop */
+      thread_scoped_lock lock(rpc_lock);
+
+      if (!acquire_queue.empty()) {
+        AcquireEntry entry = acquire_queue.front();
+        acquire_queue.pop_front();
+
+        if (entry.name == "tile_stolen") {
+          result = entry.stolen;
+          break;
+        }
+        else {
+          cout << "Error: unexpected tile stolen RPC receive call \"" + entry.name + "\"\n";
+        }
+      }
+    } while (acquire_queue.empty() && !stop && !have_error());
+
+    tile_stolen_time = time_dt();
+
+    return result;
+  }
+
   /* properties */
   Device *device;
   tcp::socket &socket;
@@ -765,11 +901,16 @@ class DeviceServer {
   struct AcquireEntry {
     string name;
     RenderTile tile;
+    bool stolen = false;
   };
 
   thread_mutex acquire_mutex;
   list<AcquireEntry> acquire_queue;
 
+  /* Seconds between asking the client whether a tile should be given up. */
+  static constexpr double TILE_STOLEN_INTERVAL = 0.5;
+  double tile_stolen_time;
+
   bool stop;
   bool blocked_waiting;
 
@@ -779,16 +920,16 @@ class DeviceServer {
   /* todo: free memory and device (osl) on network error */
 };
 
-void Device::server_run()
+void Device::server_run(int port)
 {
   try {
     /* starts thread that responds to discovery requests */
-    ServerDiscovery discovery;
+    ServerDiscovery discovery(false, port);
 
     for (;;) {
       /* accept connection */
       boost::asio::io_service io_service;
-      tcp::acceptor acceptor(io_service, tcp::endpoint(tcp::v4(), SERVER_PORT));
+      tcp::acceptor acceptor(io_service, tcp::endpoint(tcp::v4(), port));
 
       tcp::socket socket(io_service);
       acceptor.accept(socket);
@@ -33,10 +33,16 @@
 #  include <iostream>
 #  include <sstream>
 
+#  include <zlib.h>
+
+#  include "device/device.h"
+#  include "device/device_task.h"
+
 #  include "render/buffers.h"
 
 #  include "util/util_foreach.h"
 #  include "util/util_list.h"
+#  include "util/util_logging.h"
 #  include "util/util_map.h"
 #  include "util/util_param.h"
 #  include "util/util_string.h"
@@ -56,6 +62,33 @@ static const int DISCOVER_PORT = 5121;
 static const string DISCOVER_REQUEST_MSG = "REQUEST_RENDER_SERVER_IP";
 static const string DISCOVER_REPLY_MSG = "REPLY_RENDER_SERVER_IP";
 
+/* Buffers smaller than this are sent uncompressed. */
+static const size_t COMPRESS_MIN_SIZE = 4096;
+
+/* Parse "host" or "host:port" server address. Returns false when the host is empty or the port
+ * is not a number in the valid range. */
+static inline bool network_address_split(const string &address, string &host, int &port)
+{
+  size_t pos = address.rfind(':');
+  if (pos == string::npos) {
+    host = address;
+    port = SERVER_PORT;
+    return !host.empty();
+  }
+
+  host = address.substr(0, pos);
+  port = 0;
+
+  const string port_str = address.substr(pos + 1);
+  if (host.empty() || port_str.empty() || port_str.size() > 5 ||
+      port_str.find_first_not_of("0123456789") != string::npos) {
+    return false;
+  }
+
+  port = atoi(port_str.c_str());
+  return port > 0 && port <= 65535;
+}
+
 #  if 0
 typedef boost::archive::text_oarchive o_archive;
 typedef boost::archive::text_iarchive i_archive;
@@ -64,17 +97,23 @@ typedef boost::archive::binary_oarchive o_archive;
 typedef boost::archive::binary_iarchive i_archive;
 #  endif
 
-/* Serialization of device memory */
+/* Serialization of device memory
+ *
+ * Memory received over the network is a texture, so that devices can read the slot and texture
+ * info when it is one. The pointers belong to the server, not to this memory. */
 
-class network_device_memory : public device_memory {
+class network_device_memory : public device_texture {
  public:
-  network_device_memory(Device *device) : device_memory(device, "", MEM_READ_ONLY)
+  network_device_memory(Device *device)
+      : device_texture(device, "", 0, IMAGE_DATA_TYPE_FLOAT4, INTERPOLATION_NONE, EXTENSION_REPEAT)
   {
+    type = MEM_READ_ONLY;
   }
 
   ~network_device_memory()
   {
     device_pointer = 0;
+    host_pointer = 0;
   };
 
   vector<char> local_data;
@@ -118,7 +157,7 @@ class RPCSend {
   {
     archive &name_;
     error_func = e;
-    fprintf(stderr, "rpc send %s\n", name.c_str());
+    VLOG(3) << "RPC send " << name;
   }
 
   ~RPCSend()
@@ -130,8 +169,37 @@ class RPCSend {
     archive &mem.data_type &mem.data_elements &mem.data_size;
     archive &mem.data_width &mem.data_height &mem.data_depth &mem.device_pointer;
     archive &mem.type &string(mem.name);
-    archive &mem.interpolation &mem.extension;
     archive &mem.device_pointer;
+
+    if (mem.type == MEM_TEXTURE) {
+      const device_texture &tex = (const device_texture &)mem;
+      archive &tex.slot;
+      add(tex.info);
+    }
+  }
+
+  void add(const TextureInfo &info)
+  {
+    archive &info.data_type &info.interpolation &info.extension;
+    archive &info.width &info.height &info.depth;
+    archive &info.use_transform_3d;
+
+    const float *transform = (const float *)&info.transform_3d;
+    for (size_t i = 0; i < sizeof(Transform) / sizeof(float); i++) {
+      archive &transform[i];
+    }
+  }
+
+  void add(const DeviceRequestedFeatures &features)
+  {
+    archive &features.experimental &features.max_nodes_group &features.nodes_features;
+    archive &features.use_hair &features.use_hair_thick;
+    archive &features.use_object_motion &features.use_camera_motion;
+    archive &features.use_baking &features.use_subsurface &features.use_volume;
+    archive &features.use_integrator_branched &features.use_patch_evaluation;
+    archive &features.use_transparent &features.use_shadow_tricks &features.use_principled;
+    archive &features.use_denoising &features.use_shader_raytrace;
+    archive &features.use_true_displacement &features.use_background_light;
   }
 
   template<typename T> void add(const T &data)
@@ -152,10 +220,13 @@ class RPCSend {
 
   void add(const RenderTile &tile)
   {
-    archive &tile.x &tile.y &tile.w &tile.h;
+    int task = (int)tile.task;
+    int stealing_state = (int)tile.stealing_state;
+
+    archive &task &tile.x &tile.y &tile.w &tile.h;
     archive &tile.start_sample &tile.num_samples &tile.sample;
-    archive &tile.resolution &tile.offset &tile.stride;
-    archive &tile.buffer;
+    archive &tile.resolution &tile.offset &tile.stride &tile.tile_index;
+    archive &tile.buffer &stealing_state;
   }
 
   void write()
@@ -190,8 +261,45 @@ class RPCSend {
   {
     boost::system::error_code error;
 
+    /* Scene data and render buffers compress well, which matters more than
+     * the compression time when sending over the network. A compressed size
+     * of zero in the header means the buffer follows uncompressed. */
+    vector<uint8_t> compressed;
+    uLongf compressed_size = 0;
+
+    if (size >= COMPRESS_MIN_SIZE && size <= UINT_MAX) {
+      compressed_size = compressBound(size);
+      compressed.resize(compressed_size);
+
+      if (compress2(&compressed[0], &compressed_size, (const Bytef *)buffer, size, Z_BEST_SPEED) !=
+              Z_OK ||
+          compressed_size >= size) {
+        compressed_size = 0;
+      }
+    }
+
+    ostringstream header_stream;
+    header_stream << setw(16) << hex << (size_t)compressed_size;
+    string header_str = header_stream.str();
+
     boost::asio::write(
-        socket, boost::asio::buffer(buffer, size), boost::asio::transfer_all(), error);
+        socket, boost::asio::buffer(header_str), boost::asio::transfer_all(), error);
+
+    if (error.value())
+      error_func->network_error(error.message());
+
+    if (compressed_size) {
+      VLOG(3) << "RPC send buffer " << size << " bytes, compressed to " << compressed_size
+              << " bytes.";
+      boost::asio::write(socket,
+                         boost::asio::buffer(&compressed[0], compressed_size),
+                         boost::asio::transfer_all(),
+                         error);
+    }
+    else {
+      boost::asio::write(
+          socket, boost::asio::buffer(buffer, size), boost::asio::transfer_all(), error);
+    }
 
     if (error.value())
       error_func->network_error(error.message());
@@ -246,7 +354,7 @@ class RPCReceive {
           archive = new i_archive(*archive_stream);
 
           *archive &name;
-          fprintf(stderr, "rpc receive %s\n", name.c_str());
+          VLOG(3) << "RPC receive " << name;
         }
         else {
           error_func->network_error("Network receive error: data size doesn't match header");
@@ -272,9 +380,13 @@ class RPCReceive {
     *archive &mem.data_type &mem.data_elements &mem.data_size;
     *archive &mem.data_width &mem.data_height &mem.data_depth &mem.device_pointer;
     *archive &mem.type &name;
-    *archive &mem.interpolation &mem.extension;
     *archive &mem.device_pointer;
 
+    if (mem.type == MEM_TEXTURE) {
+      *archive &mem.slot;
+      read(mem.info);
+    }
+
     mem.name = name.c_str();
     mem.host_pointer = 0;
 
@@ -284,6 +396,30 @@ class RPCReceive {
     }
   }
 
+  void read(TextureInfo &info)
+  {
+    *archive &info.data_type &info.interpolation &info.extension;
+    *archive &info.width &info.height &info.depth;
+    *archive &info.use_transform_3d;
+
+    float *transform = (float *)&info.transform_3d;
+    for (size_t i = 0; i < sizeof(Transform) / sizeof(float); i++) {
+      *archive &transform[i];
+    }
+  }
+
+  void read(DeviceRequestedFeatures &features)
+  {
+    *archive &features.experimental &features.max_nodes_group &features.nodes_features;
+    *archive &features.use_hair &features.use_hair_thick;
+    *archive &features.use_object_motion &features.use_camera_motion;
+    *archive &features.use_baking &features.use_subsurface &features.use_volume;
+    *archive &features.use_integrator_branched &features.use_patch_evaluation;
+    *archive &features.use_transparent &features.use_shadow_tricks &features.use_principled;
+    *archive &features.use_denoising &features.use_shader_raytrace;
+    *archive &features.use_true_displacement &features.use_background_light;
+  }
+
   template<typename T> void read(T &data)
   {
     *archive &data;
@@ -292,7 +428,43 @@ class RPCReceive {
   void read_buffer(void *buffer, size_t size)
   {
     boost::system::error_code error;
-    size_t len = boost::asio::read(socket, boost::asio::buffer(buffer, size), error);
+
+    /* Read header with size of compressed data, see RPCSend::write_buffer. */
+    vector<char> header(16);
+    size_t len = boost::asio::read(socket, boost::asio::buffer(header), error);
+
+    size_t compressed_size = 0;
+    if (len == header.size()) {
+      istringstream header_stream(string(&header[0], header.size()));
+      if (!(header_stream >> hex >> compressed_size)) {
+        error_func->network_error("Network receive error: can't decode buffer header");
+        return;
+      }
+    }
+    else {
+      error_func->network_error("Network receive error: invalid buffer header size");
+      return;
+    }
+
+    if (compressed_size) {
+      vector<uint8_t> compressed(compressed_size);
+      len = boost::asio::read(socket, boost::asio::buffer(compressed), error);
+
+      if (error.value()) {
+        error_func->network_error(error.message());
+      }
+
+      uLongf uncompressed_size = size;
+      if (len != compressed_size ||
+          uncompress((Bytef *)buffer, &uncompressed_size, &compressed[0], compressed_size) !=
+              Z_OK ||
+          uncompressed_size != size) {
+        error_func->network_error("Network receive error: failed to decompress buffer");
+      }
+      return;
+    }
+
+    len = boost::asio::read(socket, boost::asio::buffer(buffer, size), error);
 
     if (error.value()) {
       error_func->network_error(error.message());
@@ -318,11 +490,15 @@ class RPCReceive {
 
   void read(RenderTile &tile)
   {
-    *archive &tile.x &tile.y &tile.w &tile.h;
+    int task, stealing_state;
+
+    *archive &task &tile.x &tile.y &tile.w &tile.h;
     *archive &tile.start_sample &tile.num_samples &tile.sample;
-    *archive &tile.resolution &tile.offset &tile.stride;
-    *archive &tile.buffer;
+    *archive &tile.resolution &tile.offset &tile.stride &tile.tile_index;
+    *archive &tile.buffer &stealing_state;
 
+    tile.task = (RenderTile::Task)task;
+    tile.stealing_state = (RenderTile::StealingState)stealing_state;
     tile.buffers = NULL;
   }
 
@@ -340,8 +516,8 @@ class RPCReceive {
 
 class ServerDiscovery {
  public:
-  explicit ServerDiscovery(bool discover = false)
-      : listen_socket(io_service), collect_servers(false)
+  explicit ServerDiscovery(bool discover = false, int server_port = SERVER_PORT)
+      : listen_socket(io_service), server_port(server_port), collect_servers(false)
   {
     /* setup listen socket */
     listen_endpoint.address(boost::asio::ip::address_v4::any());
@@ -400,10 +576,14 @@ class ServerDiscovery {
     if (size > 0) {
       string msg = string(receive_buffer, size);
 
-      /* handle incoming message */
+      /* handle incoming message, replies contain the port of the server so
+       * multiple servers can run on the same machine */
       if (collect_servers) {
-        if (msg == DISCOVER_REPLY_MSG) {
+        if (string_startswith(msg, DISCOVER_REPLY_MSG.c_str())) {
           string address = receive_endpoint.address().to_string();
+          if (msg.size() > DISCOVER_REPLY_MSG.size() + 1) {
+            address += ":" + msg.substr(DISCOVER_REPLY_MSG.size() + 1);
+          }
 
           mutex.lock();
 
@@ -419,7 +599,7 @@ class ServerDiscovery {
       else {
         /* reply to request */
         if (msg == DISCOVER_REQUEST_MSG)
-          broadcast_message(DISCOVER_REPLY_MSG);
+          broadcast_message(string_printf("%s:%d", DISCOVER_REPLY_MSG.c_str(), server_port));
       }
     }
 
@@ -478,6 +658,9 @@ class ServerDiscovery {
     string host_addr;
   };
 
+  /* port on which the server accepts connections */
+  int server_port;
+
   /* collection of server addresses in list */
   bool collect_servers;
   vector<string> servers;
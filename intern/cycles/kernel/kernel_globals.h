@@ -45,8 +45,6 @@ struct OSLThreadData;
 struct OSLShadingSystem;
 #  endif
 
-typedef unordered_map<float, float> CoverageMap;
-
 struct Intersection;
 struct VolumeStep;
 
@@ -73,10 +71,12 @@ typedef struct KernelGlobals {
   VolumeStep *decoupled_volume_steps[2];
   int decoupled_volume_steps_index;
 
-  /* A buffer for storing per-pixel coverage for Cryptomatte. */
-  CoverageMap *coverage_object;
-  CoverageMap *coverage_material;
-  CoverageMap *coverage_asset;
+  /* Per-pixel coverage for accurate Cryptomatte. Each points to an open addressed
+   * table of coverage_capacity (id, weight) slots for the current pixel. */
+  float2 *coverage_object;
+  float2 *coverage_material;
+  float2 *coverage_asset;
+  int coverage_capacity;
 
   /* split kernel */
   SplitData split_data;
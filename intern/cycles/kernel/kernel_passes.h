@@ -148,13 +148,51 @@ ccl_device_inline void kernel_write_debug_passes(KernelGlobals *kg,
 #endif /* __KERNEL_DEBUG__ */
 
 #ifdef __KERNEL_CPU__
+ccl_device_inline void kernel_write_id_coverage(float2 *slots,
+                                                int capacity,
+                                                float id,
+                                                float weight)
+{
+  kernel_assert(id != ID_NONE);
+  if (weight == 0.0f) {
+    return;
+  }
+
+  /* Linear probing, capacity is a power of two. Slots are never emptied, so a full
+   * table is searched entirely. */
+  const uint mask = capacity - 1;
+  uint slot = hash_uint(__float_as_uint(id)) & mask;
+  uint min_slot = slot;
+
+  for (int i = 0; i < capacity; i++) {
+    if (slots[slot].x == id) {
+      slots[slot].y += weight;
+      return;
+    }
+    if (slots[slot].x == ID_NONE) {
+      slots[slot] = make_float2(id, weight);
+      return;
+    }
+    if (slots[slot].y < slots[min_slot].y) {
+      min_slot = slot;
+    }
+    slot = (slot + 1) & mask;
+  }
+
+  /* Table is full, the new ID replaces the one with the lowest coverage and takes over its
+   * weight. Total coverage stays the same, and an ID with more than 1/capacity of the pixel
+   * coverage is always in the table, overestimated by at most the evicted weight. */
+  slots[min_slot] = make_float2(id, slots[min_slot].y + weight);
+}
+
 #  define WRITE_ID_SLOT(buffer, depth, id, matte_weight, name) \
-    kernel_write_id_pass_cpu(buffer, depth * 2, id, matte_weight, kg->coverage_##name)
+    kernel_write_id_pass_cpu( \
+        buffer, depth * 2, id, matte_weight, kg->coverage_##name, kg->coverage_capacity)
 ccl_device_inline size_t kernel_write_id_pass_cpu(
-    float *buffer, size_t depth, float id, float matte_weight, CoverageMap *map)
+    float *buffer, size_t depth, float id, float matte_weight, float2 *slots, int capacity)
 {
-  if (map) {
-    (*map)[id] += matte_weight;
+  if (slots) {
+    kernel_write_id_coverage(slots, capacity, id, matte_weight);
     return 0;
   }
 #else /* __KERNEL_CPU__ */
@@ -54,7 +54,6 @@ ccl_device void kernel_shader_sort(KernelGlobals *kg, ccl_local_param ShaderSort
   }
   ccl_barrier(CCL_LOCAL_MEM_FENCE);
 
-  /* skip sorting for cpu split kernel */
 #  ifdef __KERNEL_OPENCL__
 
   /* bitonic sort */
@@ -77,6 +76,37 @@ ccl_device void kernel_shader_sort(KernelGlobals *kg, ccl_local_param ShaderSort
       }
     }
   }
+#  else
+  /* On CPU the whole block is handled by a single work item, so sort it with
+   * a sequential bottom-up merge sort. Grouping rays by shader improves
+   * coherence of the shader evaluation that follows. Only the part of the
+   * block which is inside the queue needs sorting, the rest is empty. */
+  ccl_local ushort *local_temp = &locals->local_temp[0];
+  const int num_sort = min((int)(qsize - offset), SHADER_SORT_BLOCK_SIZE);
+
+  for (int width = 1; width < num_sort; width <<= 1) {
+    for (int left = 0; left < num_sort; left += 2 * width) {
+      const int mid = min(left + width, num_sort);
+      const int right = min(left + 2 * width, num_sort);
+      int i = left, j = mid, k = left;
+
+      while (i < mid && j < right) {
+        local_temp[k++] = (local_value[local_index[j]] < local_value[local_index[i]]) ?
+                              local_index[j++] :
+                              local_index[i++];
+      }
+      while (i < mid) {
+        local_temp[k++] = local_index[i++];
+      }
+      while (j < right) {
+        local_temp[k++] = local_index[j++];
+      }
+    }
+
+    for (int i = 0; i < num_sort; i++) {
+      local_index[i] = local_temp[i];
+    }
+  }
 #  endif /* __KERNEL_OPENCL__ */
 
   /* copy to destination */
@@ -24,7 +24,8 @@
 #include "kernel/kernel_globals.h"
 #include "kernel/kernel_id_passes.h"
 
-#include "util/util_map.h"
+#include "util/util_algorithm.h"
+#include "util/util_task.h"
 
 CCL_NAMESPACE_BEGIN
 
@@ -54,17 +55,26 @@ void Coverage::init_path_trace()
   kg->coverage_object = kg->coverage_material = kg->coverage_asset = NULL;
 
   if (kernel_data.film.cryptomatte_passes & CRYPT_ACCURATE) {
+    /* Track a few times more IDs than are written to the passes, so the ones
+     * with the largest coverage are found reliably. Power of two for probing. */
+    const int num_slots = 2 * (kernel_data.film.cryptomatte_depth);
+    capacity = 8;
+    while (capacity < num_slots * 4) {
+      capacity *= 2;
+    }
+    kg->coverage_capacity = capacity;
+
+    const size_t size = (size_t)tile.w * tile.h * capacity;
+    const float2 empty = make_float2(ID_NONE, 0.0f);
+
     if (kernel_data.film.cryptomatte_passes & CRYPT_OBJECT) {
-      coverage_object.clear();
-      coverage_object.resize(tile.w * tile.h);
+      coverage_object.assign(size, empty);
     }
     if (kernel_data.film.cryptomatte_passes & CRYPT_MATERIAL) {
-      coverage_material.clear();
-      coverage_material.resize(tile.w * tile.h);
+      coverage_material.assign(size, empty);
     }
     if (kernel_data.film.cryptomatte_passes & CRYPT_ASSET) {
-      coverage_asset.clear();
-      coverage_asset.resize(tile.w * tile.h);
+      coverage_asset.assign(size, empty);
     }
   }
 }
@@ -73,19 +83,20 @@ void Coverage::init_pixel(int x, int y)
 {
   if (kernel_data.film.cryptomatte_passes & CRYPT_ACCURATE) {
     const int pixel_index = tile.w * (y - tile.y) + x - tile.x;
+    const size_t offset = (size_t)pixel_index * capacity;
     if (kernel_data.film.cryptomatte_passes & CRYPT_OBJECT) {
-      kg->coverage_object = &coverage_object[pixel_index];
+      kg->coverage_object = &coverage_object[offset];
     }
     if (kernel_data.film.cryptomatte_passes & CRYPT_MATERIAL) {
-      kg->coverage_material = &coverage_material[pixel_index];
+      kg->coverage_material = &coverage_material[offset];
     }
     if (kernel_data.film.cryptomatte_passes & CRYPT_ASSET) {
-      kg->coverage_asset = &coverage_asset[pixel_index];
+      kg->coverage_asset = &coverage_asset[offset];
     }
   }
 }
 
-void Coverage::finalize_buffer(vector<CoverageMap> &coverage, const int pass_offset)
+void Coverage::finalize_buffer(vector<float2> &coverage, const int pass_offset)
 {
   if (kernel_data.film.cryptomatte_passes & CRYPT_ACCURATE) {
     flatten_buffer(coverage, pass_offset);
@@ -95,46 +106,59 @@ void Coverage::finalize_buffer(vector<CoverageMap> &coverage, const int pass_off
   }
 }
 
-void Coverage::flatten_buffer(vector<CoverageMap> &coverage, const int pass_offset)
+void Coverage::flatten_buffer(vector<float2> &coverage, const int pass_offset)
 {
-  /* Sort the coverage map and write it to the output */
-  int pixel_index = 0;
-  int pass_stride = tile.buffers->params.get_passes_size();
-  for (int y = 0; y < tile.h; ++y) {
-    for (int x = 0; x < tile.w; ++x) {
-      const CoverageMap &pixel = coverage[pixel_index];
-      if (!pixel.empty()) {
+  /* Sort the coverage of each pixel and write it to the output, pixels are
+   * independent so rows are processed in parallel. */
+  const int pass_stride = tile.buffers->params.get_passes_size();
+  const int num_slots = 2 * (kernel_data.film.cryptomatte_depth);
+  const int pixel_stride = capacity;
+
+  parallel_for(blocked_range<int>(0, tile.h), [&](const blocked_range<int> &r) {
+    vector<pair<float, float>> sorted_pixel;
+    sorted_pixel.reserve(capacity);
+
+    for (int y = r.begin(); y != r.end(); ++y) {
+      for (int x = 0; x < tile.w; ++x) {
+        const float2 *pixel = &coverage[(size_t)(x + y * tile.w) * pixel_stride];
+
+        sorted_pixel.clear();
+        for (int i = 0; i < capacity; ++i) {
+          if (pixel[i].x != ID_NONE) {
+            sorted_pixel.push_back(std::make_pair(pixel[i].y, pixel[i].x));
+          }
+        }
+        if (sorted_pixel.empty()) {
+          continue;
+        }
+
         /* buffer offset */
         int index = x + y * tile.stride;
         float *buffer = (float *)tile.buffer + index * pass_stride;
 
-        /* sort the cryptomatte pixel */
-        vector<pair<float, float>> sorted_pixel;
-        for (CoverageMap::const_iterator it = pixel.begin(); it != pixel.end(); ++it) {
-          sorted_pixel.push_back(std::make_pair(it->second, it->first));
+        /* Only the IDs with the largest coverage fit, the rest go to the last slot. */
+        int limit = min(num_slots, (int)sorted_pixel.size());
+        std::partial_sort(sorted_pixel.begin(),
+                          sorted_pixel.begin() + limit,
+                          sorted_pixel.end(),
+                          crypomatte_comp);
+        float leftover = 0.0f;
+        for (vector<pair<float, float>>::iterator it = sorted_pixel.begin() + limit;
+             it != sorted_pixel.end();
+             ++it) {
+          leftover += it->first;
         }
-        sort(sorted_pixel.begin(), sorted_pixel.end(), crypomatte_comp);
-        int num_slots = 2 * (kernel_data.film.cryptomatte_depth);
-        if (sorted_pixel.size() > num_slots) {
-          float leftover = 0.0f;
-          for (vector<pair<float, float>>::iterator it = sorted_pixel.begin() + num_slots;
-               it != sorted_pixel.end();
-               ++it) {
-            leftover += it->first;
-          }
-          sorted_pixel[num_slots - 1].first += leftover;
-        }
-        int limit = min(num_slots, sorted_pixel.size());
+        sorted_pixel[limit - 1].first += leftover;
+
         for (int i = 0; i < limit; ++i) {
           kernel_write_id_slots(buffer + kernel_data.film.pass_cryptomatte + pass_offset,
-                                2 * (kernel_data.film.cryptomatte_depth),
+                                num_slots,
                                 sorted_pixel[i].second,
                                 sorted_pixel[i].first);
         }
       }
-      ++pixel_index;
     }
-  }
+  });
 }
 
 void Coverage::sort_buffer(const int pass_offset)
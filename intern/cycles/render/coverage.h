@@ -17,7 +17,7 @@
 #ifndef __COVERAGE_H__
 #define __COVERAGE_H__
 
-#include "util/util_map.h"
+#include "util/util_types.h"
 #include "util/util_vector.h"
 
 CCL_NAMESPACE_BEGIN
@@ -25,11 +25,16 @@ CCL_NAMESPACE_BEGIN
 struct KernelGlobals;
 class RenderTile;
 
-typedef unordered_map<float, float> CoverageMap;
+/* Accumulates Cryptomatte coverage per pixel of a tile for accurate mode.
+ *
+ * Every pixel has a fixed capacity open addressed table of (id, weight) slots,
+ * so memory depends on tile size and Cryptomatte levels, not on the number of
+ * objects in the scene. When the table of a pixel is full, a new ID replaces
+ * the one with the lowest coverage. */
 
 class Coverage {
  public:
-  Coverage(KernelGlobals *kg_, RenderTile &tile_) : kg(kg_), tile(tile_)
+  Coverage(KernelGlobals *kg_, RenderTile &tile_) : kg(kg_), tile(tile_), capacity(0)
   {
   }
   void init_path_trace();
@@ -37,13 +42,14 @@ class Coverage {
   void finalize();
 
  private:
-  vector<CoverageMap> coverage_object;
-  vector<CoverageMap> coverage_material;
-  vector<CoverageMap> coverage_asset;
+  vector<float2> coverage_object;
+  vector<float2> coverage_material;
+  vector<float2> coverage_asset;
   KernelGlobals *kg;
   RenderTile &tile;
-  void finalize_buffer(vector<CoverageMap> &coverage, const int pass_offset);
-  void flatten_buffer(vector<CoverageMap> &coverage, const int pass_offset);
+  int capacity;
+  void finalize_buffer(vector<float2> &coverage, const int pass_offset);
+  void flatten_buffer(vector<float2> &coverage, const int pass_offset);
   void sort_buffer(const int pass_offset);
 };
 
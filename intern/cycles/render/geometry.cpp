@@ -1347,6 +1347,24 @@ void GeometryManager::device_update_volume_images(Device *device, Scene *scene,
   pool.wait_work();
 }
 
+static void tessellate_mesh(
+    Mesh *mesh, Progress *progress, size_t n, size_t total, bool use_tessellation_cache)
+{
+  if (progress->get_cancel())
+    return;
+
+  string msg = "Tessellating ";
+  if (mesh->name == "")
+    msg += string_printf("%u/%u", (uint)(n + 1), (uint)total);
+  else
+    msg += string_printf("%s %u/%u", mesh->name.c_str(), (uint)(n + 1), (uint)total);
+
+  progress->set_status("Updating Mesh", msg);
+
+  DiagSplit dsplit(*mesh->subd_params);
+  mesh->tessellate(&dsplit, use_tessellation_cache);
+}
+
 void GeometryManager::device_update(Device *device,
                                     DeviceScene *dscene,
                                     Scene *scene,
@@ -1413,6 +1431,13 @@ void GeometryManager::device_update(Device *device,
     Camera *dicing_camera = scene->dicing_camera;
     dicing_camera->update(scene);
 
+    /* Diced meshes are only kept for reuse when the scene is synced again. */
+    const bool use_tessellation_cache = !scene->params.background ||
+                                        scene->params.persistent_data;
+
+    /* Meshes are tessellated in parallel, dicing of each mesh is threaded too. */
+    TaskPool pool;
+
     size_t i = 0;
     foreach (Geometry *geom, scene->geometry) {
       if (!(geom->need_update && geom->type == Geometry::MESH)) {
@@ -1422,25 +1447,23 @@ void GeometryManager::device_update(Device *device,
       Mesh *mesh = static_cast<Mesh *>(geom);
       if (mesh->subdivision_type != Mesh::SUBDIVISION_NONE && mesh->num_subd_verts == 0 &&
           mesh->subd_params) {
-        string msg = "Tessellating ";
-        if (mesh->name == "")
-          msg += string_printf("%u/%u", (uint)(i + 1), (uint)total_tess_needed);
-        else
-          msg += string_printf(
-              "%s %u/%u", mesh->name.c_str(), (uint)(i + 1), (uint)total_tess_needed);
-
-        progress.set_status("Updating Mesh", msg);
-
         mesh->subd_params->camera = dicing_camera;
-        DiagSplit dsplit(*mesh->subd_params);
-        mesh->tessellate(&dsplit);
 
-        i++;
+        pool.push(function_bind(&tessellate_mesh,
+                                mesh,
+                                &progress,
+                                i,
+                                total_tess_needed,
+                                use_tessellation_cache));
 
-        if (progress.get_cancel())
-          return;
+        i++;
       }
     }
+
+    pool.wait_work();
+
+    if (progress.get_cancel())
+      return;
   }
 
   /* Update images needed for true displacement. */
@@ -775,6 +775,35 @@ void ShaderGraph::compute_displacement_hash()
   displacement_hash = md5.get_hex();
 }
 
+bool ShaderGraph::compute_compile_hash(MD5Hash &md5)
+{
+  /* Compute hash of the finalized graph, covering everything the SVM
+   * compiler looks at. Graphs with identical hashes compile into identical
+   * SVM nodes. */
+  assert(finalized);
+
+  foreach (ShaderNode *node, nodes) {
+    if (!node->compile_hash(md5)) {
+      return false;
+    }
+
+    node->hash(md5);
+    md5.append((uint8_t *)&node->id, sizeof(node->id));
+    md5.append((uint8_t *)&node->bump, sizeof(node->bump));
+    md5.append((uint8_t *)&node->special_type, sizeof(node->special_type));
+
+    foreach (ShaderInput *input, node->inputs) {
+      int link_id = (input->link) ? input->link->parent->id : -1;
+      md5.append((uint8_t *)&link_id, sizeof(link_id));
+      if (input->link) {
+        md5.append(input->link->name().string());
+      }
+    }
+  }
+
+  return true;
+}
+
 void ShaderGraph::clean(Scene *scene)
 {
   /* Graph simplification */
@@ -268,6 +268,17 @@ class ShaderNode : public Node {
    * is to be handled in the subclass.
    */
   virtual bool equals(const ShaderNode &other);
+
+  /* Append runtime state which is not stored in sockets but affects the SVM
+   * nodes the node compiles into, such as image slots.
+   *
+   * This is used by the compiled shader cache. Returning false means that
+   * compiling the node has side effects, and the shader is not cached.
+   */
+  virtual bool compile_hash(MD5Hash & /*md5*/)
+  {
+    return true;
+  }
 };
 
 /* Node definition utility macros */
@@ -335,6 +346,7 @@ class ShaderGraph : public NodeOwner {
 
   void remove_proxy_nodes();
   void compute_displacement_hash();
+  bool compute_compile_hash(MD5Hash &md5);
   void simplify(Scene *scene);
   void finalize(Scene *scene,
                 bool do_bump = false,
@@ -165,6 +165,31 @@ class Mesh : public Geometry {
   friend class DiagSplit;
   friend class GeometryManager;
 
+  /* Diced result of the last tessellation. Syncing clears the mesh, this is kept
+   * so dicing can be skipped when the mesh is tessellated again with the same
+   * control mesh, subdivision parameters and dicing camera. It is a second copy
+   * of the diced geometry, so it is only kept when the scene can be synced
+   * again: in the viewport and with persistent data. */
+  struct TessellationCache {
+    string key;
+    size_t num_subd_verts;
+    array<float3> verts;
+    array<float3> vN;
+    array<int> triangles;
+    array<int> shader;
+    array<bool> smooth;
+    array<int> triangle_patch;
+    array<float2> vert_patch_uv;
+    unordered_map<int, int> vert_to_stitching_key_map;
+    unordered_multimap<int, int> vert_stitching_map;
+  };
+  TessellationCache tessellation_cache;
+
+  string tessellation_cache_key();
+  bool tessellation_cache_restore(const string &key);
+  void tessellation_cache_store(const string &key);
+  void tessellation_cache_free();
+
  public:
   /* Functions */
   Mesh();
@@ -201,7 +226,7 @@ class Mesh : public Geometry {
                   size_t tri_offset);
   void pack_patches(uint *patch_data, uint vert_offset, uint face_offset, uint corner_offset);
 
-  void tessellate(DiagSplit *split);
+  void tessellate(DiagSplit *split, bool use_tessellation_cache);
 };
 
 CCL_NAMESPACE_END
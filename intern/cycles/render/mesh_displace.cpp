@@ -25,6 +25,7 @@
 #include "util/util_map.h"
 #include "util/util_progress.h"
 #include "util/util_set.h"
+#include "util/util_task.h"
 
 CCL_NAMESPACE_BEGIN
 
@@ -64,9 +65,9 @@ bool GeometryManager::displace(
     }
   }
 
-  /* setup input for device task */
+  /* setup input for device task, remembering where the output of each vert goes */
   const size_t num_verts = mesh->verts.size();
-  vector<bool> done(num_verts, false);
+  vector<int> vert_output(num_verts, -1);
   device_vector<uint4> d_input(device, "displace_input", MEM_READ_ONLY);
   uint4 *d_input_data = d_input.alloc(num_verts);
   size_t d_input_size = 0;
@@ -84,10 +85,10 @@ bool GeometryManager::displace(
     }
 
     for (int j = 0; j < 3; j++) {
-      if (done[t.v[j]])
+      if (vert_output[t.v[j]] != -1)
         continue;
 
-      done[t.v[j]] = true;
+      vert_output[t.v[j]] = d_input_size;
 
       /* set up object, primitive and barycentric coordinates */
       int object = object_index;
@@ -148,41 +149,30 @@ bool GeometryManager::displace(
   d_output.copy_from_device(0, 1, d_output.size());
   d_input.free();
 
-  /* read result */
-  done.clear();
-  done.resize(num_verts, false);
-  int k = 0;
-
-  float4 *offset = d_output.data();
+  /* read result, verts are independent so this can be done in parallel */
+  static const int VERTS_PER_TASK = 4096;
+  const float4 *offset = d_output.data();
 
   Attribute *attr_mP = mesh->attributes.find(ATTR_STD_MOTION_VERTEX_POSITION);
-  for (size_t i = 0; i < num_triangles; i++) {
-    Mesh::Triangle t = mesh->get_triangle(i);
-    int shader_index = mesh->shader[i];
-    Shader *shader = (shader_index < mesh->used_shaders.size()) ?
-                         mesh->used_shaders[shader_index] :
-                         scene->default_surface;
-
-    if (!shader->has_displacement || shader->displacement_method == DISPLACE_BUMP) {
-      continue;
-    }
-
-    for (int j = 0; j < 3; j++) {
-      if (!done[t.v[j]]) {
-        done[t.v[j]] = true;
-        float3 off = float4_to_float3(offset[k++]);
-        /* Avoid illegal vertex coordinates. */
-        off = ensure_finite3(off);
-        mesh->verts[t.v[j]] += off;
-        if (attr_mP != NULL) {
-          for (int step = 0; step < mesh->motion_steps - 1; step++) {
-            float3 *mP = attr_mP->data_float3() + step * num_verts;
-            mP[t.v[j]] += off;
-          }
-        }
-      }
-    }
-  }
+  parallel_for(blocked_range<size_t>(0, num_verts, VERTS_PER_TASK),
+               [&](const blocked_range<size_t> &r) {
+                 for (size_t vert = r.begin(); vert != r.end(); vert++) {
+                   if (vert_output[vert] == -1) {
+                     continue;
+                   }
+
+                   float3 off = float4_to_float3(offset[vert_output[vert]]);
+                   /* Avoid illegal vertex coordinates. */
+                   off = ensure_finite3(off);
+                   mesh->verts[vert] += off;
+                   if (attr_mP != NULL) {
+                     for (int step = 0; step < mesh->motion_steps - 1; step++) {
+                       float3 *mP = attr_mP->data_float3() + step * num_verts;
+                       mP[vert] += off;
+                     }
+                   }
+                 }
+               });
 
   d_output.free();
 
@@ -194,29 +184,35 @@ bool GeometryManager::displace(
 
   typedef unordered_multimap<int, int>::iterator map_it_t;
 
-  for (int key : stitch_keys) {
-    pair<map_it_t, map_it_t> verts = mesh->vert_stitching_map.equal_range(key);
+  /* each vert has a single stitching key, so keys can be averaged in parallel */
+  const vector<int> stitch_keys_list(stitch_keys.begin(), stitch_keys.end());
+  parallel_for(blocked_range<size_t>(0, stitch_keys_list.size(), VERTS_PER_TASK),
+               [&](const blocked_range<size_t> &r) {
+                 for (size_t i = r.begin(); i != r.end(); i++) {
+                   pair<map_it_t, map_it_t> verts = mesh->vert_stitching_map.equal_range(
+                       stitch_keys_list[i]);
 
-    float3 pos = make_float3(0.0f, 0.0f, 0.0f);
-    int num = 0;
+                   float3 pos = make_float3(0.0f, 0.0f, 0.0f);
+                   int num = 0;
 
-    for (map_it_t v = verts.first; v != verts.second; ++v) {
-      int vert = v->second;
+                   for (map_it_t v = verts.first; v != verts.second; ++v) {
+                     int vert = v->second;
 
-      pos += mesh->verts[vert];
-      num++;
-    }
+                     pos += mesh->verts[vert];
+                     num++;
+                   }
 
-    if (num <= 1) {
-      continue;
-    }
+                   if (num <= 1) {
+                     continue;
+                   }
 
-    pos *= 1.0f / num;
+                   pos *= 1.0f / num;
 
-    for (map_it_t v = verts.first; v != verts.second; ++v) {
-      mesh->verts[v->second] = pos;
-    }
-  }
+                   for (map_it_t v = verts.first; v != verts.second; ++v) {
+                     mesh->verts[v->second] = pos;
+                   }
+                 }
+               });
 
   /* for displacement method both, we only need to recompute the face
    * normals, as bump mapping in the shader will already alter the
@@ -248,6 +244,17 @@ bool GeometryManager::displace(
                              shader->displacement_method == DISPLACE_TRUE;
     }
 
+    /* verts used by triangles with true displacement, for normalizing in parallel */
+    vector<char> vert_has_true_disp(num_verts, false);
+
+    for (size_t i = 0; i < num_triangles; i++) {
+      if (tri_has_true_disp[i]) {
+        for (size_t j = 0; j < 3; j++) {
+          vert_has_true_disp[mesh->get_triangle(i).v[j]] = true;
+        }
+      }
+    }
+
     /* static vertex normals */
 
     /* get attributes */
@@ -296,26 +303,16 @@ bool GeometryManager::displace(
     }
 
     /* normalize vertex normals */
-    done.clear();
-    done.resize(num_verts, false);
-
-    for (size_t i = 0; i < num_triangles; i++) {
-      if (tri_has_true_disp[i]) {
-        for (size_t j = 0; j < 3; j++) {
-          int vert = mesh->get_triangle(i).v[j];
-
-          if (done[vert]) {
-            continue;
-          }
-
-          vN[vert] = normalize(vN[vert]);
-          if (flip)
-            vN[vert] = -vN[vert];
-
-          done[vert] = true;
-        }
-      }
-    }
+    parallel_for(blocked_range<size_t>(0, num_verts, VERTS_PER_TASK),
+                 [&](const blocked_range<size_t> &r) {
+                   for (size_t vert = r.begin(); vert != r.end(); vert++) {
+                     if (vert_has_true_disp[vert]) {
+                       vN[vert] = normalize(vN[vert]);
+                       if (flip)
+                         vN[vert] = -vN[vert];
+                     }
+                   }
+                 });
 
     /* motion vertex normals */
     Attribute *attr_mP = mesh->attributes.find(ATTR_STD_MOTION_VERTEX_POSITION);
@@ -367,26 +364,16 @@ bool GeometryManager::displace(
         }
 
         /* normalize vertex normals */
-        done.clear();
-        done.resize(num_verts, false);
-
-        for (size_t i = 0; i < num_triangles; i++) {
-          if (tri_has_true_disp[i]) {
-            for (size_t j = 0; j < 3; j++) {
-              int vert = mesh->get_triangle(i).v[j];
-
-              if (done[vert]) {
-                continue;
-              }
-
-              mN[vert] = normalize(mN[vert]);
-              if (flip)
-                mN[vert] = -mN[vert];
-
-              done[vert] = true;
-            }
-          }
-        }
+        parallel_for(blocked_range<size_t>(0, num_verts, VERTS_PER_TASK),
+                     [&](const blocked_range<size_t> &r) {
+                       for (size_t vert = r.begin(); vert != r.end(); vert++) {
+                         if (vert_has_true_disp[vert]) {
+                           mN[vert] = normalize(mN[vert]);
+                           if (flip)
+                             mN[vert] = -mN[vert];
+                         }
+                       }
+                     });
       }
     }
   }
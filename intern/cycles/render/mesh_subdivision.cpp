@@ -25,6 +25,7 @@
 #include "util/util_algorithm.h"
 #include "util/util_foreach.h"
 #include "util/util_hash.h"
+#include "util/util_md5.h"
 
 CCL_NAMESPACE_BEGIN
 
@@ -366,7 +367,7 @@ struct OsdPatch : Patch {
 
 #endif
 
-void Mesh::tessellate(DiagSplit *split)
+void Mesh::tessellate(DiagSplit *split, bool use_tessellation_cache)
 {
 #ifdef WITH_OPENSUBDIV
   OsdData osd_data;
@@ -409,6 +410,17 @@ void Mesh::tessellate(DiagSplit *split)
     }
   }
 
+  /* reuse the previous dicing if nothing it depends on changed */
+  string cache_key;
+  bool cache_hit = false;
+  if (use_tessellation_cache) {
+    cache_key = tessellation_cache_key();
+    cache_hit = tessellation_cache_restore(cache_key);
+  }
+  else {
+    tessellation_cache_free();
+  }
+
   /* build patches from faces */
 #ifdef WITH_OPENSUBDIV
   if (subdivision_type == SUBDIVISION_CATMULL_CLARK) {
@@ -435,7 +447,9 @@ void Mesh::tessellate(DiagSplit *split)
     }
 
     /* split patches */
-    split->split_patches(osd_patches.data(), sizeof(OsdPatch));
+    if (!cache_hit) {
+      split->split_patches(osd_patches.data(), sizeof(OsdPatch));
+    }
   }
   else
 #endif
@@ -531,7 +545,13 @@ void Mesh::tessellate(DiagSplit *split)
     }
 
     /* split patches */
-    split->split_patches(linear_patches.data(), sizeof(LinearQuadPatch));
+    if (!cache_hit) {
+      split->split_patches(linear_patches.data(), sizeof(LinearQuadPatch));
+    }
+  }
+
+  if (use_tessellation_cache && !cache_hit) {
+    tessellation_cache_store(cache_key);
   }
 
   /* interpolate center points for attributes */
@@ -638,4 +658,108 @@ void Mesh::tessellate(DiagSplit *split)
 #endif
 }
 
+string Mesh::tessellation_cache_key()
+{
+  MD5Hash md5;
+
+  md5.append((uint8_t *)&subdivision_type, sizeof(subdivision_type));
+
+  /* Control mesh. */
+  md5.append((uint8_t *)verts.data(), verts.size() * sizeof(float3));
+  md5.append((uint8_t *)subd_face_corners.data(), subd_face_corners.size() * sizeof(int));
+  md5.append((uint8_t *)subd_creases.data(), subd_creases.size() * sizeof(SubdEdgeCrease));
+
+  for (size_t i = 0; i < subd_faces.size(); i++) {
+    const SubdFace &face = subd_faces[i];
+    int face_data[5] = {
+        face.start_corner, face.num_corners, face.shader, face.smooth, face.ptex_offset};
+    md5.append((uint8_t *)face_data, sizeof(face_data));
+  }
+
+  Attribute *attr_vN = subd_attributes.find(ATTR_STD_VERTEX_NORMAL);
+  if (attr_vN) {
+    md5.append((uint8_t *)attr_vN->data(), attr_vN->buffer.size());
+  }
+
+  /* Subdivision and dicing parameters. */
+  const SubdParams &params = *subd_params;
+  int iparams[4] = {params.ptex, params.test_steps, params.split_threshold, params.max_level};
+  md5.append((uint8_t *)iparams, sizeof(iparams));
+  md5.append((uint8_t *)&params.dicing_rate, sizeof(params.dicing_rate));
+  md5.append((uint8_t *)&params.objecttoworld, sizeof(params.objecttoworld));
+
+  if (params.camera) {
+    params.camera->hash(md5);
+    int size[2] = {params.camera->full_width, params.camera->full_height};
+    md5.append((uint8_t *)size, sizeof(size));
+  }
+
+  return md5.get_hex();
+}
+
+bool Mesh::tessellation_cache_restore(const string &key)
+{
+  TessellationCache &cache = tessellation_cache;
+
+  if (cache.key != key) {
+    return false;
+  }
+
+  const size_t num_verts = verts.size();
+  const size_t num_triangles = cache.triangles.size() / 3;
+
+  /* Same attributes as EdgeDice adds. */
+  Attribute *attr_vN = attributes.add(ATTR_STD_VERTEX_NORMAL);
+  if (subd_params->ptex) {
+    attributes.add(ATTR_STD_PTEX_UV);
+    attributes.add(ATTR_STD_PTEX_FACE_ID);
+  }
+
+  resize_mesh(num_verts + cache.num_subd_verts, num_triangles);
+  num_subd_verts = cache.num_subd_verts;
+
+  std::copy_n(cache.verts.data(), cache.verts.size(), verts.data() + num_verts);
+  std::copy_n(cache.vN.data(), cache.vN.size(), attr_vN->data_float3() + num_verts);
+  std::copy_n(cache.triangles.data(), cache.triangles.size(), triangles.data());
+  std::copy_n(cache.shader.data(), cache.shader.size(), shader.data());
+  std::copy_n(cache.smooth.data(), cache.smooth.size(), smooth.data());
+  std::copy_n(cache.triangle_patch.data(), cache.triangle_patch.size(), triangle_patch.data());
+  std::copy_n(cache.vert_patch_uv.data(), cache.vert_patch_uv.size(), vert_patch_uv.data());
+
+  vert_to_stitching_key_map = cache.vert_to_stitching_key_map;
+  vert_stitching_map = cache.vert_stitching_map;
+
+  return true;
+}
+
+void Mesh::tessellation_cache_store(const string &key)
+{
+  TessellationCache &cache = tessellation_cache;
+  const size_t num_verts = verts.size() - num_subd_verts;
+
+  Attribute *attr_vN = attributes.find(ATTR_STD_VERTEX_NORMAL);
+  const float3 *vN = attr_vN->data_float3();
+
+  cache.key = key;
+  cache.num_subd_verts = num_subd_verts;
+
+  cache.verts.resize(num_subd_verts);
+  cache.vN.resize(num_subd_verts);
+  std::copy_n(verts.data() + num_verts, num_subd_verts, cache.verts.data());
+  std::copy_n(vN + num_verts, num_subd_verts, cache.vN.data());
+
+  cache.triangles = triangles;
+  cache.shader = shader;
+  cache.smooth = smooth;
+  cache.triangle_patch = triangle_patch;
+  cache.vert_patch_uv = vert_patch_uv;
+  cache.vert_to_stitching_key_map = vert_to_stitching_key_map;
+  cache.vert_stitching_map = vert_stitching_map;
+}
+
+void Mesh::tessellation_cache_free()
+{
+  tessellation_cache = TessellationCache();
+}
+
 CCL_NAMESPACE_END
@@ -31,6 +31,7 @@
 
 #include "util/util_foreach.h"
 #include "util/util_logging.h"
+#include "util/util_md5.h"
 #include "util/util_transform.h"
 
 #include "kernel/svm/svm_color_util.h"
@@ -206,6 +207,33 @@ void TextureMapping::compile(OSLCompiler &compiler)
   }
 }
 
+/* Image Slot Texture */
+
+static bool image_handle_compile_hash(ImageHandle &handle, MD5Hash &md5)
+{
+  /* Images are added to the image manager on first compile. */
+  if (handle.empty()) {
+    return false;
+  }
+
+  const int num_tiles = handle.num_tiles();
+  md5.append((uint8_t *)&num_tiles, sizeof(num_tiles));
+  for (int i = 0; i < num_tiles; i++) {
+    const int slot = handle.svm_slot(i);
+    md5.append((uint8_t *)&slot, sizeof(slot));
+  }
+
+  const uint8_t compress_as_srgb = handle.metadata().compress_as_srgb;
+  md5.append(&compress_as_srgb, sizeof(compress_as_srgb));
+
+  return true;
+}
+
+bool ImageSlotTextureNode::compile_hash(MD5Hash &md5)
+{
+  return image_handle_compile_hash(handle, md5);
+}
+
 /* Image Texture */
 
 NODE_DEFINE(ImageTextureNode)
@@ -269,6 +297,19 @@ ShaderNode *ImageTextureNode::clone(ShaderGraph *graph) const
   return node;
 }
 
+bool ImageTextureNode::compile_hash(MD5Hash &md5)
+{
+  if (!ImageSlotTextureNode::compile_hash(md5)) {
+    return false;
+  }
+
+  foreach (int tile, tiles) {
+    md5.append((uint8_t *)&tile, sizeof(tile));
+  }
+
+  return true;
+}
+
 ImageParams ImageTextureNode::image_params() const
 {
   ImageParams params;
@@ -817,6 +858,16 @@ SkyTextureNode::SkyTextureNode() : TextureNode(node_type)
 {
 }
 
+bool SkyTextureNode::compile_hash(MD5Hash &md5)
+{
+  /* Only the Nishita model uses a precomputed image. */
+  if (type != NODE_SKY_NISHITA) {
+    return true;
+  }
+
+  return image_handle_compile_hash(handle, md5);
+}
+
 void SkyTextureNode::compile(SVMCompiler &compiler)
 {
   ShaderInput *vector_in = input("Vector");
@@ -1792,6 +1843,11 @@ ShaderNode *PointDensityTextureNode::clone(ShaderGraph *graph) const
   return node;
 }
 
+bool PointDensityTextureNode::compile_hash(MD5Hash &md5)
+{
+  return image_handle_compile_hash(handle, md5);
+}
+
 void PointDensityTextureNode::attributes(Shader *shader, AttributeRequestSet *attributes)
 {
   if (shader->has_volume)
@@ -5940,6 +5996,13 @@ void OutputAOVNode::simplify_settings(Scene *scene)
   }
 }
 
+bool OutputAOVNode::compile_hash(MD5Hash &md5)
+{
+  md5.append((uint8_t *)&slot, sizeof(slot));
+  md5.append((uint8_t *)&is_color, sizeof(is_color));
+  return true;
+}
+
 void OutputAOVNode::compile(SVMCompiler &compiler)
 {
   assert(slot >= 0);
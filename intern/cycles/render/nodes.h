@@ -86,6 +86,8 @@ class ImageSlotTextureNode : public TextureNode {
     return TextureNode::equals(other) && handle == other_node.handle;
   }
 
+  virtual bool compile_hash(MD5Hash &md5);
+
   ImageHandle handle;
 };
 
@@ -105,6 +107,8 @@ class ImageTextureNode : public ImageSlotTextureNode {
     return ImageSlotTextureNode::equals(other) && animated == other_node.animated;
   }
 
+  virtual bool compile_hash(MD5Hash &md5);
+
   ImageParams image_params() const;
 
   /* Parameters. */
@@ -164,6 +168,8 @@ class SkyTextureNode : public TextureNode {
     return NODE_GROUP_LEVEL_2;
   }
 
+  virtual bool compile_hash(MD5Hash &md5);
+
   NodeSkyType type;
   float3 sun_direction;
   float turbidity;
@@ -224,6 +230,8 @@ class OutputAOVNode : public ShaderNode {
     return false;
   }
 
+  virtual bool compile_hash(MD5Hash &md5);
+
   int slot;
   bool is_color;
 };
@@ -393,6 +401,8 @@ class PointDensityTextureNode : public ShaderNode {
     const PointDensityTextureNode &other_node = (const PointDensityTextureNode &)other;
     return ShaderNode::equals(other) && handle == other_node.handle;
   }
+
+  virtual bool compile_hash(MD5Hash &md5);
 };
 
 class IESLightNode : public TextureNode {
@@ -406,6 +416,12 @@ class IESLightNode : public TextureNode {
     return NODE_GROUP_LEVEL_2;
   }
 
+  /* Slot is allocated in the light manager during compilation. */
+  virtual bool compile_hash(MD5Hash & /*md5*/)
+  {
+    return false;
+  }
+
   ustring filename;
   ustring ies;
 
@@ -1528,6 +1544,11 @@ class OSLNode : public ShaderNode {
     return false;
   }
 
+  virtual bool compile_hash(MD5Hash & /*md5*/)
+  {
+    return false;
+  }
+
   string filepath;
   string bytecode_hash;
 };
@@ -28,6 +28,7 @@
 
 #include "util/util_foreach.h"
 #include "util/util_logging.h"
+#include "util/util_md5.h"
 #include "util/util_progress.h"
 #include "util/util_task.h"
 
@@ -36,6 +37,7 @@ CCL_NAMESPACE_BEGIN
 /* Shader Manager */
 
 SVMShaderManager::SVMShaderManager()
+    : shader_cache_update(0), shader_cache_hits(0), shader_cache_misses(0)
 {
 }
 
@@ -57,18 +59,109 @@ void SVMShaderManager::device_update_shader(Scene *scene,
   }
   assert(shader->graph);
 
-  svm_nodes->push_back_slow(make_int4(NODE_SHADER_JUMP, 0, 0, 0));
-
   SVMCompiler::Summary summary;
   SVMCompiler compiler(scene);
   compiler.background = (shader == scene->background->get_shader(scene));
+  compiler.finalize(shader, &summary);
+
+  /* Reuse nodes from an identical graph compiled before. */
+  string cache_key;
+  if (compiler.compile_hash(shader, cache_key) &&
+      shader_cache_find(cache_key, shader, svm_nodes)) {
+    VLOG(2) << "Shader " << shader->name << " found in compiled shader cache.";
+    return;
+  }
+
+  svm_nodes->push_back_slow(make_int4(NODE_SHADER_JUMP, 0, 0, 0));
   compiler.compile(shader, *svm_nodes, 0, &summary);
 
+  /* Failed graphs are compiled again, so the error is reported for every shader using them. */
+  if (!cache_key.empty() && !compiler.has_failed()) {
+    shader_cache_add(cache_key, shader, *svm_nodes);
+  }
+
   VLOG(2) << "Compilation summary:\n"
           << "Shader name: " << shader->name << "\n"
           << summary.full_report();
 }
 
+/* Shader flags which are computed by the compiler, and restored on cache hits. */
+static bool Shader::*const shader_compile_flags[] = {
+    &Shader::has_surface,
+    &Shader::has_surface_emission,
+    &Shader::has_surface_transparent,
+    &Shader::has_surface_bssrdf,
+    &Shader::has_bump,
+    &Shader::has_bssrdf_bump,
+    &Shader::has_volume,
+    &Shader::has_displacement,
+    &Shader::has_surface_spatial_varying,
+    &Shader::has_volume_spatial_varying,
+    &Shader::has_volume_attribute_dependency,
+    &Shader::has_integrator_dependency,
+};
+static const int num_shader_compile_flags = sizeof(shader_compile_flags) /
+                                            sizeof(*shader_compile_flags);
+
+bool SVMShaderManager::shader_cache_find(const string &key,
+                                         Shader *shader,
+                                         array<int4> *svm_nodes)
+{
+  thread_scoped_lock lock(shader_cache_mutex);
+
+  unordered_map<string, CachedShader>::iterator it = shader_cache.find(key);
+  if (it == shader_cache.end()) {
+    shader_cache_misses++;
+    return false;
+  }
+
+  CachedShader &entry = it->second;
+  entry.last_update = shader_cache_update;
+  shader_cache_hits++;
+
+  *svm_nodes = entry.svm_nodes;
+  for (int i = 0; i < num_shader_compile_flags; i++) {
+    shader->*shader_compile_flags[i] = (entry.flags & (1 << i)) != 0;
+  }
+
+  return true;
+}
+
+void SVMShaderManager::shader_cache_add(const string &key,
+                                        Shader *shader,
+                                        const array<int4> &svm_nodes)
+{
+  CachedShader entry;
+  entry.svm_nodes = svm_nodes;
+  entry.flags = 0;
+  entry.last_update = shader_cache_update;
+  for (int i = 0; i < num_shader_compile_flags; i++) {
+    if (shader->*shader_compile_flags[i]) {
+      entry.flags |= (1 << i);
+    }
+  }
+
+  thread_scoped_lock lock(shader_cache_mutex);
+  /* Another shader with the same graph may have been compiled concurrently,
+   * in which case the existing entry is kept. */
+  shader_cache.insert(std::make_pair(key, entry));
+}
+
+void SVMShaderManager::shader_cache_evict_unused()
+{
+  /* All shaders are compiled on each update, so entries which were not used
+   * belong to shaders which no longer exist. */
+  unordered_map<string, CachedShader>::iterator it = shader_cache.begin();
+  while (it != shader_cache.end()) {
+    if (it->second.last_update != shader_cache_update) {
+      it = shader_cache.erase(it);
+    }
+    else {
+      ++it;
+    }
+  }
+}
+
 void SVMShaderManager::device_update(Device *device,
                                      DeviceScene *dscene,
                                      Scene *scene,
@@ -92,6 +185,10 @@ void SVMShaderManager::device_update(Device *device,
   /* test if we need to update */
   device_free(device, dscene, scene);
 
+  shader_cache_update++;
+  shader_cache_hits = 0;
+  shader_cache_misses = 0;
+
   /* Build all shaders. */
   TaskPool task_pool;
   vector<array<int4>> shader_svm_nodes(num_shaders);
@@ -157,12 +254,16 @@ void SVMShaderManager::device_update(Device *device,
 
   dscene->svm_nodes.copy_to_device();
 
+  shader_cache_evict_unused();
+
   device_update_common(device, dscene, scene, progress);
 
   need_update = false;
 
   VLOG(1) << "Shader manager updated " << num_shaders << " shaders in " << time_dt() - start_time
           << " seconds.";
+  VLOG(1) << "Compiled shader cache: " << shader_cache_hits << " hits, " << shader_cache_misses
+          << " misses, " << shader_cache.size() << " entries.";
 }
 
 void SVMShaderManager::device_free(Device *device, DeviceScene *dscene, Scene *scene)
@@ -180,9 +281,11 @@ SVMCompiler::SVMCompiler(Scene *scene) : scene(scene)
   current_type = SHADER_TYPE_SURFACE;
   current_shader = NULL;
   current_graph = NULL;
+  has_bump = false;
   background = false;
   mix_weight_offset = SVM_STACK_INVALID;
   compile_failed = false;
+  any_compile_failed = false;
 }
 
 int SVMCompiler::stack_size(SocketType::Type type)
@@ -823,6 +926,7 @@ void SVMCompiler::compile_type(Shader *shader, ShaderGraph *graph, ShaderType ty
   if (compile_failed) {
     current_svm_nodes.clear();
     compile_failed = false;
+    any_compile_failed = true;
   }
 
   /* for bump shaders we fall thru to the surface shader, but if this is any other kind of shader
@@ -832,26 +936,44 @@ void SVMCompiler::compile_type(Shader *shader, ShaderGraph *graph, ShaderType ty
   }
 }
 
-void SVMCompiler::compile(Shader *shader, array<int4> &svm_nodes, int index, Summary *summary)
+void SVMCompiler::finalize(Shader *shader, Summary *summary)
 {
+  scoped_timer timer((summary != NULL) ? &summary->time_finalize : NULL);
+
   /* copy graph for shader with bump mapping */
   ShaderNode *output = shader->graph->output();
-  int start_num_svm_nodes = svm_nodes.size();
-
-  const double time_start = time_dt();
+  has_bump = (shader->displacement_method != DISPLACE_TRUE) && output->input("Surface")->link &&
+             output->input("Displacement")->link;
 
-  bool has_bump = (shader->displacement_method != DISPLACE_TRUE) &&
-                  output->input("Surface")->link && output->input("Displacement")->link;
+  shader->graph->finalize(scene,
+                          has_bump,
+                          shader->has_integrator_dependency,
+                          shader->displacement_method == DISPLACE_BOTH);
+}
 
-  /* finalize */
-  {
-    scoped_timer timer((summary != NULL) ? &summary->time_finalize : NULL);
-    shader->graph->finalize(scene,
-                            has_bump,
-                            shader->has_integrator_dependency,
-                            shader->displacement_method == DISPLACE_BOTH);
+bool SVMCompiler::compile_hash(Shader *shader, string &hash)
+{
+  MD5Hash md5;
+  if (!shader->graph->compute_compile_hash(md5)) {
+    return false;
   }
 
+  /* Shader settings used during compilation. */
+  md5.append((uint8_t *)&has_bump, sizeof(has_bump));
+  md5.append((uint8_t *)&background, sizeof(background));
+  md5.append((uint8_t *)&shader->used, sizeof(shader->used));
+  md5.append((uint8_t *)&shader->displacement_method, sizeof(shader->displacement_method));
+
+  hash = md5.get_hex();
+  return true;
+}
+
+void SVMCompiler::compile(Shader *shader, array<int4> &svm_nodes, int index, Summary *summary)
+{
+  int start_num_svm_nodes = svm_nodes.size();
+
+  const double time_start = time_dt();
+
   current_shader = shader;
 
   shader->has_surface = false;
@@ -905,7 +1027,7 @@ void SVMCompiler::compile(Shader *shader, array<int4> &svm_nodes, int index, Sum
 
   /* Fill in summary information. */
   if (summary != NULL) {
-    summary->time_total = time_dt() - time_start;
+    summary->time_total = time_dt() - time_start + summary->time_finalize;
     summary->peak_stack_usage = max_stack_use;
     summary->num_svm_nodes = svm_nodes.size() - start_num_svm_nodes;
   }
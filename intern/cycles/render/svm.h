@@ -22,6 +22,7 @@
 #include "render/shader.h"
 
 #include "util/util_array.h"
+#include "util/util_map.h"
 #include "util/util_set.h"
 #include "util/util_string.h"
 #include "util/util_thread.h"
@@ -54,6 +55,29 @@ class SVMShaderManager : public ShaderManager {
                             Shader *shader,
                             Progress *progress,
                             array<int4> *svm_nodes);
+
+  /* Compiled shader cache.
+   *
+   * SVM nodes are stored by hash of the finalized shader graph, so shaders
+   * with identical graphs share a single compilation, and unchanged shaders
+   * are not recompiled on subsequent updates. */
+  struct CachedShader {
+    array<int4> svm_nodes;
+    /* Shader flags which are set by the compiler. */
+    uint flags;
+    /* Last update in which the entry was used. */
+    int last_update;
+  };
+
+  bool shader_cache_find(const string &key, Shader *shader, array<int4> *svm_nodes);
+  void shader_cache_add(const string &key, Shader *shader, const array<int4> &svm_nodes);
+  void shader_cache_evict_unused();
+
+  unordered_map<string, CachedShader> shader_cache;
+  thread_mutex shader_cache_mutex;
+  int shader_cache_update;
+  int shader_cache_hits;
+  int shader_cache_misses;
 };
 
 /* Graph Compiler */
@@ -92,6 +116,11 @@ class SVMCompiler {
   };
 
   SVMCompiler(Scene *scene);
+  /* Finalize the shader graph, must be done before compile(). */
+  void finalize(Shader *shader, Summary *summary = NULL);
+  /* Compute hash of everything the compiled SVM nodes depend on. Returns false
+   * if the shader can not be cached. */
+  bool compile_hash(Shader *shader, string &hash);
   void compile(Shader *shader, array<int4> &svm_nodes, int index, Summary *summary = NULL);
 
   int stack_assign(ShaderOutput *output);
@@ -121,6 +150,12 @@ class SVMCompiler {
     return current_type;
   }
 
+  /* Compilation of a shader type failed, and was replaced by an empty shader. */
+  bool has_failed()
+  {
+    return any_compile_failed;
+  }
+
   Scene *scene;
   ShaderGraph *current_graph;
   bool background;
@@ -215,10 +250,12 @@ class SVMCompiler {
   array<int4> current_svm_nodes;
   ShaderType current_type;
   Shader *current_shader;
+  bool has_bump;
   Stack active_stack;
   int max_stack_use;
   uint mix_weight_offset;
   bool compile_failed;
+  bool any_compile_failed;
 };
 
 CCL_NAMESPACE_END
@@ -20,6 +20,8 @@
 #include "subd/subd_dice.h"
 #include "subd/subd_patch.h"
 
+#include "util/util_task.h"
+
 CCL_NAMESPACE_BEGIN
 
 /* EdgeDice Base */
@@ -45,8 +47,9 @@ void EdgeDice::reserve(int num_verts, int num_triangles)
   vert_offset = mesh->verts.size();
   tri_offset = mesh->num_triangles();
 
-  mesh->resize_mesh(mesh->verts.size() + num_verts, mesh->num_triangles());
-  mesh->reserve_mesh(mesh->verts.size() + num_verts, mesh->num_triangles() + num_triangles);
+  /* Allocate everything up front, so subpatches can be diced in parallel
+   * with each of them writing to its own range of verts and triangles. */
+  mesh->resize_mesh(mesh->verts.size() + num_verts, mesh->num_triangles() + num_triangles);
 
   Attribute *attr_vN = mesh->attributes.add(ATTR_STD_VERTEX_NORMAL);
 
@@ -69,17 +72,22 @@ void EdgeDice::set_vert(Patch *patch, int index, float2 uv)
   params.mesh->vert_patch_uv[index + vert_offset] = make_float2(uv.x, uv.y);
 }
 
-void EdgeDice::add_triangle(Patch *patch, int v0, int v1, int v2)
+void EdgeDice::add_triangle(Patch *patch, int tri, int v0, int v1, int v2)
 {
   Mesh *mesh = params.mesh;
+  size_t index = tri_offset + tri;
 
-  mesh->add_triangle(v0 + vert_offset, v1 + vert_offset, v2 + vert_offset, patch->shader, true);
-  params.mesh->triangle_patch[params.mesh->num_triangles() - 1] = patch->patch_index;
+  assert(index < mesh->num_triangles());
 
-  tri_offset++;
+  mesh->triangles[index * 3 + 0] = v0 + vert_offset;
+  mesh->triangles[index * 3 + 1] = v1 + vert_offset;
+  mesh->triangles[index * 3 + 2] = v2 + vert_offset;
+  mesh->shader[index] = patch->shader;
+  mesh->smooth[index] = true;
+  mesh->triangle_patch[index] = patch->patch_index;
 }
 
-void EdgeDice::stitch_triangles(Subpatch &sub, int edge)
+void EdgeDice::stitch_triangles(Subpatch &sub, int edge, int &tri)
 {
   int Mu = max(sub.edge_u0.T, sub.edge_u1.T);
   int Mv = max(sub.edge_v0.T, sub.edge_v1.T);
@@ -122,7 +130,7 @@ void EdgeDice::stitch_triangles(Subpatch &sub, int edge)
         v2 = sub.get_vert_along_grid_edge(edge, ++i);
     }
 
-    add_triangle(sub.patch, v1, v0, v2);
+    add_triangle(sub.patch, tri++, v1, v0, v2);
   }
 }
 
@@ -157,7 +165,7 @@ void QuadDice::set_vert(Subpatch &sub, int index, float u, float v)
   EdgeDice::set_vert(sub.patch, index, map_uv(sub, u, v));
 }
 
-void QuadDice::set_side(Subpatch &sub, int edge)
+void QuadDice::set_side(Subpatch &sub, int edge, const int *vert_owner, int owner)
 {
   int t = sub.edges[edge].T;
 
@@ -186,7 +194,11 @@ void QuadDice::set_side(Subpatch &sub, int edge)
         break;
     }
 
-    set_vert(sub, sub.get_vert_along_edge(edge, i), u, v);
+    /* Verts on the edge are shared with neighboring subpatches, only one of them sets it. */
+    int index = sub.get_vert_along_edge(edge, i);
+    if (vert_owner[index] == owner) {
+      set_vert(sub, index, u, v);
+    }
   }
 }
 
@@ -224,7 +236,7 @@ float QuadDice::scale_factor(Subpatch &sub, int Mu, int Mv)
   return S;
 }
 
-void QuadDice::add_grid(Subpatch &sub, int Mu, int Mv, int offset)
+void QuadDice::add_grid_verts(Subpatch &sub, int Mu, int Mv, int offset)
 {
   /* create inner grid */
   float du = 1.0f / (float)Mu;
@@ -236,25 +248,30 @@ void QuadDice::add_grid(Subpatch &sub, int Mu, int Mv, int offset)
       float v = j * dv;
 
       set_vert(sub, offset + (i - 1) + (j - 1) * (Mu - 1), u, v);
+    }
+  }
+}
 
-      if (i < Mu - 1 && j < Mv - 1) {
-        int i1 = offset + (i - 1) + (j - 1) * (Mu - 1);
-        int i2 = offset + i + (j - 1) * (Mu - 1);
-        int i3 = offset + i + j * (Mu - 1);
-        int i4 = offset + (i - 1) + j * (Mu - 1);
-
-        add_triangle(sub.patch, i1, i2, i3);
-        add_triangle(sub.patch, i1, i3, i4);
-      }
+void QuadDice::add_grid_triangles(Subpatch &sub, int Mu, int Mv, int offset, int &tri)
+{
+  for (int j = 1; j < Mv - 1; j++) {
+    for (int i = 1; i < Mu - 1; i++) {
+      int i1 = offset + (i - 1) + (j - 1) * (Mu - 1);
+      int i2 = offset + i + (j - 1) * (Mu - 1);
+      int i3 = offset + i + j * (Mu - 1);
+      int i4 = offset + (i - 1) + j * (Mu - 1);
+
+      add_triangle(sub.patch, tri++, i1, i2, i3);
+      add_triangle(sub.patch, tri++, i1, i3, i4);
     }
   }
 }
 
-void QuadDice::dice(Subpatch &sub)
+void QuadDice::grid_size(Subpatch &sub, int &Mu, int &Mv)
 {
   /* compute inner grid size with scale factor */
-  int Mu = max(sub.edge_u0.T, sub.edge_u1.T);
-  int Mv = max(sub.edge_v0.T, sub.edge_v1.T);
+  Mu = max(sub.edge_u0.T, sub.edge_u1.T);
+  Mv = max(sub.edge_v0.T, sub.edge_v1.T);
 
 #if 0 /* Doesn't work very well, especially at grazing angles. */
   float S = scale_factor(sub, ef, Mu, Mv);
@@ -264,20 +281,75 @@ void QuadDice::dice(Subpatch &sub)
 
   Mu = max((int)ceilf(S * Mu), 2);  // XXX handle 0 & 1?
   Mv = max((int)ceilf(S * Mv), 2);  // XXX handle 0 & 1?
+}
+
+void QuadDice::dice_verts(Subpatch &sub, const int *vert_owner, int owner)
+{
+  int Mu, Mv;
+  grid_size(sub, Mu, Mv);
 
   /* inner grid */
-  add_grid(sub, Mu, Mv, sub.inner_grid_vert_offset);
+  add_grid_verts(sub, Mu, Mv, sub.inner_grid_vert_offset);
 
   /* sides */
-  set_side(sub, 0);
-  set_side(sub, 1);
-  set_side(sub, 2);
-  set_side(sub, 3);
-
-  stitch_triangles(sub, 0);
-  stitch_triangles(sub, 1);
-  stitch_triangles(sub, 2);
-  stitch_triangles(sub, 3);
+  set_side(sub, 0, vert_owner, owner);
+  set_side(sub, 1, vert_owner, owner);
+  set_side(sub, 2, vert_owner, owner);
+  set_side(sub, 3, vert_owner, owner);
+}
+
+void QuadDice::dice_triangles(Subpatch &sub)
+{
+  int Mu, Mv;
+  grid_size(sub, Mu, Mv);
+
+  int tri = sub.triangle_offset;
+
+  /* inner grid */
+  add_grid_triangles(sub, Mu, Mv, sub.inner_grid_vert_offset, tri);
+
+  /* sides, these read back edge verts so all verts must have been set */
+  stitch_triangles(sub, 0, tri);
+  stitch_triangles(sub, 1, tri);
+  stitch_triangles(sub, 2, tri);
+  stitch_triangles(sub, 3, tri);
+
+  assert(tri == sub.triangle_offset + sub.calc_num_triangles());
+}
+
+void QuadDice::dice(vector<Subpatch> &subpatches)
+{
+  /* Edge verts are shared between subpatches. Pick the last subpatch using a
+   * vert as its owner, so the result matches dicing subpatches in order. */
+  const size_t num_verts = params.mesh->verts.size() - vert_offset;
+  vector<int> vert_owner(num_verts, -1);
+
+  for (size_t i = 0; i < subpatches.size(); i++) {
+    const Subpatch &sub = subpatches[i];
+
+    for (int edge = 0; edge < 4; edge++) {
+      for (int j = 0; j < sub.edges[edge].T; j++) {
+        vert_owner[sub.get_vert_along_edge(edge, j)] = i;
+      }
+    }
+  }
+
+  /* Evaluate patches first, then stitch triangles which compare diagonal
+   * lengths of verts that may be set by other subpatches. */
+  static const int SUBPATCHES_PER_TASK = 16;
+  parallel_for(blocked_range<size_t>(0, subpatches.size(), SUBPATCHES_PER_TASK),
+               [&](const blocked_range<size_t> &r) {
+                 for (size_t i = r.begin(); i != r.end(); i++) {
+                   dice_verts(subpatches[i], vert_owner.data(), i);
+                 }
+               });
+
+  parallel_for(blocked_range<size_t>(0, subpatches.size(), SUBPATCHES_PER_TASK),
+               [&](const blocked_range<size_t> &r) {
+                 for (size_t i = r.begin(); i != r.end(); i++) {
+                   dice_triangles(subpatches[i]);
+                 }
+               });
 }
 
 CCL_NAMESPACE_END
@@ -72,9 +72,9 @@ class EdgeDice {
   void reserve(int num_verts, int num_triangles);
 
   void set_vert(Patch *patch, int index, float2 uv);
-  void add_triangle(Patch *patch, int v0, int v1, int v2);
+  void add_triangle(Patch *patch, int tri, int v0, int v1, int v2);
 
-  void stitch_triangles(Subpatch &sub, int edge);
+  void stitch_triangles(Subpatch &sub, int edge, int &tri);
 };
 
 /* Quad EdgeDice */
@@ -88,14 +88,21 @@ class QuadDice : public EdgeDice {
   float2 map_uv(Subpatch &sub, float u, float v);
   void set_vert(Subpatch &sub, int index, float u, float v);
 
-  void add_grid(Subpatch &sub, int Mu, int Mv, int offset);
+  void add_grid_verts(Subpatch &sub, int Mu, int Mv, int offset);
+  void add_grid_triangles(Subpatch &sub, int Mu, int Mv, int offset, int &tri);
 
-  void set_side(Subpatch &sub, int edge);
+  void set_side(Subpatch &sub, int edge, const int *vert_owner, int owner);
 
   float quad_area(const float3 &a, const float3 &b, const float3 &c, const float3 &d);
   float scale_factor(Subpatch &sub, int Mu, int Mv);
 
-  void dice(Subpatch &sub);
+  void grid_size(Subpatch &sub, int &Mu, int &Mv);
+
+  void dice_verts(Subpatch &sub, const int *vert_owner, int owner);
+  void dice_triangles(Subpatch &sub);
+
+  /* Dice all subpatches in parallel, requires reserve() to be called first. */
+  void dice(vector<Subpatch> &subpatches);
 };
 
 CCL_NAMESPACE_END
@@ -0,0 +1,290 @@
+/*
+ * Copyright 2011-2020 Blender Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "testing/testing.h"
+
+#include <cstring>
+#include <thread>
+
+#include "device/device_network.h"
+
+CCL_NAMESPACE_BEGIN
+
+TEST(network_address_split, Valid)
+{
+  string host;
+  int port;
+
+  EXPECT_TRUE(network_address_split("render1", host, port));
+  EXPECT_EQ(host, "render1");
+  EXPECT_EQ(port, SERVER_PORT);
+
+  EXPECT_TRUE(network_address_split("render1:5200", host, port));
+  EXPECT_EQ(host, "render1");
+  EXPECT_EQ(port, 5200);
+
+  EXPECT_TRUE(network_address_split("192.168.0.2:65535", host, port));
+  EXPECT_EQ(host, "192.168.0.2");
+  EXPECT_EQ(port, 65535);
+}
+
+TEST(network_address_split, Invalid)
+{
+  string host;
+  int port;
+
+  EXPECT_FALSE(network_address_split("", host, port));
+  EXPECT_FALSE(network_address_split(":5120", host, port));
+  EXPECT_FALSE(network_address_split("render1:", host, port));
+  EXPECT_FALSE(network_address_split("render1:abc", host, port));
+  EXPECT_FALSE(network_address_split("render1:51a", host, port));
+  EXPECT_FALSE(network_address_split("render1:-1", host, port));
+  EXPECT_FALSE(network_address_split("render1:0", host, port));
+  EXPECT_FALSE(network_address_split("render1:65536", host, port));
+  EXPECT_FALSE(network_address_split("render1:5120000", host, port));
+}
+
+/* Client and server sockets connected over the loopback interface. */
+class NetworkLoopbackTest : public ::testing::Test {
+ protected:
+  NetworkLoopbackTest()
+      : acceptor(io_service, tcp::endpoint(boost::asio::ip::address_v4::loopback(), 0)),
+        client_socket(io_service),
+        server_socket(io_service)
+  {
+  }
+
+  void SetUp() override
+  {
+    client_socket.connect(acceptor.local_endpoint());
+    acceptor.accept(server_socket);
+  }
+
+  /* Send from another thread, so large buffers don't block on a full socket. */
+  template<typename F> void send(const F &f)
+  {
+    send_thread = std::thread(f);
+  }
+
+  void TearDown() override
+  {
+    if (send_thread.joinable()) {
+      send_thread.join();
+    }
+    EXPECT_FALSE(client_error.have_error());
+    EXPECT_FALSE(server_error.have_error());
+  }
+
+  void expect_buffer_round_trip(const vector<uint8_t> &buffer)
+  {
+    send([&]() {
+      RPCSend snd(client_socket, &client_error, "mem_copy_to");
+      snd.write();
+      snd.write_buffer((void *)buffer.data(), buffer.size());
+    });
+
+    RPCReceive rcv(server_socket, &server_error);
+    EXPECT_EQ(rcv.name, "mem_copy_to");
+
+    vector<uint8_t> result(buffer.size());
+    rcv.read_buffer(result.data(), result.size());
+    send_thread.join();
+
+    EXPECT_TRUE(result == buffer);
+  }
+
+  boost::asio::io_service io_service;
+  tcp::acceptor acceptor;
+  tcp::socket client_socket;
+  tcp::socket server_socket;
+  NetworkError client_error;
+  NetworkError server_error;
+  std::thread send_thread;
+};
+
+TEST_F(NetworkLoopbackTest, RequestedFeatures)
+{
+  DeviceRequestedFeatures features;
+  features.experimental = true;
+  features.max_nodes_group = 3;
+  features.nodes_features = 0x15;
+  features.use_hair = true;
+  features.use_camera_motion = true;
+  features.use_volume = true;
+  features.use_principled = true;
+  features.use_true_displacement = true;
+  features.use_background_light = true;
+
+  send([&]() {
+    RPCSend snd(client_socket, &client_error, "load_kernels");
+    snd.add(features);
+    snd.write();
+  });
+
+  RPCReceive rcv(server_socket, &server_error);
+  DeviceRequestedFeatures result;
+  result.experimental = false;
+  rcv.read(result);
+
+  EXPECT_EQ(rcv.name, "load_kernels");
+  EXPECT_FALSE(result.modified(features));
+  EXPECT_EQ(result.get_build_options(), features.get_build_options());
+  EXPECT_TRUE(result.experimental);
+  EXPECT_TRUE(result.use_true_displacement);
+  EXPECT_TRUE(result.use_background_light);
+}
+
+TEST_F(NetworkLoopbackTest, Texture)
+{
+  device_texture texture(
+      NULL, "texture", 7, IMAGE_DATA_TYPE_HALF4, INTERPOLATION_CUBIC, EXTENSION_CLIP);
+  texture.alloc(16, 8, 4);
+  texture.device_pointer = 42;
+  texture.info.use_transform_3d = true;
+  texture.info.transform_3d = transform_translate(1.0f, 2.0f, 3.0f);
+
+  send([&]() {
+    RPCSend snd(client_socket, &client_error, "mem_copy_to");
+    snd.add(static_cast<const device_memory &>(texture));
+    snd.add(1234);
+    snd.write();
+  });
+
+  RPCReceive rcv(server_socket, &server_error);
+  network_device_memory mem(NULL);
+  string name;
+  int marker;
+  rcv.read(mem, name);
+  rcv.read(marker);
+  send_thread.join();
+  texture.device_pointer = 0;
+
+  EXPECT_EQ(name, "texture");
+  EXPECT_EQ(mem.type, MEM_TEXTURE);
+  EXPECT_EQ(mem.device_pointer, 42);
+  EXPECT_EQ(mem.memory_size(), texture.memory_size());
+  EXPECT_EQ(mem.slot, 7);
+  EXPECT_EQ(mem.info.data_type, IMAGE_DATA_TYPE_HALF4);
+  EXPECT_EQ(mem.info.interpolation, INTERPOLATION_CUBIC);
+  EXPECT_EQ(mem.info.extension, EXTENSION_CLIP);
+  EXPECT_EQ(mem.info.width, 16);
+  EXPECT_EQ(mem.info.height, 8);
+  EXPECT_EQ(mem.info.depth, 4);
+  EXPECT_TRUE(mem.info.use_transform_3d);
+  EXPECT_EQ(memcmp(&mem.info.transform_3d, &texture.info.transform_3d, sizeof(Transform)), 0);
+  EXPECT_EQ(marker, 1234);
+}
+
+/* Only textures carry texture info. */
+TEST_F(NetworkLoopbackTest, Memory)
+{
+  device_vector<float> buffer(NULL, "buffer", MEM_READ_WRITE);
+  buffer.alloc(100);
+  buffer.device_pointer = 43;
+
+  send([&]() {
+    RPCSend snd(client_socket, &client_error, "mem_alloc");
+    snd.add(static_cast<const device_memory &>(buffer));
+    snd.add(1234);
+    snd.write();
+  });
+
+  RPCReceive rcv(server_socket, &server_error);
+  network_device_memory mem(NULL);
+  string name;
+  int marker;
+  rcv.read(mem, name);
+  rcv.read(marker);
+  send_thread.join();
+  buffer.device_pointer = 0;
+
+  EXPECT_EQ(name, "buffer");
+  EXPECT_EQ(mem.type, MEM_READ_WRITE);
+  EXPECT_EQ(mem.device_pointer, 43);
+  EXPECT_EQ(mem.memory_size(), buffer.memory_size());
+  EXPECT_EQ(marker, 1234);
+}
+
+TEST_F(NetworkLoopbackTest, StolenTile)
+{
+  RenderTile tile;
+  tile.task = RenderTile::BAKE;
+  tile.x = 64;
+  tile.y = 32;
+  tile.w = 16;
+  tile.h = 8;
+  tile.start_sample = 4;
+  tile.num_samples = 12;
+  tile.sample = 9;
+  tile.tile_index = 5;
+  tile.buffer = 44;
+  tile.stealing_state = RenderTile::WAS_STOLEN;
+
+  send([&]() {
+    RPCSend snd(client_socket, &client_error, "release_tile");
+    snd.add(tile);
+    snd.write();
+  });
+
+  RPCReceive rcv(server_socket, &server_error);
+  RenderTile result;
+  rcv.read(result);
+
+  EXPECT_EQ(result.task, RenderTile::BAKE);
+  EXPECT_EQ(result.x, 64);
+  EXPECT_EQ(result.y, 32);
+  EXPECT_EQ(result.w, 16);
+  EXPECT_EQ(result.h, 8);
+  EXPECT_EQ(result.start_sample, 4);
+  EXPECT_EQ(result.num_samples, 12);
+  EXPECT_EQ(result.sample, 9);
+  EXPECT_EQ(result.tile_index, 5);
+  EXPECT_EQ(result.buffer, 44);
+  EXPECT_EQ(result.stealing_state, RenderTile::WAS_STOLEN);
+  EXPECT_EQ(result.buffers, (RenderBuffers *)NULL);
+}
+
+/* Small buffers are sent as they are, others are compressed when that saves space. */
+TEST_F(NetworkLoopbackTest, Buffer)
+{
+  vector<uint8_t> small(COMPRESS_MIN_SIZE - 1);
+  for (size_t i = 0; i < small.size(); i++) {
+    small[i] = (uint8_t)i;
+  }
+  expect_buffer_round_trip(small);
+}
+
+TEST_F(NetworkLoopbackTest, BufferCompressed)
+{
+  vector<uint8_t> compressible(4 * 1024 * 1024);
+  for (size_t i = 0; i < compressible.size(); i++) {
+    compressible[i] = (uint8_t)((i / 1024) % 7);
+  }
+  expect_buffer_round_trip(compressible);
+}
+
+TEST_F(NetworkLoopbackTest, BufferIncompressible)
+{
+  vector<uint8_t> random(1024 * 1024);
+  uint state = 1;
+  for (size_t i = 0; i < random.size(); i++) {
+    state = state * 1103515245 + 12345;
+    random[i] = (uint8_t)(state >> 16);
+  }
+  expect_buffer_round_trip(random);
+}
+
+CCL_NAMESPACE_END
@@ -25,6 +25,7 @@
 
 #include "util/util_array.h"
 #include "util/util_logging.h"
+#include "util/util_md5.h"
 #include "util/util_stats.h"
 #include "util/util_string.h"
 #include "util/util_vector.h"
@@ -1539,4 +1540,49 @@ TEST_F(RenderGraph, constant_fold_convert_color_float_color)
   graph.finalize(scene);
 }
 
+/*
+ * Tests:
+ *  - identical finalized graphs have the same compile hash, used for the compiled shader cache.
+ *  - a changed socket value results in a different compile hash.
+ */
+TEST_F(RenderGraph, compile_hash)
+{
+  EXPECT_ANY_MESSAGE(log);
+
+  ShaderGraph graph2, graph3;
+  ShaderGraphBuilder builder2(&graph2), builder3(&graph3);
+
+  builder.add_attribute("Attribute")
+      .add_node(ShaderNodeBuilder<MathNode>(graph, "Math")
+                    .set(&MathNode::type, NODE_MATH_MULTIPLY)
+                    .set("Value2", 0.5f))
+      .add_connection("Attribute::Fac", "Math::Value1")
+      .output_value("Math::Value");
+  builder2.add_attribute("Attribute")
+      .add_node(ShaderNodeBuilder<MathNode>(graph2, "Math")
+                    .set(&MathNode::type, NODE_MATH_MULTIPLY)
+                    .set("Value2", 0.5f))
+      .add_connection("Attribute::Fac", "Math::Value1")
+      .output_value("Math::Value");
+  builder3.add_attribute("Attribute")
+      .add_node(ShaderNodeBuilder<MathNode>(graph3, "Math")
+                    .set(&MathNode::type, NODE_MATH_MULTIPLY)
+                    .set("Value2", 0.25f))
+      .add_connection("Attribute::Fac", "Math::Value1")
+      .output_value("Math::Value");
+
+  graph.finalize(scene);
+  graph2.finalize(scene);
+  graph3.finalize(scene);
+
+  MD5Hash md5, md5_2, md5_3;
+  EXPECT_TRUE(graph.compute_compile_hash(md5));
+  EXPECT_TRUE(graph2.compute_compile_hash(md5_2));
+  EXPECT_TRUE(graph3.compute_compile_hash(md5_3));
+
+  const string hash = md5.get_hex();
+  EXPECT_EQ(hash, md5_2.get_hex());
+  EXPECT_NE(hash, md5_3.get_hex());
+}
+
 CCL_NAMESPACE_END
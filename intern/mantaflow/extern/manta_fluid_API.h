@@ -72,6 +72,14 @@ int manta_has_guiding(struct MANTA *fluid,
                       int framenr,
                       bool domain);
 
+/* Cache files kept in memory are read from there instead of from disk, see
+ * #BKE_fluid_cache_file_acquire. */
+typedef const void *(*MantaFileCacheAcquireFn)(const char *filepath,
+                                               size_t *r_size,
+                                               void **r_handle);
+typedef void (*MantaFileCacheReleaseFn)(void *handle);
+void manta_set_file_cache(MantaFileCacheAcquireFn acquire, MantaFileCacheReleaseFn release);
+
 void manta_update_variables(struct MANTA *fluid, struct FluidModifierData *fmd);
 int manta_get_frame(struct MANTA *fluid);
 float manta_get_timestep(struct MANTA *fluid);
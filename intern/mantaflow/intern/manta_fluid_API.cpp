@@ -24,6 +24,7 @@
 #include <cmath>
 
 #include "MANTA_main.h"
+#include "fileio/mantaio.h"
 #include "manta_fluid_API.h"
 
 /* Fluid functions */
@@ -195,6 +196,11 @@ int manta_has_guiding(MANTA *fluid, FluidModifierData *fmd, int framenr, bool do
   return fluid->hasGuiding(fmd, framenr, domain);
 }
 
+void manta_set_file_cache(MantaFileCacheAcquireFn acquire, MantaFileCacheReleaseFn release)
+{
+  Manta::setFileCache(acquire, release);
+}
+
 void manta_update_variables(MANTA *fluid, FluidModifierData *fmd)
 {
   if (!fluid)
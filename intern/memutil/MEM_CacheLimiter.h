@@ -54,8 +54,11 @@
  */
 
 #include "MEM_Allocator.h"
-#include <list>
+#include <algorithm>
+#include <atomic>
+#include <mutex>
 #include <queue>
+#include <stdint.h>
 #include <vector>
 
 template<class T> class MEM_CacheLimiter;
@@ -72,7 +75,15 @@ bool MEM_CacheLimiter_is_disabled(void);
 template<class T> class MEM_CacheLimiterHandle {
  public:
   explicit MEM_CacheLimiterHandle(T *data_, MEM_CacheLimiter<T> *parent_)
-      : data(data_), refcount(0), parent(parent_)
+      : data(data_),
+        refcount(0),
+        parent(parent_),
+        prev(NULL),
+        next(NULL),
+        linked(false),
+        uses_priority(false),
+        size(0),
+        stamp(0)
   {
   }
 
@@ -127,69 +138,107 @@ template<class T> class MEM_CacheLimiterHandle {
     parent->touch(this);
   }
 
+  void use_priority()
+  {
+    parent->use_priority(this);
+  }
+
  private:
   friend class MEM_CacheLimiter<T>;
 
   T *data;
-  int refcount;
-  int pos;
+  std::atomic<int> refcount;
   MEM_CacheLimiter<T> *parent;
+
+  /* Links in the LRU list of the shard, only valid while linked is set. */
+  MEM_CacheLimiterHandle *prev, *next;
+  bool linked;
+  /* Ranked with the item priority function against other elements using priorities. */
+  bool uses_priority;
+  int shard;
+  /* Size of the data when the element was inserted or last touched. */
+  size_t size;
+  /* Access stamp, elements with a lower stamp were used less recently. */
+  uint64_t stamp;
 };
 
+/**
+ * Elements are kept in least recently used order, so touching an element and finding the next one
+ * to evict are constant time. To let threads insert and touch elements concurrently the elements
+ * are spread over a number of shards, each with its own lock and LRU list. A global access stamp
+ * orders elements across shards, the least recently used element is the oldest shard head.
+ *
+ * Elements can opt in to the item priority function. When the least recently used element is
+ * one of them, only the elements using priorities are ranked and the lowest priority ones among
+ * them are evicted. Other elements never pay for the ranking.
+ */
 template<class T> class MEM_CacheLimiter {
  public:
   typedef size_t (*MEM_CacheLimiter_DataSize_Func)(void *data);
   typedef int (*MEM_CacheLimiter_ItemPriority_Func)(void *item, int default_priority);
   typedef bool (*MEM_CacheLimiter_ItemDestroyable_Func)(void *item);
 
-  MEM_CacheLimiter(MEM_CacheLimiter_DataSize_Func data_size_func) : data_size_func(data_size_func)
+  MEM_CacheLimiter(MEM_CacheLimiter_DataSize_Func data_size_func)
+      : data_size_func(data_size_func),
+        item_priority_func(NULL),
+        item_destroyable_func(NULL),
+        memory_in_use(0),
+        num_elements(0),
+        access_stamp(0)
   {
   }
 
   ~MEM_CacheLimiter()
   {
-    int i;
-    for (i = 0; i < queue.size(); i++) {
-      delete queue[i];
+    for (int i = 0; i < NUM_SHARDS; i++) {
+      MEM_CacheElementPtr elem = shards[i].head;
+      while (elem) {
+        MEM_CacheElementPtr next = elem->next;
+        delete elem;
+        elem = next;
+      }
     }
   }
 
   MEM_CacheLimiterHandle<T> *insert(T *elem)
   {
-    queue.push_back(new MEM_CacheLimiterHandle<T>(elem, this));
-    queue.back()->pos = queue.size() - 1;
-    return queue.back();
+    MEM_CacheElementPtr handle = new MEM_CacheLimiterHandle<T>(elem, this);
+    handle->shard = (int)(((uintptr_t)handle >> 4) % NUM_SHARDS);
+    if (data_size_func) {
+      handle->size = data_size_func(elem->get_data());
+    }
+
+    Shard &shard = shards[handle->shard];
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    link(shard, handle);
+    return handle;
   }
 
   void unmanage(MEM_CacheLimiterHandle<T> *handle)
   {
-    int pos = handle->pos;
-    queue[pos] = queue.back();
-    queue[pos]->pos = pos;
-    queue.pop_back();
+    Shard &shard = shards[handle->shard];
+    {
+      std::lock_guard<std::mutex> lock(shard.mutex);
+      /* Elements being evicted are already unlinked. */
+      if (handle->linked) {
+        unlink(shard, handle);
+      }
+    }
     delete handle;
   }
 
   size_t get_memory_in_use()
   {
-    size_t size = 0;
     if (data_size_func) {
-      int i;
-      for (i = 0; i < queue.size(); i++) {
-        size += data_size_func(queue[i]->get()->get_data());
-      }
+      return memory_in_use;
     }
-    else {
-      size = MEM_get_memory_in_use();
-    }
-    return size;
+    return MEM_get_memory_in_use();
   }
 
   void enforce_limits()
   {
     size_t max = MEM_CacheLimiter_get_maximum();
     bool is_disabled = MEM_CacheLimiter_is_disabled();
-    size_t mem_in_use, cur_size;
 
     if (is_disabled) {
       return;
@@ -199,49 +248,54 @@ template<class T> class MEM_CacheLimiter {
       return;
     }
 
-    mem_in_use = get_memory_in_use();
-
-    if (mem_in_use <= max) {
+    if (get_memory_in_use() <= max) {
       return;
     }
 
-    while (!queue.empty() && mem_in_use > max) {
-      MEM_CacheElementPtr elem = get_least_priority_destroyable_element();
+    /* Only one thread evicts at a time, inserting and touching elements is still possible. */
+    std::lock_guard<std::mutex> lock(enforce_mutex);
 
-      if (!elem)
-        break;
+    std::vector<MEM_CacheElementPtr> detached;
+    while (get_memory_in_use() > max) {
+      detach_destroyable_elements(max, detached);
 
-      if (data_size_func) {
-        cur_size = data_size_func(elem->get()->get_data());
+      if (detached.empty()) {
+        break;
       }
-      else {
-        cur_size = mem_in_use;
+
+      bool destroyed_any = false;
+      for (MEM_CacheElementPtr elem : detached) {
+        destroyed_any |= destroy_detached_element(elem);
       }
+      detached.clear();
 
-      if (elem->destroy_if_possible()) {
-        if (data_size_func) {
-          mem_in_use -= cur_size;
-        }
-        else {
-          mem_in_use -= cur_size - MEM_get_memory_in_use();
-        }
+      if (!destroyed_any) {
+        break;
       }
     }
   }
 
   void touch(MEM_CacheLimiterHandle<T> *handle)
   {
-    /* If we're using custom priority callback re-arranging the queue
-     * doesn't make much sense because we'll iterate it all to get
-     * least priority element anyway.
-     */
-    if (item_priority_func == NULL) {
-      queue[handle->pos] = queue.back();
-      queue[handle->pos]->pos = handle->pos;
-      queue.pop_back();
-      queue.push_back(handle);
-      handle->pos = queue.size() - 1;
+    /* Query the size outside of the lock, buffers might have been added to the data since it
+     * was inserted. */
+    size_t size = data_size_func ? data_size_func(handle->get()->get_data()) : 0;
+
+    Shard &shard = shards[handle->shard];
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    if (!handle->linked) {
+      return;
     }
+    unlink(shard, handle);
+    handle->size = size;
+    link(shard, handle);
+  }
+
+  void use_priority(MEM_CacheLimiterHandle<T> *handle)
+  {
+    Shard &shard = shards[handle->shard];
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    handle->uses_priority = true;
   }
 
   void set_item_priority_func(MEM_CacheLimiter_ItemPriority_Func item_priority_func)
@@ -256,8 +310,69 @@ template<class T> class MEM_CacheLimiter {
 
  private:
   typedef MEM_CacheLimiterHandle<T> *MEM_CacheElementPtr;
-  typedef std::vector<MEM_CacheElementPtr, MEM_Allocator<MEM_CacheElementPtr>> MEM_CacheQueue;
-  typedef typename MEM_CacheQueue::iterator iterator;
+
+  enum { NUM_SHARDS = 16 };
+
+  struct Shard {
+    std::mutex mutex;
+    /* Least recently used element first. */
+    MEM_CacheElementPtr head = NULL, tail = NULL;
+  };
+
+  /* Append element as the most recently used one, shard must be locked. */
+  void link(Shard &shard, MEM_CacheElementPtr elem)
+  {
+    elem->stamp = ++access_stamp;
+    elem->prev = shard.tail;
+    elem->next = NULL;
+    if (shard.tail) {
+      shard.tail->next = elem;
+    }
+    else {
+      shard.head = elem;
+    }
+    shard.tail = elem;
+    elem->linked = true;
+
+    memory_in_use += elem->size;
+    num_elements++;
+  }
+
+  /* Shard must be locked. */
+  void unlink(Shard &shard, MEM_CacheElementPtr elem)
+  {
+    if (elem->prev) {
+      elem->prev->next = elem->next;
+    }
+    else {
+      shard.head = elem->next;
+    }
+    if (elem->next) {
+      elem->next->prev = elem->prev;
+    }
+    else {
+      shard.tail = elem->prev;
+    }
+    elem->prev = elem->next = NULL;
+    elem->linked = false;
+
+    memory_in_use -= elem->size;
+    num_elements--;
+  }
+
+  void lock_all_shards()
+  {
+    for (int i = 0; i < NUM_SHARDS; i++) {
+      shards[i].mutex.lock();
+    }
+  }
+
+  void unlock_all_shards()
+  {
+    for (int i = NUM_SHARDS - 1; i >= 0; i--) {
+      shards[i].mutex.unlock();
+    }
+  }
 
   /* Check whether element can be destroyed when enforcing cache limits */
   bool can_destroy_element(MEM_CacheElementPtr &elem)
@@ -273,52 +388,134 @@ template<class T> class MEM_CacheLimiter {
     return true;
   }
 
-  MEM_CacheElementPtr get_least_priority_destroyable_element(void)
+  /* Detach the least recently used destroyable element, or the lowest priority ones when that
+   * element uses priorities. */
+  void detach_destroyable_elements(size_t max, std::vector<MEM_CacheElementPtr> &detached)
   {
-    if (queue.empty())
-      return NULL;
-
-    MEM_CacheElementPtr best_match_elem = NULL;
+    lock_all_shards();
+
+    for (size_t num_checked = num_elements; num_checked > 0; num_checked--) {
+      Shard *oldest_shard = NULL;
+      for (int i = 0; i < NUM_SHARDS; i++) {
+        if (shards[i].head &&
+            (oldest_shard == NULL || shards[i].head->stamp < oldest_shard->head->stamp)) {
+          oldest_shard = &shards[i];
+        }
+      }
+      if (oldest_shard == NULL) {
+        break;
+      }
 
-    if (!item_priority_func) {
-      for (iterator it = queue.begin(); it != queue.end(); it++) {
-        MEM_CacheElementPtr elem = *it;
-        if (!can_destroy_element(elem))
-          continue;
-        best_match_elem = elem;
+      MEM_CacheElementPtr elem = oldest_shard->head;
+      if (can_destroy_element(elem)) {
+        if (elem->uses_priority && item_priority_func) {
+          detach_least_priority_destroyable_elements(max, detached);
+        }
+        else {
+          unlink(*oldest_shard, elem);
+          detached.push_back(elem);
+        }
         break;
       }
+
+      /* Referenced elements are in use, treat them as most recently used so they are not checked
+       * again on every eviction. */
+      unlink(*oldest_shard, elem);
+      link(*oldest_shard, elem);
     }
-    else {
-      int best_match_priority = 0;
-      int i;
 
-      for (i = 0; i < queue.size(); i++) {
-        MEM_CacheElementPtr elem = queue[i];
+    unlock_all_shards();
+  }
 
-        if (!can_destroy_element(elem))
-          continue;
+  /* All shards must be locked. */
+  void detach_least_priority_destroyable_elements(size_t max,
+                                                  std::vector<MEM_CacheElementPtr> &detached)
+  {
+    struct Candidate {
+      int priority;
+      uint64_t stamp;
+      MEM_CacheElementPtr elem;
+    };
+
+    /* Merge the shard lists from most to least recently used, the lists are already in order. */
+    auto is_older = [](MEM_CacheElementPtr a, MEM_CacheElementPtr b) {
+      return a->stamp < b->stamp;
+    };
+    std::priority_queue<MEM_CacheElementPtr, std::vector<MEM_CacheElementPtr>, decltype(is_older)>
+        newest(is_older);
+    for (int i = 0; i < NUM_SHARDS; i++) {
+      if (shards[i].tail) {
+        newest.push(shards[i].tail);
+      }
+    }
 
-        /* by default 0 means highest priority element */
-        /* casting a size type to int is questionable,
-           but unlikely to cause problems */
-        int priority = -((int)(queue.size()) - i - 1);
-        priority = item_priority_func(elem->get()->get_data(), priority);
+    std::vector<Candidate> candidates;
+    int num_ranked = 0;
+    while (!newest.empty()) {
+      MEM_CacheElementPtr elem = newest.top();
+      newest.pop();
+      if (elem->prev) {
+        newest.push(elem->prev);
+      }
+      if (!elem->uses_priority) {
+        continue;
+      }
 
-        if (priority < best_match_priority || best_match_elem == NULL) {
-          best_match_priority = priority;
-          best_match_elem = elem;
-        }
+      /* By default 0 means highest priority element, the most recently used one. */
+      const int default_priority = -num_ranked++;
+      if (!can_destroy_element(elem)) {
+        continue;
       }
+      int priority = item_priority_func(elem->get()->get_data(), default_priority);
+      candidates.push_back({priority, elem->stamp, elem});
     }
 
-    return best_match_elem;
+    /* Lowest priority on top, the least recently used one of equal priorities. Only the evicted
+     * candidates are taken off the heap in order. */
+    auto is_kept_longer = [](const Candidate &a, const Candidate &b) {
+      return (a.priority != b.priority) ? a.priority > b.priority : a.stamp > b.stamp;
+    };
+    std::make_heap(candidates.begin(), candidates.end(), is_kept_longer);
+
+    /* Without a size function the memory freed by an element is only known after destroying it,
+     * detach one element at a time then. */
+    while (!candidates.empty()) {
+      std::pop_heap(candidates.begin(), candidates.end(), is_kept_longer);
+      MEM_CacheElementPtr elem = candidates.back().elem;
+      candidates.pop_back();
+
+      unlink(shards[elem->shard], elem);
+      detached.push_back(elem);
+      if (!data_size_func || memory_in_use <= max) {
+        break;
+      }
+    }
+  }
+
+  bool destroy_detached_element(MEM_CacheElementPtr elem)
+  {
+    if (elem->destroy_if_possible()) {
+      return true;
+    }
+
+    /* Element got referenced since it was detached, keep it. */
+    Shard &shard = shards[elem->shard];
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    link(shard, elem);
+    return false;
   }
 
-  MEM_CacheQueue queue;
+  Shard shards[NUM_SHARDS];
+  std::mutex enforce_mutex;
+
   MEM_CacheLimiter_DataSize_Func data_size_func;
   MEM_CacheLimiter_ItemPriority_Func item_priority_func;
   MEM_CacheLimiter_ItemDestroyable_Func item_destroyable_func;
+
+  /* Sum of the sizes of linked elements, only used when there is a data size function. */
+  std::atomic<size_t> memory_in_use;
+  std::atomic<size_t> num_elements;
+  std::atomic<uint64_t> access_stamp;
 };
 
 #endif  // __MEM_CACHELIMITER_H__
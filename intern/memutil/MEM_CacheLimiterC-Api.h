@@ -107,6 +107,15 @@ void MEM_CacheLimiter_unmanage(MEM_CacheLimiterHandleC *handle);
 
 void MEM_CacheLimiter_touch(MEM_CacheLimiterHandleC *handle);
 
+/**
+ * Rank object with the item priority function when freeing memory, against other objects using
+ * priorities. Objects are freed in least recently used order otherwise.
+ *
+ * \param handle: of object.
+ */
+
+void MEM_CacheLimiter_use_priority(MEM_CacheLimiterHandleC *handle);
+
 /**
  * Increment reference counter. Objects with reference counter != 0 are _not_
  * deleted.
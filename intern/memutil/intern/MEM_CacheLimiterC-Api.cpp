@@ -19,6 +19,8 @@
  */
 
 #include <cstddef>
+#include <list>
+#include <mutex>
 
 #include "MEM_CacheLimiter.h"
 #include "MEM_CacheLimiterC-Api.h"
@@ -83,6 +85,8 @@ class MEM_CacheLimiterCClass {
   MEM_CacheLimiter<MEM_CacheLimiterHandleCClass> cache;
 
   list_t cclass_list;
+  /* Elements are inserted and destructed from multiple threads. */
+  std::mutex cclass_list_mutex;
 };
 
 class MEM_CacheLimiterHandleCClass {
@@ -117,17 +121,23 @@ class MEM_CacheLimiterHandleCClass {
 
 handle_t *MEM_CacheLimiterCClass::insert(void *data)
 {
-  cclass_list.push_back(new MEM_CacheLimiterHandleCClass(data, this));
-  list_t::iterator it = cclass_list.end();
-  --it;
-  cclass_list.back()->set_iter(it);
+  MEM_CacheLimiterHandleCClass *cclass_handle = new MEM_CacheLimiterHandleCClass(data, this);
+  {
+    std::lock_guard<std::mutex> lock(cclass_list_mutex);
+    cclass_list.push_back(cclass_handle);
+    list_t::iterator it = cclass_list.end();
+    --it;
+    cclass_handle->set_iter(it);
+  }
 
-  return cache.insert(cclass_list.back());
+  return cache.insert(cclass_handle);
 }
 
 void MEM_CacheLimiterCClass::destruct(void *data, list_t::iterator it)
 {
   data_destructor(data);
+
+  std::lock_guard<std::mutex> lock(cclass_list_mutex);
   cclass_list.erase(it);
 }
 
@@ -191,6 +201,11 @@ void MEM_CacheLimiter_touch(MEM_CacheLimiterHandleC *handle)
   cast(handle)->touch();
 }
 
+void MEM_CacheLimiter_use_priority(MEM_CacheLimiterHandleC *handle)
+{
+  cast(handle)->use_priority();
+}
+
 void MEM_CacheLimiter_ref(MEM_CacheLimiterHandleC *handle)
 {
   cast(handle)->ref();
@@ -0,0 +1,241 @@
+/* Apache License, Version 2.0 */
+
+#include "testing/testing.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "MEM_CacheLimiterC-Api.h"
+
+namespace {
+
+struct CacheItem {
+  size_t size;
+  int priority;
+  bool destroyed;
+  MEM_CacheLimiterHandleC *handle;
+};
+
+std::atomic<int> num_destroyed(0);
+
+void item_destruct(void *data)
+{
+  CacheItem *item = (CacheItem *)data;
+  item->destroyed = true;
+  item->handle = NULL;
+  num_destroyed++;
+}
+
+size_t item_size(void *data)
+{
+  return ((CacheItem *)data)->size;
+}
+
+int item_priority(void *data, int UNUSED(default_priority))
+{
+  return ((CacheItem *)data)->priority;
+}
+
+class CacheLimiterTest : public ::testing::Test {
+ protected:
+  void SetUp() override
+  {
+    old_maximum = MEM_CacheLimiter_get_maximum();
+    num_destroyed = 0;
+    limiter = new_MEM_CacheLimiter(item_destruct, item_size);
+  }
+
+  void TearDown() override
+  {
+    delete_MEM_CacheLimiter(limiter);
+    MEM_CacheLimiter_set_maximum(old_maximum);
+  }
+
+  void insert(CacheItem &item, bool use_priority = false)
+  {
+    item.handle = MEM_CacheLimiter_insert(limiter, &item);
+    if (use_priority) {
+      MEM_CacheLimiter_use_priority(item.handle);
+    }
+    MEM_CacheLimiter_ref(item.handle);
+    MEM_CacheLimiter_enforce_limits(limiter);
+    MEM_CacheLimiter_unref(item.handle);
+  }
+
+  /* Most puts evict an item, while other threads touch their referenced items. */
+  void put_from_threads(const int num_threads,
+                        const int num_items_per_thread,
+                        const int num_cached_items)
+  {
+    std::vector<CacheItem> items(num_threads * num_items_per_thread, {1, 0, false, NULL});
+    std::vector<CacheItem> used_items(num_threads, {1, 0, false, NULL});
+    MEM_CacheLimiter_set_maximum(num_cached_items);
+
+    /* Referenced items can't be evicted, so they are safe to touch without any locking. */
+    for (CacheItem &item : used_items) {
+      insert(item);
+      MEM_CacheLimiter_ref(item.handle);
+    }
+
+    std::mutex put_mutex;
+    auto thread_func = [&](int thread) {
+      CacheItem *thread_items = &items[thread * num_items_per_thread];
+      for (int i = 0; i < num_items_per_thread; i++) {
+        {
+          /* Same as movie cache, which serializes putting items. */
+          std::lock_guard<std::mutex> lock(put_mutex);
+          insert(thread_items[i]);
+        }
+        for (int j = 0; j < 4; j++) {
+          MEM_CacheLimiter_touch(used_items[thread].handle);
+        }
+      }
+    };
+
+    std::vector<std::thread> threads;
+    for (int thread = 0; thread < num_threads; thread++) {
+      threads.emplace_back(thread_func, thread);
+    }
+    for (std::thread &thread : threads) {
+      thread.join();
+    }
+
+    for (CacheItem &item : used_items) {
+      EXPECT_FALSE(item.destroyed);
+      MEM_CacheLimiter_unref(item.handle);
+    }
+    EXPECT_EQ(MEM_CacheLimiter_get_memory_in_use(limiter), (size_t)num_cached_items);
+    EXPECT_EQ(num_destroyed, (int)(items.size() + used_items.size()) - num_cached_items);
+  }
+
+  size_t old_maximum;
+  MEM_CacheLimiterC *limiter;
+};
+
+}  // namespace
+
+TEST_F(CacheLimiterTest, EvictLeastRecentlyUsed)
+{
+  std::vector<CacheItem> items(20, {100, 0, false, NULL});
+  MEM_CacheLimiter_set_maximum(1000);
+
+  for (int i = 0; i < 10; i++) {
+    insert(items[i]);
+  }
+  EXPECT_EQ(MEM_CacheLimiter_get_memory_in_use(limiter), 1000u);
+
+  /* Touch the oldest half, so the other half gets evicted first. */
+  for (int i = 0; i < 5; i++) {
+    MEM_CacheLimiter_touch(items[i].handle);
+  }
+  for (int i = 10; i < 15; i++) {
+    insert(items[i]);
+  }
+
+  for (int i = 0; i < 15; i++) {
+    EXPECT_EQ(items[i].destroyed, i >= 5 && i < 10) << "item " << i;
+  }
+  EXPECT_EQ(MEM_CacheLimiter_get_memory_in_use(limiter), 1000u);
+}
+
+TEST_F(CacheLimiterTest, KeepReferenced)
+{
+  std::vector<CacheItem> items(4, {100, 0, false, NULL});
+  MEM_CacheLimiter_set_maximum(200);
+
+  insert(items[0]);
+  MEM_CacheLimiter_ref(items[0].handle);
+  for (int i = 1; i < 4; i++) {
+    insert(items[i]);
+  }
+
+  EXPECT_FALSE(items[0].destroyed);
+  EXPECT_TRUE(items[1].destroyed);
+  EXPECT_TRUE(items[2].destroyed);
+  EXPECT_FALSE(items[3].destroyed);
+
+  MEM_CacheLimiter_unref(items[0].handle);
+}
+
+TEST_F(CacheLimiterTest, EvictLowestPriority)
+{
+  std::vector<CacheItem> items(10, {100, 0, false, NULL});
+  MEM_CacheLimiter_set_maximum(1000);
+  MEM_CacheLimiter_ItemPriority_Func_set(limiter, item_priority);
+
+  for (int i = 0; i < 10; i++) {
+    /* Even items are more important. */
+    items[i].priority = (i % 2) ? -i : 0;
+    insert(items[i], true);
+  }
+
+  MEM_CacheLimiter_set_maximum(500);
+  MEM_CacheLimiter_enforce_limits(limiter);
+
+  for (int i = 0; i < 10; i++) {
+    EXPECT_EQ(items[i].destroyed, i % 2 == 1) << "item " << i;
+  }
+}
+
+/* Items using priorities are only ranked among each other, once the least recently used item is
+ * one of them. */
+TEST_F(CacheLimiterTest, EvictLowestPriorityOfPriorityItems)
+{
+  std::vector<CacheItem> items(6, {100, 0, false, NULL});
+  MEM_CacheLimiter_set_maximum(1000);
+  MEM_CacheLimiter_ItemPriority_Func_set(limiter, item_priority);
+
+  items[2].priority = -1;
+  for (int i = 0; i < 6; i++) {
+    insert(items[i], i == 1 || i == 2 || i == 4);
+  }
+
+  MEM_CacheLimiter_set_maximum(300);
+  MEM_CacheLimiter_enforce_limits(limiter);
+
+  for (int i = 0; i < 6; i++) {
+    EXPECT_EQ(items[i].destroyed, i < 3) << "item " << i;
+  }
+  EXPECT_EQ(MEM_CacheLimiter_get_memory_in_use(limiter), 300u);
+}
+
+TEST_F(CacheLimiterTest, Unmanage)
+{
+  std::vector<CacheItem> items(3, {100, 0, false, NULL});
+  MEM_CacheLimiter_set_maximum(1000);
+
+  for (CacheItem &item : items) {
+    insert(item);
+  }
+  MEM_CacheLimiter_unmanage(items[1].handle);
+
+  EXPECT_EQ(MEM_CacheLimiter_get_memory_in_use(limiter), 200u);
+  EXPECT_EQ(num_destroyed, 0);
+}
+
+TEST_F(CacheLimiterTest, Threaded)
+{
+  put_from_threads(4, 2000, 500);
+}
+
+/* Benchmark with many items from all hardware threads, run with --gtest_also_run_disabled_tests
+ * to compare timings between implementations. */
+TEST_F(CacheLimiterTest, DISABLED_Stress)
+{
+  const int num_threads = std::max(2u, std::thread::hardware_concurrency());
+  const int num_items_per_thread = 50000;
+
+  const auto start = std::chrono::steady_clock::now();
+  put_from_threads(num_threads, num_items_per_thread, 20000);
+  const std::chrono::duration<double> duration = std::chrono::steady_clock::now() - start;
+
+  printf("%d threads, %d puts: %fs\n",
+         num_threads,
+         num_threads * num_items_per_thread,
+         duration.count());
+}
@@ -58,14 +58,29 @@ typedef struct rbMeshData rbMeshData;
 /* Constraint */
 typedef struct rbConstraint rbConstraint;
 
+/* ********************************** */
+/* Task Scheduler */
+
+/* Run one task of a parallel loop */
+typedef void (*rbTaskFunc)(void *userdata, int index);
+/* Run the task for every index from 0 to len, using multiple threads, and return when all are
+ * done */
+typedef void (*rbParallelForFunc)(int len, rbTaskFunc func, void *userdata);
+
+/* Use the task scheduler of the application for multi-threaded dynamics worlds,
+ * must be called before creating one */
+void RB_task_scheduler_set(int num_threads, rbParallelForFunc parallel_for);
+
 /* ********************************** */
 /* Dynamics World Methods */
 
 /* Setup ---------------------------- */
 
-/* Create a new dynamics world instance */
+/* Create a new dynamics world instance, with collision detection and constraint solving split in
+ * tasks when use_multithreading is set. Simulation islands are solved in parallel, which doesn't
+ * give the same results between runs. */
 // TODO: add args to set the type of constraint solvers, etc.
-rbDynamicsWorld *RB_dworld_new(const float gravity[3]);
+rbDynamicsWorld *RB_dworld_new(const float gravity[3], int use_multithreading);
 
 /* Delete the given dynamics world, and free any extra data it may require */
 void RB_dworld_delete(rbDynamicsWorld *world);
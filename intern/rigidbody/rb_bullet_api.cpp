@@ -67,6 +67,19 @@
 #include "BulletCollision/Gimpact/btGImpactCollisionAlgorithm.h"
 #include "BulletCollision/Gimpact/btGImpactShape.h"
 
+#include "BLI_utildefines.h"
+
+#ifdef WITH_BULLET_THREADS
+#  include <atomic>
+#  include <mutex>
+#  include <thread>
+#  include <vector>
+
+#  include "BulletCollision/CollisionDispatch/btCollisionDispatcherMt.h"
+#  include "BulletDynamics/Dynamics/btDiscreteDynamicsWorldMt.h"
+#  include "LinearMath/btThreads.h"
+#endif
+
 struct rbDynamicsWorld {
   btDiscreteDynamicsWorld *dynamicsWorld;
   btDefaultCollisionConfiguration *collisionConfiguration;
@@ -131,19 +144,209 @@ static inline void copy_quat_btquat(float quat[4], const btQuaternion &btquat)
   quat[3] = btquat.getZ();
 }
 
+/* ********************************** */
+/* Task Scheduler */
+
+#ifdef WITH_BULLET_THREADS
+
+/* Bullet keeps per thread data indexed by the thread index, which has to be unique among the
+ * threads running tasks at the same time. Threads of the application can run tasks for other
+ * code in between, so instead of a fixed index per thread they take a free slot while running
+ * a task or stepping a world, so that worlds stepped at the same time by different threads don't
+ * share a slot. Slot 0 is only used by threads outside of both. */
+static std::atomic<uint64_t> thread_slots_used(1);
+static thread_local unsigned int thread_slot = 0;
+
+static unsigned int rb_thread_index()
+{
+  return thread_slot;
+}
+
+class rbThreadSlot {
+ public:
+  rbThreadSlot() : prev_slot_(thread_slot)
+  {
+    for (;;) {
+      uint64_t used = thread_slots_used.load();
+      if (used == ~uint64_t(0)) {
+        /* Only with more threads than BT_MAX_THREAD_COUNT, wait for a task to finish. */
+        std::this_thread::yield();
+        continue;
+      }
+      unsigned int slot = 1;
+      while (used & (uint64_t(1) << slot)) {
+        slot++;
+      }
+      if (thread_slots_used.compare_exchange_weak(used, used | (uint64_t(1) << slot))) {
+        thread_slot = slot;
+        return;
+      }
+    }
+  }
+
+  ~rbThreadSlot()
+  {
+    thread_slots_used.fetch_and(~(uint64_t(1) << thread_slot));
+    thread_slot = prev_slot_;
+  }
+
+ private:
+  unsigned int prev_slot_;
+};
+
+struct rbTaskRange {
+  int begin, end, grain_size;
+  const btIParallelForBody *for_body;
+  const btIParallelSumBody *sum_body;
+  btScalar *sums;
+};
+
+/* Runs loops of Bullet with the parallel for of the application, one task per grain. */
+class rbTaskScheduler : public btITaskScheduler {
+ public:
+  rbTaskScheduler() : btITaskScheduler("Blender"), num_threads_(1), parallel_for_(NULL)
+  {
+  }
+
+  void set(int num_threads, rbParallelForFunc parallel_for)
+  {
+    num_threads_ = btMax(num_threads, 1);
+    parallel_for_ = parallel_for;
+  }
+
+  /* Threads use slots as index, which are only limited by BT_MAX_THREAD_COUNT. */
+  int getMaxNumThreads() const override
+  {
+    return BT_MAX_THREAD_COUNT;
+  }
+  int getNumThreads() const override
+  {
+    return BT_MAX_THREAD_COUNT;
+  }
+  void setNumThreads(int /*numThreads*/) override
+  {
+  }
+
+  /* Number of threads of the application, for the number of constraint solvers. */
+  int getNumSolvers() const
+  {
+    return num_threads_;
+  }
+
+  void parallelFor(int iBegin, int iEnd, int grainSize, const btIParallelForBody &body) override
+  {
+    rbTaskRange range = {iBegin, iEnd, btMax(grainSize, 1), &body, NULL, NULL};
+    const int len = (iEnd - iBegin + range.grain_size - 1) / range.grain_size;
+
+    if (len <= 1 || parallel_for_ == NULL) {
+      rbThreadSlot slot;
+      body.forLoop(iBegin, iEnd);
+      return;
+    }
+
+    parallel_for_(len, for_task, &range);
+  }
+
+  btScalar parallelSum(int iBegin,
+                       int iEnd,
+                       int grainSize,
+                       const btIParallelSumBody &body) override
+  {
+    rbTaskRange range = {iBegin, iEnd, btMax(grainSize, 1), NULL, &body, NULL};
+    const int len = (iEnd - iBegin + range.grain_size - 1) / range.grain_size;
+
+    if (len <= 1 || parallel_for_ == NULL) {
+      rbThreadSlot slot;
+      return body.sumLoop(iBegin, iEnd);
+    }
+
+    /* Add up in order, so the result doesn't depend on the threads. */
+    std::vector<btScalar> sums(len);
+    range.sums = sums.data();
+    parallel_for_(len, sum_task, &range);
+
+    btScalar sum = btScalar(0);
+    for (btScalar value : sums) {
+      sum += value;
+    }
+    return sum;
+  }
+
+ private:
+  static void for_task(void *userdata, int index)
+  {
+    const rbTaskRange *range = (const rbTaskRange *)userdata;
+    const int begin = range->begin + index * range->grain_size;
+    const int end = btMin(begin + range->grain_size, range->end);
+
+    rbThreadSlot slot;
+    range->for_body->forLoop(begin, end);
+  }
+
+  static void sum_task(void *userdata, int index)
+  {
+    const rbTaskRange *range = (const rbTaskRange *)userdata;
+    const int begin = range->begin + index * range->grain_size;
+    const int end = btMin(begin + range->grain_size, range->end);
+
+    rbThreadSlot slot;
+    range->sums[index] = range->sum_body->sumLoop(begin, end);
+  }
+
+  int num_threads_;
+  rbParallelForFunc parallel_for_;
+};
+
+static rbTaskScheduler task_scheduler;
+static std::mutex task_scheduler_mutex;
+
+#endif /* WITH_BULLET_THREADS */
+
+void RB_task_scheduler_set(int num_threads, rbParallelForFunc parallel_for)
+{
+#ifdef WITH_BULLET_THREADS
+  std::lock_guard<std::mutex> lock(task_scheduler_mutex);
+
+  task_scheduler.set(num_threads, parallel_for);
+  if (btGetTaskScheduler() != &task_scheduler) {
+    btSetThreadIndexFunc(rb_thread_index);
+    btSetTaskScheduler(&task_scheduler);
+  }
+#else
+  (void)num_threads;
+  (void)parallel_for;
+#endif
+}
+
 /* ********************************** */
 /* Dynamics World Methods */
 
 /* Setup ---------------------------- */
 
-rbDynamicsWorld *RB_dworld_new(const float gravity[3])
+rbDynamicsWorld *RB_dworld_new(const float gravity[3], int use_multithreading)
 {
   rbDynamicsWorld *world = new rbDynamicsWorld;
 
+#ifdef WITH_BULLET_THREADS
+  /* Multi-threading needs RB_task_scheduler_set() to be called first. */
+  use_multithreading = use_multithreading && btGetTaskScheduler() == &task_scheduler;
+#else
+  UNUSED_VARS(use_multithreading);
+#endif
+
   /* collision detection/handling */
   world->collisionConfiguration = new btDefaultCollisionConfiguration();
 
-  world->dispatcher = new btCollisionDispatcher(world->collisionConfiguration);
+#ifdef WITH_BULLET_THREADS
+  if (use_multithreading) {
+    /* Number of collision pairs per task. */
+    world->dispatcher = new btCollisionDispatcherMt(world->collisionConfiguration, 40);
+  }
+  else
+#endif
+  {
+    world->dispatcher = new btCollisionDispatcher(world->collisionConfiguration);
+  }
   btGImpactCollisionAlgorithm::registerAlgorithm((btCollisionDispatcher *)world->dispatcher);
 
   world->pairCache = new btDbvtBroadphase();
@@ -151,12 +354,31 @@ rbDynamicsWorld *RB_dworld_new(const float gravity[3])
   world->filterCallback = new rbFilterCallback();
   world->pairCache->getOverlappingPairCache()->setOverlapFilterCallback(world->filterCallback);
 
-  /* constraint solving */
-  world->constraintSolver = new btSequentialImpulseConstraintSolver();
-
-  /* world */
-  world->dynamicsWorld = new btDiscreteDynamicsWorld(
-      world->dispatcher, world->pairCache, world->constraintSolver, world->collisionConfiguration);
+#ifdef WITH_BULLET_THREADS
+  if (use_multithreading) {
+    /* Simulation islands are solved in parallel, each by a solver of the pool. Bullet's batched
+     * solver for large islands is not used, it needs more iterations for stable stacks. */
+    btConstraintSolverPoolMt *solver_pool = new btConstraintSolverPoolMt(
+        task_scheduler.getNumSolvers());
+    world->constraintSolver = solver_pool;
+    world->dynamicsWorld = new btDiscreteDynamicsWorldMt(world->dispatcher,
+                                                         world->pairCache,
+                                                         solver_pool,
+                                                         NULL,
+                                                         world->collisionConfiguration);
+  }
+  else
+#endif
+  {
+    /* constraint solving */
+    world->constraintSolver = new btSequentialImpulseConstraintSolver();
+
+    /* world */
+    world->dynamicsWorld = new btDiscreteDynamicsWorld(world->dispatcher,
+                                                       world->pairCache,
+                                                       world->constraintSolver,
+                                                       world->collisionConfiguration);
+  }
 
   RB_dworld_set_gravity(world, gravity);
 
@@ -211,6 +433,9 @@ void RB_dworld_step_simulation(rbDynamicsWorld *world,
                                int maxSubSteps,
                                float timeSubStep)
 {
+#ifdef WITH_BULLET_THREADS
+  rbThreadSlot slot;
+#endif
   world->dynamicsWorld->stepSimulation(timeStep, maxSubSteps, timeSubStep);
 }
 
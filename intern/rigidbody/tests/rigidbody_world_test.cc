@@ -0,0 +1,249 @@
+/* Apache License, Version 2.0 */
+
+#include "testing/testing.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <thread>
+#include <vector>
+
+#include "RBI_api.h"
+
+namespace {
+
+/* Run tasks on threads started for every loop, like a task scheduler without a thread pool. */
+void test_parallel_for(int len, rbTaskFunc func, void *userdata)
+{
+  const int num_threads = std::min<int>(len, std::max(2u, std::thread::hardware_concurrency()));
+  std::atomic<int> next(0);
+  std::vector<std::thread> threads;
+
+  for (int i = 0; i < num_threads; i++) {
+    threads.emplace_back([&]() {
+      for (int index = next++; index < len; index = next++) {
+        func(userdata, index);
+      }
+    });
+  }
+  for (std::thread &thread : threads) {
+    thread.join();
+  }
+}
+
+struct TestWorld {
+  rbDynamicsWorld *world;
+  rbCollisionShape *ground_shape, *cube_shape;
+  rbRigidBody *ground;
+  std::vector<rbRigidBody *> cubes;
+};
+
+void test_world_init(TestWorld *test, bool use_multithreading)
+{
+  const float gravity[3] = {0.0f, 0.0f, -9.81f};
+  const float loc[3] = {0.0f, 0.0f, -1.0f};
+  const float rot[4] = {1.0f, 0.0f, 0.0f, 0.0f};
+
+  RB_task_scheduler_set((int)std::thread::hardware_concurrency(), test_parallel_for);
+
+  test->world = RB_dworld_new(gravity, use_multithreading);
+  RB_dworld_set_solver_iterations(test->world, 10);
+
+  test->ground_shape = RB_shape_new_box(500.0f, 500.0f, 1.0f);
+  test->cube_shape = RB_shape_new_box(0.5f, 0.5f, 0.5f);
+
+  test->ground = RB_body_new(test->ground_shape, loc, rot);
+  RB_body_set_mass(test->ground, 0.0f);
+  RB_dworld_add_body(test->world, test->ground, 1);
+}
+
+void test_world_add_cube(TestWorld *test, float x, float y, float z, float angle)
+{
+  const float loc[3] = {x, y, z};
+  const float rot[4] = {cosf(angle * 0.5f), sinf(angle * 0.5f), 0.0f, 0.0f};
+
+  rbRigidBody *cube = RB_body_new(test->cube_shape, loc, rot);
+  RB_body_set_mass(cube, 1.0f);
+  RB_body_set_friction(cube, 0.5f);
+  RB_dworld_add_body(test->world, cube, 1);
+  test->cubes.push_back(cube);
+}
+
+/* Cubes that each fall on the ground on their own, so every cube is a simulation island. */
+void test_world_add_separate(TestWorld *test, int size)
+{
+  for (int y = 0; y < size; y++) {
+    for (int x = 0; x < size; x++) {
+      test_world_add_cube(
+          test, x * 4.0f, y * 4.0f, 1.0f + 0.1f * ((x + y) % 7), 0.3f * ((x * 3 + y) % 5));
+    }
+  }
+}
+
+/* A pile of cubes with every other layer offset, so that it collapses into one island. */
+void test_world_add_pile(TestWorld *test, int size, int layers)
+{
+  for (int layer = 0; layer < layers; layer++) {
+    const float offset = 0.5f * (layer % 2);
+    for (int y = 0; y < size; y++) {
+      for (int x = 0; x < size; x++) {
+        test_world_add_cube(test,
+                            x * 1.1f + offset - size * 0.5f,
+                            y * 1.1f + offset - size * 0.5f,
+                            layer * 1.2f + 1.0f,
+                            0.0f);
+      }
+    }
+  }
+}
+
+void test_world_step(TestWorld *test, int steps)
+{
+  for (int i = 0; i < steps; i++) {
+    RB_dworld_step_simulation(test->world, 1.0f / 24.0f, 10, 1.0f / 60.0f);
+  }
+}
+
+std::vector<float> test_world_positions(TestWorld *test)
+{
+  std::vector<float> positions(test->cubes.size() * 3);
+  for (size_t i = 0; i < test->cubes.size(); i++) {
+    RB_body_get_position(test->cubes[i], &positions[i * 3]);
+  }
+  return positions;
+}
+
+void test_world_free(TestWorld *test)
+{
+  for (rbRigidBody *cube : test->cubes) {
+    RB_dworld_remove_body(test->world, cube);
+    RB_body_delete(cube);
+  }
+  RB_dworld_remove_body(test->world, test->ground);
+  RB_body_delete(test->ground);
+  RB_dworld_delete(test->world);
+  RB_shape_delete(test->cube_shape);
+  RB_shape_delete(test->ground_shape);
+}
+
+void expect_positions_near(const std::vector<float> &a, const std::vector<float> &b, float eps)
+{
+  ASSERT_EQ(a.size(), b.size());
+  for (size_t i = 0; i < a.size(); i++) {
+    EXPECT_NEAR(a[i], b[i], eps) << "cube " << i / 3;
+  }
+}
+
+float mean_height(const std::vector<float> &positions)
+{
+  double sum = 0.0;
+  for (size_t i = 2; i < positions.size(); i += 3) {
+    sum += positions[i];
+  }
+  return (float)(sum / (positions.size() / 3));
+}
+
+}  // namespace
+
+/* Separate islands are solved the same way by both worlds, only in a different order. */
+TEST(rigidbody_world, MultiThreadingSeparateIslands)
+{
+  TestWorld serial, threaded;
+
+  test_world_init(&serial, false);
+  test_world_add_separate(&serial, 12);
+  test_world_step(&serial, 48);
+
+  test_world_init(&threaded, true);
+  test_world_add_separate(&threaded, 12);
+  test_world_step(&threaded, 48);
+
+  const std::vector<float> positions = test_world_positions(&serial);
+  expect_positions_near(positions, test_world_positions(&threaded), 1e-3f);
+
+  /* All cubes came to rest on the ground. */
+  for (size_t i = 2; i < positions.size(); i += 3) {
+    EXPECT_GT(positions[i], 0.4f);
+    EXPECT_LT(positions[i], 0.9f);
+  }
+
+  test_world_free(&serial);
+  test_world_free(&threaded);
+}
+
+/* Solving a collapsing pile in parallel doesn't give exactly the same result, but it must end
+ * up at the same height. */
+TEST(rigidbody_world, MultiThreadingPile)
+{
+  TestWorld serial, threaded;
+
+  test_world_init(&serial, false);
+  test_world_add_pile(&serial, 8, 5);
+  test_world_step(&serial, 48);
+
+  test_world_init(&threaded, true);
+  test_world_add_pile(&threaded, 8, 5);
+  test_world_step(&threaded, 48);
+
+  const std::vector<float> positions = test_world_positions(&threaded);
+  for (size_t i = 2; i < positions.size(); i += 3) {
+    EXPECT_GT(positions[i], 0.0f);
+    EXPECT_LT(positions[i], 7.0f);
+  }
+  EXPECT_NEAR(mean_height(test_world_positions(&serial)), mean_height(positions), 0.25f);
+
+  test_world_free(&serial);
+  test_world_free(&threaded);
+}
+
+/* Worlds stepped by different threads at the same time don't share per thread solver data. */
+TEST(rigidbody_world, MultiThreadingConcurrentWorlds)
+{
+  TestWorld reference;
+  test_world_init(&reference, true);
+  test_world_add_separate(&reference, 8);
+  test_world_step(&reference, 48);
+  const std::vector<float> positions = test_world_positions(&reference);
+  test_world_free(&reference);
+
+  TestWorld worlds[4];
+  for (TestWorld &test : worlds) {
+    test_world_init(&test, true);
+    test_world_add_separate(&test, 8);
+  }
+
+  std::vector<std::thread> threads;
+  for (TestWorld &test : worlds) {
+    threads.emplace_back([&test]() { test_world_step(&test, 48); });
+  }
+  for (std::thread &thread : threads) {
+    thread.join();
+  }
+
+  for (TestWorld &test : worlds) {
+    expect_positions_near(positions, test_world_positions(&test), 1e-3f);
+    test_world_free(&test);
+  }
+}
+
+/* Run with --gtest_also_run_disabled_tests. */
+TEST(rigidbody_world, DISABLED_Performance)
+{
+  for (int use_multithreading = 0; use_multithreading < 2; use_multithreading++) {
+    TestWorld test;
+    test_world_init(&test, use_multithreading);
+    test_world_add_pile(&test, 32, 5);
+
+    const auto start = std::chrono::steady_clock::now();
+    test_world_step(&test, 50);
+    const std::chrono::duration<double> seconds = std::chrono::steady_clock::now() - start;
+
+    printf("%d cubes, multithreading %d: %fs\n",
+           (int)test.cubes.size(),
+           use_multithreading,
+           seconds.count());
+    test_world_free(&test);
+  }
+}
@@ -1802,6 +1802,7 @@ class SEQUENCER_PT_cache_settings(SequencerButtonsPanel, Panel):
         col.prop(ed, "use_cache_composite", text="Composite")
         col.prop(ed, "use_cache_final", text="Final")
         col.separator()
+        col.prop(ed, "use_cache_half_float", text="Half Float")
         col.prop(ed, "recycle_max_cost")
 
 
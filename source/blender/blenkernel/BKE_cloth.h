@@ -66,6 +66,11 @@ typedef struct ClothSolverResult {
   int max_iterations, min_iterations;
   float avg_iterations;
   float max_error, min_error, avg_error;
+
+  /* Time in seconds spent per substep, for tuning the simulation settings. */
+  float avg_time_solve;
+  float avg_time_collision_overlap;
+  float avg_time_collision_response;
 } ClothSolverResult;
 
 /**
@@ -60,6 +60,27 @@ typedef struct EffectedPoint {
   struct ParticleSystem *psys; /* particle system the point belongs to */
 } EffectedPoint;
 
+/* Input to effector code for many points at once. Attributes of the points are stored in
+ * separate arrays, settings shared by all points are stored once. */
+typedef struct EffectedPoints {
+  int totpoint;
+  const float (*loc)[3];
+  const float (*vel)[3];
+  /* Index of every point, same as #EffectedPoint.index. When NULL, the index of a point is its
+   * position in the arrays. */
+  const int *index;
+  /* Size of every point, may be NULL for points without size. */
+  const float *size;
+
+  float vel_to_frame;
+  float vel_to_sec;
+  float charge;
+
+  unsigned int flag;
+
+  struct ParticleSystem *psys; /* particle system the points belong to */
+} EffectedPoints;
+
 typedef struct GuideEffectorData {
   float vec_to_point[3];
   float strength;
@@ -131,6 +152,13 @@ void BKE_effectors_apply(struct ListBase *effectors,
                          float *force,
                          float *wind_force,
                          float *impulse);
+void BKE_effectors_apply_points(struct ListBase *effectors,
+                                struct ListBase *colliders,
+                                struct EffectorWeights *weights,
+                                const struct EffectedPoints *points,
+                                float (*force)[3],
+                                float (*wind_force)[3],
+                                float (*impulse)[3]);
 void BKE_effectors_free(struct ListBase *lb);
 
 void pd_point_from_particle(struct ParticleSimulationData *sim,
@@ -141,6 +169,16 @@ void pd_point_from_loc(
     struct Scene *scene, float *loc, float *vel, int index, struct EffectedPoint *point);
 void pd_point_from_soft(
     struct Scene *scene, float *loc, float *vel, int index, struct EffectedPoint *point);
+void pd_points_from_loc(struct Scene *scene,
+                        const float (*loc)[3],
+                        const float (*vel)[3],
+                        int totpoint,
+                        struct EffectedPoints *points);
+void pd_points_from_soft(struct Scene *scene,
+                         const float (*loc)[3],
+                         const float (*vel)[3],
+                         int totpoint,
+                         struct EffectedPoints *points);
 
 /* needed for boids */
 float effector_falloff(struct EffectorCache *eff,
@@ -64,6 +64,14 @@ void BKE_fluid_cache_free_all(struct FluidDomainSettings *fds, struct Object *ob
 void BKE_fluid_cache_free(struct FluidDomainSettings *fds, struct Object *ob, int cache_map);
 void BKE_fluid_cache_new_name_for_current_session(int maxlen, char *r_name);
 
+/* Reading cache files ahead in the playback direction, direction is 1 or -1. */
+void BKE_fluid_cache_prefetch(struct FluidDomainSettings *fds, int framenr, int direction);
+void BKE_fluid_cache_prefetch_wait(struct FluidDomainSettings *fds);
+void BKE_fluid_cache_prefetch_free(struct FluidDomainSettings *fds);
+/* Cache files read ahead into memory, the data stays valid until released. */
+const void *BKE_fluid_cache_file_acquire(const char *filepath, size_t *r_size, void **r_handle);
+void BKE_fluid_cache_file_release(void *handle);
+
 float BKE_fluid_get_velocity_at(struct Object *ob, float position[3], float velocity[3]);
 int BKE_fluid_get_data_flags(struct FluidDomainSettings *fds);
 
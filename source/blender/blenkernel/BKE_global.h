@@ -77,6 +77,7 @@ typedef struct Global {
    *   *   1112: Disable new Cloth internal springs handling (09/2014).
    *   *   1234: Disable new dyntopo code fixing skinny faces generation (04/2015).
    *   *   3001: Enable additional Fluid modifier (Mantaflow) options (02/2020).
+   *   *   4040: Delay sequencer image file reads, to test read-ahead on slow storage (10/2026).
    *   * 16384 and above: Reserved for python (add-ons) usage.
    */
   short debug_value;
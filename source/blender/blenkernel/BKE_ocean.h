@@ -109,6 +109,10 @@ void BKE_ocean_eval_uv_catrom(struct Ocean *oc, struct OceanResult *ocr, float u
 void BKE_ocean_eval_xz(struct Ocean *oc, struct OceanResult *ocr, float x, float z);
 void BKE_ocean_eval_xz_catrom(struct Ocean *oc, struct OceanResult *ocr, float x, float z);
 void BKE_ocean_eval_ij(struct Ocean *oc, struct OceanResult *ocr, int i, int j);
+void BKE_ocean_eval_uv_disp_array(struct Ocean *oc,
+                                  const float (*uv)[2],
+                                  float (*r_disp)[3],
+                                  const int totpoint);
 
 /* ocean cache handling */
 struct OceanCache *BKE_ocean_init_cache(const char *bakepath,
@@ -58,6 +58,7 @@ struct MVert;
 struct Main;
 struct ModifierData;
 struct Object;
+struct PointGrid;
 struct RNG;
 struct Scene;
 struct BlendDataReader;
@@ -433,7 +434,7 @@ void psys_apply_child_modifiers(struct ParticleThreadContext *ctx,
 
 void psys_sph_init(struct ParticleSimulationData *sim, struct SPHData *sphdata);
 void psys_sph_finalize(struct SPHData *sphdata);
-void psys_sph_density(struct BVHTree *tree, struct SPHData *data, float co[3], float vars[2]);
+void psys_sph_density(struct PointGrid *grid, struct SPHData *data, float co[3], float vars[2]);
 
 /* for anim.c */
 void psys_get_dupli_texture(struct ParticleSystem *psys,
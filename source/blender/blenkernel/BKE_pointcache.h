@@ -49,6 +49,8 @@ extern "C" {
 
 /* Add the blendfile name after blendcache_ */
 #define PTCACHE_EXT ".bphys"
+/* All frames of a cache in one file, see PTCACHE_SINGLE_FILE */
+#define PTCACHE_ARCHIVE_EXT ".bpcache"
 #define PTCACHE_PATH "blendcache_"
 
 /* File open options, for BKE_ptcache_file_open */
@@ -104,9 +106,16 @@ typedef struct PTCacheData {
   struct BoidData boids;
 } PTCacheData;
 
+struct PTCacheArchiveFile;
+
 typedef struct PTCacheFile {
   FILE *fp;
 
+  /* Frame of a single file cache, read from or written to memory instead of fp. */
+  struct PTCacheArchiveFile *archive;
+  unsigned char *mem;
+  size_t mem_len, mem_pos, mem_alloc;
+
   int frame, old_format;
   unsigned int totpoint, type;
   unsigned int data_types, flag;
@@ -298,6 +307,8 @@ bool BKE_ptcache_object_has(struct Scene *scene, struct Object *ob, int duplis);
 
 /***************** Global funcs ****************************/
 void BKE_ptcache_remove(void);
+/* Write and close the open single file caches. */
+void BKE_ptcache_exit(void);
 
 /************ ID specific functions ************************/
 void BKE_ptcache_id_clear(PTCacheID *id, int mode, unsigned int cfra);
@@ -360,6 +371,9 @@ void BKE_ptcache_mem_to_disk(struct PTCacheID *pid);
 /* Convert disk cache to memory cache and vice versa. Clears the cache that was converted. */
 void BKE_ptcache_toggle_disk_cache(struct PTCacheID *pid);
 
+/* Convert disk cache files to or from a single file, after PTCACHE_SINGLE_FILE was toggled. */
+void BKE_ptcache_toggle_single_file(struct PTCacheID *pid);
+
 /* Rename all disk cache files with a new name. Doesn't touch the actual content of the files. */
 void BKE_ptcache_disk_cache_rename(struct PTCacheID *pid,
                                    const char *name_src,
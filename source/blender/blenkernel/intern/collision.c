@@ -35,6 +35,7 @@
 #include "BLI_edgehash.h"
 #include "BLI_linklist.h"
 #include "BLI_math.h"
+#include "BLI_math_bits.h"
 #include "BLI_task.h"
 #include "BLI_threads.h"
 #include "BLI_utildefines.h"
@@ -53,10 +54,15 @@
 #include "DEG_depsgraph_physics.h"
 #include "DEG_depsgraph_query.h"
 
+#include "PIL_time.h"
+
 #ifdef WITH_ELTOPO
 #  include "eltopo-capi.h"
 #endif
 
+/* Pairs that conflict with all batches go in one extra batch, which is handled serially. */
+#define COLLISION_SELF_MAX_BATCHES 64
+
 typedef struct ColDetectData {
   ClothModifierData *clmd;
   CollisionModifierData *collmd;
@@ -74,6 +80,22 @@ typedef struct SelfColDetectData {
   bool collided;
 } SelfColDetectData;
 
+/* Self collision pairs grouped into batches that don't share any vertices, so the impulses of
+ * a batch can be applied in parallel. */
+typedef struct SelfColBatches {
+  /* Pair indices sorted by batch. */
+  int *pairs;
+  int batch_offsets[COLLISION_SELF_MAX_BATCHES + 2];
+} SelfColBatches;
+
+typedef struct SelfColResponseData {
+  ClothModifierData *clmd;
+  CollPair *collisions;
+  const int *pairs;
+  float dt;
+  bool collided;
+} SelfColResponseData;
+
 /***********************************
  * Collision modifier code start
  ***********************************/
@@ -837,107 +859,125 @@ static int cloth_collision_response_static(ClothModifierData *clmd,
   return result;
 }
 
-static int cloth_selfcollision_response_static(ClothModifierData *clmd,
-                                               CollPair *collpair,
-                                               uint collision_count,
-                                               const float dt)
+/* Impulses of a self collision pair. Pairs that don't share vertices can be handled in
+ * parallel. */
+static bool cloth_selfcollision_response_static(ClothModifierData *clmd,
+                                                CollPair *collpair,
+                                                const float dt)
 {
-  int result = 0;
+  bool result = false;
   Cloth *cloth = clmd->clothObject;
   const float clamp_sq = square_f(clmd->coll_parms->self_clamp * dt);
   const float time_multiplier = 1.0f / (clmd->sim_parms->dt * clmd->sim_parms->timescale);
   const float min_distance = (2.0f * clmd->coll_parms->selfepsilon) * (8.0f / 9.0f);
 
-  for (int i = 0; i < collision_count; i++, collpair++) {
-    float ia[3][3] = {{0.0f}};
-    float ib[3][3] = {{0.0f}};
-    float w1, w2, w3, u1, u2, u3;
-    float v1[3], v2[3], relativeVelocity[3];
+  float ia[3][3] = {{0.0f}};
+  float ib[3][3] = {{0.0f}};
+  float w1, w2, w3, u1, u2, u3;
+  float v1[3], v2[3], relativeVelocity[3];
 
-    /* Only handle static collisions here. */
-    if (collpair->flag & (COLLISION_IN_FUTURE | COLLISION_INACTIVE)) {
-      continue;
-    }
+  /* Only handle static collisions here. */
+  if (collpair->flag & (COLLISION_IN_FUTURE | COLLISION_INACTIVE)) {
+    return false;
+  }
 
-    /* Compute barycentric coordinates for both collision points. */
-    collision_compute_barycentric(collpair->pa,
-                                  cloth->verts[collpair->ap1].tx,
-                                  cloth->verts[collpair->ap2].tx,
-                                  cloth->verts[collpair->ap3].tx,
-                                  &w1,
-                                  &w2,
-                                  &w3);
+  /* Compute barycentric coordinates for both collision points. */
+  collision_compute_barycentric(collpair->pa,
+                                cloth->verts[collpair->ap1].tx,
+                                cloth->verts[collpair->ap2].tx,
+                                cloth->verts[collpair->ap3].tx,
+                                &w1,
+                                &w2,
+                                &w3);
 
-    collision_compute_barycentric(collpair->pb,
-                                  cloth->verts[collpair->bp1].tx,
-                                  cloth->verts[collpair->bp2].tx,
-                                  cloth->verts[collpair->bp3].tx,
-                                  &u1,
-                                  &u2,
-                                  &u3);
+  collision_compute_barycentric(collpair->pb,
+                                cloth->verts[collpair->bp1].tx,
+                                cloth->verts[collpair->bp2].tx,
+                                cloth->verts[collpair->bp3].tx,
+                                &u1,
+                                &u2,
+                                &u3);
 
-    /* Calculate relative "velocity". */
-    collision_interpolateOnTriangle(v1,
-                                    cloth->verts[collpair->ap1].tv,
-                                    cloth->verts[collpair->ap2].tv,
-                                    cloth->verts[collpair->ap3].tv,
-                                    w1,
-                                    w2,
-                                    w3);
+  /* Calculate relative "velocity". */
+  collision_interpolateOnTriangle(v1,
+                                  cloth->verts[collpair->ap1].tv,
+                                  cloth->verts[collpair->ap2].tv,
+                                  cloth->verts[collpair->ap3].tv,
+                                  w1,
+                                  w2,
+                                  w3);
+
+  collision_interpolateOnTriangle(v2,
+                                  cloth->verts[collpair->bp1].tv,
+                                  cloth->verts[collpair->bp2].tv,
+                                  cloth->verts[collpair->bp3].tv,
+                                  u1,
+                                  u2,
+                                  u3);
 
-    collision_interpolateOnTriangle(v2,
-                                    cloth->verts[collpair->bp1].tv,
-                                    cloth->verts[collpair->bp2].tv,
-                                    cloth->verts[collpair->bp3].tv,
-                                    u1,
-                                    u2,
-                                    u3);
+  sub_v3_v3v3(relativeVelocity, v2, v1);
 
-    sub_v3_v3v3(relativeVelocity, v2, v1);
+  /* Calculate the normal component of the relative velocity
+   * (actually only the magnitude - the direction is stored in 'normal'). */
+  const float magrelVel = dot_v3v3(relativeVelocity, collpair->normal);
+  const float d = min_distance - collpair->distance;
 
-    /* Calculate the normal component of the relative velocity
-     * (actually only the magnitude - the direction is stored in 'normal'). */
-    const float magrelVel = dot_v3v3(relativeVelocity, collpair->normal);
-    const float d = min_distance - collpair->distance;
+  /* TODO: Impulses should be weighed by mass as this is self col,
+   * this has to be done after mass distribution is implemented. */
 
-    /* TODO: Impulses should be weighed by mass as this is self col,
-     * this has to be done after mass distribution is implemented. */
+  /* If magrelVel < 0 the edges are approaching each other. */
+  if (magrelVel > 0.0f) {
+    /* Calculate Impulse magnitude to stop all motion in normal direction. */
+    float magtangent = 0, repulse = 0;
+    double impulse = 0.0;
+    float vrel_t_pre[3];
+    float temp[3];
 
-    /* If magrelVel < 0 the edges are approaching each other. */
-    if (magrelVel > 0.0f) {
-      /* Calculate Impulse magnitude to stop all motion in normal direction. */
-      float magtangent = 0, repulse = 0;
-      double impulse = 0.0;
-      float vrel_t_pre[3];
-      float temp[3];
+    /* Calculate tangential velocity. */
+    copy_v3_v3(temp, collpair->normal);
+    mul_v3_fl(temp, magrelVel);
+    sub_v3_v3v3(vrel_t_pre, relativeVelocity, temp);
 
-      /* Calculate tangential velocity. */
-      copy_v3_v3(temp, collpair->normal);
-      mul_v3_fl(temp, magrelVel);
-      sub_v3_v3v3(vrel_t_pre, relativeVelocity, temp);
+    /* Decrease in magnitude of relative tangential velocity due to coulomb friction
+     * in original formula "magrelVel" should be the
+     * "change of relative velocity in normal direction". */
+    magtangent = min_ff(clmd->coll_parms->self_friction * 0.01f * magrelVel, len_v3(vrel_t_pre));
 
-      /* Decrease in magnitude of relative tangential velocity due to coulomb friction
-       * in original formula "magrelVel" should be the
-       * "change of relative velocity in normal direction". */
-      magtangent = min_ff(clmd->coll_parms->self_friction * 0.01f * magrelVel, len_v3(vrel_t_pre));
+    /* Apply friction impulse. */
+    if (magtangent > ALMOST_ZERO) {
+      normalize_v3(vrel_t_pre);
 
-      /* Apply friction impulse. */
-      if (magtangent > ALMOST_ZERO) {
-        normalize_v3(vrel_t_pre);
+      impulse = magtangent / 1.5;
 
-        impulse = magtangent / 1.5;
+      VECADDMUL(ia[0], vrel_t_pre, (double)w1 * impulse);
+      VECADDMUL(ia[1], vrel_t_pre, (double)w2 * impulse);
+      VECADDMUL(ia[2], vrel_t_pre, (double)w3 * impulse);
 
-        VECADDMUL(ia[0], vrel_t_pre, (double)w1 * impulse);
-        VECADDMUL(ia[1], vrel_t_pre, (double)w2 * impulse);
-        VECADDMUL(ia[2], vrel_t_pre, (double)w3 * impulse);
+      VECADDMUL(ib[0], vrel_t_pre, (double)u1 * -impulse);
+      VECADDMUL(ib[1], vrel_t_pre, (double)u2 * -impulse);
+      VECADDMUL(ib[2], vrel_t_pre, (double)u3 * -impulse);
+    }
 
-        VECADDMUL(ib[0], vrel_t_pre, (double)u1 * -impulse);
-        VECADDMUL(ib[1], vrel_t_pre, (double)u2 * -impulse);
-        VECADDMUL(ib[2], vrel_t_pre, (double)u3 * -impulse);
+    /* Apply velocity stopping impulse. */
+    impulse = magrelVel / 3.0f;
+
+    VECADDMUL(ia[0], collpair->normal, (double)w1 * impulse);
+    VECADDMUL(ia[1], collpair->normal, (double)w2 * impulse);
+    VECADDMUL(ia[2], collpair->normal, (double)w3 * impulse);
+
+    VECADDMUL(ib[0], collpair->normal, (double)u1 * -impulse);
+    VECADDMUL(ib[1], collpair->normal, (double)u2 * -impulse);
+    VECADDMUL(ib[2], collpair->normal, (double)u3 * -impulse);
+
+    if ((magrelVel < 0.1f * d * time_multiplier) && (d > ALMOST_ZERO)) {
+      repulse = MIN2(d / time_multiplier, 0.1f * d * time_multiplier - magrelVel);
+
+      if (impulse > ALMOST_ZERO) {
+        repulse = min_ff(repulse, 5.0 * impulse);
       }
 
-      /* Apply velocity stopping impulse. */
-      impulse = magrelVel / 3.0f;
+      repulse = max_ff(impulse, repulse);
+      impulse = repulse / 1.5f;
 
       VECADDMUL(ia[0], collpair->normal, (double)w1 * impulse);
       VECADDMUL(ia[1], collpair->normal, (double)w2 * impulse);
@@ -946,53 +986,34 @@ static int cloth_selfcollision_response_static(ClothModifierData *clmd,
       VECADDMUL(ib[0], collpair->normal, (double)u1 * -impulse);
       VECADDMUL(ib[1], collpair->normal, (double)u2 * -impulse);
       VECADDMUL(ib[2], collpair->normal, (double)u3 * -impulse);
-
-      if ((magrelVel < 0.1f * d * time_multiplier) && (d > ALMOST_ZERO)) {
-        repulse = MIN2(d / time_multiplier, 0.1f * d * time_multiplier - magrelVel);
-
-        if (impulse > ALMOST_ZERO) {
-          repulse = min_ff(repulse, 5.0 * impulse);
-        }
-
-        repulse = max_ff(impulse, repulse);
-        impulse = repulse / 1.5f;
-
-        VECADDMUL(ia[0], collpair->normal, (double)w1 * impulse);
-        VECADDMUL(ia[1], collpair->normal, (double)w2 * impulse);
-        VECADDMUL(ia[2], collpair->normal, (double)w3 * impulse);
-
-        VECADDMUL(ib[0], collpair->normal, (double)u1 * -impulse);
-        VECADDMUL(ib[1], collpair->normal, (double)u2 * -impulse);
-        VECADDMUL(ib[2], collpair->normal, (double)u3 * -impulse);
-      }
-
-      result = 1;
     }
-    else if (d > ALMOST_ZERO) {
-      /* Stay on the safe side and clamp repulse. */
-      float repulse = d * 1.0f / time_multiplier;
-      float impulse = repulse / 9.0f;
 
-      VECADDMUL(ia[0], collpair->normal, w1 * impulse);
-      VECADDMUL(ia[1], collpair->normal, w2 * impulse);
-      VECADDMUL(ia[2], collpair->normal, w3 * impulse);
+    result = true;
+  }
+  else if (d > ALMOST_ZERO) {
+    /* Stay on the safe side and clamp repulse. */
+    float repulse = d * 1.0f / time_multiplier;
+    float impulse = repulse / 9.0f;
 
-      VECADDMUL(ib[0], collpair->normal, u1 * -impulse);
-      VECADDMUL(ib[1], collpair->normal, u2 * -impulse);
-      VECADDMUL(ib[2], collpair->normal, u3 * -impulse);
+    VECADDMUL(ia[0], collpair->normal, w1 * impulse);
+    VECADDMUL(ia[1], collpair->normal, w2 * impulse);
+    VECADDMUL(ia[2], collpair->normal, w3 * impulse);
 
-      result = 1;
-    }
+    VECADDMUL(ib[0], collpair->normal, u1 * -impulse);
+    VECADDMUL(ib[1], collpair->normal, u2 * -impulse);
+    VECADDMUL(ib[2], collpair->normal, u3 * -impulse);
 
-    if (result) {
-      cloth_collision_impulse_vert(clamp_sq, ia[0], &cloth->verts[collpair->ap1]);
-      cloth_collision_impulse_vert(clamp_sq, ia[1], &cloth->verts[collpair->ap2]);
-      cloth_collision_impulse_vert(clamp_sq, ia[2], &cloth->verts[collpair->ap3]);
+    result = true;
+  }
 
-      cloth_collision_impulse_vert(clamp_sq, ib[0], &cloth->verts[collpair->bp1]);
-      cloth_collision_impulse_vert(clamp_sq, ib[1], &cloth->verts[collpair->bp2]);
-      cloth_collision_impulse_vert(clamp_sq, ib[2], &cloth->verts[collpair->bp3]);
-    }
+  if (result) {
+    cloth_collision_impulse_vert(clamp_sq, ia[0], &cloth->verts[collpair->ap1]);
+    cloth_collision_impulse_vert(clamp_sq, ia[1], &cloth->verts[collpair->ap2]);
+    cloth_collision_impulse_vert(clamp_sq, ia[2], &cloth->verts[collpair->ap3]);
+
+    cloth_collision_impulse_vert(clamp_sq, ib[0], &cloth->verts[collpair->bp1]);
+    cloth_collision_impulse_vert(clamp_sq, ib[1], &cloth->verts[collpair->bp2]);
+    cloth_collision_impulse_vert(clamp_sq, ib[2], &cloth->verts[collpair->bp3]);
   }
 
   return result;
@@ -1467,9 +1488,109 @@ static int cloth_bvh_objcollisions_resolve(ClothModifierData *clmd,
   return ret;
 }
 
+/* Greedy graph coloring of the overlapping triangle pairs, every pair is put in the first batch
+ * none of its vertices is used in yet. */
+static void cloth_selfcollision_batches_create(const Cloth *cloth,
+                                               const BVHTreeOverlap *overlap,
+                                               uint overlap_num,
+                                               SelfColBatches *r_batches)
+{
+  uint64_t *vert_batches = MEM_callocN(sizeof(*vert_batches) * cloth->mvert_num, __func__);
+  uchar *pair_batch = MEM_mallocN(sizeof(*pair_batch) * overlap_num, __func__);
+  int *batch_offsets = r_batches->batch_offsets;
+
+  memset(batch_offsets, 0, sizeof(r_batches->batch_offsets));
+
+  for (uint i = 0; i < overlap_num; i++) {
+    const uint *tri_a = cloth->tri[overlap[i].indexA].tri;
+    const uint *tri_b = cloth->tri[overlap[i].indexB].tri;
+    uint64_t used = 0;
+
+    for (int k = 0; k < 3; k++) {
+      used |= vert_batches[tri_a[k]] | vert_batches[tri_b[k]];
+    }
+
+    uint batch = COLLISION_SELF_MAX_BATCHES;
+    if (used != UINT64_MAX) {
+      batch = bitscan_forward_uint64(~used);
+      for (int k = 0; k < 3; k++) {
+        vert_batches[tri_a[k]] |= (uint64_t)1 << batch;
+        vert_batches[tri_b[k]] |= (uint64_t)1 << batch;
+      }
+    }
+
+    pair_batch[i] = (uchar)batch;
+    batch_offsets[batch + 1]++;
+  }
+
+  for (int batch = 0; batch <= COLLISION_SELF_MAX_BATCHES; batch++) {
+    batch_offsets[batch + 1] += batch_offsets[batch];
+  }
+
+  /* Sort pairs by batch, keeping their order within a batch. */
+  int batch_fill[COLLISION_SELF_MAX_BATCHES + 1];
+  memcpy(batch_fill, batch_offsets, sizeof(batch_fill));
+
+  r_batches->pairs = MEM_mallocN(sizeof(*r_batches->pairs) * overlap_num, __func__);
+  for (uint i = 0; i < overlap_num; i++) {
+    r_batches->pairs[batch_fill[pair_batch[i]]++] = (int)i;
+  }
+
+  MEM_freeN(vert_batches);
+  MEM_freeN(pair_batch);
+}
+
+static void cloth_selfcollision_response_cb(void *__restrict userdata,
+                                            const int index,
+                                            const TaskParallelTLS *__restrict UNUSED(tls))
+{
+  SelfColResponseData *data = (SelfColResponseData *)userdata;
+  CollPair *collpair = &data->collisions[data->pairs[index]];
+
+  if (cloth_selfcollision_response_static(data->clmd, collpair, data->dt)) {
+    data->collided = true;
+  }
+}
+
+static bool cloth_selfcollision_response_batches(ClothModifierData *clmd,
+                                                 CollPair *collisions,
+                                                 const SelfColBatches *batches,
+                                                 const float dt)
+{
+  bool collided = false;
+
+  for (int batch = 0; batch <= COLLISION_SELF_MAX_BATCHES; batch++) {
+    const int start = batches->batch_offsets[batch];
+    const int end = batches->batch_offsets[batch + 1];
+
+    if (start == end) {
+      continue;
+    }
+
+    SelfColResponseData data = {
+        .clmd = clmd,
+        .collisions = collisions,
+        .pairs = batches->pairs + start,
+        .dt = dt,
+        .collided = false,
+    };
+
+    /* Vertices are only shared between pairs of different batches, except for the last one. */
+    TaskParallelSettings settings;
+    BLI_parallel_range_settings_defaults(&settings);
+    settings.use_threading = (batch != COLLISION_SELF_MAX_BATCHES);
+    settings.min_iter_per_thread = 64;
+    BLI_task_parallel_range(0, end - start, &data, cloth_selfcollision_response_cb, &settings);
+
+    collided |= data.collided;
+  }
+
+  return collided;
+}
+
 static int cloth_bvh_selfcollisions_resolve(ClothModifierData *clmd,
                                             CollPair *collisions,
-                                            int collision_count,
+                                            const SelfColBatches *batches,
                                             const float dt)
 {
   Cloth *cloth = clmd->clothObject;
@@ -1484,7 +1605,7 @@ static int cloth_bvh_selfcollisions_resolve(ClothModifierData *clmd,
   for (j = 0; j < 2; j++) {
     result = 0;
 
-    result += cloth_selfcollision_response_static(clmd, collisions, collision_count, dt);
+    result += cloth_selfcollision_response_batches(clmd, collisions, batches, dt);
 
     /* Apply impulses in parallel. */
     if (result) {
@@ -1542,11 +1663,14 @@ int cloth_bvh_collision(
   BVHTreeOverlap **overlap_obj = NULL;
   uint coll_count_self = 0;
   BVHTreeOverlap *overlap_self = NULL;
+  SelfColBatches batches_self = {NULL};
 
   if ((clmd->sim_parms->flags & CLOTH_SIMSETTINGS_FLAG_COLLOBJ) || cloth_bvh == NULL) {
     return 0;
   }
 
+  const double time_start = PIL_check_seconds_timer();
+
   verts = cloth->verts;
   mvert_num = cloth->mvert_num;
 
@@ -1589,8 +1713,14 @@ int cloth_bvh_collision(
 
     overlap_self = BLI_bvhtree_overlap(
         cloth->bvhselftree, cloth->bvhselftree, &coll_count_self, cloth_bvh_self_overlap_cb, clmd);
+
+    if (coll_count_self && overlap_self) {
+      cloth_selfcollision_batches_create(cloth, overlap_self, coll_count_self, &batches_self);
+    }
   }
 
+  const double time_overlap = PIL_check_seconds_timer();
+
   do {
     ret2 = 0;
 
@@ -1650,7 +1780,7 @@ int cloth_bvh_collision(
 
           if (cloth_bvh_selfcollisions_nearcheck(
                   clmd, collisions, coll_count_self, overlap_self)) {
-            ret += cloth_bvh_selfcollisions_resolve(clmd, collisions, coll_count_self, dt);
+            ret += cloth_bvh_selfcollisions_resolve(clmd, collisions, &batches_self, dt);
             ret2 += ret;
           }
         }
@@ -1686,9 +1816,19 @@ int cloth_bvh_collision(
   MEM_SAFE_FREE(coll_counts_obj);
 
   MEM_SAFE_FREE(overlap_self);
+  MEM_SAFE_FREE(batches_self.pairs);
 
   BKE_collision_objects_free(collobjs);
 
+  if (clmd->solver_result) {
+    /* Averaged over the substeps of a frame. */
+    const double time_end = PIL_check_seconds_timer();
+    clmd->solver_result->avg_time_collision_overlap += (float)(time_overlap - time_start) *
+                                                       clmd->sim_parms->dt;
+    clmd->solver_result->avg_time_collision_response += (float)(time_end - time_overlap) *
+                                                        clmd->sim_parms->dt;
+  }
+
   return MIN2(ret, 1);
 }
 
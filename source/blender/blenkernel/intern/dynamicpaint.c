@@ -84,6 +84,8 @@
 
 #include "CLG_log.h"
 
+#include "dynamicpaint_intern.h"
+
 /* could enable at some point but for now there are far too many conversions */
 #ifdef __GNUC__
 //#  pragma GCC diagnostic ignored "-Wdouble-promotion"
@@ -5066,8 +5068,6 @@ typedef struct DynamicPaintEffectData {
   const void *prevPoint;
   const float eff_scale;
 
-  uint8_t *point_locks;
-
   const float wave_speed;
   const float wave_scale;
   const float wave_max_slope;
@@ -5324,137 +5324,233 @@ static void dynamic_paint_effect_shrink_cb(void *__restrict userdata,
   }
 }
 
-static void dynamic_paint_effect_drip_cb(void *__restrict userdata,
-                                         const int index,
-                                         const TaskParallelTLS *__restrict UNUSED(tls))
+typedef struct DynamicPaintDripTargetsData {
+  const PaintSurfaceData *sData;
+  const float *force;
+  PaintDripData *drip;
+} DynamicPaintDripTargetsData;
+
+static void dynamic_paint_drip_targets_cb(void *__restrict userdata,
+                                          const int index,
+                                          const TaskParallelTLS *__restrict UNUSED(tls))
 {
-  const DynamicPaintEffectData *data = userdata;
+  const DynamicPaintDripTargetsData *data = userdata;
+  const PaintSurfaceData *sData = data->sData;
+  const BakeAdjPoint *bNeighs = sData->bData->bNeighs;
+  const int *n_target = sData->adj_data->n_target;
+  PaintDripData *drip = data->drip;
+  int closest_id[2];
+  float closest_d[2];
 
-  const DynamicPaintSurface *surface = data->surface;
-  const PaintSurfaceData *sData = surface->data;
+  drip->target[index * 2] = drip->target[index * 2 + 1] = -1;
 
   if (sData->adj_data->flags[index] & ADJ_BORDER_PIXEL) {
     return;
   }
 
-  BakeAdjPoint *bNeighs = sData->bData->bNeighs;
-  PaintPoint *pPoint = &((PaintPoint *)sData->type_data)[index];
-  const PaintPoint *prevPoint = data->prevPoint;
-  const PaintPoint *pPoint_prev = &prevPoint[index];
-  const float *force = data->force;
-  const float eff_scale = data->eff_scale;
+  /* get force affect points */
+  surface_determineForceTargetPoints(sData, index, &data->force[index * 4], closest_d, closest_id);
 
-  const int *n_target = sData->adj_data->n_target;
+  for (int i = 0; i < 2; i++) {
+    /* just skip if angle is too extreme */
+    if (closest_id[i] == -1 || closest_d[i] <= 0.0f) {
+      continue;
+    }
+    drip->target[index * 2 + i] = n_target[closest_id[i]];
+    drip->influence[index * 2 + i] = closest_d[i];
+    drip->speed[index * 2 + i] = data->force[index * 4 + 3] / bNeighs[closest_id[i]].dist;
+  }
+}
 
-  uint8_t *point_locks = data->point_locks;
+static PaintDripData *dynamicPaint_prepareDripData(DynamicPaintSurface *surface, float *force)
+{
+  PaintSurfaceData *sData = surface->data;
+  PaintDripData *drip = dynamicPaint_dripData_new(sData->total_points);
 
-  int closest_id[2];
-  float closest_d[2];
+  DynamicPaintDripTargetsData data = {
+      .sData = sData,
+      .force = force,
+      .drip = drip,
+  };
+  TaskParallelSettings settings;
+  BLI_parallel_range_settings_defaults(&settings);
+  settings.use_threading = (sData->total_points > 1000);
+  BLI_task_parallel_range(
+      0, sData->total_points, &data, dynamic_paint_drip_targets_cb, &settings);
 
-  /* adjust drip speed depending on wetness */
-  float w_factor = pPoint_prev->wetness - 0.025f;
-  if (w_factor <= 0) {
-    return;
-  }
-  CLAMP(w_factor, 0.0f, 1.0f);
+  dynamicPaint_dripData_index(drip);
+  return drip;
+}
 
-  float ppoint_wetness_diff = 0.0f;
+PaintDripData *dynamicPaint_dripData_new(int total_points)
+{
+  PaintDripData *drip = MEM_callocN(sizeof(*drip), __func__);
 
-  /* get force affect points */
-  surface_determineForceTargetPoints(sData, index, &force[index * 4], closest_d, closest_id);
+  drip->total_points = total_points;
+  drip->target = MEM_mallocN(sizeof(int[2]) * total_points, "Drip Targets");
+  drip->influence = MEM_mallocN(sizeof(float[2]) * total_points, "Drip Influences");
+  drip->speed = MEM_mallocN(sizeof(float[2]) * total_points, "Drip Speeds");
+  drip->in_index = MEM_mallocN(sizeof(int) * total_points, "Drip Index");
+  drip->in_num = MEM_callocN(sizeof(int) * total_points, "Drip Num");
+  drip->wetness_diff = MEM_mallocN(sizeof(float[2]) * total_points, "Drip Wetness");
 
-  /* Apply movement towards those two points */
-  for (int i = 0; i < 2; i++) {
-    const int n_idx = closest_id[i];
-    if (n_idx != -1 && closest_d[i] > 0.0f) {
-      const float dir_dot = closest_d[i];
+  return drip;
+}
 
-      /* just skip if angle is too extreme */
-      if (dir_dot <= 0.0f) {
-        continue;
-      }
+void dynamicPaint_dripData_index(PaintDripData *drip)
+{
+  const int total_points = drip->total_points;
+  int total_drips = 0;
 
-      float dir_factor, a_factor;
-      const float speed_scale = eff_scale * force[index * 4 + 3] / bNeighs[n_idx].dist;
+  /* count drips into each point */
+  memset(drip->in_num, 0, sizeof(int) * total_points);
+  for (int i = 0; i < total_points * 2; i++) {
+    if (drip->target[i] != -1) {
+      drip->in_num[drip->target[i]]++;
+      total_drips++;
+    }
+  }
 
-      const unsigned int n_trgt = (unsigned int)n_target[n_idx];
+  MEM_SAFE_FREE(drip->in_drip);
+  drip->in_drip = MEM_mallocN(sizeof(int) * max_ii(total_drips, 1), "Drip Sources");
+  for (int index = 0, n_pos = 0; index < total_points; index++) {
+    drip->in_index[index] = n_pos;
+    n_pos += drip->in_num[index];
+  }
 
-      /* Sort of spinlock, but only for given ePoint.
-       * Since the odds a same ePoint is modified at the same time by several threads is very low,
-       * this is much more efficient than a global spin lock. */
-      const unsigned int epointlock_idx = n_trgt / 8;
-      const uint8_t epointlock_bitmask = 1 << (n_trgt & 7); /* 7 == 0b111 */
-      while (atomic_fetch_and_or_uint8(&point_locks[epointlock_idx], epointlock_bitmask) &
-             epointlock_bitmask) {
-        /* pass */
-      }
+  /* store drips in point order, so they are applied in the same order every step */
+  memset(drip->in_num, 0, sizeof(int) * total_points);
+  for (int i = 0; i < total_points * 2; i++) {
+    if (drip->target[i] != -1) {
+      const int target = drip->target[i];
+      drip->in_drip[drip->in_index[target] + drip->in_num[target]++] = i;
+    }
+  }
+}
+
+void dynamicPaint_dripData_free(PaintDripData *drip)
+{
+  MEM_freeN(drip->target);
+  MEM_freeN(drip->influence);
+  MEM_freeN(drip->speed);
+  MEM_SAFE_FREE(drip->in_drip);
+  MEM_freeN(drip->in_index);
+  MEM_freeN(drip->in_num);
+  MEM_freeN(drip->wetness_diff);
+  MEM_freeN(drip);
+}
 
-      PaintPoint *ePoint = &((PaintPoint *)sData->type_data)[n_trgt];
-      const float e_wet = ePoint->wetness;
+typedef struct DynamicPaintDripStepData {
+  const PaintDripData *drip;
+  PaintPoint *points;
+  const PaintPoint *prev_points;
+  float eff_scale;
+} DynamicPaintDripStepData;
 
-      dir_factor = min_ff(0.5f, dir_dot * min_ff(speed_scale, 1.0f) * w_factor);
+/* Moves paint of the previous step into this point, from the points dripping into it. */
+static void dynamic_paint_effect_drip_cb(void *__restrict userdata,
+                                         const int index,
+                                         const TaskParallelTLS *__restrict UNUSED(tls))
+{
+  const DynamicPaintDripStepData *data = userdata;
+  const PaintDripData *drip = data->drip;
+  PaintPoint *ePoint = &data->points[index];
+  const float eff_scale = data->eff_scale;
 
-      /* mix new wetness */
-      ePoint->wetness += dir_factor;
-      CLAMP(ePoint->wetness, 0.0f, MAX_WETNESS);
+  for (int i = 0; i < drip->in_num[index]; i++) {
+    const int drip_index = drip->in_drip[drip->in_index[index] + i];
+    const float dir_dot = drip->influence[drip_index];
+    const PaintPoint *pPoint_prev = &data->prev_points[drip_index / 2];
 
-      /* mix new color */
-      a_factor = dir_factor / pPoint_prev->wetness;
-      CLAMP(a_factor, 0.0f, 1.0f);
-      mixColors(ePoint->e_color,
-                ePoint->e_color[3],
-                pPoint_prev->e_color,
-                pPoint_prev->e_color[3],
-                a_factor);
-      /* dripping is supposed to preserve alpha level */
-      if (pPoint_prev->e_color[3] > ePoint->e_color[3]) {
-        ePoint->e_color[3] += a_factor * pPoint_prev->e_color[3];
-        CLAMP_MAX(ePoint->e_color[3], pPoint_prev->e_color[3]);
-      }
+    drip->wetness_diff[drip_index] = 0.0f;
 
-      /* Decrease paint wetness on current point (just store diff here,
-       * that way we can only lock current point once at the end to apply it). */
-      ppoint_wetness_diff += (ePoint->wetness - e_wet);
+    /* adjust drip speed depending on wetness */
+    float w_factor = pPoint_prev->wetness - 0.025f;
+    if (w_factor <= 0) {
+      continue;
+    }
+    CLAMP(w_factor, 0.0f, 1.0f);
 
-#ifndef NDEBUG
-      {
-        uint8_t ret = atomic_fetch_and_and_uint8(&point_locks[epointlock_idx],
-                                                 ~epointlock_bitmask);
-        BLI_assert(ret & epointlock_bitmask);
-      }
-#else
-      atomic_fetch_and_and_uint8(&point_locks[epointlock_idx], ~epointlock_bitmask);
-#endif
+    float dir_factor, a_factor;
+    const float speed_scale = eff_scale * drip->speed[drip_index];
+    const float e_wet = ePoint->wetness;
+
+    dir_factor = min_ff(0.5f, dir_dot * min_ff(speed_scale, 1.0f) * w_factor);
+
+    /* mix new wetness */
+    ePoint->wetness += dir_factor;
+    CLAMP(ePoint->wetness, 0.0f, MAX_WETNESS);
+
+    /* mix new color */
+    a_factor = dir_factor / pPoint_prev->wetness;
+    CLAMP(a_factor, 0.0f, 1.0f);
+    mixColors(ePoint->e_color,
+              ePoint->e_color[3],
+              pPoint_prev->e_color,
+              pPoint_prev->e_color[3],
+              a_factor);
+    /* dripping is supposed to preserve alpha level */
+    if (pPoint_prev->e_color[3] > ePoint->e_color[3]) {
+      ePoint->e_color[3] += a_factor * pPoint_prev->e_color[3];
+      CLAMP_MAX(ePoint->e_color[3], pPoint_prev->e_color[3]);
     }
+
+    /* Decrease paint wetness on the dripping point afterwards, by the amount actually added. */
+    drip->wetness_diff[drip_index] = ePoint->wetness - e_wet;
   }
+}
 
-  {
-    const unsigned int ppointlock_idx = index / 8;
-    const uint8_t ppointlock_bitmask = 1 << (index & 7); /* 7 == 0b111 */
-    while (atomic_fetch_and_or_uint8(&point_locks[ppointlock_idx], ppointlock_bitmask) &
-           ppointlock_bitmask) {
-      /* pass */
+/* Removes the wetness that dripped from this point to its targets. */
+static void dynamic_paint_effect_drip_apply_cb(void *__restrict userdata,
+                                               const int index,
+                                               const TaskParallelTLS *__restrict UNUSED(tls))
+{
+  const DynamicPaintDripStepData *data = userdata;
+  const PaintDripData *drip = data->drip;
+  PaintPoint *pPoint = &data->points[index];
+  float ppoint_wetness_diff = 0.0f;
+
+  for (int i = 0; i < 2; i++) {
+    if (drip->target[index * 2 + i] != -1) {
+      ppoint_wetness_diff += drip->wetness_diff[index * 2 + i];
     }
+  }
 
+  if (ppoint_wetness_diff != 0.0f) {
     pPoint->wetness -= ppoint_wetness_diff;
     CLAMP(pPoint->wetness, 0.0f, MAX_WETNESS);
-
-#ifndef NDEBUG
-    {
-      uint8_t ret = atomic_fetch_and_and_uint8(&point_locks[ppointlock_idx], ~ppointlock_bitmask);
-      BLI_assert(ret & ppointlock_bitmask);
-    }
-#else
-    atomic_fetch_and_and_uint8(&point_locks[ppointlock_idx], ~ppointlock_bitmask);
-#endif
   }
 }
 
+void dynamicPaint_dripStep(const PaintDripData *drip,
+                           PaintPoint *points,
+                           const PaintPoint *prev_points,
+                           float eff_scale,
+                           bool use_threading)
+{
+  DynamicPaintDripStepData data = {
+      .drip = drip,
+      .points = points,
+      .prev_points = prev_points,
+      .eff_scale = eff_scale,
+  };
+  TaskParallelSettings settings;
+  BLI_parallel_range_settings_defaults(&settings);
+  settings.use_threading = use_threading;
+
+  /* Every point first gathers the paint dripping into it, and then removes the wetness that
+   * dripped out of it, so no point is written from several threads and no locks are needed. */
+  BLI_task_parallel_range(0, drip->total_points, &data, dynamic_paint_effect_drip_cb, &settings);
+  BLI_task_parallel_range(
+      0, drip->total_points, &data, dynamic_paint_effect_drip_apply_cb, &settings);
+}
+
 static void dynamicPaint_doEffectStep(
     DynamicPaintSurface *surface,
     /* Cannot be const, because it is assigned to non-const variable.
      * NOLINTNEXTLINE: readability-non-const-parameter. */
     float *force,
+    const PaintDripData *drip,
     PaintPoint *prevPoint,
     float timescale,
     float steps)
@@ -5515,30 +5611,14 @@ static void dynamicPaint_doEffectStep(
   /*
    * Drip Effect
    */
-  if (surface->effect & MOD_DPAINT_EFFECT_DO_DRIP && force) {
+  if (surface->effect & MOD_DPAINT_EFFECT_DO_DRIP && force && drip) {
     const float eff_scale = distance_scale * EFF_MOVEMENT_PER_FRAME * timescale / 2.0f;
 
-    /* Same as BLI_bitmask, but handled atomicaly as 'ePoint' locks. */
-    const size_t point_locks_size = (sData->total_points / 8) + 1;
-    uint8_t *point_locks = MEM_callocN(sizeof(*point_locks) * point_locks_size, __func__);
-
     /* Copy current surface to the previous points array to read unmodified values */
     memcpy(prevPoint, sData->type_data, sData->total_points * sizeof(struct PaintPoint));
 
-    DynamicPaintEffectData data = {
-        .surface = surface,
-        .prevPoint = prevPoint,
-        .eff_scale = eff_scale,
-        .force = force,
-        .point_locks = point_locks,
-    };
-    TaskParallelSettings settings;
-    BLI_parallel_range_settings_defaults(&settings);
-    settings.use_threading = (sData->total_points > 1000);
-    BLI_task_parallel_range(
-        0, sData->total_points, &data, dynamic_paint_effect_drip_cb, &settings);
-
-    MEM_freeN(point_locks);
+    dynamicPaint_dripStep(
+        drip, sData->type_data, prevPoint, eff_scale, sData->total_points > 1000);
   }
 }
 
@@ -6339,6 +6419,7 @@ static int dynamicPaint_doStep(Depsgraph *depsgraph,
     if (surface->effect && surface->type == MOD_DPAINT_SURFACE_T_PAINT) {
       int steps = 1, s;
       PaintPoint *prevPoint;
+      PaintDripData *drip = NULL;
       float *force = NULL;
 
       /* Allocate memory for surface previous points to read unchanged values from */
@@ -6350,8 +6431,11 @@ static int dynamicPaint_doStep(Depsgraph *depsgraph,
 
       /* Prepare effects and get number of required steps */
       steps = dynamicPaint_prepareEffectStep(depsgraph, surface, scene, ob, &force, timescale);
+      if (force) {
+        drip = dynamicPaint_prepareDripData(surface, force);
+      }
       for (s = 0; s < steps; s++) {
-        dynamicPaint_doEffectStep(surface, force, prevPoint, timescale, (float)steps);
+        dynamicPaint_doEffectStep(surface, force, drip, prevPoint, timescale, (float)steps);
       }
 
       /* Free temporary effect data */
@@ -6361,6 +6445,9 @@ static int dynamicPaint_doStep(Depsgraph *depsgraph,
       if (force) {
         MEM_freeN(force);
       }
+      if (drip) {
+        dynamicPaint_dripData_free(drip);
+      }
     }
 
     /* paint island border pixels */
@@ -0,0 +1,64 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+/** \file
+ * \ingroup bke
+ */
+
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct PaintPoint;
+
+/**
+ * Drips of all points, they only depend on the force, so they are the same for all effect steps
+ * of a frame. Drips are also stored per target point, so each point gathers the paint dripping
+ * into it and no point is written by more than one thread.
+ *
+ * Every point has two drips, indexed as point index * 2 + drip.
+ */
+typedef struct PaintDripData {
+  int total_points;
+  /** Point each drip moves paint to, -1 when there is no drip. */
+  int *target;
+  /** Influence of the drip direction, and force strength over distance to the target. */
+  float *influence;
+  float *speed;
+  /** Drips into each point (in_index + in_num), in point order. */
+  int *in_drip;
+  int *in_index;
+  int *in_num;
+  /** Wetness added to the target of each drip in the current step. */
+  float *wetness_diff;
+} PaintDripData;
+
+PaintDripData *dynamicPaint_dripData_new(int total_points);
+/* Build the drips into each point, after the drip targets are set. */
+void dynamicPaint_dripData_index(PaintDripData *drip);
+void dynamicPaint_dripData_free(PaintDripData *drip);
+/* Move paint along the drips, reading from a copy of the points before the step. */
+void dynamicPaint_dripStep(const PaintDripData *drip,
+                           struct PaintPoint *points,
+                           const struct PaintPoint *prev_points,
+                           float eff_scale,
+                           bool use_threading);
+
+#ifdef __cplusplus
+}
+#endif
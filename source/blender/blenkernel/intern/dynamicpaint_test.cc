@@ -0,0 +1,153 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+#include "testing/testing.h"
+
+#include <cstring>
+#include <random>
+#include <vector>
+
+#include "BKE_dynamicpaint.h"
+
+#include "BLI_task.h"
+
+#include "dynamicpaint_intern.h"
+
+namespace blender::bke::tests {
+
+static const int TEST_POINTS = 20000;
+static const int TEST_STEPS = 8;
+
+/* Points that drip into up to two random other points, many points get several drips. */
+static PaintDripData *drip_data_random(std::vector<PaintPoint> &points)
+{
+  std::mt19937 rng(1234);
+  std::uniform_int_distribution<int> target_dist(0, TEST_POINTS / 8);
+  std::uniform_real_distribution<float> unit_dist(0.0f, 1.0f);
+
+  PaintDripData *drip = dynamicPaint_dripData_new(TEST_POINTS);
+  for (int i = 0; i < TEST_POINTS * 2; i++) {
+    const int target = target_dist(rng);
+    drip->target[i] = (target == i / 2 || unit_dist(rng) < 0.1f) ? -1 : target;
+    drip->influence[i] = unit_dist(rng);
+    drip->speed[i] = unit_dist(rng) * 4.0f;
+  }
+  dynamicPaint_dripData_index(drip);
+
+  points.resize(TEST_POINTS);
+  for (PaintPoint &point : points) {
+    memset(&point, 0, sizeof(point));
+    point.wetness = unit_dist(rng) * 2.0f;
+    for (int j = 0; j < 4; j++) {
+      point.e_color[j] = unit_dist(rng);
+    }
+  }
+  return drip;
+}
+
+static std::vector<PaintPoint> drip_steps(bool use_threading, float eff_scale)
+{
+  std::vector<PaintPoint> points, prev_points;
+  PaintDripData *drip = drip_data_random(points);
+
+  for (int step = 0; step < TEST_STEPS; step++) {
+    prev_points = points;
+    dynamicPaint_dripStep(drip, points.data(), prev_points.data(), eff_scale, use_threading);
+  }
+
+  dynamicPaint_dripData_free(drip);
+  return points;
+}
+
+static double total_wetness(const std::vector<PaintPoint> &points)
+{
+  double sum = 0.0;
+  for (const PaintPoint &point : points) {
+    sum += point.wetness;
+  }
+  return sum;
+}
+
+class DynamicPaintDripTest : public ::testing::Test {
+ protected:
+  static void SetUpTestCase()
+  {
+    BLI_task_scheduler_init();
+  }
+
+  static void TearDownTestCase()
+  {
+    BLI_task_scheduler_exit();
+  }
+};
+
+/* Drips are gathered per target point in point order, so the result doesn't depend on threads. */
+TEST_F(DynamicPaintDripTest, Deterministic)
+{
+  const std::vector<PaintPoint> serial = drip_steps(false, 0.5f);
+  const std::vector<PaintPoint> threaded_a = drip_steps(true, 0.5f);
+  const std::vector<PaintPoint> threaded_b = drip_steps(true, 0.5f);
+
+  EXPECT_EQ(memcmp(serial.data(), threaded_a.data(), sizeof(PaintPoint) * TEST_POINTS), 0);
+  EXPECT_EQ(memcmp(serial.data(), threaded_b.data(), sizeof(PaintPoint) * TEST_POINTS), 0);
+}
+
+/* Wetness is moved, not created: what is added to a target is removed from its source. */
+TEST_F(DynamicPaintDripTest, MovesWetness)
+{
+  std::vector<PaintPoint> points;
+  PaintDripData *drip = drip_data_random(points);
+  dynamicPaint_dripData_free(drip);
+  const double wetness_before = total_wetness(points);
+
+  /* Small steps, so no point runs dry or overflows and wetness is not clamped. */
+  const std::vector<PaintPoint> result = drip_steps(true, 0.01f);
+  EXPECT_NEAR(total_wetness(result), wetness_before, wetness_before * 1e-5);
+
+  int moved = 0;
+  for (int i = 0; i < TEST_POINTS; i++) {
+    moved += result[i].wetness != points[i].wetness;
+  }
+  EXPECT_GT(moved, TEST_POINTS / 2);
+}
+
+/* The drips into a point are listed in the order of the dripping points. */
+TEST_F(DynamicPaintDripTest, Index)
+{
+  std::vector<PaintPoint> points;
+  PaintDripData *drip = drip_data_random(points);
+
+  int total_drips = 0;
+  for (int index = 0; index < TEST_POINTS; index++) {
+    for (int i = 0; i < drip->in_num[index]; i++) {
+      const int drip_index = drip->in_drip[drip->in_index[index] + i];
+      EXPECT_EQ(drip->target[drip_index], index);
+      if (i > 0) {
+        EXPECT_LT(drip->in_drip[drip->in_index[index] + i - 1], drip_index);
+      }
+    }
+    total_drips += drip->in_num[index];
+  }
+
+  int expected_drips = 0;
+  for (int i = 0; i < TEST_POINTS * 2; i++) {
+    expected_drips += drip->target[i] != -1;
+  }
+  EXPECT_EQ(total_drips, expected_drips);
+
+  dynamicPaint_dripData_free(drip);
+}
+
+}  // namespace blender::bke::tests
@@ -45,6 +45,7 @@
 #include "BLI_math.h"
 #include "BLI_noise.h"
 #include "BLI_rand.h"
+#include "BLI_task.h"
 #include "BLI_utildefines.h"
 
 #include "PIL_time.h"
@@ -406,6 +407,31 @@ void pd_point_from_soft(Scene *scene, float *loc, float *vel, int index, Effecte
 
   point->psys = NULL;
 }
+
+void pd_points_from_loc(Scene *scene,
+                        const float (*loc)[3],
+                        const float (*vel)[3],
+                        int totpoint,
+                        EffectedPoints *points)
+{
+  memset(points, 0, sizeof(*points));
+  points->totpoint = totpoint;
+  points->loc = loc;
+  points->vel = vel;
+
+  points->vel_to_sec = (float)scene->r.frs_sec;
+  points->vel_to_frame = 1.0f;
+}
+
+void pd_points_from_soft(Scene *scene,
+                         const float (*loc)[3],
+                         const float (*vel)[3],
+                         int totpoint,
+                         EffectedPoints *points)
+{
+  pd_points_from_loc(scene, loc, vel, totpoint, points);
+  points->flag = PE_WIND_AS_SPEED;
+}
 /************************************************/
 /*          Effectors       */
 /************************************************/
@@ -635,7 +661,6 @@ int get_effector_data(EffectorCache *eff,
                       EffectedPoint *point,
                       int real_velocity)
 {
-  float cfra = DEG_get_ctime(eff->depsgraph);
   int ret = 0;
 
   /* In case surface object is in Edit mode when loading the .blend,
@@ -681,6 +706,7 @@ int get_effector_data(EffectorCache *eff,
     }
     else {
       ParticleSimulationData sim = {NULL};
+      float cfra = DEG_get_ctime(eff->depsgraph);
       sim.depsgraph = eff->depsgraph;
       sim.scene = eff->scene;
       sim.ob = eff->ob;
@@ -1063,6 +1089,60 @@ static void do_physical_effector(EffectorCache *eff,
   }
 }
 
+/* Modifies the force on a point according to its relation with one effector object. */
+static void effector_apply(EffectorCache *eff,
+                           ListBase *colliders,
+                           EffectorWeights *weights,
+                           EffectedPoint *point,
+                           float *force,
+                           float *wind_force,
+                           float *impulse)
+{
+  EffectorData efd;
+  int p = 0, tot = 1, step = 1;
+
+  /* object effectors were fully checked to be OK to evaluate! */
+
+  get_effector_tot(eff, &efd, point, &tot, &p, &step);
+
+  for (; p < tot; p += step) {
+    if (get_effector_data(eff, &efd, point, 0)) {
+      efd.falloff = effector_falloff(eff, &efd, point, weights);
+
+      if (efd.falloff > 0.0f) {
+        efd.falloff *= eff_calc_visibility(colliders, eff, &efd, point);
+      }
+      if (efd.falloff > 0.0f) {
+        float out_force[3] = {0, 0, 0};
+
+        if (eff->pd->forcefield == PFIELD_TEXTURE) {
+          do_texture_effector(eff, &efd, point, out_force);
+        }
+        else {
+          do_physical_effector(eff, &efd, point, out_force);
+
+          /* for softbody backward compatibility */
+          if (point->flag & PE_WIND_AS_SPEED && impulse) {
+            sub_v3_v3v3(impulse, impulse, out_force);
+          }
+        }
+
+        if (wind_force) {
+          madd_v3_v3fl(force, out_force, 1.0f - eff->pd->f_wind_factor);
+          madd_v3_v3fl(wind_force, out_force, eff->pd->f_wind_factor);
+        }
+        else {
+          add_v3_v3(force, out_force);
+        }
+      }
+    }
+    else if (eff->flag & PE_VELOCITY_TO_IMPULSE && impulse) {
+      /* special case for harmonic effector */
+      add_v3_v3v3(impulse, impulse, efd.vel);
+    }
+  }
+}
+
 /*  -------- BKE_effectors_apply() --------
  * generic force/speed system, now used for particles and softbodies
  * scene       = scene where it runs in, for time and stuff
@@ -1099,58 +1179,247 @@ void BKE_effectors_apply(ListBase *effectors,
    *     (is independent of other effectors)
    */
   EffectorCache *eff;
-  EffectorData efd;
-  int p = 0, tot = 1, step = 1;
 
   /* Cycle through collected objects, get total of (1/(gravity_strength * dist^gravity_power)) */
   /* Check for min distance here? (yes would be cool to add that, ton) */
 
   if (effectors) {
     for (eff = effectors->first; eff; eff = eff->next) {
-      /* object effectors were fully checked to be OK to evaluate! */
+      effector_apply(eff, colliders, weights, point, force, wind_force, impulse);
+    }
+  }
+}
 
-      get_effector_tot(eff, &efd, point, &tot, &p, &step);
+/*  -------- BKE_effectors_apply_points() --------
+ * Same as #BKE_effectors_apply for many points, with the same result. Points are split in
+ * chunks that are evaluated in parallel. Within a chunk one effector is evaluated for all points
+ * before the next, so the settings of the effector are only read once, and the most common
+ * effectors use loops over arrays without branches per effector type.
+ */
 
-      for (; p < tot; p += step) {
-        if (get_effector_data(eff, &efd, point, 0)) {
-          efd.falloff = effector_falloff(eff, &efd, point, weights);
+/* Number of points evaluated together. */
+#define EFFECTOR_CHUNK_SIZE 256
+
+typedef struct EffectorsApplyPointsData {
+  ListBase *effectors;
+  ListBase *colliders;
+  EffectorWeights *weights;
+  const EffectedPoints *points;
+  float (*force)[3];
+  float (*wind_force)[3];
+  float (*impulse)[3];
+} EffectorsApplyPointsData;
+
+/* Force and wind fields with spherical falloff around the object center, which only depend on
+ * the location and velocity of the point. Anything random, texture or collider dependent is
+ * left to #effector_apply. */
+static bool effector_apply_points_is_simple(const EffectorCache *eff)
+{
+  const PartDeflect *pd = eff->pd;
 
-          if (efd.falloff > 0.0f) {
-            efd.falloff *= eff_calc_visibility(colliders, eff, &efd, point);
-          }
-          if (efd.falloff > 0.0f) {
-            float out_force[3] = {0, 0, 0};
-
-            if (eff->pd->forcefield == PFIELD_TEXTURE) {
-              do_texture_effector(eff, &efd, point, out_force);
-            }
-            else {
-              do_physical_effector(eff, &efd, point, out_force);
-
-              /* for softbody backward compatibility */
-              if (point->flag & PE_WIND_AS_SPEED && impulse) {
-                sub_v3_v3v3(impulse, impulse, out_force);
-              }
-            }
-
-            if (wind_force) {
-              madd_v3_v3fl(force, out_force, 1.0f - eff->pd->f_wind_factor);
-              madd_v3_v3fl(wind_force, out_force, eff->pd->f_wind_factor);
-            }
-            else {
-              add_v3_v3(force, out_force);
-            }
-          }
+  return (eff->psys == NULL) && (pd->shape == PFIELD_SHAPE_POINT) &&
+         ELEM(pd->forcefield, PFIELD_FORCE, PFIELD_WIND) && (pd->falloff == PFIELD_FALL_SPHERE) &&
+         (pd->f_noise <= 0.0f) && (pd->flag & PFIELD_DO_LOCATION) &&
+         !(pd->flag & PFIELD_VISIBILITY) && !(eff->flag & PE_USE_NORMAL_DATA);
+}
+
+/* Evaluates a simple effector for the points from start to end, the same way as
+ * #get_effector_data, #effector_falloff and #do_physical_effector do for a single point. */
+static void effector_apply_points_simple(EffectorCache *eff,
+                                         const EffectorsApplyPointsData *data,
+                                         const int start,
+                                         const int end)
+{
+  const PartDeflect *pd = eff->pd;
+  const EffectedPoints *points = data->points;
+  const Object *ob = eff->ob;
+  const int len = end - start;
+  const float weight = data->weights ?
+                           data->weights->weight[0] * data->weights->weight[pd->forcefield] :
+                           1.0f;
+  const float vel_to_sec_inv = 1.0f / points->vel_to_sec;
+  const bool use_gravitation = (pd->forcefield == PFIELD_FORCE) &&
+                               (pd->flag & PFIELD_GRAVITATION);
+  const int usemin = pd->flag & PFIELD_USEMIN;
+  const int usemax = pd->flag & PFIELD_USEMAX;
+  const float mindist = usemin ? pd->mindist : 0.0f;
+  float nor[3];
+  float vec_to_point[EFFECTOR_CHUNK_SIZE][3];
+  float distance[EFFECTOR_CHUNK_SIZE];
+  float falloff[EFFECTOR_CHUNK_SIZE];
+
+  /* use z-axis as normal*/
+  normalize_v3_v3(nor, ob->obmat[2]);
+
+  for (int i = 0; i < len; i++) {
+    sub_v3_v3v3(vec_to_point[i], points->loc[start + i], ob->obmat[3]);
+    distance[i] = len_v3(vec_to_point[i]);
+  }
+
+  for (int i = 0; i < len; i++) {
+    const float fac = dot_v3v3(nor, vec_to_point[i]);
+    const float dist = distance[i];
+
+    if ((pd->zdir == PFIELD_Z_POS && fac < 0.0f) || (pd->zdir == PFIELD_Z_NEG && fac > 0.0f)) {
+      falloff[i] = 0.0f;
+    }
+    else if (usemax && dist > pd->maxdist) {
+      falloff[i] = 0.0f;
+    }
+    else if (usemin && dist < pd->mindist) {
+      falloff[i] = weight;
+    }
+    else if (pd->f_power == 0.0f) {
+      falloff[i] = weight;
+    }
+    else {
+      falloff[i] = weight * (float)pow((double)(1.0f + dist - mindist), (double)(-pd->f_power));
+    }
+  }
+
+  for (int i = 0; i < len; i++) {
+    const int p = start + i;
+    float force[3], out_force[3] = {0.0f, 0.0f, 0.0f};
+    float strength = pd->f_strength;
+
+    if (!(falloff[i] > 0.0f)) {
+      continue;
+    }
+
+    if (pd->forcefield == PFIELD_WIND) {
+      mul_v3_v3fl(force, nor, strength * falloff[i]);
+    }
+    else {
+      normalize_v3_v3(force, vec_to_point[i]);
+      if (use_gravitation) { /* Option: Multiply by 1/distance^2 */
+        if (distance[i] < FLT_EPSILON) {
+          strength = 0.0f;
         }
-        else if (eff->flag & PE_VELOCITY_TO_IMPULSE && impulse) {
-          /* special case for harmonic effector */
-          add_v3_v3v3(impulse, impulse, efd.vel);
+        else {
+          strength *= powf(distance[i], -2.0f);
         }
       }
+      mul_v3_fl(force, strength * falloff[i]);
+    }
+
+    madd_v3_v3fl(out_force, force, vel_to_sec_inv);
+    if (pd->f_flow != 0.0f) {
+      madd_v3_v3fl(out_force, points->vel[p], -pd->f_flow * falloff[i]);
+    }
+
+    /* for softbody backward compatibility */
+    if (points->flag & PE_WIND_AS_SPEED && data->impulse) {
+      sub_v3_v3(data->impulse[p], out_force);
+    }
+
+    if (data->wind_force) {
+      madd_v3_v3fl(data->force[p], out_force, 1.0f - pd->f_wind_factor);
+      madd_v3_v3fl(data->wind_force[p], out_force, pd->f_wind_factor);
+    }
+    else {
+      add_v3_v3(data->force[p], out_force);
     }
   }
 }
 
+static void effectors_apply_points_cb(void *__restrict userdata,
+                                      const int chunk,
+                                      const TaskParallelTLS *__restrict UNUSED(tls))
+{
+  const EffectorsApplyPointsData *data = userdata;
+  const EffectedPoints *points = data->points;
+  const int start = chunk * EFFECTOR_CHUNK_SIZE;
+  const int end = min_ii(start + EFFECTOR_CHUNK_SIZE, points->totpoint);
+
+  LISTBASE_FOREACH (EffectorCache *, eff, data->effectors) {
+    if (effector_apply_points_is_simple(eff)) {
+      effector_apply_points_simple(eff, data, start, end);
+      continue;
+    }
+
+    for (int p = start; p < end; p++) {
+      EffectedPoint point = {
+          .loc = (float *)points->loc[p],
+          .vel = (float *)points->vel[p],
+          .vel_to_frame = points->vel_to_frame,
+          .vel_to_sec = points->vel_to_sec,
+          .size = points->size ? points->size[p] : 0.0f,
+          .charge = points->charge,
+          .flag = points->flag,
+          .index = points->index ? points->index[p] : p,
+          .psys = points->psys,
+      };
+      effector_apply(eff,
+                     data->colliders,
+                     data->weights,
+                     &point,
+                     data->force[p],
+                     data->wind_force ? data->wind_force[p] : NULL,
+                     data->impulse ? data->impulse[p] : NULL);
+    }
+  }
+}
+
+/* Accumulates the forces of all effectors on the points, like #BKE_effectors_apply does for
+ * one point. The wind_force and impulse arrays are optional. */
+void BKE_effectors_apply_points(ListBase *effectors,
+                                ListBase *colliders,
+                                EffectorWeights *weights,
+                                const EffectedPoints *points,
+                                float (*force)[3],
+                                float (*wind_force)[3],
+                                float (*impulse)[3])
+{
+  if (effectors == NULL || points->totpoint == 0) {
+    return;
+  }
+
+  EffectorsApplyPointsData data = {
+      .effectors = effectors,
+      .colliders = colliders,
+      .weights = weights,
+      .points = points,
+      .force = force,
+      .wind_force = wind_force,
+      .impulse = impulse,
+  };
+  bool use_threading = true;
+  bool use_visibility = false;
+
+  LISTBASE_FOREACH (EffectorCache *, eff, effectors) {
+    /* Noise is drawn from the random generator of the effector, evaluating points in order
+     * keeps the result the same as for single points. */
+    if (eff->pd->f_noise > 0.0f) {
+      use_threading = false;
+    }
+    if (eff->pd->flag & PFIELD_VISIBILITY) {
+      use_visibility = true;
+    }
+  }
+
+  /* Create the colliders once, instead of for every point. */
+  if (use_visibility && colliders == NULL) {
+    EffectorCache *eff = effectors->first;
+    data.colliders = BKE_collider_cache_create(eff->depsgraph, NULL, NULL);
+  }
+
+  TaskParallelSettings settings;
+  BLI_parallel_range_settings_defaults(&settings);
+  settings.use_threading = use_threading;
+  settings.min_iter_per_thread = 1;
+  BLI_task_parallel_range(0,
+                          (int)divide_ceil_u((uint)points->totpoint, EFFECTOR_CHUNK_SIZE),
+                          &data,
+                          effectors_apply_points_cb,
+                          &settings);
+
+  if (data.colliders != colliders) {
+    BKE_collider_cache_free(&data.colliders);
+  }
+}
+
+#undef EFFECTOR_CHUNK_SIZE
+
 /* ======== Simulation Debugging ======== */
 
 SimDebugData *_sim_debug_data = NULL;
@@ -0,0 +1,301 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+#include "testing/testing.h"
+
+#include <cstring>
+#include <vector>
+
+#include "MEM_guardedalloc.h"
+
+#include "BKE_effect.h"
+
+#include "DNA_listBase.h"
+#include "DNA_object_force_types.h"
+#include "DNA_object_types.h"
+
+#include "BLI_listbase.h"
+#include "BLI_math.h"
+#include "BLI_rand.h"
+#include "BLI_rand.hh"
+
+#include "PIL_time.h"
+
+namespace blender::bke::tests {
+
+/* Object effectors, without depsgraph or scene. */
+struct EffectorTestContext {
+  std::vector<Object *> objects;
+  ListBase effectors = {nullptr, nullptr};
+  EffectorWeights weights;
+};
+
+static void test_effectors_init(EffectorTestContext *ctx)
+{
+  memset(&ctx->weights, 0, sizeof(ctx->weights));
+  for (int i = 0; i < NUM_PFIELD_TYPES; i++) {
+    ctx->weights.weight[i] = 1.0f;
+  }
+  ctx->weights.weight[PFIELD_WIND] = 0.5f;
+}
+
+static PartDeflect *test_effector_add(EffectorTestContext *ctx, int type, const float loc[3])
+{
+  Object *ob = (Object *)MEM_callocN(sizeof(Object), __func__);
+  ob->pd = BKE_partdeflect_new(type);
+  ob->pd->rng = BLI_rng_new(1);
+  unit_m4(ob->obmat);
+  rotate_m4(ob->obmat, 'X', 0.3f * (float)ctx->objects.size());
+  copy_v3_v3(ob->obmat[3], loc);
+  ctx->objects.push_back(ob);
+
+  EffectorCache *eff = (EffectorCache *)MEM_callocN(sizeof(EffectorCache), __func__);
+  eff->ob = ob;
+  eff->pd = ob->pd;
+  eff->frame = -1;
+  BLI_addtail(&ctx->effectors, eff);
+
+  return ob->pd;
+}
+
+static void test_effectors_free(EffectorTestContext *ctx)
+{
+  for (Object *ob : ctx->objects) {
+    BKE_partdeflect_free(ob->pd);
+    MEM_freeN(ob);
+  }
+  BLI_freelistN(&ctx->effectors);
+}
+
+static void test_effectors_reseed(EffectorTestContext *ctx)
+{
+  for (Object *ob : ctx->objects) {
+    BLI_rng_srandom(ob->pd->rng, 1);
+  }
+}
+
+static void random_points(RandomNumberGenerator &rng,
+                          int totpoint,
+                          float scale,
+                          std::vector<float> &r_values)
+{
+  r_values.resize(totpoint * 3);
+  for (float &value : r_values) {
+    value = (rng.get_float() - 0.5f) * scale;
+  }
+}
+
+/* Compare #BKE_effectors_apply_points with #BKE_effectors_apply for every point. */
+static void test_effectors_compare(EffectorTestContext *ctx, int totpoint, unsigned int flag)
+{
+  RandomNumberGenerator rng(1234);
+  std::vector<float> loc, vel;
+  random_points(rng, totpoint, 10.0f, loc);
+  random_points(rng, totpoint, 2.0f, vel);
+
+  EffectedPoints points = {0};
+  points.totpoint = totpoint;
+  points.loc = (const float(*)[3])loc.data();
+  points.vel = (const float(*)[3])vel.data();
+  points.vel_to_frame = 1.0f;
+  points.vel_to_sec = 24.0f;
+  points.flag = flag;
+
+  std::vector<float> force(totpoint * 3, 0.0f), wind(totpoint * 3, 0.0f),
+      impulse(totpoint * 3, 0.0f);
+  test_effectors_reseed(ctx);
+  BKE_effectors_apply_points(&ctx->effectors,
+                             nullptr,
+                             &ctx->weights,
+                             &points,
+                             (float(*)[3])force.data(),
+                             (float(*)[3])wind.data(),
+                             (float(*)[3])impulse.data());
+
+  test_effectors_reseed(ctx);
+  for (int i = 0; i < totpoint; i++) {
+    EffectedPoint point = {nullptr};
+    point.loc = &loc[i * 3];
+    point.vel = &vel[i * 3];
+    point.vel_to_frame = points.vel_to_frame;
+    point.vel_to_sec = points.vel_to_sec;
+    point.flag = flag;
+    point.index = i;
+
+    float point_force[3] = {0.0f}, point_wind[3] = {0.0f}, point_impulse[3] = {0.0f};
+    BKE_effectors_apply(
+        &ctx->effectors, nullptr, &ctx->weights, &point, point_force, point_wind, point_impulse);
+
+    /* Same operations in the same order give exactly the same result. */
+    for (int j = 0; j < 3; j++) {
+      EXPECT_EQ(force[i * 3 + j], point_force[j]);
+      EXPECT_EQ(wind[i * 3 + j], point_wind[j]);
+      EXPECT_EQ(impulse[i * 3 + j], point_impulse[j]);
+    }
+  }
+}
+
+TEST(effect, ApplyPoints_Empty)
+{
+  EffectorTestContext ctx;
+  test_effectors_init(&ctx);
+  test_effectors_compare(&ctx, 0, 0);
+
+  const float loc[3] = {0.0f, 0.0f, 0.0f};
+  test_effector_add(&ctx, PFIELD_FORCE, loc);
+  test_effectors_compare(&ctx, 0, 0);
+  test_effectors_free(&ctx);
+}
+
+/* Effectors evaluated with arrays. */
+TEST(effect, ApplyPoints_Simple)
+{
+  EffectorTestContext ctx;
+  test_effectors_init(&ctx);
+
+  const float loc1[3] = {1.0f, 2.0f, -0.5f};
+  PartDeflect *pd = test_effector_add(&ctx, PFIELD_FORCE, loc1);
+  pd->f_strength = 3.0f;
+  pd->f_power = 1.5f;
+  pd->f_flow = 0.5f;
+  pd->flag |= PFIELD_USEMIN | PFIELD_USEMAX;
+  pd->mindist = 0.5f;
+  pd->maxdist = 4.0f;
+
+  const float loc2[3] = {-1.0f, 0.0f, 0.0f};
+  pd = test_effector_add(&ctx, PFIELD_FORCE, loc2);
+  pd->f_strength = -2.0f;
+  pd->flag |= PFIELD_GRAVITATION;
+
+  const float loc3[3] = {0.0f, 0.0f, 3.0f};
+  pd = test_effector_add(&ctx, PFIELD_WIND, loc3);
+  pd->shape = PFIELD_SHAPE_POINT;
+  pd->f_strength = 5.0f;
+  pd->f_wind_factor = 0.25f;
+  pd->zdir = PFIELD_Z_POS;
+
+  test_effectors_compare(&ctx, 1000, 0);
+  test_effectors_compare(&ctx, 1000, PE_WIND_AS_SPEED);
+  test_effectors_free(&ctx);
+}
+
+/* Effectors evaluated one point at a time, mixed with simple effectors. */
+TEST(effect, ApplyPoints_Generic)
+{
+  EffectorTestContext ctx;
+  test_effectors_init(&ctx);
+
+  const float loc1[3] = {1.0f, 2.0f, -0.5f};
+  PartDeflect *pd = test_effector_add(&ctx, PFIELD_VORTEX, loc1);
+  pd->f_strength = 2.0f;
+  pd->shape = PFIELD_SHAPE_PLANE;
+
+  const float loc2[3] = {0.0f, 1.0f, 0.0f};
+  pd = test_effector_add(&ctx, PFIELD_FORCE, loc2);
+  pd->f_strength = 1.0f;
+  pd->falloff = PFIELD_FALL_TUBE;
+  pd->flag |= PFIELD_USEMAXR;
+  pd->maxrad = 2.0f;
+
+  const float loc3[3] = {-2.0f, 0.0f, 1.0f};
+  pd = test_effector_add(&ctx, PFIELD_HARMONIC, loc3);
+  pd->f_strength = 4.0f;
+  pd->f_damp = 0.5f;
+
+  const float loc4[3] = {0.0f, 0.0f, 0.0f};
+  pd = test_effector_add(&ctx, PFIELD_DRAG, loc4);
+  pd->f_strength = 0.5f;
+  pd->f_damp = 0.1f;
+
+  const float loc5[3] = {0.0f, -1.0f, 0.0f};
+  pd = test_effector_add(&ctx, PFIELD_FORCE, loc5);
+  pd->f_strength = 1.0f;
+
+  test_effectors_compare(&ctx, 1000, 0);
+  test_effectors_compare(&ctx, 1000, PE_WIND_AS_SPEED);
+  test_effectors_free(&ctx);
+}
+
+/* Noise is random, but still gives the same result as for single points. */
+TEST(effect, ApplyPoints_Noise)
+{
+  EffectorTestContext ctx;
+  test_effectors_init(&ctx);
+
+  const float loc1[3] = {0.0f, 0.0f, 0.0f};
+  PartDeflect *pd = test_effector_add(&ctx, PFIELD_WIND, loc1);
+  pd->f_strength = 2.0f;
+  pd->f_noise = 1.0f;
+
+  const float loc2[3] = {1.0f, 0.0f, 0.0f};
+  pd = test_effector_add(&ctx, PFIELD_FORCE, loc2);
+  pd->f_strength = 1.0f;
+  pd->f_noise = 0.5f;
+
+  test_effectors_compare(&ctx, 1000, 0);
+  test_effectors_free(&ctx);
+}
+
+/* Run with --gtest_also_run_disabled_tests. */
+TEST(effect, DISABLED_ApplyPoints_Performance)
+{
+  EffectorTestContext ctx;
+  test_effectors_init(&ctx);
+
+  RandomNumberGenerator rng(4321);
+  for (int i = 0; i < 4; i++) {
+    const float loc[3] = {rng.get_float(), rng.get_float(), rng.get_float()};
+    PartDeflect *pd = test_effector_add(&ctx, (i % 2) ? PFIELD_WIND : PFIELD_FORCE, loc);
+    pd->f_strength = 1.0f;
+    pd->f_power = 2.0f;
+  }
+
+  const int totpoint = 1000000;
+  std::vector<float> loc, vel;
+  random_points(rng, totpoint, 10.0f, loc);
+  random_points(rng, totpoint, 2.0f, vel);
+  std::vector<float> force(totpoint * 3, 0.0f);
+
+  double start = PIL_check_seconds_timer();
+  for (int i = 0; i < totpoint; i++) {
+    EffectedPoint point = {nullptr};
+    point.loc = &loc[i * 3];
+    point.vel = &vel[i * 3];
+    point.vel_to_frame = 1.0f;
+    point.vel_to_sec = 24.0f;
+    point.index = i;
+    BKE_effectors_apply(
+        &ctx.effectors, nullptr, &ctx.weights, &point, &force[i * 3], nullptr, nullptr);
+  }
+  const double time_single = PIL_check_seconds_timer() - start;
+
+  EffectedPoints points = {0};
+  points.totpoint = totpoint;
+  points.loc = (const float(*)[3])loc.data();
+  points.vel = (const float(*)[3])vel.data();
+  points.vel_to_frame = 1.0f;
+  points.vel_to_sec = 24.0f;
+
+  start = PIL_check_seconds_timer();
+  BKE_effectors_apply_points(
+      &ctx.effectors, nullptr, &ctx.weights, &points, (float(*)[3])force.data(), nullptr, nullptr);
+  const double time_points = PIL_check_seconds_timer() - start;
+
+  printf("%d points, %d effectors\n", totpoint, (int)ctx.objects.size());
+  printf("single points: %fs, arrays: %fs\n", time_single, time_points);
+  test_effectors_free(&ctx);
+}
+
+}  // namespace blender::bke::tests
@@ -48,11 +48,18 @@
 
 #ifdef WITH_FLUID
 
+#  include <fcntl.h>
 #  include <float.h>
 #  include <math.h>
 #  include <stdio.h>
 #  include <string.h> /* memset */
 
+#  ifndef WIN32
+#    include <unistd.h>
+#  else
+#    include <io.h>
+#  endif
+
 #  include "DNA_customdata_types.h"
 #  include "DNA_light_types.h"
 #  include "DNA_mesh_types.h"
@@ -86,6 +93,10 @@
 
 #  include "manta_fluid_API.h"
 
+#  include "MEM_CacheLimiterC-Api.h"
+
+#  include "atomic_ops.h"
+
 #endif /* WITH_FLUID */
 
 /** Time step default value for nice appearance. */
@@ -325,6 +336,419 @@ void BKE_fluid_reallocate_copy_fluid(FluidDomainSettings *fds,
   manta_free(fluid_old);
 }
 
+/* -------------------------------------------------------------------- */
+/** \name Cache Prefetching
+ *
+ * Playing back a baked cache reads the files of a frame when changing to it. The files of the
+ * next frames in playback direction are read in a background thread. OpenVDB files are kept in
+ * memory and handed to Mantaflow's reader without copying, see #BKE_fluid_cache_file_acquire.
+ * Other formats are read by Mantaflow through zlib, those files are only read ahead to have them
+ * in the file system cache. Files are kept in memory up to a part of the memory cache limit, the
+ * files of frames which are played or jumped over are freed.
+ * \{ */
+
+/** Number of frames read ahead of the current frame. */
+#  define FLUID_CACHE_PREFETCH_FRAMES 4
+/** Size of the blocks read from cache files, cancelling is checked between blocks. */
+#  define FLUID_CACHE_PREFETCH_BLOCK_SIZE (1 << 20)
+/** Part of the memory cache limit used for files kept in memory. */
+#  define FLUID_CACHE_PREFETCH_MEMORY_PART 4
+
+typedef struct FluidCachePrefetch {
+  struct FluidCachePrefetch *next, *prev;
+  TaskPool *pool;
+  char cache_directory[FILE_MAX];
+  char cache_data_format, cache_mesh_format, cache_particle_format, cache_noise_format;
+  /** 1 when playing forward, -1 when playing backward. */
+  int direction;
+  /** Last frame pushed to the pool. */
+  int frame_queued;
+  /** Generation of the frames pushed to the pool. */
+  int generation_queued;
+  /** Set when a file was not kept in memory for lack of room, to read it again later. */
+  int memory_full;
+  /**
+   * Incremented with the files lock held to skip frames which are queued or being read. The pool
+   * is not canceled, a canceled background serial pool doesn't run tasks pushed afterwards.
+   */
+  int generation;
+} FluidCachePrefetch;
+
+typedef struct FluidCachePrefetchFrame {
+  FluidCachePrefetch *prefetch;
+  int generation;
+  int framenr;
+} FluidCachePrefetchFrame;
+
+typedef struct FluidCacheFile {
+  struct FluidCacheFile *next, *prev;
+  /** Prefetch which read the file, NULL once discarded. */
+  FluidCachePrefetch *prefetch;
+  char filepath[FILE_MAX];
+  int framenr;
+  /** Readers of the data, a discarded file is freed by the last one. */
+  int users;
+  void *data;
+  size_t size;
+} FluidCacheFile;
+
+/** Files kept in memory by the prefetches of all domains. */
+static struct {
+  ThreadMutex mutex;
+  /** All prefetches, to stop the ones reading a cache which is being freed. */
+  ListBase prefetches;
+  ListBase files;
+  /** Size of the files in memory, including discarded files which are still being read. */
+  size_t memory_in_use;
+} fluid_cache_files = {BLI_MUTEX_INITIALIZER};
+
+static bool fluid_cache_prefetch_skip(const FluidCachePrefetchFrame *prefetch_frame)
+{
+  return atomic_fetch_and_add_int32(&prefetch_frame->prefetch->generation, 0) !=
+         prefetch_frame->generation;
+}
+
+static void fluid_cache_file_free(FluidCacheFile *file)
+{
+  fluid_cache_files.memory_in_use -= file->size;
+  MEM_SAFE_FREE(file->data);
+  MEM_freeN(file);
+}
+
+/* Drop the files of the prefetch, except the ones of frames which are still read ahead. Frames
+ * are only kept with a direction other than zero. Needs the files lock. */
+static void fluid_cache_prefetch_discard_files(FluidCachePrefetch *prefetch,
+                                               int framenr,
+                                               int direction)
+{
+  LISTBASE_FOREACH_MUTABLE (FluidCacheFile *, file, &fluid_cache_files.files) {
+    const int frames_ahead = direction * (file->framenr - framenr);
+    if (file->prefetch != prefetch ||
+        (frames_ahead > 0 && frames_ahead <= FLUID_CACHE_PREFETCH_FRAMES)) {
+      continue;
+    }
+    BLI_remlink(&fluid_cache_files.files, file);
+    file->prefetch = NULL;
+    if (file->users == 0) {
+      fluid_cache_file_free(file);
+    }
+  }
+}
+
+static FluidCacheFile *fluid_cache_file_find(const char *filepath)
+{
+  LISTBASE_FOREACH (FluidCacheFile *, file, &fluid_cache_files.files) {
+    if (BLI_path_cmp(file->filepath, filepath) == 0) {
+      return file;
+    }
+  }
+  return NULL;
+}
+
+/* Reserve memory for a file to be read. NULL when the frame is skipped, when the file is in
+ * memory already, or when it doesn't fit in the memory budget, which sets r_memory_full. */
+static FluidCacheFile *fluid_cache_file_reserve(const FluidCachePrefetchFrame *prefetch_frame,
+                                                const char *filepath,
+                                                size_t size,
+                                                bool *r_memory_full)
+{
+  const size_t memory_max = MEM_CacheLimiter_get_maximum() / FLUID_CACHE_PREFETCH_MEMORY_PART;
+  FluidCacheFile *file = NULL;
+
+  *r_memory_full = false;
+
+  BLI_mutex_lock(&fluid_cache_files.mutex);
+  if (fluid_cache_prefetch_skip(prefetch_frame) || fluid_cache_file_find(filepath)) {
+    /* Pass. */
+  }
+  else if (size == 0 || fluid_cache_files.memory_in_use > memory_max ||
+           size > memory_max - fluid_cache_files.memory_in_use) {
+    *r_memory_full = true;
+  }
+  else {
+    file = MEM_callocN(sizeof(FluidCacheFile), __func__);
+    STRNCPY(file->filepath, filepath);
+    file->framenr = prefetch_frame->framenr;
+    file->size = size;
+    fluid_cache_files.memory_in_use += size;
+  }
+  BLI_mutex_unlock(&fluid_cache_files.mutex);
+
+  return file;
+}
+
+/* Make a file which was read available, unless the frame was skipped in the meantime. */
+static void fluid_cache_file_add(const FluidCachePrefetchFrame *prefetch_frame,
+                                 FluidCacheFile *file,
+                                 bool success)
+{
+  BLI_mutex_lock(&fluid_cache_files.mutex);
+  if (success && !fluid_cache_prefetch_skip(prefetch_frame)) {
+    file->prefetch = prefetch_frame->prefetch;
+    BLI_addtail(&fluid_cache_files.files, file);
+  }
+  else {
+    fluid_cache_file_free(file);
+  }
+  BLI_mutex_unlock(&fluid_cache_files.mutex);
+}
+
+static void fluid_cache_prefetch_file(const FluidCachePrefetchFrame *prefetch_frame,
+                                      const char *filepath,
+                                      bool keep_in_memory,
+                                      char *buf)
+{
+  int fd = BLI_open(filepath, O_BINARY | O_RDONLY, 0);
+  if (fd == -1) {
+    return;
+  }
+
+  FluidCacheFile *file = NULL;
+  if (keep_in_memory) {
+    bool memory_full;
+    file = fluid_cache_file_reserve(
+        prefetch_frame, filepath, BLI_file_descriptor_size(fd), &memory_full);
+    if (memory_full) {
+      atomic_fetch_and_or_int32(&prefetch_frame->prefetch->memory_full, 1);
+    }
+    else if (file == NULL) {
+      close(fd);
+      return;
+    }
+  }
+
+  if (file) {
+    file->data = MEM_mallocN(file->size, __func__);
+
+    size_t offset = 0;
+    while (offset < file->size && !fluid_cache_prefetch_skip(prefetch_frame)) {
+      const size_t block_size = MIN2(file->size - offset, FLUID_CACHE_PREFETCH_BLOCK_SIZE);
+      if (read(fd, (char *)file->data + offset, block_size) != (int)block_size) {
+        break;
+      }
+      offset += block_size;
+    }
+    fluid_cache_file_add(prefetch_frame, file, offset == file->size);
+  }
+  else {
+    /* Only have the file in the file system cache. */
+    while (!fluid_cache_prefetch_skip(prefetch_frame) &&
+           read(fd, buf, FLUID_CACHE_PREFETCH_BLOCK_SIZE) == FLUID_CACHE_PREFETCH_BLOCK_SIZE) {
+      /* Pass. */
+    }
+  }
+
+  close(fd);
+}
+
+static const char *fluid_cache_file_extension(char cache_format)
+{
+  switch (cache_format) {
+    case FLUID_DOMAIN_FILE_OPENVDB:
+      return FLUID_DOMAIN_EXTENSION_OPENVDB;
+    case FLUID_DOMAIN_FILE_RAW:
+      return FLUID_DOMAIN_EXTENSION_RAW;
+    case FLUID_DOMAIN_FILE_BIN_OBJECT:
+      return FLUID_DOMAIN_EXTENSION_BINOBJ;
+    case FLUID_DOMAIN_FILE_OBJECT:
+      return FLUID_DOMAIN_EXTENSION_OBJ;
+    case FLUID_DOMAIN_FILE_UNI:
+    default:
+      return FLUID_DOMAIN_EXTENSION_UNI;
+  }
+}
+
+static void fluid_cache_prefetch_frame(TaskPool *__restrict UNUSED(pool), void *taskdata)
+{
+  const FluidCachePrefetchFrame *prefetch_frame = taskdata;
+  const FluidCachePrefetch *prefetch = prefetch_frame->prefetch;
+  /* The files of a frame, named the same way as by Mantaflow's cache readers. */
+  const struct {
+    const char *subdirectory, *name;
+    char cache_format;
+  } files[] = {
+      {FLUID_DOMAIN_DIR_CONFIG, FLUID_NAME_CONFIG, FLUID_DOMAIN_FILE_UNI},
+      {FLUID_DOMAIN_DIR_DATA, FLUID_NAME_DATA, prefetch->cache_data_format},
+      {FLUID_DOMAIN_DIR_NOISE, FLUID_NAME_NOISE, prefetch->cache_noise_format},
+      {FLUID_DOMAIN_DIR_MESH, FLUID_NAME_MESH, prefetch->cache_mesh_format},
+      {FLUID_DOMAIN_DIR_PARTICLES, FLUID_NAME_PARTICLES, prefetch->cache_particle_format},
+  };
+
+  if (fluid_cache_prefetch_skip(prefetch_frame)) {
+    return;
+  }
+
+  char *buf = MEM_mallocN(FLUID_CACHE_PREFETCH_BLOCK_SIZE, __func__);
+
+  for (int i = 0; i < ARRAY_SIZE(files) && !fluid_cache_prefetch_skip(prefetch_frame); i++) {
+    char directory[FILE_MAX], filename[FILE_MAX], filepath[FILE_MAX];
+
+    BLI_path_join(
+        directory, sizeof(directory), prefetch->cache_directory, files[i].subdirectory, NULL);
+    BLI_path_make_safe(directory);
+    BLI_snprintf(filename,
+                 sizeof(filename),
+                 "%s_####%s",
+                 files[i].name,
+                 fluid_cache_file_extension(files[i].cache_format));
+    BLI_join_dirfile(filepath, sizeof(filepath), directory, filename);
+    BLI_path_frame(filepath, prefetch_frame->framenr, 0);
+
+    fluid_cache_prefetch_file(prefetch_frame,
+                              filepath,
+                              files[i].cache_format == FLUID_DOMAIN_FILE_OPENVDB,
+                              buf);
+  }
+
+  MEM_freeN(buf);
+}
+
+/* Skip the queued frames and drop the files read so far. Needs the files lock. */
+static void fluid_cache_prefetch_restart(FluidCachePrefetch *prefetch)
+{
+  atomic_add_and_fetch_int32(&prefetch->generation, 1);
+  fluid_cache_prefetch_discard_files(prefetch, 0, 0);
+}
+
+void BKE_fluid_cache_prefetch_free(FluidDomainSettings *fds)
+{
+  FluidCachePrefetch *prefetch = fds->cache_prefetch;
+  if (prefetch == NULL) {
+    return;
+  }
+
+  /* Queued frames are skipped, wait for the file which is being read. */
+  BLI_mutex_lock(&fluid_cache_files.mutex);
+  fluid_cache_prefetch_restart(prefetch);
+  BLI_remlink(&fluid_cache_files.prefetches, prefetch);
+  BLI_mutex_unlock(&fluid_cache_files.mutex);
+
+  BLI_task_pool_free(prefetch->pool);
+  MEM_freeN(prefetch);
+  fds->cache_prefetch = NULL;
+}
+
+/* Stop reading ahead the cache in the directory, for all domains. The prefetches are owned by
+ * the evaluated domains, while the cache is freed through the original one. */
+static void fluid_cache_prefetch_discard_directory(const char *cache_directory)
+{
+  BLI_mutex_lock(&fluid_cache_files.mutex);
+  LISTBASE_FOREACH (FluidCachePrefetch *, prefetch, &fluid_cache_files.prefetches) {
+    if (BLI_path_cmp(prefetch->cache_directory, cache_directory) == 0) {
+      fluid_cache_prefetch_restart(prefetch);
+    }
+  }
+  BLI_mutex_unlock(&fluid_cache_files.mutex);
+}
+
+void BKE_fluid_cache_prefetch(FluidDomainSettings *fds, int framenr, int direction)
+{
+  FluidCachePrefetch *prefetch = fds->cache_prefetch;
+
+  if (prefetch == NULL) {
+    manta_set_file_cache(BKE_fluid_cache_file_acquire, BKE_fluid_cache_file_release);
+
+    prefetch = MEM_callocN(sizeof(FluidCachePrefetch), __func__);
+    prefetch->pool = BLI_task_pool_create_background_serial(NULL, TASK_PRIORITY_LOW);
+    prefetch->frame_queued = framenr;
+    fds->cache_prefetch = prefetch;
+
+    BLI_mutex_lock(&fluid_cache_files.mutex);
+    BLI_addtail(&fluid_cache_files.prefetches, prefetch);
+    BLI_mutex_unlock(&fluid_cache_files.mutex);
+  }
+
+  BLI_mutex_lock(&fluid_cache_files.mutex);
+
+  /* Start over when jumping to another frame, or when the cache changed. */
+  const int frames_ahead = direction * (prefetch->frame_queued - framenr);
+  if (prefetch->direction != direction || frames_ahead < 0 ||
+      frames_ahead > FLUID_CACHE_PREFETCH_FRAMES ||
+      prefetch->generation_queued != prefetch->generation ||
+      !STREQ(prefetch->cache_directory, fds->cache_directory) ||
+      prefetch->cache_data_format != fds->cache_data_format ||
+      prefetch->cache_mesh_format != fds->cache_mesh_format ||
+      prefetch->cache_particle_format != fds->cache_particle_format ||
+      prefetch->cache_noise_format != fds->cache_noise_format) {
+    fluid_cache_prefetch_restart(prefetch);
+    STRNCPY(prefetch->cache_directory, fds->cache_directory);
+    prefetch->cache_data_format = fds->cache_data_format;
+    prefetch->cache_mesh_format = fds->cache_mesh_format;
+    prefetch->cache_particle_format = fds->cache_particle_format;
+    prefetch->cache_noise_format = fds->cache_noise_format;
+    prefetch->direction = direction;
+    prefetch->frame_queued = framenr;
+    prefetch->generation_queued = prefetch->generation;
+  }
+  else {
+    /* The current frame was read already, free the files of the frames before. */
+    fluid_cache_prefetch_discard_files(prefetch, framenr, direction);
+    /* Files which didn't fit before may fit now, frames which are in memory are skipped. */
+    if (atomic_cas_int32(&prefetch->memory_full, 1, 0) == 1) {
+      prefetch->frame_queued = framenr;
+    }
+  }
+
+  BLI_mutex_unlock(&fluid_cache_files.mutex);
+
+  const int frame_last = framenr + direction * FLUID_CACHE_PREFETCH_FRAMES;
+  for (int frame = prefetch->frame_queued + direction; direction * (frame_last - frame) >= 0;
+       frame += direction) {
+    if (frame < fds->cache_frame_start || frame > fds->cache_frame_end) {
+      continue;
+    }
+    FluidCachePrefetchFrame *prefetch_frame = MEM_mallocN(sizeof(FluidCachePrefetchFrame),
+                                                          __func__);
+    prefetch_frame->prefetch = prefetch;
+    prefetch_frame->generation = prefetch->generation_queued;
+    prefetch_frame->framenr = frame;
+    BLI_task_pool_push(prefetch->pool, fluid_cache_prefetch_frame, prefetch_frame, true, NULL);
+  }
+  prefetch->frame_queued = frame_last;
+}
+
+void BKE_fluid_cache_prefetch_wait(FluidDomainSettings *fds)
+{
+  if (fds->cache_prefetch) {
+    BLI_task_pool_work_and_wait(fds->cache_prefetch->pool);
+  }
+}
+
+const void *BKE_fluid_cache_file_acquire(const char *filepath, size_t *r_size, void **r_handle)
+{
+  const void *data = NULL;
+
+  BLI_mutex_lock(&fluid_cache_files.mutex);
+  FluidCacheFile *file = fluid_cache_file_find(filepath);
+  if (file) {
+    file->users++;
+    data = file->data;
+    *r_size = file->size;
+    *r_handle = file;
+  }
+  BLI_mutex_unlock(&fluid_cache_files.mutex);
+
+  return data;
+}
+
+void BKE_fluid_cache_file_release(void *handle)
+{
+  FluidCacheFile *file = handle;
+
+  BLI_mutex_lock(&fluid_cache_files.mutex);
+  file->users--;
+  if (file->users == 0 && file->prefetch == NULL) {
+    fluid_cache_file_free(file);
+  }
+  BLI_mutex_unlock(&fluid_cache_files.mutex);
+}
+
+#  undef FLUID_CACHE_PREFETCH_FRAMES
+#  undef FLUID_CACHE_PREFETCH_BLOCK_SIZE
+#  undef FLUID_CACHE_PREFETCH_MEMORY_PART
+
+/** \} */
+
 void BKE_fluid_cache_free_all(FluidDomainSettings *fds, Object *ob)
 {
   int cache_map = (FLUID_DOMAIN_OUTDATED_DATA | FLUID_DOMAIN_OUTDATED_NOISE |
@@ -339,6 +763,12 @@ void BKE_fluid_cache_free(FluidDomainSettings *fds, Object *ob, int cache_map)
   int flags = fds->cache_flag;
   const char *relbase = BKE_modifier_path_relbase_from_global(ob);
 
+  /* Don't read files that are being deleted. */
+  char cache_directory[FILE_MAX];
+  BLI_strncpy(cache_directory, fds->cache_directory, sizeof(cache_directory));
+  BLI_path_abs(cache_directory, relbase);
+  fluid_cache_prefetch_discard_directory(cache_directory);
+
   if (cache_map & FLUID_DOMAIN_OUTDATED_DATA) {
     flags &= ~(FLUID_DOMAIN_BAKING_DATA | FLUID_DOMAIN_BAKED_DATA | FLUID_DOMAIN_OUTDATED_DATA);
     BLI_path_join(temp_dir, sizeof(temp_dir), fds->cache_directory, FLUID_DOMAIN_DIR_CONFIG, NULL);
@@ -4122,6 +4552,20 @@ static void BKE_fluid_modifier_processDomain(FluidModifierData *fmd,
     }
   }
 
+  /* Read ahead in playback direction when playing back the cache. */
+  if (read_cache && !bake_cache && has_data) {
+    if (scene_framenr == fmd->time + 1) {
+      BKE_fluid_cache_prefetch(fds, data_frame, 1);
+    }
+    else if (scene_framenr == fmd->time - 1) {
+      BKE_fluid_cache_prefetch(fds, data_frame, -1);
+    }
+  }
+  else if (bake_cache) {
+    /* Don't read files which are being written. */
+    BKE_fluid_cache_prefetch_free(fds);
+  }
+
   /* Ensure that fluid pointers are always up to date at the end of modifier processing. */
   manta_update_pointers(fds->fluid, fmd, false);
 
@@ -4737,6 +5181,10 @@ static void BKE_fluid_modifier_freeDomain(FluidModifierData *fmd)
 #endif
     }
 
+#ifdef WITH_FLUID
+    BKE_fluid_cache_prefetch_free(fmd->domain);
+#endif
+
     if (fmd->domain->fluid_mutex) {
       BLI_rw_mutex_free(fmd->domain->fluid_mutex);
     }
@@ -0,0 +1,268 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+#include "testing/testing.h"
+
+#include <cstring>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#include "MEM_CacheLimiterC-Api.h"
+
+#include "BKE_fluid.h"
+
+#include "DNA_fluid_types.h"
+#include "DNA_object_types.h"
+
+#include "BLI_fileops.h"
+#include "BLI_path_util.h"
+#include "BLI_string.h"
+#include "BLI_threads.h"
+
+namespace blender::bke::tests {
+
+static const int TEST_FRAMES = 10;
+static const size_t TEST_FILE_SIZE = 4096;
+
+/* A baked cache with OpenVDB data and binary object meshes, read ahead during playback. */
+class FluidCachePrefetchTest : public ::testing::Test {
+ protected:
+  static void SetUpTestCase()
+  {
+    BLI_threadapi_init();
+  }
+
+  static void TearDownTestCase()
+  {
+    BLI_threadapi_exit();
+  }
+
+  void SetUp() override
+  {
+    old_maximum = MEM_CacheLimiter_get_maximum();
+    MEM_CacheLimiter_set_maximum(TEST_FILE_SIZE * 1024);
+
+    dir = (std::filesystem::temp_directory_path() / "blender_fluid_cache_test").string();
+
+    memset(&fds, 0, sizeof(fds));
+    BLI_strncpy(fds.cache_directory, dir.c_str(), sizeof(fds.cache_directory));
+    fds.cache_frame_start = 1;
+    fds.cache_frame_end = TEST_FRAMES;
+    fds.cache_data_format = FLUID_DOMAIN_FILE_OPENVDB;
+    fds.cache_noise_format = FLUID_DOMAIN_FILE_OPENVDB;
+    fds.cache_particle_format = FLUID_DOMAIN_FILE_OPENVDB;
+    fds.cache_mesh_format = FLUID_DOMAIN_FILE_BIN_OBJECT;
+
+    for (int frame = 1; frame <= TEST_FRAMES; frame++) {
+      write_file(FLUID_DOMAIN_DIR_CONFIG, FLUID_NAME_CONFIG, FLUID_DOMAIN_EXTENSION_UNI, frame);
+      write_file(FLUID_DOMAIN_DIR_DATA, FLUID_NAME_DATA, FLUID_DOMAIN_EXTENSION_OPENVDB, frame);
+      write_file(FLUID_DOMAIN_DIR_MESH, FLUID_NAME_MESH, FLUID_DOMAIN_EXTENSION_BINOBJ, frame);
+    }
+  }
+
+  void TearDown() override
+  {
+    BKE_fluid_cache_prefetch_free(&fds);
+    BLI_delete(dir.c_str(), true, true);
+    MEM_CacheLimiter_set_maximum(old_maximum);
+  }
+
+  std::string filepath(const char *subdirectory, const char *name, const char *ext, int frame)
+  {
+    char path[FILE_MAX];
+    BLI_snprintf(
+        path, sizeof(path), "%s/%s/%s_%04d%s", dir.c_str(), subdirectory, name, frame, ext);
+    BLI_path_slash_native(path);
+    return path;
+  }
+
+  std::string data_filepath(int frame)
+  {
+    return filepath(FLUID_DOMAIN_DIR_DATA, FLUID_NAME_DATA, FLUID_DOMAIN_EXTENSION_OPENVDB, frame);
+  }
+
+  static std::vector<char> file_contents(int frame)
+  {
+    std::vector<char> contents(TEST_FILE_SIZE);
+    for (size_t i = 0; i < TEST_FILE_SIZE; i++) {
+      contents[i] = (char)(frame * 31 + i);
+    }
+    return contents;
+  }
+
+  void write_file(const char *subdirectory, const char *name, const char *ext, int frame)
+  {
+    const std::string path = filepath(subdirectory, name, ext, frame);
+    BLI_make_existing_file(path.c_str());
+    FILE *file = BLI_fopen(path.c_str(), "wb");
+    ASSERT_NE(file, nullptr);
+    const std::vector<char> contents = file_contents(frame);
+    fwrite(contents.data(), 1, contents.size(), file);
+    fclose(file);
+  }
+
+  /* The data file of the frame is in memory, with the contents of the file. */
+  void expect_hit(int frame)
+  {
+    size_t size = 0;
+    void *handle = nullptr;
+    const void *data = BKE_fluid_cache_file_acquire(data_filepath(frame).c_str(), &size, &handle);
+    ASSERT_NE(data, nullptr) << "frame " << frame;
+    ASSERT_EQ(size, TEST_FILE_SIZE);
+    EXPECT_EQ(memcmp(data, file_contents(frame).data(), size), 0) << "frame " << frame;
+    BKE_fluid_cache_file_release(handle);
+  }
+
+  void expect_miss(int frame)
+  {
+    size_t size = 0;
+    void *handle = nullptr;
+    const void *data = BKE_fluid_cache_file_acquire(data_filepath(frame).c_str(), &size, &handle);
+    EXPECT_EQ(data, nullptr) << "frame " << frame;
+    if (data) {
+      BKE_fluid_cache_file_release(handle);
+    }
+  }
+
+  void prefetch(int framenr, int direction)
+  {
+    BKE_fluid_cache_prefetch(&fds, framenr, direction);
+    BKE_fluid_cache_prefetch_wait(&fds);
+  }
+
+  size_t old_maximum;
+  std::string dir;
+  FluidDomainSettings fds;
+};
+
+TEST_F(FluidCachePrefetchTest, Forward)
+{
+  prefetch(1, 1);
+  expect_miss(1);
+  for (int frame = 2; frame <= 5; frame++) {
+    expect_hit(frame);
+  }
+  expect_miss(6);
+
+  /* Only OpenVDB files are kept in memory. */
+  size_t size;
+  void *handle;
+  EXPECT_EQ(BKE_fluid_cache_file_acquire(
+                filepath(FLUID_DOMAIN_DIR_MESH, FLUID_NAME_MESH, FLUID_DOMAIN_EXTENSION_BINOBJ, 2)
+                    .c_str(),
+                &size,
+                &handle),
+            nullptr);
+
+  /* Played frames are freed, the next frame is read. */
+  prefetch(2, 1);
+  expect_miss(2);
+  for (int frame = 3; frame <= 6; frame++) {
+    expect_hit(frame);
+  }
+
+  /* Frames after the end of the cache are not read. */
+  prefetch(8, 1);
+  expect_miss(6);
+  expect_hit(9);
+  expect_hit(10);
+  expect_miss(11);
+}
+
+TEST_F(FluidCachePrefetchTest, Backward)
+{
+  prefetch(TEST_FRAMES, -1);
+  for (int frame = 6; frame <= 9; frame++) {
+    expect_hit(frame);
+  }
+  expect_miss(5);
+  expect_miss(TEST_FRAMES);
+
+  /* Changing direction starts over. */
+  prefetch(6, 1);
+  expect_miss(6);
+  for (int frame = 7; frame <= TEST_FRAMES; frame++) {
+    expect_hit(frame);
+  }
+}
+
+/* Handing out the same memory, without copying. */
+TEST_F(FluidCachePrefetchTest, ZeroCopy)
+{
+  prefetch(1, 1);
+
+  size_t size_a, size_b;
+  void *handle_a, *handle_b;
+  const void *data_a = BKE_fluid_cache_file_acquire(data_filepath(2).c_str(), &size_a, &handle_a);
+  const void *data_b = BKE_fluid_cache_file_acquire(data_filepath(2).c_str(), &size_b, &handle_b);
+  ASSERT_NE(data_a, nullptr);
+  EXPECT_EQ(data_a, data_b);
+  EXPECT_EQ(size_a, size_b);
+  BKE_fluid_cache_file_release(handle_a);
+  BKE_fluid_cache_file_release(handle_b);
+}
+
+/* Files in memory are bounded by a part of the memory cache limit. */
+TEST_F(FluidCachePrefetchTest, MemoryLimit)
+{
+  MEM_CacheLimiter_set_maximum(TEST_FILE_SIZE * 2 * 4);
+
+  prefetch(1, 1);
+  expect_hit(2);
+  expect_hit(3);
+  expect_miss(4);
+  expect_miss(5);
+
+  /* Freeing played frames makes room for the frames which didn't fit. */
+  prefetch(3, 1);
+  expect_hit(4);
+  expect_hit(5);
+  expect_miss(6);
+  expect_miss(7);
+}
+
+/* Freeing the cache through another domain, like the original of the evaluated domain that is
+ * played back, drops the files in memory. Files which are being read stay valid until released. */
+TEST_F(FluidCachePrefetchTest, Discard)
+{
+  prefetch(1, 1);
+
+  size_t size;
+  void *handle;
+  const void *data = BKE_fluid_cache_file_acquire(data_filepath(2).c_str(), &size, &handle);
+  ASSERT_NE(data, nullptr);
+
+  FluidDomainSettings fds_orig = fds;
+  fds_orig.cache_prefetch = nullptr;
+  Object ob;
+  memset(&ob, 0, sizeof(ob));
+  BKE_fluid_cache_free_all(&fds_orig, &ob);
+
+  EXPECT_FALSE(BLI_exists(data_filepath(3).c_str()));
+  for (int frame = 2; frame <= 5; frame++) {
+    expect_miss(frame);
+  }
+  EXPECT_EQ(memcmp(data, file_contents(2).data(), size), 0);
+  BKE_fluid_cache_file_release(handle);
+
+  /* Nothing is read from the freed cache. */
+  prefetch(2, 1);
+  for (int frame = 3; frame <= 6; frame++) {
+    expect_miss(frame);
+  }
+}
+
+}  // namespace blender::bke::tests
@@ -414,6 +414,100 @@ void BKE_ocean_eval_ij(struct Ocean *oc, struct OceanResult *ocr, int i, int j)
   BLI_rw_mutex_unlock(&oc->oceanmutex);
 }
 
+/* Number of points sampled together by #BKE_ocean_eval_uv_disp_array. */
+#  define OCEAN_EVAL_CHUNK_SIZE 256
+
+static void ocean_eval_uv_disp_chunk(const Ocean *oc,
+                                     const float (*uv)[2],
+                                     float (*r_disp)[3],
+                                     const int len)
+{
+  int row0[OCEAN_EVAL_CHUNK_SIZE], row1[OCEAN_EVAL_CHUNK_SIZE];
+  int col0[OCEAN_EVAL_CHUNK_SIZE], col1[OCEAN_EVAL_CHUNK_SIZE];
+  float frac_x[OCEAN_EVAL_CHUNK_SIZE], frac_z[OCEAN_EVAL_CHUNK_SIZE];
+
+  /* Same lookup as #BKE_ocean_eval_uv, with the grid offsets stored so each result grid is
+   * sampled in its own loop. */
+  for (int p = 0; p < len; p++) {
+    float u = fmodf(uv[p][0], 1.0f);
+    float v = fmodf(uv[p][1], 1.0f);
+
+    if (u < 0) {
+      u += 1.0f;
+    }
+    if (v < 0) {
+      v += 1.0f;
+    }
+
+    const float uu = u * oc->_M;
+    const float vv = v * oc->_N;
+    const int i0 = (int)floor(uu);
+    const int j0 = (int)floor(vv);
+
+    frac_x[p] = uu - i0;
+    frac_z[p] = vv - j0;
+    row0[p] = (i0 % oc->_M) * oc->_N;
+    row1[p] = ((i0 + 1) % oc->_M) * oc->_N;
+    col0[p] = j0 % oc->_N;
+    col1[p] = (j0 + 1) % oc->_N;
+  }
+
+#  define BILERP(m, p) \
+    (interpf(interpf(m[row1[p] + col1[p]], m[row0[p] + col1[p]], frac_x[p]), \
+             interpf(m[row1[p] + col0[p]], m[row0[p] + col0[p]], frac_x[p]), \
+             frac_z[p]))
+
+  if (oc->_do_disp_y) {
+    const double *disp_y = oc->_disp_y;
+    for (int p = 0; p < len; p++) {
+      r_disp[p][1] = BILERP(disp_y, p);
+    }
+  }
+  else {
+    for (int p = 0; p < len; p++) {
+      r_disp[p][1] = 0.0f;
+    }
+  }
+
+  if (oc->_do_chop) {
+    const double *disp_x = oc->_disp_x;
+    const double *disp_z = oc->_disp_z;
+    for (int p = 0; p < len; p++) {
+      r_disp[p][0] = BILERP(disp_x, p);
+    }
+    for (int p = 0; p < len; p++) {
+      r_disp[p][2] = BILERP(disp_z, p);
+    }
+  }
+  else {
+    for (int p = 0; p < len; p++) {
+      r_disp[p][0] = 0.0f;
+      r_disp[p][2] = 0.0f;
+    }
+  }
+
+#  undef BILERP
+}
+
+/* Displacement of many points, the same as #BKE_ocean_eval_uv gives for each point. The lock
+ * is only taken once, which makes it safe to call from many threads at once. */
+void BKE_ocean_eval_uv_disp_array(struct Ocean *oc,
+                                  const float (*uv)[2],
+                                  float (*r_disp)[3],
+                                  const int totpoint)
+{
+  BLI_rw_mutex_lock(&oc->oceanmutex, THREAD_LOCK_READ);
+
+  for (int start = 0; start < totpoint; start += OCEAN_EVAL_CHUNK_SIZE) {
+    const int len = min_ii(totpoint - start, OCEAN_EVAL_CHUNK_SIZE);
+    ocean_eval_uv_disp_chunk(oc, &uv[start], &r_disp[start], len);
+  }
+
+  BLI_rw_mutex_unlock(&oc->oceanmutex);
+}
+
+#  undef OCEAN_EVAL_CHUNK_SIZE
+
 typedef struct OceanSimulateData {
   Ocean *o;
   float t;
@@ -439,10 +533,10 @@ static void ocean_compute_htilda(void *__restrict userdata,
     fftw_complex exp_param2;
     fftw_complex conj_param;
 
-    init_complex(exp_param1, 0.0, omega(o->_k[i * (1 + o->_N / 2) + j], o->_depth) * t);
-    init_complex(exp_param2, 0.0, -omega(o->_k[i * (1 + o->_N / 2) + j], o->_depth) * t);
+    /* exp(-i w t) is the conjugate of exp(i w t). */
+    init_complex(exp_param1, 0.0, o->_omega[i * (1 + o->_N / 2) + j] * t);
     exp_complex(exp_param1, exp_param1);
-    exp_complex(exp_param2, exp_param2);
+    conj_complex(exp_param2, exp_param1);
     conj_complex(conj_param, o->_h0_minus[i * o->_N + j]);
 
     mul_complex_c(exp_param1, o->_h0[i * o->_N + j], exp_param1);
@@ -658,6 +752,18 @@ void BKE_ocean_simulate(struct Ocean *o, float t, float scale, float chop_amount
 
   scale *= o->normalize_factor;
 
+  /* Only time dependent data is recomputed, the spectrum is kept from #BKE_ocean_init. When
+   * nothing changed since the last step, e.g. when the modifier is re-evaluated for the same
+   * frame, the results are still valid. */
+  BLI_rw_mutex_lock(&o->oceanmutex, THREAD_LOCK_READ);
+  const bool is_simulated = o->_is_simulated && o->_sim_time == t && o->_sim_scale == scale &&
+                            o->_sim_chop_amount == chop_amount;
+  BLI_rw_mutex_unlock(&o->oceanmutex);
+
+  if (is_simulated) {
+    return;
+  }
+
   osd.o = o;
   osd.t = t;
   osd.scale = scale;
@@ -703,6 +809,11 @@ void BKE_ocean_simulate(struct Ocean *o, float t, float scale, float chop_amount
 
   BLI_task_pool_work_and_wait(pool);
 
+  o->_sim_time = t;
+  o->_sim_scale = scale;
+  o->_sim_chop_amount = chop_amount;
+  o->_is_simulated = true;
+
   BLI_rw_mutex_unlock(&o->oceanmutex);
 
   BLI_task_pool_free(pool);
@@ -850,6 +961,7 @@ void BKE_ocean_init(struct Ocean *o,
   o->_wz = -sin(w);        /* wave direction */
   o->_L = V * V / GRAVITY; /* largest wave for a given velocity V */
   o->time = time;
+  o->_is_simulated = false;
 
   /* Spectrum to use. */
   o->_spectrum = spectrum;
@@ -865,6 +977,7 @@ void BKE_ocean_init(struct Ocean *o,
   o->_do_jacobian = do_jacobian;
 
   o->_k = (float *)MEM_mallocN(M * (1 + N / 2) * sizeof(float), "ocean_k");
+  o->_omega = (float *)MEM_mallocN(M * (1 + N / 2) * sizeof(float), "ocean_omega");
   o->_h0 = (fftw_complex *)MEM_mallocN(M * N * sizeof(fftw_complex), "ocean_h0");
   o->_h0_minus = (fftw_complex *)MEM_mallocN(M * N * sizeof(fftw_complex), "ocean_h0_minus");
   o->_kx = (float *)MEM_mallocN(o->_M * sizeof(float), "ocean_kx");
@@ -903,6 +1016,7 @@ void BKE_ocean_init(struct Ocean *o,
   for (i = 0; i < o->_M; i++) {
     for (j = 0; j <= o->_N / 2; j++) {
       o->_k[i * (1 + o->_N / 2) + j] = sqrt(o->_kx[i] * o->_kx[i] + o->_kz[j] * o->_kz[j]);
+      o->_omega[i * (1 + o->_N / 2) + j] = omega(o->_k[i * (1 + o->_N / 2) + j], o->_depth);
     }
   }
 
@@ -1083,6 +1197,7 @@ void BKE_ocean_free_data(struct Ocean *oc)
   if (oc->_htilda) {
     MEM_freeN(oc->_htilda);
     MEM_freeN(oc->_k);
+    MEM_freeN(oc->_omega);
     MEM_freeN(oc->_h0);
     MEM_freeN(oc->_h0_minus);
     MEM_freeN(oc->_kx);
@@ -1583,6 +1698,14 @@ void BKE_ocean_eval_xz_catrom(struct Ocean *UNUSED(oc),
 {
 }
 
+void BKE_ocean_eval_uv_disp_array(struct Ocean *UNUSED(oc),
+                                  const float (*uv)[2],
+                                  float (*r_disp)[3],
+                                  const int UNUSED(totpoint))
+{
+  UNUSED_VARS(uv, r_disp);
+}
+
 void BKE_ocean_eval_ij(struct Ocean *UNUSED(oc),
                        struct OceanResult *UNUSED(ocr),
                        int UNUSED(i),
@@ -55,6 +55,12 @@ typedef struct Ocean {
   float normalize_factor; /* init w */
   float time;
 
+  /* Parameters of the last simulation step, to skip simulating the same step again. */
+  float _sim_time;
+  float _sim_scale;
+  float _sim_chop_amount;
+  bool _is_simulated;
+
   short _do_disp_y;
   short _do_normals;
   short _do_spray;
@@ -121,6 +127,9 @@ typedef struct Ocean {
 
   /* two dimensional float array */
   float *_k; /* init w   sim r */
+
+  /* two dimensional float array, dispersion relation for the wave numbers of _k */
+  float *_omega; /* init w   sim r */
 } Ocean;
 #else
 /* stub */
@@ -44,10 +44,10 @@
 #include "DNA_scene_types.h"
 
 #include "BLI_blenlib.h"
-#include "BLI_kdopbvh.h"
 #include "BLI_kdtree.h"
 #include "BLI_linklist.h"
 #include "BLI_math.h"
+#include "BLI_point_grid.h"
 #include "BLI_rand.h"
 #include "BLI_task.h"
 #include "BLI_threads.h"
@@ -1118,7 +1118,7 @@ void psys_free(Object *ob, ParticleSystem *psys)
 
     BLI_freelistN(&psys->targets);
 
-    BLI_bvhtree_free(psys->bvhtree);
+    BLI_point_grid_free(psys->point_grid);
     BLI_kdtree_3d_free(psys->tree);
 
     if (psys->fluid_springs) {
@@ -51,6 +51,7 @@
 #include "BLI_kdtree.h"
 #include "BLI_linklist.h"
 #include "BLI_math.h"
+#include "BLI_point_grid.h"
 #include "BLI_rand.h"
 #include "BLI_string_utils.h"
 #include "BLI_task.h"
@@ -91,7 +92,7 @@
 #  include "manta_fluid_API.h"
 #endif  // WITH_FLUID
 
-static ThreadRWMutex psys_bvhtree_rwlock = BLI_RWLOCK_INITIALIZER;
+static ThreadRWMutex psys_sph_grid_rwlock = BLI_RWLOCK_INITIALIZER;
 
 /************************************************/
 /*          Reacting to system events           */
@@ -1318,44 +1319,54 @@ void psys_get_pointcache_start_end(Scene *scene, ParticleSystem *psys, int *sfra
 /************************************************/
 /*          Effectors                           */
 /************************************************/
-static void psys_update_particle_bvhtree(ParticleSystem *psys, float cfra)
+/* Neighbor search of fluid particles, the cell size matches the radius of the interactions. */
+static void psys_update_particle_sph_grid(ParticleSystem *psys, float cfra)
 {
   if (psys) {
     PARTICLE_P;
     int totpart = 0;
     bool need_rebuild;
 
-    BLI_rw_mutex_lock(&psys_bvhtree_rwlock, THREAD_LOCK_READ);
-    need_rebuild = !psys->bvhtree || psys->bvhtree_frame != cfra;
-    BLI_rw_mutex_unlock(&psys_bvhtree_rwlock);
+    BLI_rw_mutex_lock(&psys_sph_grid_rwlock, THREAD_LOCK_READ);
+    need_rebuild = !psys->point_grid || psys->bvhtree_frame != cfra;
+    BLI_rw_mutex_unlock(&psys_sph_grid_rwlock);
 
     if (need_rebuild) {
+      ParticleSettings *part = psys->part;
+      SPHFluidSettings *fluid = part->fluid;
+      float cell_size = 1.0f;
+
+      if (fluid) {
+        cell_size = fluid->radius * (fluid->flag & SPH_FAC_RADIUS ? 4.0f * part->size : 1.0f);
+        CLAMP_MIN(cell_size, 1e-4f);
+      }
+
       LOOP_SHOWN_PARTICLES
       {
         totpart++;
       }
 
-      BLI_rw_mutex_lock(&psys_bvhtree_rwlock, THREAD_LOCK_WRITE);
+      BLI_rw_mutex_lock(&psys_sph_grid_rwlock, THREAD_LOCK_WRITE);
 
-      BLI_bvhtree_free(psys->bvhtree);
-      psys->bvhtree = BLI_bvhtree_new(totpart, 0.0, 4, 6);
+      BLI_point_grid_free(psys->point_grid);
+      psys->point_grid = BLI_point_grid_new(totpart, cell_size);
 
       LOOP_SHOWN_PARTICLES
       {
         if (pa->alive == PARS_ALIVE) {
           if (pa->state.time == cfra) {
-            BLI_bvhtree_insert(psys->bvhtree, p, pa->prev_state.co, 1);
+            BLI_point_grid_insert(psys->point_grid, p, pa->prev_state.co);
           }
           else {
-            BLI_bvhtree_insert(psys->bvhtree, p, pa->state.co, 1);
+            BLI_point_grid_insert(psys->point_grid, p, pa->state.co);
           }
         }
       }
-      BLI_bvhtree_balance(psys->bvhtree);
+      BLI_point_grid_balance(psys->point_grid);
 
       psys->bvhtree_frame = cfra;
 
-      BLI_rw_mutex_unlock(&psys_bvhtree_rwlock);
+      BLI_rw_mutex_unlock(&psys_sph_grid_rwlock);
     }
   }
 }
@@ -1687,12 +1698,12 @@ typedef struct SPHRangeData {
   int use_size;
 } SPHRangeData;
 
-static void sph_evaluate_func(BVHTree *tree,
+static void sph_evaluate_func(PointGrid *grid,
                               ParticleSystem **psys,
                               const float co[3],
                               SPHRangeData *pfr,
                               float interaction_radius,
-                              BVHTree_RangeQuery callback)
+                              PointGrid_RangeQuery callback)
 {
   int i;
 
@@ -1703,16 +1714,16 @@ static void sph_evaluate_func(BVHTree *tree,
     pfr->massfac = psys[i]->part->mass / pfr->mass;
     pfr->use_size = psys[i]->part->flag & PART_SIZEMASS;
 
-    if (tree) {
-      BLI_bvhtree_range_query(tree, co, interaction_radius, callback, pfr);
+    if (grid) {
+      BLI_point_grid_range_query(grid, co, interaction_radius, callback, pfr);
       break;
     }
 
-    BLI_rw_mutex_lock(&psys_bvhtree_rwlock, THREAD_LOCK_READ);
+    BLI_rw_mutex_lock(&psys_sph_grid_rwlock, THREAD_LOCK_READ);
 
-    BLI_bvhtree_range_query(psys[i]->bvhtree, co, interaction_radius, callback, pfr);
+    BLI_point_grid_range_query(psys[i]->point_grid, co, interaction_radius, callback, pfr);
 
-    BLI_rw_mutex_unlock(&psys_bvhtree_rwlock);
+    BLI_rw_mutex_unlock(&psys_sph_grid_rwlock);
   }
 }
 static void sph_density_accum_cb(void *userdata, int index, const float co[3], float squared_dist)
@@ -2171,7 +2182,7 @@ void psys_sph_finalize(SPHData *sphdata)
 }
 
 /* Sample the density field at a point in space. */
-void psys_sph_density(BVHTree *tree, SPHData *sphdata, float co[3], float vars[2])
+void psys_sph_density(PointGrid *grid, SPHData *sphdata, float co[3], float vars[2])
 {
   ParticleSystem **psys = sphdata->psys;
   SPHFluidSettings *fluid = psys[0]->part->fluid;
@@ -2186,7 +2197,7 @@ void psys_sph_density(BVHTree *tree, SPHData *sphdata, float co[3], float vars[2
   pfr.h = interaction_radius * sphdata->hfac;
   pfr.mass = sphdata->mass;
 
-  sph_evaluate_func(tree, psys, co, &pfr, interaction_radius, sphdata->density_cb);
+  sph_evaluate_func(grid, psys, co, &pfr, interaction_radius, sphdata->density_cb);
 
   vars[0] = pfr.data[0];
   vars[1] = pfr.data[1];
@@ -2227,7 +2238,114 @@ typedef struct EfData {
   ParticleTexture ptex;
   ParticleSimulationData *sim;
   ParticleData *pa;
+  /* Effector force and impulse evaluated before integrating, see #ParticleEffectorForces. */
+  const float *effector_force;
+  const float *effector_impulse;
 } EfData;
+
+/* Effector forces of all dynamic particles, evaluated at once before integrating. */
+typedef struct ParticleEffectorForces {
+  /* Position in the arrays for every particle, -1 for particles that are not dynamic. */
+  int *point_of_particle;
+  float (*force)[3];
+  float (*impulse)[3];
+} ParticleEffectorForces;
+
+static void psys_effector_forces_eval(ParticleSimulationData *sim,
+                                      ParticleEffectorForces *eff_forces)
+{
+  ParticleSystem *psys = sim->psys;
+  ParticleSettings *part = psys->part;
+  PARTICLE_P;
+  int totpoint = 0;
+
+  memset(eff_forces, 0, sizeof(*eff_forces));
+
+  if (psys->effectors == NULL) {
+    return;
+  }
+  if (part->type == PART_HAIR && (part->effector_weights->flag & EFF_WEIGHT_DO_HAIR) == 0) {
+    return;
+  }
+  /* Forces are evaluated for the state at the start of the step, the other integrators
+   * also evaluate them for intermediate states. */
+  if (!ELEM(part->integrator, PART_INT_EULER, PART_INT_VERLET)) {
+    return;
+  }
+  /* Effectors can change the angular velocity of particles with dynamic rotation. */
+  if (part->flag & PART_ROT_DYN) {
+    return;
+  }
+  /* Particles effecting each other see the particles that were integrated before them. */
+  LISTBASE_FOREACH (EffectorCache *, eff, psys->effectors) {
+    if (eff->psys == psys) {
+      return;
+    }
+  }
+
+  eff_forces->point_of_particle = MEM_mallocN(sizeof(int) * (size_t)psys->totpart, __func__);
+  LOOP_PARTICLES
+  {
+    eff_forces->point_of_particle[p] = (pa->state.time > 0.0f) ? totpoint++ : -1;
+  }
+
+  float(*loc)[3] = MEM_mallocN(sizeof(*loc) * (size_t)totpoint, __func__);
+  float(*vel)[3] = MEM_mallocN(sizeof(*vel) * (size_t)totpoint, __func__);
+  int *index = MEM_mallocN(sizeof(*index) * (size_t)totpoint, __func__);
+  float *size = MEM_mallocN(sizeof(*size) * (size_t)totpoint, __func__);
+
+  LOOP_DYNAMIC_PARTICLES
+  {
+    const int point = eff_forces->point_of_particle[p];
+    copy_v3_v3(loc[point], pa->state.co);
+    copy_v3_v3(vel[point], pa->state.vel);
+    index[point] = p;
+    size[point] = pa->size;
+  }
+
+  /* Same as #pd_point_from_particle. */
+  EffectedPoints points = {
+      .totpoint = totpoint,
+      .loc = (const float(*)[3])loc,
+      .vel = (const float(*)[3])vel,
+      .index = index,
+      .size = size,
+      .vel_to_frame = psys_get_timestep(sim),
+      .vel_to_sec = 1.0f,
+      .charge = 0.0f,
+      .flag = 0,
+      .psys = psys,
+  };
+  if (part->pd && part->pd->forcefield == PFIELD_CHARGE) {
+    points.charge += part->pd->f_strength;
+  }
+  if (part->pd2 && part->pd2->forcefield == PFIELD_CHARGE) {
+    points.charge += part->pd2->f_strength;
+  }
+
+  eff_forces->force = MEM_callocN(sizeof(*eff_forces->force) * (size_t)totpoint, __func__);
+  eff_forces->impulse = MEM_callocN(sizeof(*eff_forces->impulse) * (size_t)totpoint, __func__);
+  BKE_effectors_apply_points(psys->effectors,
+                             sim->colliders,
+                             part->effector_weights,
+                             &points,
+                             eff_forces->force,
+                             NULL,
+                             eff_forces->impulse);
+
+  MEM_freeN(loc);
+  MEM_freeN(vel);
+  MEM_freeN(index);
+  MEM_freeN(size);
+}
+
+static void psys_effector_forces_free(ParticleEffectorForces *eff_forces)
+{
+  MEM_SAFE_FREE(eff_forces->point_of_particle);
+  MEM_SAFE_FREE(eff_forces->force);
+  MEM_SAFE_FREE(eff_forces->impulse);
+}
+
 static void basic_force_cb(void *efdata_v, ParticleKey *state, float *force, float *impulse)
 {
   EfData *efdata = (EfData *)efdata_v;
@@ -2239,7 +2357,11 @@ static void basic_force_cb(void *efdata_v, ParticleKey *state, float *force, flo
 
   /* add effectors */
   pd_point_from_particle(efdata->sim, efdata->pa, state, &epoint);
-  if (part->type != PART_HAIR || part->effector_weights->flag & EFF_WEIGHT_DO_HAIR) {
+  if (efdata->effector_force) {
+    add_v3_v3(force, efdata->effector_force);
+    add_v3_v3(impulse, efdata->effector_impulse);
+  }
+  else if (part->type != PART_HAIR || part->effector_weights->flag & EFF_WEIGHT_DO_HAIR) {
     BKE_effectors_apply(sim->psys->effectors,
                         sim->colliders,
                         part->effector_weights,
@@ -2269,7 +2391,11 @@ static void basic_force_cb(void *efdata_v, ParticleKey *state, float *force, flo
   }
 }
 /* gathers all forces that effect particles and calculates a new state for the particle */
-static void basic_integrate(ParticleSimulationData *sim, int p, float dfra, float cfra)
+static void basic_integrate(ParticleSimulationData *sim,
+                            int p,
+                            float dfra,
+                            float cfra,
+                            const ParticleEffectorForces *eff_forces)
 {
   ParticleSettings *part = sim->psys->part;
   ParticleData *pa = sim->psys->particles + p;
@@ -2282,6 +2408,14 @@ static void basic_integrate(ParticleSimulationData *sim, int p, float dfra, floa
 
   efdata.pa = pa;
   efdata.sim = sim;
+  efdata.effector_force = NULL;
+  efdata.effector_impulse = NULL;
+
+  if (eff_forces && eff_forces->force) {
+    const int point = eff_forces->point_of_particle[p];
+    efdata.effector_force = eff_forces->force[point];
+    efdata.effector_impulse = eff_forces->impulse[point];
+  }
 
   /* add global acceleration (gravitation) */
   if (psys_uses_gravity(sim) &&
@@ -3718,7 +3852,7 @@ static void dynamics_step_sph_ddr_task_cb_ex(void *__restrict userdata,
   }
 
   /* do global forces & effectors */
-  basic_integrate(sim, p, pa->state.time, data->cfra);
+  basic_integrate(sim, p, pa->state.time, data->cfra, NULL);
 
   /* actual fluids calculations */
   sph_integrate(sim, pa, pa->state.time, sphdata);
@@ -3749,7 +3883,7 @@ static void dynamics_step_sph_classical_basic_integrate_task_cb_ex(
     return;
   }
 
-  basic_integrate(sim, p, pa->state.time, data->cfra);
+  basic_integrate(sim, p, pa->state.time, data->cfra, NULL);
 }
 
 static void dynamics_step_sph_classical_calc_density_task_cb_ex(
@@ -3870,12 +4004,12 @@ static void dynamics_step(ParticleSimulationData *sim, float cfra)
     }
     case PART_PHYS_FLUID: {
       ParticleTarget *pt = psys->targets.first;
-      psys_update_particle_bvhtree(psys, cfra);
+      psys_update_particle_sph_grid(psys, cfra);
 
       for (; pt;
            pt = pt->next) { /* Updating others systems particle tree for fluid-fluid interaction */
         if (pt->ob) {
-          psys_update_particle_bvhtree(BLI_findlink(&pt->ob->particlesystem, pt->psys - 1), cfra);
+          psys_update_particle_sph_grid(BLI_findlink(&pt->ob->particlesystem, pt->psys - 1), cfra);
         }
       }
       break;
@@ -3931,10 +4065,13 @@ static void dynamics_step(ParticleSimulationData *sim, float cfra)
 
   switch (part->phystype) {
     case PART_PHYS_NEWTON: {
+      ParticleEffectorForces eff_forces;
+      psys_effector_forces_eval(sim, &eff_forces);
+
       LOOP_DYNAMIC_PARTICLES
       {
         /* do global forces & effectors */
-        basic_integrate(sim, p, pa->state.time, cfra);
+        basic_integrate(sim, p, pa->state.time, cfra, &eff_forces);
 
         /* deflection */
         if (sim->colliders) {
@@ -3944,6 +4081,8 @@ static void dynamics_step(ParticleSimulationData *sim, float cfra)
         /* rotations */
         basic_rotate(part, pa, pa->state.time, timestep);
       }
+
+      psys_effector_forces_free(&eff_forces);
       break;
     }
     case PART_PHYS_BOIDS: {
@@ -21,6 +21,7 @@
  * \ingroup bke
  */
 
+#include <fcntl.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -44,8 +45,11 @@
 #include "DNA_simulation_types.h"
 
 #include "BLI_blenlib.h"
+#include "BLI_ghash.h"
 #include "BLI_math.h"
 #include "BLI_string.h"
+#include "BLI_task.h"
+#include "BLI_threads.h"
 #include "BLI_utildefines.h"
 
 #include "BLT_translation.h"
@@ -96,6 +100,15 @@
 #  include "BLI_winstuff.h"
 #endif
 
+/* needed for reading single file caches */
+#ifndef WIN32
+#  include <sys/mman.h>
+#  include <unistd.h>
+#else
+#  include "mmap_win.h"
+#  include <io.h>
+#endif
+
 #define PTCACHE_DATA_FROM(data, type, from) \
   if (data[type]) { \
     memcpy(data[type], from, ptcache_data_size[type]); \
@@ -145,11 +158,11 @@ static int ptcache_basic_header_read(PTCacheFile *pf)
   int error = 0;
 
   /* Custom functions should read these basic elements too! */
-  if (!error && !fread(&pf->totpoint, sizeof(unsigned int), 1, pf->fp)) {
+  if (!error && !ptcache_file_read(pf, &pf->totpoint, 1, sizeof(unsigned int))) {
     error = 1;
   }
 
-  if (!error && !fread(&pf->data_types, sizeof(unsigned int), 1, pf->fp)) {
+  if (!error && !ptcache_file_read(pf, &pf->data_types, 1, sizeof(unsigned int))) {
     error = 1;
   }
 
@@ -158,11 +171,11 @@ static int ptcache_basic_header_read(PTCacheFile *pf)
 static int ptcache_basic_header_write(PTCacheFile *pf)
 {
   /* Custom functions should write these basic elements too! */
-  if (!fwrite(&pf->totpoint, sizeof(unsigned int), 1, pf->fp)) {
+  if (!ptcache_file_write(pf, &pf->totpoint, 1, sizeof(unsigned int))) {
     return 0;
   }
 
-  if (!fwrite(&pf->data_types, sizeof(unsigned int), 1, pf->fp)) {
+  if (!ptcache_file_write(pf, &pf->data_types, 1, sizeof(unsigned int))) {
     return 0;
   }
 
@@ -1405,6 +1418,13 @@ static int ptcache_filename(PTCacheID *pid, char *filename, int cfra, short do_p
 
     const char *ext = ptcache_file_extension(pid);
 
+    if (pid->cache->flag & PTCACHE_SINGLE_FILE) {
+      /* One file for all frames. */
+      len += BLI_snprintf(
+          newname, MAX_PTCACHE_FILE, "_%02u%s", pid->stack_index, PTCACHE_ARCHIVE_EXT);
+      return len;
+    }
+
     if (pid->cache->flag & PTCACHE_EXTERNAL) {
       if (pid->cache->index >= 0) {
         /* Always 6 chars. */
@@ -1425,6 +1445,837 @@ static int ptcache_filename(PTCacheID *pid, char *filename, int cfra, short do_p
   return len; /* make sure the above string is always 16 chars */
 }
 
+/* -------------------------------------------------------------------- */
+/** \name Single File Cache
+ *
+ * With #PTCACHE_SINGLE_FILE all frames of a disk cache are stored in one file, which is much
+ * faster to write, list and read than many small files on network storage. The file contains:
+ * - #PTCacheArchiveHeader, with the location of the index.
+ * - A #PTCacheArchiveChunk for every written frame, followed by the same data as the file of
+ *   that frame would contain, or a chunk without data for a removed frame. Chunks are in the
+ *   order they were written.
+ * - The index, an array of #PTCacheArchiveEntry sorted by frame.
+ *
+ * Files stay open and mapped with their index in memory, so reading a frame is a lookup in the
+ * index and a copy of its data. New frames are written after the last chunk and added to the index in memory. The first
+ * new frame invalidates the index in the file, it's written again when the file is closed or
+ * baking is done. If that didn't happen, the index is rebuilt from the chunks.
+ *
+ * Removing frames truncates the file after the last remaining chunk. Chunks of removed frames
+ * before that are marked by chunks without data, so rebuilding the index doesn't restore them.
+ * \{ */
+
+#define PTCACHE_ARCHIVE_VERSION 1
+/* Number of files kept open, the file opened first is closed first. Opening a file again after it
+ * was closed to stay under the limit raises the limit, until all caches in use fit. */
+#define PTCACHE_ARCHIVE_MAX_OPEN_MIN 16
+#define PTCACHE_ARCHIVE_MAX_OPEN_MAX 512
+/* Seconds between checks if a file was changed by others while reading from it. */
+#define PTCACHE_ARCHIVE_CHECK_INTERVAL 1.0
+
+typedef struct PTCacheArchiveHeader {
+  char id[8];
+  unsigned int version;
+  unsigned int totentry;
+  uint64_t index_offset;
+} PTCacheArchiveHeader;
+
+typedef struct PTCacheArchiveChunk {
+  /** "BPCF" for frame data, "BPCX" for a removed frame without data. */
+  char id[4];
+  int frame;
+  unsigned int size;
+} PTCacheArchiveChunk;
+
+typedef struct PTCacheArchiveEntry {
+  int frame;
+  unsigned int size;
+  /** Location of the #PTCacheArchiveChunk. */
+  uint64_t offset;
+} PTCacheArchiveEntry;
+
+/* Entry of a removed frame, only used while rebuilding the index. */
+#define PTCACHE_ARCHIVE_REMOVED UINT_MAX
+
+/* Open file, shared by everything reading from or writing to it. */
+typedef struct PTCacheArchive {
+  struct PTCacheArchive *next, *prev;
+  char filepath[MAX_PTCACHE_FILE];
+
+  int file;
+  bool writable;
+  /** Size of the file, to notice when it was changed by others. */
+  uint64_t file_len;
+  /** Time of the last check for changes by others. */
+  double check_time;
+
+  unsigned char *map;
+  size_t map_len;
+
+  PTCacheArchiveEntry *entries;
+  int totentry, entries_alloc;
+  /** End of the last chunk, where the next chunk is written. */
+  uint64_t data_end;
+  /** The index in the file doesn't match the entries. */
+  bool index_dirty;
+} PTCacheArchive;
+
+/* Frame of a single file cache being read or written. */
+typedef struct PTCacheArchiveFile {
+  char filepath[MAX_PTCACHE_FILE];
+  int mode;
+} PTCacheArchiveFile;
+
+/* Open files, most recently opened first. Open files are only added, changed or closed with the
+ * write lock held, the read lock is only held while looking up or copying a frame. */
+static ListBase ptcache_archives = {NULL, NULL};
+static ThreadRWMutex ptcache_archive_rwlock = BLI_RWLOCK_INITIALIZER;
+static int ptcache_archive_max_open = PTCACHE_ARCHIVE_MAX_OPEN_MIN;
+/* Paths of files closed to stay under the limit. */
+static GSet *ptcache_archive_closed_paths = NULL;
+/* Memory mapping is not thread safe on Windows. */
+static ThreadMutex ptcache_archive_mmap_lock = BLI_MUTEX_INITIALIZER;
+
+static bool ptcache_archive_chunk_read(const PTCacheArchive *archive,
+                                       uint64_t offset,
+                                       uint64_t end,
+                                       PTCacheArchiveChunk *r_chunk)
+{
+  if (offset < sizeof(PTCacheArchiveHeader) || offset > end ||
+      end - offset < sizeof(PTCacheArchiveChunk)) {
+    return false;
+  }
+
+  memcpy(r_chunk, archive->map + offset, sizeof(PTCacheArchiveChunk));
+
+  if (STREQLEN(r_chunk->id, "BPCX", 4)) {
+    return r_chunk->size == 0;
+  }
+  return STREQLEN(r_chunk->id, "BPCF", 4) &&
+         r_chunk->size <= end - offset - sizeof(PTCacheArchiveChunk);
+}
+
+static bool ptcache_archive_write_at(PTCacheArchive *archive,
+                                     uint64_t offset,
+                                     const void *data,
+                                     size_t size)
+{
+  if (BLI_lseek(archive->file, (int64_t)offset, SEEK_SET) == -1) {
+    return false;
+  }
+  if (size && write(archive->file, data, size) != (int64_t)size) {
+    return false;
+  }
+
+  archive->file_len = MAX2(archive->file_len, offset + size);
+  return true;
+}
+
+static bool ptcache_archive_header_write(PTCacheArchive *archive,
+                                         unsigned int totentry,
+                                         uint64_t index_offset)
+{
+  PTCacheArchiveHeader header;
+
+  memcpy(header.id, "BPHYSARC", sizeof(header.id));
+  header.version = PTCACHE_ARCHIVE_VERSION;
+  header.totentry = totentry;
+  header.index_offset = index_offset;
+
+  return ptcache_archive_write_at(archive, 0, &header, sizeof(header));
+}
+
+static void ptcache_archive_entries_reserve(PTCacheArchive *archive, int totentry)
+{
+  if (totentry > archive->entries_alloc) {
+    archive->entries_alloc = max_iii(totentry, archive->entries_alloc * 2, 64);
+    archive->entries = MEM_reallocN_id(archive->entries,
+                                       sizeof(PTCacheArchiveEntry) * archive->entries_alloc,
+                                       "PTCacheArchive entries");
+  }
+}
+
+/* Index of the first entry with a frame that is not lower than the given one. */
+static int ptcache_archive_entry_lower_bound(const PTCacheArchive *archive, int frame)
+{
+  int min = 0, max = archive->totentry;
+
+  /* Frames are usually written and read in order, check the end first. */
+  if (max == 0 || archive->entries[max - 1].frame < frame) {
+    return max;
+  }
+
+  while (min < max) {
+    const int mid = (min + max) / 2;
+
+    if (archive->entries[mid].frame < frame) {
+      min = mid + 1;
+    }
+    else {
+      max = mid;
+    }
+  }
+
+  return min;
+}
+
+static const PTCacheArchiveEntry *ptcache_archive_find(const PTCacheArchive *archive, int frame)
+{
+  const int index = ptcache_archive_entry_lower_bound(archive, frame);
+
+  if (index < archive->totentry && archive->entries[index].frame == frame) {
+    return &archive->entries[index];
+  }
+  return NULL;
+}
+
+/* Add a frame, or replace it when it's written again. */
+static void ptcache_archive_entry_set(PTCacheArchive *archive,
+                                      int frame,
+                                      unsigned int size,
+                                      uint64_t offset)
+{
+  const int index = ptcache_archive_entry_lower_bound(archive, frame);
+  PTCacheArchiveEntry *entry;
+
+  if (index == archive->totentry || archive->entries[index].frame != frame) {
+    ptcache_archive_entries_reserve(archive, archive->totentry + 1);
+    memmove(&archive->entries[index + 1],
+            &archive->entries[index],
+            sizeof(PTCacheArchiveEntry) * (archive->totentry - index));
+    archive->totentry++;
+  }
+
+  entry = &archive->entries[index];
+  entry->frame = frame;
+  entry->size = size;
+  entry->offset = offset;
+}
+
+static int ptcache_archive_entry_cmp(const void *a_v, const void *b_v)
+{
+  const PTCacheArchiveEntry *a = a_v;
+  const PTCacheArchiveEntry *b = b_v;
+
+  if (a->frame != b->frame) {
+    return (a->frame < b->frame) ? -1 : 1;
+  }
+  return (a->offset < b->offset) ? -1 : (a->offset > b->offset);
+}
+
+/* Sort by frame, a chunk written later replaces earlier chunks of the same frame. */
+static void ptcache_archive_entries_sort(PTCacheArchive *archive)
+{
+  int tot = 0;
+
+  qsort(archive->entries,
+        (size_t)archive->totentry,
+        sizeof(PTCacheArchiveEntry),
+        ptcache_archive_entry_cmp);
+
+  for (int i = 0; i < archive->totentry; i++) {
+    if (i + 1 < archive->totentry && archive->entries[i + 1].frame == archive->entries[i].frame) {
+      continue;
+    }
+    if (archive->entries[i].size == PTCACHE_ARCHIVE_REMOVED) {
+      continue;
+    }
+    archive->entries[tot++] = archive->entries[i];
+  }
+  archive->totentry = tot;
+}
+
+static bool ptcache_archive_index_read(PTCacheArchive *archive)
+{
+  PTCacheArchiveHeader header;
+  memcpy(&header, archive->map, sizeof(header));
+
+  if (header.index_offset < sizeof(header) || header.index_offset > archive->map_len ||
+      header.totentry > (archive->map_len - header.index_offset) / sizeof(PTCacheArchiveEntry)) {
+    return false;
+  }
+
+  archive->data_end = header.index_offset;
+  ptcache_archive_entries_reserve(archive, (int)header.totentry);
+  archive->totentry = (int)header.totentry;
+  memcpy(archive->entries,
+         archive->map + header.index_offset,
+         sizeof(PTCacheArchiveEntry) * archive->totentry);
+
+  /* Check the chunks once here, so reading frames only needs a lookup in the index. */
+  for (int i = 0; i < archive->totentry; i++) {
+    const PTCacheArchiveEntry *entry = &archive->entries[i];
+    PTCacheArchiveChunk chunk;
+
+    if ((i > 0 && entry->frame <= entry[-1].frame) ||
+        !ptcache_archive_chunk_read(archive, entry->offset, archive->data_end, &chunk) ||
+        !STREQLEN(chunk.id, "BPCF", 4) || chunk.frame != entry->frame ||
+        chunk.size != entry->size) {
+      archive->totentry = 0;
+      return false;
+    }
+  }
+
+  return true;
+}
+
+/* Rebuild the index from the chunks, when writing the file was interrupted. */
+static void ptcache_archive_index_rebuild(PTCacheArchive *archive)
+{
+  PTCacheArchiveChunk chunk;
+  uint64_t offset = sizeof(PTCacheArchiveHeader);
+
+  archive->totentry = 0;
+
+  while (ptcache_archive_chunk_read(archive, offset, archive->map_len, &chunk)) {
+    ptcache_archive_entries_reserve(archive, archive->totentry + 1);
+
+    PTCacheArchiveEntry *entry = &archive->entries[archive->totentry++];
+    entry->frame = chunk.frame;
+    entry->size = STREQLEN(chunk.id, "BPCX", 4) ? PTCACHE_ARCHIVE_REMOVED : chunk.size;
+    entry->offset = offset;
+
+    offset += sizeof(PTCacheArchiveChunk) + chunk.size;
+  }
+
+  archive->data_end = offset;
+  archive->index_dirty = true;
+  ptcache_archive_entries_sort(archive);
+}
+
+/* Write the index after the chunks, and the header pointing to it. */
+static bool ptcache_archive_index_write(PTCacheArchive *archive)
+{
+  if (!ptcache_archive_write_at(archive,
+                                archive->data_end,
+                                archive->entries,
+                                sizeof(PTCacheArchiveEntry) * archive->totentry) ||
+      !ptcache_archive_header_write(
+          archive, (unsigned int)archive->totentry, archive->data_end)) {
+    return false;
+  }
+
+  archive->index_dirty = false;
+  return true;
+}
+
+static bool ptcache_archive_is_mapped(const PTCacheArchive *archive)
+{
+  return archive->map && archive->map_len == archive->file_len;
+}
+
+static void ptcache_archive_unmap(PTCacheArchive *archive)
+{
+  if (archive->map) {
+    BLI_mutex_lock(&ptcache_archive_mmap_lock);
+    munmap(archive->map, archive->map_len);
+    BLI_mutex_unlock(&ptcache_archive_mmap_lock);
+    archive->map = NULL;
+    archive->map_len = 0;
+  }
+}
+
+/* Map the whole file again after it was written to. */
+static bool ptcache_archive_map(PTCacheArchive *archive)
+{
+  if (ptcache_archive_is_mapped(archive)) {
+    return true;
+  }
+
+  ptcache_archive_unmap(archive);
+
+  if (archive->file_len < sizeof(PTCacheArchiveHeader) || archive->file_len > SIZE_MAX) {
+    return false;
+  }
+
+  BLI_mutex_lock(&ptcache_archive_mmap_lock);
+  archive->map = mmap(NULL, (size_t)archive->file_len, PROT_READ, MAP_SHARED, archive->file, 0);
+  BLI_mutex_unlock(&ptcache_archive_mmap_lock);
+
+  if (archive->map == (unsigned char *)MAP_FAILED) {
+    archive->map = NULL;
+    return false;
+  }
+
+  archive->map_len = (size_t)archive->file_len;
+  return true;
+}
+
+static void ptcache_archive_close(PTCacheArchive *archive)
+{
+  if (archive->index_dirty && archive->writable && !ptcache_archive_index_write(archive)) {
+    CLOG_ERROR(&LOG, "Failed to write point cache file: %s", archive->filepath);
+  }
+
+  ptcache_archive_unmap(archive);
+  close(archive->file);
+  MEM_SAFE_FREE(archive->entries);
+
+  BLI_remlink(&ptcache_archives, archive);
+  MEM_freeN(archive);
+}
+
+static void ptcache_archive_add(PTCacheArchive *archive)
+{
+  BLI_addhead(&ptcache_archives, archive);
+  archive->check_time = PIL_check_seconds_timer();
+
+  /* More caches are used than files are kept open, keep one more open. */
+  if (ptcache_archive_closed_paths &&
+      BLI_gset_remove(ptcache_archive_closed_paths, archive->filepath, MEM_freeN)) {
+    ptcache_archive_max_open = min_ii(ptcache_archive_max_open + 1, PTCACHE_ARCHIVE_MAX_OPEN_MAX);
+  }
+
+  if (BLI_listbase_count_at_most(&ptcache_archives, ptcache_archive_max_open + 1) >
+      ptcache_archive_max_open) {
+    PTCacheArchive *oldest = ptcache_archives.last;
+
+    if (ptcache_archive_closed_paths == NULL) {
+      ptcache_archive_closed_paths = BLI_gset_str_new(__func__);
+    }
+    BLI_gset_add(ptcache_archive_closed_paths, BLI_strdup(oldest->filepath));
+
+    ptcache_archive_close(oldest);
+  }
+}
+
+static PTCacheArchive *ptcache_archive_alloc(const char *filepath, int file, bool writable)
+{
+  PTCacheArchive *archive = MEM_callocN(sizeof(PTCacheArchive), "PTCacheArchive");
+
+  BLI_strncpy(archive->filepath, filepath, sizeof(archive->filepath));
+  archive->file = file;
+  archive->writable = writable;
+  archive->data_end = sizeof(PTCacheArchiveHeader);
+
+  return archive;
+}
+
+/* Open the file and read its index, returns NULL if it doesn't exist or is no cache file. */
+static PTCacheArchive *ptcache_archive_open(const char *filepath)
+{
+  PTCacheArchive *archive;
+  PTCacheArchiveHeader header;
+  bool writable = true;
+  size_t file_len;
+  int file;
+
+  file = BLI_open(filepath, O_BINARY | O_RDWR, 0);
+  if (file == -1) {
+    file = BLI_open(filepath, O_BINARY | O_RDONLY, 0);
+    writable = false;
+  }
+  if (file == -1) {
+    return NULL;
+  }
+
+  archive = ptcache_archive_alloc(filepath, file, writable);
+
+  file_len = BLI_file_descriptor_size(file);
+  archive->file_len = (file_len == (size_t)-1) ? 0 : file_len;
+
+  if (ptcache_archive_map(archive)) {
+    memcpy(&header, archive->map, sizeof(header));
+  }
+
+  if (archive->map == NULL || !STREQLEN(header.id, "BPHYSARC", 8) ||
+      header.version != PTCACHE_ARCHIVE_VERSION) {
+    ptcache_archive_unmap(archive);
+    close(file);
+    MEM_freeN(archive);
+    return NULL;
+  }
+
+  if (!ptcache_archive_index_read(archive)) {
+    ptcache_archive_index_rebuild(archive);
+  }
+
+  ptcache_archive_add(archive);
+
+  return archive;
+}
+
+/* Create an empty file, replacing anything that isn't a cache file. */
+static PTCacheArchive *ptcache_archive_create(const char *filepath)
+{
+  PTCacheArchive *archive;
+  int file;
+
+  BLI_make_existing_file(filepath);
+
+  file = BLI_open(filepath, O_BINARY | O_RDWR | O_CREAT | O_TRUNC, 0666);
+  if (file == -1) {
+    return NULL;
+  }
+
+  archive = ptcache_archive_alloc(filepath, file, true);
+
+  if (!ptcache_archive_header_write(archive, 0, sizeof(PTCacheArchiveHeader))) {
+    close(file);
+    MEM_freeN(archive);
+    return NULL;
+  }
+
+  ptcache_archive_add(archive);
+
+  return archive;
+}
+
+static PTCacheArchive *ptcache_archive_find_open(const char *filepath)
+{
+  LISTBASE_FOREACH (PTCacheArchive *, archive, &ptcache_archives) {
+    if (STREQ(archive->filepath, filepath)) {
+      return archive;
+    }
+  }
+  return NULL;
+}
+
+/* Check if the file was removed or replaced by others, like another Blender instance. */
+static bool ptcache_archive_is_changed(const PTCacheArchive *archive)
+{
+  BLI_stat_t st;
+
+  return BLI_stat(archive->filepath, &st) != 0 || (uint64_t)st.st_size != archive->file_len;
+}
+
+/* Reading doesn't check for changes by others every time, that's slow on network storage. */
+static bool ptcache_archive_check_needed(const PTCacheArchive *archive)
+{
+  return PIL_check_seconds_timer() - archive->check_time > PTCACHE_ARCHIVE_CHECK_INTERVAL;
+}
+
+/* Get the file if it's open, or open it. Needs the write lock. */
+static PTCacheArchive *ptcache_archive_get(const char *filepath)
+{
+  PTCacheArchive *archive = ptcache_archive_find_open(filepath);
+
+  if (archive && ptcache_archive_is_changed(archive)) {
+    /* The index in memory is for another file now, don't write it. */
+    archive->index_dirty = false;
+    ptcache_archive_close(archive);
+    archive = NULL;
+  }
+
+  if (archive) {
+    archive->check_time = PIL_check_seconds_timer();
+    return archive;
+  }
+  return ptcache_archive_open(filepath);
+}
+
+/* Close the file, before it's renamed or removed. Needs the write lock. */
+static void ptcache_archive_close_path(const char *filepath)
+{
+  PTCacheArchive *archive = ptcache_archive_find_open(filepath);
+
+  if (archive) {
+    ptcache_archive_close(archive);
+  }
+}
+
+/* Get the open and mapped file with the read lock held, the lock must be released with
+ * #ptcache_archive_read_end as soon as possible, it blocks writing to any file. Returns NULL
+ * without holding the lock if the file doesn't exist. */
+static const PTCacheArchive *ptcache_archive_read_begin(const char *filepath)
+{
+  /* Another thread may write to or close the file between releasing the write lock and taking
+   * the read lock, try again a few times. */
+  for (int pass = 0; pass < 3; pass++) {
+    PTCacheArchive *archive;
+
+    BLI_rw_mutex_lock(&ptcache_archive_rwlock, THREAD_LOCK_READ);
+
+    archive = ptcache_archive_find_open(filepath);
+    if (archive && ptcache_archive_is_mapped(archive) && !ptcache_archive_check_needed(archive)) {
+      return archive;
+    }
+
+    BLI_rw_mutex_unlock(&ptcache_archive_rwlock);
+
+    /* Opening or mapping the file needs the write lock. */
+    BLI_rw_mutex_lock(&ptcache_archive_rwlock, THREAD_LOCK_WRITE);
+
+    archive = ptcache_archive_get(filepath);
+    if (archive && !ptcache_archive_map(archive)) {
+      archive = NULL;
+    }
+
+    BLI_rw_mutex_unlock(&ptcache_archive_rwlock);
+
+    if (archive == NULL) {
+      break;
+    }
+  }
+
+  return NULL;
+}
+
+static void ptcache_archive_read_end(void)
+{
+  BLI_rw_mutex_unlock(&ptcache_archive_rwlock);
+}
+
+static bool ptcache_archive_append(const char *filepath,
+                                   int frame,
+                                   const unsigned char *data,
+                                   unsigned int size)
+{
+  PTCacheArchive *archive;
+  PTCacheArchiveChunk chunk;
+  bool ok;
+
+  BLI_rw_mutex_lock(&ptcache_archive_rwlock, THREAD_LOCK_WRITE);
+
+  archive = ptcache_archive_get(filepath);
+  if (archive == NULL) {
+    archive = ptcache_archive_create(filepath);
+  }
+
+  memcpy(chunk.id, "BPCF", sizeof(chunk.id));
+  chunk.frame = frame;
+  chunk.size = size;
+
+  ok = archive && archive->writable;
+
+  /* The chunk is written over the index in the file, so it's invalid until written again. */
+  if (ok && !archive->index_dirty) {
+    ok = ptcache_archive_header_write(archive, 0, 0);
+    archive->index_dirty = true;
+  }
+
+  ok = ok && ptcache_archive_write_at(archive, archive->data_end, &chunk, sizeof(chunk)) &&
+       ptcache_archive_write_at(archive, archive->data_end + sizeof(chunk), data, size);
+
+  if (ok) {
+    ptcache_archive_entry_set(archive, frame, size, archive->data_end);
+    archive->data_end += sizeof(chunk) + size;
+  }
+
+  BLI_rw_mutex_unlock(&ptcache_archive_rwlock);
+
+  return ok;
+}
+
+static int ptcache_archive_chunk_frame_cmp(const void *a_v, const void *b_v)
+{
+  const PTCacheArchiveChunk *a = a_v;
+  const PTCacheArchiveChunk *b = b_v;
+
+  return (a->frame < b->frame) ? -1 : (a->frame > b->frame);
+}
+
+/* Truncate the file after the last remaining chunk, mark removed frames with earlier chunks, and
+ * write the index. */
+static bool ptcache_archive_truncate(PTCacheArchive *archive, uint64_t keep_end)
+{
+  PTCacheArchiveChunk chunk;
+  PTCacheArchiveChunk *removed = NULL;
+  int totremoved = 0, removed_alloc = 0;
+  bool ok;
+
+  if (!ptcache_archive_map(archive)) {
+    return false;
+  }
+
+  /* Removed frames can't be told apart from remaining ones without the index, mark them. */
+  for (uint64_t offset = sizeof(PTCacheArchiveHeader);
+       offset < keep_end && ptcache_archive_chunk_read(archive, offset, keep_end, &chunk);
+       offset += sizeof(PTCacheArchiveChunk) + chunk.size) {
+    if (STREQLEN(chunk.id, "BPCF", 4) && ptcache_archive_find(archive, chunk.frame) == NULL) {
+      if (totremoved == removed_alloc) {
+        removed_alloc = max_ii(removed_alloc * 2, 16);
+        removed = MEM_reallocN_id(
+            removed, sizeof(PTCacheArchiveChunk) * removed_alloc, "PTCacheArchive removed");
+      }
+      memcpy(removed[totremoved].id, "BPCX", sizeof(chunk.id));
+      removed[totremoved].frame = chunk.frame;
+      removed[totremoved].size = 0;
+      totremoved++;
+    }
+  }
+
+  /* Every frame is only marked once. */
+  if (totremoved > 1) {
+    int tot = 1;
+
+    qsort(removed, (size_t)totremoved, sizeof(PTCacheArchiveChunk), ptcache_archive_chunk_frame_cmp);
+    for (int i = 1; i < totremoved; i++) {
+      if (removed[i].frame != removed[tot - 1].frame) {
+        removed[tot++] = removed[i];
+      }
+    }
+    totremoved = tot;
+  }
+
+  /* Windows can't truncate mapped files. */
+  ptcache_archive_unmap(archive);
+
+#ifdef WIN32
+  ok = _chsize_s(archive->file, (int64_t)keep_end) == 0;
+#else
+  ok = ftruncate(archive->file, (off_t)keep_end) == 0;
+#endif
+
+  if (ok) {
+    archive->file_len = keep_end;
+    archive->data_end = keep_end;
+
+    if (totremoved) {
+      ok = ptcache_archive_write_at(
+          archive, keep_end, removed, sizeof(PTCacheArchiveChunk) * totremoved);
+      archive->data_end += sizeof(PTCacheArchiveChunk) * totremoved;
+    }
+  }
+
+  ok = ok && ptcache_archive_index_write(archive);
+
+  MEM_SAFE_FREE(removed);
+
+  return ok;
+}
+
+/* Remove frames, with the same modes as #BKE_ptcache_id_clear. Returns true if any frame was
+ * removed. */
+static bool ptcache_archive_remove(const char *filepath, int mode, int cfra)
+{
+  PTCacheArchive *archive;
+  uint64_t keep_end = sizeof(PTCacheArchiveHeader);
+  int tot = 0;
+  bool removed = false;
+
+  BLI_rw_mutex_lock(&ptcache_archive_rwlock, THREAD_LOCK_WRITE);
+
+  archive = ptcache_archive_get(filepath);
+
+  if (archive && archive->writable) {
+    for (int i = 0; i < archive->totentry; i++) {
+      const PTCacheArchiveEntry *entry = &archive->entries[i];
+
+      if (mode == PTCACHE_CLEAR_ALL || (mode == PTCACHE_CLEAR_FRAME && entry->frame == cfra) ||
+          (mode == PTCACHE_CLEAR_BEFORE && entry->frame < cfra) ||
+          (mode == PTCACHE_CLEAR_AFTER && entry->frame > cfra)) {
+        continue;
+      }
+
+      keep_end = MAX2(keep_end, entry->offset + sizeof(PTCacheArchiveChunk) + entry->size);
+      archive->entries[tot++] = *entry;
+    }
+
+    removed = (tot != archive->totentry);
+    archive->totentry = tot;
+
+    if (tot == 0) {
+      archive->index_dirty = false;
+      ptcache_archive_close(archive);
+      BLI_delete(filepath, false, false);
+    }
+    else if (removed && !ptcache_archive_truncate(archive, keep_end)) {
+      CLOG_ERROR(&LOG, "Failed to write point cache file: %s", filepath);
+    }
+  }
+
+  BLI_rw_mutex_unlock(&ptcache_archive_rwlock);
+
+  return removed;
+}
+
+/* Write the index of all open files. */
+static void ptcache_archive_flush_all(void)
+{
+  BLI_rw_mutex_lock(&ptcache_archive_rwlock, THREAD_LOCK_WRITE);
+
+  LISTBASE_FOREACH (PTCacheArchive *, archive, &ptcache_archives) {
+    if (archive->index_dirty && archive->writable && !ptcache_archive_index_write(archive)) {
+      CLOG_ERROR(&LOG, "Failed to write point cache file: %s", archive->filepath);
+    }
+  }
+
+  BLI_rw_mutex_unlock(&ptcache_archive_rwlock);
+}
+
+static void ptcache_archive_close_all(void)
+{
+  BLI_rw_mutex_lock(&ptcache_archive_rwlock, THREAD_LOCK_WRITE);
+
+  while (ptcache_archives.first) {
+    ptcache_archive_close(ptcache_archives.first);
+  }
+
+  if (ptcache_archive_closed_paths) {
+    BLI_gset_free(ptcache_archive_closed_paths, MEM_freeN);
+    ptcache_archive_closed_paths = NULL;
+  }
+  ptcache_archive_max_open = PTCACHE_ARCHIVE_MAX_OPEN_MIN;
+
+  BLI_rw_mutex_unlock(&ptcache_archive_rwlock);
+}
+
+static PTCacheFile *ptcache_archive_file_open(const char *filepath, int mode, int cfra)
+{
+  PTCacheArchiveFile *archive_file;
+  PTCacheFile *pf;
+  unsigned char *mem = NULL;
+  size_t mem_len = 0;
+
+  if (!ELEM(mode, PTCACHE_FILE_READ, PTCACHE_FILE_WRITE)) {
+    return NULL;
+  }
+
+  if (mode == PTCACHE_FILE_READ) {
+    const PTCacheArchive *archive = ptcache_archive_read_begin(filepath);
+    const PTCacheArchiveEntry *entry = archive ? ptcache_archive_find(archive, cfra) : NULL;
+
+    /* Copy the frame, so other threads can write to files while it's read. */
+    if (entry) {
+      mem_len = entry->size;
+      mem = MEM_mallocN(mem_len, "PTCacheArchiveFile mem");
+      memcpy(mem, archive->map + entry->offset + sizeof(PTCacheArchiveChunk), mem_len);
+    }
+
+    if (archive) {
+      ptcache_archive_read_end();
+    }
+    if (mem == NULL) {
+      return NULL;
+    }
+  }
+
+  archive_file = MEM_mallocN(sizeof(PTCacheArchiveFile), "PTCacheArchiveFile");
+  BLI_strncpy(archive_file->filepath, filepath, sizeof(archive_file->filepath));
+  archive_file->mode = mode;
+
+  /* Written to memory first, and appended to the file when closing. */
+  pf = MEM_callocN(sizeof(PTCacheFile), "PTCacheFile");
+  pf->archive = archive_file;
+  pf->frame = cfra;
+  pf->mem = mem;
+  pf->mem_len = mem_len;
+
+  return pf;
+}
+
+static bool ptcache_archive_file_close(PTCacheFile *pf)
+{
+  PTCacheArchiveFile *archive_file = pf->archive;
+  bool ok = true;
+
+  if (archive_file->mode == PTCACHE_FILE_WRITE) {
+    ok = ptcache_archive_append(
+        archive_file->filepath, pf->frame, pf->mem, (unsigned int)pf->mem_len);
+    if (!ok) {
+      CLOG_ERROR(&LOG, "Failed to write point cache file: %s", archive_file->filepath);
+    }
+  }
+  MEM_SAFE_FREE(pf->mem);
+
+  MEM_freeN(archive_file);
+
+  return ok;
+}
+
+/** \} */
+
 /**
  * Caller must close after!
  */
@@ -1446,6 +2297,10 @@ static PTCacheFile *ptcache_file_open(PTCacheID *pid, int mode, int cfra)
 
   ptcache_filename(pid, filename, cfra, 1, 1);
 
+  if (pid->cache->flag & PTCACHE_SINGLE_FILE) {
+    return ptcache_archive_file_open(filename, mode, cfra);
+  }
+
   if (mode == PTCACHE_FILE_READ) {
     fp = BLI_fopen(filename, "rb");
   }
@@ -1464,19 +2319,28 @@ static PTCacheFile *ptcache_file_open(PTCacheID *pid, int mode, int cfra)
     return NULL;
   }
 
-  pf = MEM_mallocN(sizeof(PTCacheFile), "PTCacheFile");
+  pf = MEM_callocN(sizeof(PTCacheFile), "PTCacheFile");
   pf->fp = fp;
   pf->old_format = 0;
   pf->frame = cfra;
 
   return pf;
 }
-static void ptcache_file_close(PTCacheFile *pf)
+static int ptcache_file_close(PTCacheFile *pf)
 {
+  int ok = 1;
+
   if (pf) {
-    fclose(pf->fp);
+    if (pf->archive) {
+      ok = ptcache_archive_file_close(pf);
+    }
+    else {
+      ok = (fclose(pf->fp) == 0);
+    }
     MEM_freeN(pf);
   }
+
+  return ok;
 }
 
 static int ptcache_file_compressed_read(PTCacheFile *pf, unsigned char *result, unsigned int len)
@@ -1528,13 +2392,26 @@ static int ptcache_file_compressed_read(PTCacheFile *pf, unsigned char *result,
 
   return r;
 }
-static int ptcache_file_compressed_write(
-    PTCacheFile *pf, unsigned char *in, unsigned int in_len, unsigned char *out, int mode)
+/* Data compressed separately from writing, so blocks can be compressed in parallel. */
+typedef struct PTCacheCompressBlock {
+  unsigned char *in;
+  unsigned int in_len;
+  unsigned char *out;
+  size_t out_len;
+  unsigned char props[16];
+  size_t props_len;
+  unsigned char compressed;
+  int result;
+} PTCacheCompressBlock;
+
+static void ptcache_compress_block(PTCacheCompressBlock *block, int mode)
 {
   int r = 0;
   unsigned char compressed = 0;
   size_t out_len = 0;
-  unsigned char *props = MEM_callocN(sizeof(char[16]), "tmp");
+  unsigned int in_len = block->in_len;
+  unsigned char *in = block->in;
+  unsigned char *out = block->out;
   size_t sizeOfIt = 5;
 
   (void)mode; /* unused when building w/o compression */
@@ -1555,15 +2432,21 @@ static int ptcache_file_compressed_write(
 #endif
 #ifdef WITH_LZMA
   if (mode == 2) {
+    /* A dictionary larger than the data doesn't compress better, but uses a lot of memory when
+     * compressing blocks in parallel. */
+    const size_t dict_min = MAX2(in_len, 1u << 12);
+    const unsigned int dict_size = (unsigned int)MIN2(dict_min, 1u << 24);
+
+    out_len = LZO_OUT_LEN(in_len);
 
     r = LzmaCompress(out,
                      &out_len,
                      in,
                      in_len, /* assume sizeof(char)==1.... */
-                     props,
+                     block->props,
                      &sizeOfIt,
                      5,
-                     1 << 24,
+                     dict_size,
                      3,
                      0,
                      2,
@@ -1579,33 +2462,70 @@ static int ptcache_file_compressed_write(
   }
 #endif
 
-  ptcache_file_write(pf, &compressed, 1, sizeof(unsigned char));
-  if (compressed) {
-    unsigned int size = out_len;
+  block->compressed = compressed;
+  block->out_len = out_len;
+  block->props_len = sizeOfIt;
+  block->result = r;
+}
+
+static void ptcache_file_compressed_block_write(PTCacheFile *pf, const PTCacheCompressBlock *block)
+{
+  ptcache_file_write(pf, &block->compressed, 1, sizeof(unsigned char));
+  if (block->compressed) {
+    unsigned int size = block->out_len;
     ptcache_file_write(pf, &size, 1, sizeof(unsigned int));
-    ptcache_file_write(pf, out, out_len, sizeof(unsigned char));
+    ptcache_file_write(pf, block->out, block->out_len, sizeof(unsigned char));
   }
   else {
-    ptcache_file_write(pf, in, in_len, sizeof(unsigned char));
+    ptcache_file_write(pf, block->in, block->in_len, sizeof(unsigned char));
   }
 
-  if (compressed == 2) {
-    unsigned int size = sizeOfIt;
-    ptcache_file_write(pf, &sizeOfIt, 1, sizeof(unsigned int));
-    ptcache_file_write(pf, props, size, sizeof(unsigned char));
+  if (block->compressed == 2) {
+    unsigned int size = block->props_len;
+    ptcache_file_write(pf, &size, 1, sizeof(unsigned int));
+    ptcache_file_write(pf, block->props, size, sizeof(unsigned char));
   }
+}
 
-  MEM_freeN(props);
+static int ptcache_file_compressed_write(
+    PTCacheFile *pf, unsigned char *in, unsigned int in_len, unsigned char *out, int mode)
+{
+  PTCacheCompressBlock block = {.in = in, .in_len = in_len, .out = out};
 
-  return r;
+  ptcache_compress_block(&block, mode);
+  ptcache_file_compressed_block_write(pf, &block);
+
+  return block.result;
 }
 static int ptcache_file_read(PTCacheFile *pf, void *f, unsigned int tot, unsigned int size)
 {
-  return (fread(f, size, tot, pf->fp) == tot);
+  if (pf->fp) {
+    return (fread(f, size, tot, pf->fp) == tot);
+  }
+
+  const size_t len = (size_t)size * tot;
+  if (len > pf->mem_len - pf->mem_pos) {
+    pf->mem_pos = pf->mem_len;
+    return 0;
+  }
+  memcpy(f, pf->mem + pf->mem_pos, len);
+  pf->mem_pos += len;
+  return 1;
 }
 static int ptcache_file_write(PTCacheFile *pf, const void *f, unsigned int tot, unsigned int size)
 {
-  return (fwrite(f, size, tot, pf->fp) == tot);
+  if (pf->fp) {
+    return (fwrite(f, size, tot, pf->fp) == tot);
+  }
+
+  const size_t len = (size_t)size * tot;
+  if (pf->mem_len + len > pf->mem_alloc) {
+    pf->mem_alloc = max_zz(pf->mem_alloc * 2, pf->mem_len + len);
+    pf->mem = MEM_reallocN(pf->mem, pf->mem_alloc);
+  }
+  memcpy(pf->mem + pf->mem_len, f, len);
+  pf->mem_len += len;
+  return 1;
 }
 static int ptcache_file_data_read(PTCacheFile *pf)
 {
@@ -1641,7 +2561,7 @@ static int ptcache_file_header_begin_read(PTCacheFile *pf)
 
   pf->data_types = 0;
 
-  if (fread(bphysics, sizeof(char), 8, pf->fp) != 8) {
+  if (!ptcache_file_read(pf, bphysics, 8, sizeof(char))) {
     error = 1;
   }
 
@@ -1649,7 +2569,7 @@ static int ptcache_file_header_begin_read(PTCacheFile *pf)
     error = 1;
   }
 
-  if (!error && !fread(&typeflag, sizeof(unsigned int), 1, pf->fp)) {
+  if (!error && !ptcache_file_read(pf, &typeflag, 1, sizeof(unsigned int))) {
     error = 1;
   }
 
@@ -1658,7 +2578,12 @@ static int ptcache_file_header_begin_read(PTCacheFile *pf)
 
   /* if there was an error set file as it was */
   if (error) {
-    BLI_fseek(pf->fp, 0, SEEK_SET);
+    if (pf->fp) {
+      BLI_fseek(pf->fp, 0, SEEK_SET);
+    }
+    else {
+      pf->mem_pos = 0;
+    }
   }
 
   return !error;
@@ -1668,11 +2593,11 @@ static int ptcache_file_header_begin_write(PTCacheFile *pf)
   const char *bphysics = "BPHYSICS";
   unsigned int typeflag = pf->type + pf->flag;
 
-  if (fwrite(bphysics, sizeof(char), 8, pf->fp) != 8) {
+  if (!ptcache_file_write(pf, bphysics, 8, sizeof(char))) {
     return 0;
   }
 
-  if (!fwrite(&typeflag, sizeof(unsigned int), 1, pf->fp)) {
+  if (!ptcache_file_write(pf, &typeflag, 1, sizeof(unsigned int))) {
     return 0;
   }
 
@@ -1995,9 +2920,66 @@ static PTCacheMem *ptcache_disk_frame_to_mem(PTCacheID *pid, int cfra)
 
   return pm;
 }
+typedef struct PTCacheCompressData {
+  PTCacheCompressBlock *blocks;
+  int mode;
+} PTCacheCompressData;
+
+static void ptcache_compress_block_cb(void *__restrict userdata,
+                                      const int i,
+                                      const TaskParallelTLS *__restrict UNUSED(tls))
+{
+  PTCacheCompressData *data = userdata;
+  ptcache_compress_block(&data->blocks[i], data->mode);
+}
+
+/* Compress the data and extra data of a frame in parallel, in the order they are written. */
+static PTCacheCompressBlock *ptcache_mem_frame_compress(PTCacheMem *pm, int mode, int *r_totblock)
+{
+  PTCacheCompressBlock *blocks = MEM_callocN(
+      sizeof(PTCacheCompressBlock) * (BPHYS_TOT_DATA + BLI_listbase_count(&pm->extradata)),
+      "PTCacheCompressBlock");
+  int totblock = 0;
+
+  for (int i = 0; i < BPHYS_TOT_DATA; i++) {
+    if (pm->data[i]) {
+      blocks[totblock].in = (unsigned char *)pm->data[i];
+      blocks[totblock].in_len = pm->totpoint * ptcache_data_size[i];
+      totblock++;
+    }
+  }
+
+  LISTBASE_FOREACH (PTCacheExtra *, extra, &pm->extradata) {
+    if (extra->data && extra->totdata) {
+      blocks[totblock].in = (unsigned char *)extra->data;
+      blocks[totblock].in_len = extra->totdata * ptcache_extra_datasize[extra->type];
+      totblock++;
+    }
+  }
+
+  for (int i = 0; i < totblock; i++) {
+    blocks[i].out = MEM_callocN(LZO_OUT_LEN(blocks[i].in_len) * 4, "pointcache_lzo_buffer");
+  }
+
+  PTCacheCompressData data = {
+      .blocks = blocks,
+      .mode = mode,
+  };
+
+  TaskParallelSettings settings;
+  BLI_parallel_range_settings_defaults(&settings);
+  settings.min_iter_per_thread = 1;
+  BLI_task_parallel_range(0, totblock, &data, ptcache_compress_block_cb, &settings);
+
+  *r_totblock = totblock;
+  return blocks;
+}
+
 static int ptcache_mem_frame_to_disk(PTCacheID *pid, PTCacheMem *pm)
 {
   PTCacheFile *pf = NULL;
+  PTCacheCompressBlock *blocks = NULL;
+  int totblock = 0, block = 0;
   unsigned int i, error = 0;
 
   BKE_ptcache_id_clear(pid, PTCACHE_CLEAR_FRAME, pm->frame);
@@ -2028,16 +3010,15 @@ static int ptcache_mem_frame_to_disk(PTCacheID *pid, PTCacheMem *pm)
     error = 1;
   }
 
+  if (!error && pid->cache->compression) {
+    blocks = ptcache_mem_frame_compress(pm, pid->cache->compression, &totblock);
+  }
+
   if (!error) {
     if (pid->cache->compression) {
       for (i = 0; i < BPHYS_TOT_DATA; i++) {
         if (pm->data[i]) {
-          unsigned int in_len = pm->totpoint * ptcache_data_size[i];
-          unsigned char *out = (unsigned char *)MEM_callocN(LZO_OUT_LEN(in_len) * 4,
-                                                            "pointcache_lzo_buffer");
-          ptcache_file_compressed_write(
-              pf, (unsigned char *)(pm->data[i]), in_len, out, pid->cache->compression);
-          MEM_freeN(out);
+          ptcache_file_compressed_block_write(pf, &blocks[block++]);
         }
       }
     }
@@ -2068,12 +3049,7 @@ static int ptcache_mem_frame_to_disk(PTCacheID *pid, PTCacheMem *pm)
       ptcache_file_write(pf, &extra->totdata, 1, sizeof(unsigned int));
 
       if (pid->cache->compression) {
-        unsigned int in_len = extra->totdata * ptcache_extra_datasize[extra->type];
-        unsigned char *out = (unsigned char *)MEM_callocN(LZO_OUT_LEN(in_len) * 4,
-                                                          "pointcache_lzo_buffer");
-        ptcache_file_compressed_write(
-            pf, (unsigned char *)(extra->data), in_len, out, pid->cache->compression);
-        MEM_freeN(out);
+        ptcache_file_compressed_block_write(pf, &blocks[block++]);
       }
       else {
         ptcache_file_write(pf, extra->data, extra->totdata, ptcache_extra_datasize[extra->type]);
@@ -2081,7 +3057,16 @@ static int ptcache_mem_frame_to_disk(PTCacheID *pid, PTCacheMem *pm)
     }
   }
 
-  ptcache_file_close(pf);
+  if (blocks) {
+    for (int b = 0; b < totblock; b++) {
+      MEM_freeN(blocks[b].out);
+    }
+    MEM_freeN(blocks);
+  }
+
+  if (!ptcache_file_close(pf)) {
+    error = 1;
+  }
 
   if (error && G.debug & G_DEBUG) {
     printf("Error writing to disk cache\n");
@@ -2376,7 +3361,9 @@ static int ptcache_write_stream(PTCacheID *pid, int cfra, int totpoint)
     pid->write_stream(pf, pid->calldata);
   }
 
-  ptcache_file_close(pf);
+  if (!ptcache_file_close(pf)) {
+    error = 1;
+  }
 
   if (error && G.debug & G_DEBUG) {
     printf("Error writing to disk cache\n");
@@ -2596,7 +3583,23 @@ void BKE_ptcache_id_clear(PTCacheID *pid, int mode, unsigned int cfra)
     case PTCACHE_CLEAR_ALL:
     case PTCACHE_CLEAR_BEFORE:
     case PTCACHE_CLEAR_AFTER:
-      if (pid->cache->flag & PTCACHE_DISK_CACHE) {
+      if ((pid->cache->flag & PTCACHE_DISK_CACHE) && (pid->cache->flag & PTCACHE_SINGLE_FILE)) {
+        ptcache_filename(pid, path_full, cfra, 1, 1);
+
+        if (ptcache_archive_remove(path_full, mode, cfra) && mode == PTCACHE_CLEAR_ALL) {
+          pid->cache->last_exact = MIN2(pid->cache->startframe, 0);
+        }
+
+        if (pid->cache->cached_frames) {
+          for (int frame = (int)sta; frame <= (int)end; frame++) {
+            if (mode == PTCACHE_CLEAR_ALL || (mode == PTCACHE_CLEAR_BEFORE && frame < cfra) ||
+                (mode == PTCACHE_CLEAR_AFTER && frame > cfra)) {
+              pid->cache->cached_frames[frame - sta] = 0;
+            }
+          }
+        }
+      }
+      else if (pid->cache->flag & PTCACHE_DISK_CACHE) {
         ptcache_path(pid, path);
 
         dir = opendir(path);
@@ -2687,7 +3690,12 @@ void BKE_ptcache_id_clear(PTCacheID *pid, int mode, unsigned int cfra)
       if (pid->cache->flag & PTCACHE_DISK_CACHE) {
         if (BKE_ptcache_id_exist(pid, cfra)) {
           ptcache_filename(pid, filename, cfra, 1, 1); /* no path */
-          BLI_delete(filename, false, false);
+          if (pid->cache->flag & PTCACHE_SINGLE_FILE) {
+            ptcache_archive_remove(filename, PTCACHE_CLEAR_FRAME, cfra);
+          }
+          else {
+            BLI_delete(filename, false, false);
+          }
         }
       }
       else {
@@ -2729,6 +3737,18 @@ int BKE_ptcache_id_exist(PTCacheID *pid, int cfra)
 
     ptcache_filename(pid, filename, cfra, 1, 1);
 
+    if (pid->cache->flag & PTCACHE_SINGLE_FILE) {
+      const PTCacheArchive *archive = ptcache_archive_read_begin(filename);
+      bool exists = false;
+
+      if (archive) {
+        exists = ptcache_archive_find(archive, cfra) != NULL;
+        ptcache_archive_read_end();
+      }
+
+      return exists;
+    }
+
     return BLI_exists(filename);
   }
 
@@ -2792,7 +3812,25 @@ void BKE_ptcache_id_time(
     cache->cached_frames = MEM_callocN(sizeof(char) * cache->cached_frames_len,
                                        "cached frames array");
 
-    if (pid->cache->flag & PTCACHE_DISK_CACHE) {
+    if ((pid->cache->flag & PTCACHE_DISK_CACHE) && (pid->cache->flag & PTCACHE_SINGLE_FILE)) {
+      const PTCacheArchive *archive;
+      char filename[MAX_PTCACHE_FILE];
+
+      ptcache_filename(pid, filename, (int)cfra, 1, 1);
+
+      archive = ptcache_archive_read_begin(filename);
+      if (archive) {
+        for (int i = 0; i < archive->totentry; i++) {
+          const int frame = archive->entries[i].frame;
+
+          if (frame >= sta && frame <= end) {
+            cache->cached_frames[frame - sta] = 1;
+          }
+        }
+        ptcache_archive_read_end();
+      }
+    }
+    else if (pid->cache->flag & PTCACHE_DISK_CACHE) {
       /* mode is same as fopen's modes */
       DIR *dir;
       struct dirent *de;
@@ -2982,6 +4020,8 @@ void BKE_ptcache_remove(void)
 
   ptcache_path(NULL, path);
 
+  ptcache_archive_close_all();
+
   if (BLI_exists(path)) {
     /* The pointcache dir exists? - remove all pointcache */
 
@@ -2997,7 +4037,7 @@ void BKE_ptcache_remove(void)
       if (FILENAME_IS_CURRPAR(de->d_name)) {
         /* do nothing */
       }
-      else if (strstr(de->d_name, PTCACHE_EXT)) { /* do we have the right extension?*/
+      else if (strstr(de->d_name, PTCACHE_EXT) || strstr(de->d_name, PTCACHE_ARCHIVE_EXT)) {
         BLI_join_dirfile(path_full, sizeof(path_full), path, de->d_name);
         BLI_delete(path_full, false, false);
       }
@@ -3017,6 +4057,11 @@ void BKE_ptcache_remove(void)
   }
 }
 
+void BKE_ptcache_exit(void)
+{
+  ptcache_archive_close_all();
+}
+
 /* Point Cache handling */
 
 PointCache *BKE_ptcache_add(ListBase *ptcaches)
@@ -3391,6 +4436,9 @@ void BKE_ptcache_bake(PTCacheBaker *baker)
     }
   }
 
+  /* Write the index of single file caches, they stay open for playback. */
+  ptcache_archive_flush_all();
+
   scene->r.framelen = frameleno;
   CFRA = cfrao;
 
@@ -3496,6 +4544,53 @@ void BKE_ptcache_toggle_disk_cache(PTCacheID *pid)
   }
 }
 
+void BKE_ptcache_toggle_single_file(PTCacheID *pid)
+{
+  PointCache *cache = pid->cache;
+  int last_exact = cache->last_exact;
+  int baked = cache->flag & PTCACHE_BAKED;
+
+  if ((cache->flag & PTCACHE_DISK_CACHE) == 0) {
+    return;
+  }
+
+  if (cache->cached_frames) {
+    MEM_freeN(cache->cached_frames);
+    cache->cached_frames = NULL;
+    cache->cached_frames_len = 0;
+  }
+
+  /* Read the files in the previous format into memory. */
+  cache->flag ^= PTCACHE_SINGLE_FILE;
+  cache->flag &= ~PTCACHE_DISK_CACHE;
+  BKE_ptcache_disk_to_mem(pid);
+
+  /* Remove the previous files. */
+  cache->flag &= ~PTCACHE_BAKED;
+  cache->flag |= PTCACHE_DISK_CACHE;
+  BKE_ptcache_id_clear(pid, PTCACHE_CLEAR_ALL, 0);
+  cache->flag |= baked;
+
+  /* Write in the new format. */
+  cache->flag ^= PTCACHE_SINGLE_FILE;
+  BKE_ptcache_mem_to_disk(pid);
+
+  /* Free the memory cache. */
+  cache->flag &= ~PTCACHE_BAKED;
+  if (cache->flag & PTCACHE_DISK_CACHE) {
+    cache->flag &= ~PTCACHE_DISK_CACHE;
+    BKE_ptcache_id_clear(pid, PTCACHE_CLEAR_ALL, 0);
+    cache->flag |= PTCACHE_DISK_CACHE;
+  }
+  cache->flag |= baked;
+
+  cache->last_exact = last_exact;
+
+  BKE_ptcache_id_time(pid, NULL, 0.0f, NULL, NULL, NULL);
+
+  cache->flag |= PTCACHE_FLAG_INFO_DIRTY;
+}
+
 void BKE_ptcache_disk_cache_rename(PTCacheID *pid, const char *name_src, const char *name_dst)
 {
   char old_name[80];
@@ -3515,6 +4610,23 @@ void BKE_ptcache_disk_cache_rename(PTCacheID *pid, const char *name_src, const c
   /* get "from" filename */
   BLI_strncpy(pid->cache->name, name_src, sizeof(pid->cache->name));
 
+  if (pid->cache->flag & PTCACHE_SINGLE_FILE) {
+    ptcache_filename(pid, old_path_full, 0, 1, 1);
+    BLI_strncpy(pid->cache->name, name_dst, sizeof(pid->cache->name));
+    ptcache_filename(pid, new_path_full, 0, 1, 1);
+
+    BLI_rw_mutex_lock(&ptcache_archive_rwlock, THREAD_LOCK_WRITE);
+    ptcache_archive_close_path(old_path_full);
+    ptcache_archive_close_path(new_path_full);
+    if (BLI_exists(old_path_full)) {
+      BLI_rename(old_path_full, new_path_full);
+    }
+    BLI_rw_mutex_unlock(&ptcache_archive_rwlock);
+
+    BLI_strncpy(pid->cache->name, old_name, sizeof(pid->cache->name));
+    return;
+  }
+
   len = ptcache_filename(pid, old_filename, 0, 0, 0); /* no path */
 
   ptcache_path(pid, path);
@@ -3565,48 +4677,77 @@ void BKE_ptcache_load_external(PTCacheID *pid)
   char path[MAX_PTCACHE_PATH];
   char filename[MAX_PTCACHE_FILE];
   char ext[MAX_PTCACHE_PATH];
+  const PTCacheArchive *archive;
+  bool found_archive = false;
 
   if (!cache) {
     return;
   }
 
-  ptcache_path(pid, path);
+  /* Look for a single file with all frames first, these are always written with an index. */
+  if (cache->index >= 0) {
+    cache->flag |= PTCACHE_SINGLE_FILE;
+    ptcache_filename(pid, filename, 1, 1, 1);
 
-  len = ptcache_filename(pid, filename, 1, 0, 0); /* no path */
+    archive = ptcache_archive_read_begin(filename);
+    if (archive) {
+      for (int i = 0; i < archive->totentry; i++) {
+        const int frame = archive->entries[i].frame;
 
-  dir = opendir(path);
-  if (dir == NULL) {
-    return;
+        if (frame) {
+          start = MIN2(start, frame);
+          end = MAX2(end, frame);
+        }
+        else {
+          info = 1;
+        }
+      }
+      ptcache_archive_read_end();
+      found_archive = true;
+    }
   }
 
-  const char *fext = ptcache_file_extension(pid);
+  if (!found_archive) {
+    cache->flag &= ~PTCACHE_SINGLE_FILE;
 
-  if (cache->index >= 0) {
-    BLI_snprintf(ext, sizeof(ext), "_%02d%s", cache->index, fext);
-  }
-  else {
-    BLI_strncpy(ext, fext, sizeof(ext));
-  }
+    ptcache_path(pid, path);
 
-  while ((de = readdir(dir)) != NULL) {
-    if (strstr(de->d_name, ext)) {               /* do we have the right extension?*/
-      if (STREQLEN(filename, de->d_name, len)) { /* do we have the right prefix */
-        /* read the number of the file */
-        const int frame = ptcache_frame_from_filename(de->d_name, ext);
+    len = ptcache_filename(pid, filename, 1, 0, 0); /* no path */
 
-        if (frame != -1) {
-          if (frame) {
-            start = MIN2(start, frame);
-            end = MAX2(end, frame);
-          }
-          else {
-            info = 1;
+    dir = opendir(path);
+    if (dir == NULL) {
+      return;
+    }
+
+    const char *fext = ptcache_file_extension(pid);
+
+    if (cache->index >= 0) {
+      BLI_snprintf(ext, sizeof(ext), "_%02d%s", cache->index, fext);
+    }
+    else {
+      BLI_strncpy(ext, fext, sizeof(ext));
+    }
+
+    while ((de = readdir(dir)) != NULL) {
+      if (strstr(de->d_name, ext)) {               /* do we have the right extension?*/
+        if (STREQLEN(filename, de->d_name, len)) { /* do we have the right prefix */
+          /* read the number of the file */
+          const int frame = ptcache_frame_from_filename(de->d_name, ext);
+
+          if (frame != -1) {
+            if (frame) {
+              start = MIN2(start, frame);
+              end = MAX2(end, frame);
+            }
+            else {
+              info = 1;
+            }
           }
         }
       }
     }
+    closedir(dir);
   }
-  closedir(dir);
 
   if (start != MAXFRAME) {
     PTCacheFile *pf;
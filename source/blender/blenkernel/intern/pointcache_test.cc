@@ -0,0 +1,206 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+#include "testing/testing.h"
+
+#include <cstring>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#include "MEM_guardedalloc.h"
+
+#include "BKE_pointcache.h"
+#include "BKE_softbody.h"
+
+#include "DNA_object_force_types.h"
+#include "DNA_object_types.h"
+
+#include "BLI_fileops.h"
+#include "BLI_path_util.h"
+#include "BLI_string.h"
+
+namespace blender::bke::tests {
+
+static const int TEST_POINTS = 64;
+
+/* Soft body with its point cache stored in a single file in the temporary directory. */
+class PointCacheSingleFileTest : public ::testing::Test {
+ protected:
+  void SetUp() override
+  {
+    dir = (std::filesystem::temp_directory_path() / "blender_pointcache_test").string();
+    BLI_dir_create_recursive(dir.c_str());
+
+    memset(&ob, 0, sizeof(ob));
+    memset(&sb, 0, sizeof(sb));
+    memset(&shared, 0, sizeof(shared));
+    BLI_strncpy(ob.id.name, "OBsoftbody", sizeof(ob.id.name));
+
+    PointCache *cache = BKE_ptcache_add(&shared.ptcaches);
+    cache->flag |= PTCACHE_DISK_CACHE | PTCACHE_SINGLE_FILE | PTCACHE_EXTERNAL;
+    cache->index = 0;
+    BLI_strncpy(cache->path, dir.c_str(), sizeof(cache->path));
+    BLI_strncpy(cache->name, "softbody", sizeof(cache->name));
+    shared.pointcache = cache;
+
+    points.resize(TEST_POINTS);
+    sb.shared = &shared;
+    sb.totpoint = TEST_POINTS;
+    sb.bpoint = points.data();
+
+    BKE_ptcache_id_from_softbody(&pid, &ob, &sb);
+  }
+
+  void TearDown() override
+  {
+    BKE_ptcache_exit();
+    BKE_ptcache_free_list(&shared.ptcaches);
+    BLI_delete(dir.c_str(), true, true);
+  }
+
+  std::string filepath(const char *name)
+  {
+    char file[FILE_MAX], path[FILE_MAX];
+    BLI_snprintf(file, sizeof(file), "%s_00%s", name, PTCACHE_ARCHIVE_EXT);
+    BLI_join_dirfile(path, sizeof(path), dir.c_str(), file);
+    return path;
+  }
+
+  /* Switch to another file in the same directory. */
+  void set_name(const char *name)
+  {
+    BLI_strncpy(pid.cache->name, name, sizeof(pid.cache->name));
+  }
+
+  void write_frames(int start, int end)
+  {
+    for (int frame = start; frame <= end; frame++) {
+      for (int i = 0; i < TEST_POINTS; i++) {
+        points[i].pos[0] = (float)frame;
+        points[i].pos[1] = (float)i;
+        points[i].vec[2] = (float)(frame * i);
+      }
+      ASSERT_TRUE(BKE_ptcache_write(&pid, (unsigned int)frame)) << "frame " << frame;
+    }
+  }
+
+  void expect_frame(int frame)
+  {
+    for (BodyPoint &point : points) {
+      memset(&point, 0, sizeof(point));
+    }
+    ASSERT_TRUE(BKE_ptcache_id_exist(&pid, frame)) << "frame " << frame;
+    ASSERT_EQ(BKE_ptcache_read(&pid, (float)frame, false), PTCACHE_READ_EXACT)
+        << "frame " << frame;
+    for (int i = 0; i < TEST_POINTS; i++) {
+      EXPECT_EQ(points[i].pos[0], (float)frame);
+      EXPECT_EQ(points[i].pos[1], (float)i);
+      EXPECT_EQ(points[i].vec[2], (float)(frame * i));
+    }
+  }
+
+  /* Frames in the range exist and have the data written for them, other frames don't exist. */
+  void expect_frames(int start, int end, int removed = 0)
+  {
+    for (int frame = 1; frame <= end + 2; frame++) {
+      if (frame >= start && frame <= end && frame != removed) {
+        expect_frame(frame);
+      }
+      else {
+        EXPECT_FALSE(BKE_ptcache_id_exist(&pid, frame)) << "frame " << frame;
+      }
+    }
+  }
+
+  std::string dir;
+  Object ob;
+  SoftBody sb;
+  SoftBody_Shared shared;
+  std::vector<BodyPoint> points;
+  PTCacheID pid;
+};
+
+TEST_F(PointCacheSingleFileTest, Append)
+{
+  write_frames(1, 10);
+  expect_frames(1, 10);
+
+  /* All frames are in one file. */
+  EXPECT_TRUE(BLI_exists(filepath("softbody").c_str()));
+
+  /* The index is written when closing, frames are appended after reopening. */
+  BKE_ptcache_exit();
+  expect_frames(1, 10);
+  write_frames(11, 20);
+  BKE_ptcache_exit();
+  expect_frames(1, 20);
+}
+
+/* Baking was interrupted before the index was written, it's rebuilt from the frames. */
+TEST_F(PointCacheSingleFileTest, IndexRebuild)
+{
+  write_frames(1, 10);
+  ASSERT_EQ(BLI_copy(filepath("softbody").c_str(), filepath("interrupted").c_str()), 0);
+
+  set_name("interrupted");
+  expect_frames(1, 10);
+
+  /* Baking continues after the rebuilt index. */
+  write_frames(11, 12);
+  BKE_ptcache_exit();
+  expect_frames(1, 12);
+}
+
+TEST_F(PointCacheSingleFileTest, Truncate)
+{
+  write_frames(1, 5);
+  BKE_ptcache_exit();
+  const size_t size_5_frames = BLI_file_size(filepath("softbody").c_str());
+
+  set_name("truncated");
+  write_frames(1, 10);
+  BKE_ptcache_id_clear(&pid, PTCACHE_CLEAR_AFTER, 5);
+  expect_frames(1, 5);
+
+  /* The removed frames are cut off, leaving the same file as when only writing the others. */
+  BKE_ptcache_exit();
+  EXPECT_EQ(BLI_file_size(filepath("truncated").c_str()), size_5_frames);
+  expect_frames(1, 5);
+
+  write_frames(6, 8);
+  expect_frames(1, 8);
+
+  BKE_ptcache_id_clear(&pid, PTCACHE_CLEAR_ALL, 0);
+  EXPECT_FALSE(BLI_exists(filepath("truncated").c_str()));
+}
+
+/* Frames removed before the last frame stay in the file, marked so that rebuilding the index
+ * doesn't restore them. */
+TEST_F(PointCacheSingleFileTest, RemovedFrameMarker)
+{
+  write_frames(1, 10);
+  BKE_ptcache_id_clear(&pid, PTCACHE_CLEAR_FRAME, 3);
+  expect_frames(1, 10, 3);
+
+  /* Writing a frame invalidates the index in the file, as if baking was interrupted. */
+  write_frames(11, 11);
+  ASSERT_EQ(BLI_copy(filepath("softbody").c_str(), filepath("interrupted").c_str()), 0);
+
+  set_name("interrupted");
+  expect_frames(1, 11, 3);
+}
+
+}  // namespace blender::bke::tests
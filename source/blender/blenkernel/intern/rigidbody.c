@@ -35,6 +35,7 @@
 
 #include "BLI_listbase.h"
 #include "BLI_math.h"
+#include "BLI_task.h"
 
 #ifdef WITH_BULLET
 #  include "RBI_api.h"
@@ -1131,6 +1132,35 @@ static void rigidbody_validate_sim_constraint(RigidBodyWorld *rbw, Object *ob, b
 
 /* --------------------- */
 
+typedef struct RigidBodyTaskData {
+  rbTaskFunc func;
+  void *userdata;
+} RigidBodyTaskData;
+
+static void rigidbody_task_cb(void *__restrict userdata,
+                              const int i,
+                              const TaskParallelTLS *__restrict UNUSED(tls))
+{
+  RigidBodyTaskData *data = userdata;
+  data->func(data->userdata, i);
+}
+
+/* Run tasks of multi-threaded physics worlds with our task scheduler. */
+static void rigidbody_parallel_for(int len, rbTaskFunc func, void *userdata)
+{
+  RigidBodyTaskData data = {
+      .func = func,
+      .userdata = userdata,
+  };
+
+  TaskParallelSettings settings;
+  BLI_parallel_range_settings_defaults(&settings);
+  /* Every task is already a batch of bodies or contacts. */
+  settings.min_iter_per_thread = 1;
+
+  BLI_task_parallel_range(0, len, &data, rigidbody_task_cb, &settings);
+}
+
 /**
  * Create physics sim world given RigidBody world settings
  *
@@ -1149,7 +1179,13 @@ void BKE_rigidbody_validate_sim_world(Scene *scene, RigidBodyWorld *rbw, bool re
     if (rbw->shared->physics_world) {
       RB_dworld_delete(rbw->shared->physics_world);
     }
-    rbw->shared->physics_world = RB_dworld_new(scene->physics_settings.gravity);
+
+    const bool use_multithreading = (rbw->flag & RBW_FLAG_USE_MULTITHREADING) != 0;
+    if (use_multithreading) {
+      RB_task_scheduler_set(BLI_task_scheduler_num_threads(), rigidbody_parallel_for);
+    }
+    rbw->shared->physics_world = RB_dworld_new(scene->physics_settings.gravity,
+                                               use_multithreading);
   }
 
   RB_dworld_set_solver_iterations(rbw->shared->physics_world, rbw->num_solver_iterations);
@@ -1659,8 +1695,13 @@ static void rigidbody_update_sim_world(Scene *scene, RigidBodyWorld *rbw)
   rigidbody_update_ob_array(rbw);
 }
 
-static void rigidbody_update_sim_ob(
-    Depsgraph *depsgraph, Scene *scene, RigidBodyWorld *rbw, Object *ob, RigidBodyOb *rbo)
+/* Thread safe, as long as effectors are created before. */
+static void rigidbody_update_sim_ob(Depsgraph *depsgraph,
+                                    Scene *scene,
+                                    RigidBodyWorld *rbw,
+                                    ListBase *effectors,
+                                    Object *ob,
+                                    RigidBodyOb *rbo)
 {
   /* only update if rigid body exists */
   if (rbo->shared->physics_object == NULL) {
@@ -1717,10 +1758,7 @@ static void rigidbody_update_sim_ob(
            ((ob->pd == NULL) || (ob->pd->forcefield == PFIELD_NULL))) {
     EffectorWeights *effector_weights = rbw->effector_weights;
     EffectedPoint epoint;
-    ListBase *effectors;
 
-    /* get effectors present in the group specified by effector_weights */
-    effectors = BKE_effectors_create(depsgraph, ob, NULL, effector_weights);
     if (effectors) {
       float eff_force[3] = {0.0f, 0.0f, 0.0f};
       float eff_loc[3], eff_vel[3];
@@ -1753,9 +1791,6 @@ static void rigidbody_update_sim_ob(
     else if (G.f & G_DEBUG) {
       printf("\tno forces to apply to '%s'\n", ob->id.name + 2);
     }
-
-    /* cleanup */
-    BKE_effectors_free(effectors);
   }
   /* NOTE: passive objects don't need to be updated since they don't move */
 
@@ -1764,6 +1799,25 @@ static void rigidbody_update_sim_ob(
    */
 }
 
+typedef struct RigidBodyUpdateSimData {
+  Depsgraph *depsgraph;
+  Scene *scene;
+  RigidBodyWorld *rbw;
+  ListBase *effectors;
+  Object **objects;
+} RigidBodyUpdateSimData;
+
+static void rigidbody_update_sim_ob_cb(void *__restrict userdata,
+                                       const int i,
+                                       const TaskParallelTLS *__restrict UNUSED(tls))
+{
+  RigidBodyUpdateSimData *data = userdata;
+  Object *ob = data->objects[i];
+
+  rigidbody_update_sim_ob(
+      data->depsgraph, data->scene, data->rbw, data->effectors, ob, ob->rigidbody_object);
+}
+
 /**
  * Updates and validates world, bodies and shapes.
  *
@@ -1803,6 +1857,23 @@ static void rigidbody_update_simulation(Depsgraph *depsgraph,
     FOREACH_COLLECTION_OBJECT_RECURSIVE_END;
   }
 
+  /* Objects are validated one by one, since that adds and removes bodies of the world. Updating
+   * from the objects is done in parallel after, it only changes the bodies themselves. */
+  int objects_len = 0;
+  FOREACH_COLLECTION_OBJECT_RECURSIVE_BEGIN (rbw->group, ob) {
+    (void)ob;
+    objects_len++;
+  }
+  FOREACH_COLLECTION_OBJECT_RECURSIVE_END;
+
+  RigidBodyUpdateSimData data = {
+      .depsgraph = depsgraph,
+      .scene = scene,
+      .rbw = rbw,
+      .objects = MEM_mallocN(sizeof(Object *) * (size_t)max_ii(objects_len, 1), __func__),
+  };
+  int update_len = 0;
+
   /* update objects */
   FOREACH_COLLECTION_OBJECT_RECURSIVE_BEGIN (rbw->group, ob) {
     if (ob->type == OB_MESH) {
@@ -1851,12 +1922,24 @@ static void rigidbody_update_simulation(Depsgraph *depsgraph,
       }
       rbo->flag &= ~(RBO_FLAG_NEEDS_VALIDATE | RBO_FLAG_NEEDS_RESHAPE);
 
-      /* update simulation object... */
-      rigidbody_update_sim_ob(depsgraph, scene, rbw, ob, rbo);
+      data.objects[update_len++] = ob;
     }
   }
   FOREACH_COLLECTION_OBJECT_RECURSIVE_END;
 
+  /* Get effectors present in the group specified by effector_weights. Objects affected by them
+   * are no effectors themselves, so they can share the same list. */
+  data.effectors = BKE_effectors_create(depsgraph, NULL, NULL, rbw->effector_weights);
+
+  /* update simulation objects... */
+  TaskParallelSettings settings;
+  BLI_parallel_range_settings_defaults(&settings);
+  settings.min_iter_per_thread = 256;
+  BLI_task_parallel_range(0, update_len, &data, rigidbody_update_sim_ob_cb, &settings);
+
+  BKE_effectors_free(data.effectors);
+  MEM_freeN(data.objects);
+
   /* update constraints */
   if (rbw->constraints == NULL) { /* no constraints, move on */
     return;
@@ -55,10 +55,14 @@
 #include "DNA_object_types.h"
 #include "DNA_scene_types.h"
 
+#include "BLI_buffer.h"
 #include "BLI_ghash.h"
+#include "BLI_kdopbvh.h"
 #include "BLI_listbase.h"
 #include "BLI_math.h"
-#include "BLI_threads.h"
+#include "BLI_point_grid.h"
+#include "BLI_sort_utils.h"
+#include "BLI_task.h"
 #include "BLI_utildefines.h"
 
 #include "BKE_collection.h"
@@ -121,23 +125,10 @@ typedef struct SBScratch {
   int totface;
   float aabbmin[3], aabbmax[3];
   ReferenceState Ref;
+  /* Time spent in the parts of #softbody_calc_forces during a step, for monitoring. */
+  double time_springs, time_points, time_faces;
 } SBScratch;
 
-typedef struct SB_thread_context {
-  Scene *scene;
-  Object *ob;
-  float forcetime;
-  float timenow;
-  int ifirst;
-  int ilast;
-  ListBase *effectors;
-  int do_deflector;
-  float fieldfactor;
-  float windfactor;
-  int nr;
-  int tot;
-} SB_thread_context;
-
 #define MID_PRESERVE 1
 
 #define SOFTGOALSNAP 0.999f
@@ -275,11 +266,44 @@ typedef struct ccd_Mesh {
   const MVertTri *tri;
   int safety;
   ccdf_minmax *mima;
+  /* Tree of the face AABB's, so vertex collisions don't have to test every face. */
+  BVHTree *bvhtree;
   /* Axis Aligned Bounding Box AABB */
   float bbmin[3];
   float bbmax[3];
 } ccd_Mesh;
 
+static void ccd_mesh_update_bvhtree(ccd_Mesh *pccd_M)
+{
+  const bool rebuild = (pccd_M->bvhtree == NULL);
+  ccdf_minmax *mima;
+  int i;
+
+  if (rebuild) {
+    pccd_M->bvhtree = BLI_bvhtree_new(pccd_M->tri_num, 0.0f, 4, 6);
+  }
+
+  for (i = 0, mima = pccd_M->mima; i < pccd_M->tri_num; i++, mima++) {
+    const float co[2][3] = {
+        {mima->minx, mima->miny, mima->minz},
+        {mima->maxx, mima->maxy, mima->maxz},
+    };
+    if (rebuild) {
+      BLI_bvhtree_insert(pccd_M->bvhtree, i, co[0], 2);
+    }
+    else {
+      BLI_bvhtree_update_node(pccd_M->bvhtree, i, co[0], NULL, 2);
+    }
+  }
+
+  if (rebuild) {
+    BLI_bvhtree_balance(pccd_M->bvhtree);
+  }
+  else {
+    BLI_bvhtree_update_tree(pccd_M->bvhtree);
+  }
+}
+
 static ccd_Mesh *ccd_mesh_make(Object *ob)
 {
   CollisionModifierData *cmd;
@@ -306,6 +330,7 @@ static ccd_Mesh *ccd_mesh_make(Object *ob)
   pccd_M->bbmin[0] = pccd_M->bbmin[1] = pccd_M->bbmin[2] = 1e30f;
   pccd_M->bbmax[0] = pccd_M->bbmax[1] = pccd_M->bbmax[2] = -1e30f;
   pccd_M->mprevvert = NULL;
+  pccd_M->bvhtree = NULL;
 
   /* blow it up with forcefield ranges */
   hull = max_ff(ob->pd->pdef_sbift, ob->pd->pdef_sboft);
@@ -365,6 +390,8 @@ static ccd_Mesh *ccd_mesh_make(Object *ob)
     mima->maxz = max_ff(mima->maxz, v[2] + hull);
   }
 
+  ccd_mesh_update_bvhtree(pccd_M);
+
   return pccd_M;
 }
 static void ccd_mesh_update(Object *ob, ccd_Mesh *pccd_M)
@@ -485,6 +512,8 @@ static void ccd_mesh_update(Object *ob, ccd_Mesh *pccd_M)
     mima->maxy = max_ff(mima->maxy, v[1] + hull);
     mima->maxz = max_ff(mima->maxz, v[2] + hull);
   }
+
+  ccd_mesh_update_bvhtree(pccd_M);
 }
 
 static void ccd_mesh_free(ccd_Mesh *ccdm)
@@ -497,6 +526,7 @@ static void ccd_mesh_free(ccd_Mesh *ccdm)
       MEM_freeN((void *)ccdm->mprevvert);
     }
     MEM_freeN(ccdm->mima);
+    BLI_bvhtree_free(ccdm->bvhtree);
     MEM_freeN(ccdm);
     ccdm = NULL;
   }
@@ -1441,152 +1471,107 @@ static int sb_detect_edge_collisionCached(const float edge_v1[3],
   return deflected;
 }
 
-static void _scan_for_ext_spring_forces(
-    Scene *scene, Object *ob, float timenow, int ifirst, int ilast, struct ListBase *effectors)
+static void scan_for_ext_spring_force(
+    Scene *scene, Object *ob, float timenow, int a, struct ListBase *effectors)
 {
   SoftBody *sb = ob->soft;
-  int a;
   float damp;
   float feedback[3];
 
-  if (sb && sb->totspring) {
-    for (a = ifirst; a < ilast; a++) {
-      BodySpring *bs = &sb->bspring[a];
-      bs->ext_force[0] = bs->ext_force[1] = bs->ext_force[2] = 0.0f;
-      feedback[0] = feedback[1] = feedback[2] = 0.0f;
-      bs->flag &= ~BSF_INTERSECT;
+  BodySpring *bs = &sb->bspring[a];
+  bs->ext_force[0] = bs->ext_force[1] = bs->ext_force[2] = 0.0f;
+  feedback[0] = feedback[1] = feedback[2] = 0.0f;
+  bs->flag &= ~BSF_INTERSECT;
+
+  if (bs->springtype == SB_EDGE) {
+    /* +++ springs colliding */
+    if (ob->softflag & OB_SB_EDGECOLL) {
+      if (sb_detect_edge_collisionCached(
+              sb->bpoint[bs->v1].pos, sb->bpoint[bs->v2].pos, &damp, feedback, ob, timenow)) {
+        add_v3_v3(bs->ext_force, feedback);
+        bs->flag |= BSF_INTERSECT;
+        // bs->cf=damp;
+        bs->cf = sb->choke * 0.01f;
+      }
+    }
+    /* ---- springs colliding */
 
-      if (bs->springtype == SB_EDGE) {
-        /* +++ springs colliding */
-        if (ob->softflag & OB_SB_EDGECOLL) {
-          if (sb_detect_edge_collisionCached(
-                  sb->bpoint[bs->v1].pos, sb->bpoint[bs->v2].pos, &damp, feedback, ob, timenow)) {
-            add_v3_v3(bs->ext_force, feedback);
-            bs->flag |= BSF_INTERSECT;
-            // bs->cf=damp;
-            bs->cf = sb->choke * 0.01f;
-          }
-        }
-        /* ---- springs colliding */
-
-        /* +++ springs seeing wind ... n stuff depending on their orientation*/
-        /* note we don't use sb->mediafrict but use sb->aeroedge for magnitude of effect*/
-        if (sb->aeroedge) {
-          float vel[3], sp[3], pr[3], force[3];
-          float f, windfactor = 0.25f;
-          /*see if we have wind*/
-          if (effectors) {
-            EffectedPoint epoint;
-            float speed[3] = {0.0f, 0.0f, 0.0f};
-            float pos[3];
-            mid_v3_v3v3(pos, sb->bpoint[bs->v1].pos, sb->bpoint[bs->v2].pos);
-            mid_v3_v3v3(vel, sb->bpoint[bs->v1].vec, sb->bpoint[bs->v2].vec);
-            pd_point_from_soft(scene, pos, vel, -1, &epoint);
-            BKE_effectors_apply(
-                effectors, NULL, sb->effector_weights, &epoint, force, NULL, speed);
-
-            mul_v3_fl(speed, windfactor);
-            add_v3_v3(vel, speed);
-          }
-          /* media in rest */
-          else {
-            add_v3_v3v3(vel, sb->bpoint[bs->v1].vec, sb->bpoint[bs->v2].vec);
-          }
-          f = normalize_v3(vel);
-          f = -0.0001f * f * f * sb->aeroedge;
-          /* (todo) add a nice angle dependent function done for now BUT */
-          /* still there could be some nice drag/lift function, but who needs it */
-
-          sub_v3_v3v3(sp, sb->bpoint[bs->v1].pos, sb->bpoint[bs->v2].pos);
-          project_v3_v3v3(pr, vel, sp);
-          sub_v3_v3(vel, pr);
-          normalize_v3(vel);
-          if (ob->softflag & OB_SB_AERO_ANGLE) {
-            normalize_v3(sp);
-            madd_v3_v3fl(bs->ext_force, vel, f * (1.0f - fabsf(dot_v3v3(vel, sp))));
-          }
-          else {
-            madd_v3_v3fl(bs->ext_force, vel, f); /* to keep compatible with 2.45 release files */
-          }
-        }
-        /* --- springs seeing wind */
+    /* +++ springs seeing wind ... n stuff depending on their orientation*/
+    /* note we don't use sb->mediafrict but use sb->aeroedge for magnitude of effect*/
+    if (sb->aeroedge) {
+      float vel[3], sp[3], pr[3], force[3];
+      float f, windfactor = 0.25f;
+      /*see if we have wind*/
+      if (effectors) {
+        EffectedPoint epoint;
+        float speed[3] = {0.0f, 0.0f, 0.0f};
+        float pos[3];
+        mid_v3_v3v3(pos, sb->bpoint[bs->v1].pos, sb->bpoint[bs->v2].pos);
+        mid_v3_v3v3(vel, sb->bpoint[bs->v1].vec, sb->bpoint[bs->v2].vec);
+        pd_point_from_soft(scene, pos, vel, -1, &epoint);
+        BKE_effectors_apply(effectors, NULL, sb->effector_weights, &epoint, force, NULL, speed);
+
+        mul_v3_fl(speed, windfactor);
+        add_v3_v3(vel, speed);
+      }
+      /* media in rest */
+      else {
+        add_v3_v3v3(vel, sb->bpoint[bs->v1].vec, sb->bpoint[bs->v2].vec);
+      }
+      f = normalize_v3(vel);
+      f = -0.0001f * f * f * sb->aeroedge;
+      /* (todo) add a nice angle dependent function done for now BUT */
+      /* still there could be some nice drag/lift function, but who needs it */
+
+      sub_v3_v3v3(sp, sb->bpoint[bs->v1].pos, sb->bpoint[bs->v2].pos);
+      project_v3_v3v3(pr, vel, sp);
+      sub_v3_v3(vel, pr);
+      normalize_v3(vel);
+      if (ob->softflag & OB_SB_AERO_ANGLE) {
+        normalize_v3(sp);
+        madd_v3_v3fl(bs->ext_force, vel, f * (1.0f - fabsf(dot_v3v3(vel, sp))));
+      }
+      else {
+        madd_v3_v3fl(bs->ext_force, vel, f); /* to keep compatible with 2.45 release files */
       }
     }
+    /* --- springs seeing wind */
   }
 }
 
-static void *exec_scan_for_ext_spring_forces(void *data)
+typedef struct SoftbodySpringScanData {
+  Scene *scene;
+  Object *ob;
+  float timenow;
+  ListBase *effectors;
+} SoftbodySpringScanData;
+
+static void scan_for_ext_spring_forces_cb(void *__restrict userdata,
+                                          const int a,
+                                          const TaskParallelTLS *__restrict UNUSED(tls))
 {
-  SB_thread_context *pctx = (SB_thread_context *)data;
-  _scan_for_ext_spring_forces(
-      pctx->scene, pctx->ob, pctx->timenow, pctx->ifirst, pctx->ilast, pctx->effectors);
-  return NULL;
+  SoftbodySpringScanData *data = userdata;
+  scan_for_ext_spring_force(data->scene, data->ob, data->timenow, a, data->effectors);
 }
 
-static void sb_sfesf_threads_run(struct Depsgraph *depsgraph,
-                                 Scene *scene,
-                                 struct Object *ob,
-                                 float timenow,
-                                 int totsprings,
-                                 int *UNUSED(ptr_to_break_func(void)))
+static void scan_for_ext_spring_forces(
+    struct Depsgraph *depsgraph, Scene *scene, Object *ob, float timenow)
 {
-  ListBase threads;
-  SB_thread_context *sb_threads;
-  int i, totthread, left, dec;
-
-  /* wild guess .. may increase with better thread management 'above'
-   * or even be UI option sb->spawn_cf_threads_nopts */
-  int lowsprings = 100;
-
-  ListBase *effectors = BKE_effectors_create(depsgraph, ob, NULL, ob->soft->effector_weights);
-
-  /* figure the number of threads while preventing pretty pointless threading overhead */
-  totthread = BKE_scene_num_threads(scene);
-  /* what if we got zillions of CPUs running but less to spread*/
-  while ((totsprings / totthread < lowsprings) && (totthread > 1)) {
-    totthread--;
-  }
-
-  sb_threads = MEM_callocN(sizeof(SB_thread_context) * totthread, "SBSpringsThread");
-  memset(sb_threads, 0, sizeof(SB_thread_context) * totthread);
-  left = totsprings;
-  dec = totsprings / totthread + 1;
-  for (i = 0; i < totthread; i++) {
-    sb_threads[i].scene = scene;
-    sb_threads[i].ob = ob;
-    sb_threads[i].forcetime = 0.0; /* not used here */
-    sb_threads[i].timenow = timenow;
-    sb_threads[i].ilast = left;
-    left = left - dec;
-    if (left > 0) {
-      sb_threads[i].ifirst = left;
-    }
-    else {
-      sb_threads[i].ifirst = 0;
-    }
-    sb_threads[i].effectors = effectors;
-    sb_threads[i].do_deflector = false; /* not used here */
-    sb_threads[i].fieldfactor = 0.0f;   /* not used here */
-    sb_threads[i].windfactor = 0.0f;    /* not used here */
-    sb_threads[i].nr = i;
-    sb_threads[i].tot = totthread;
-  }
-  if (totthread > 1) {
-    BLI_threadpool_init(&threads, exec_scan_for_ext_spring_forces, totthread);
-
-    for (i = 0; i < totthread; i++) {
-      BLI_threadpool_insert(&threads, &sb_threads[i]);
-    }
+  SoftBody *sb = ob->soft;
+  SoftbodySpringScanData data = {
+      .scene = scene,
+      .ob = ob,
+      .timenow = timenow,
+      .effectors = BKE_effectors_create(depsgraph, ob, NULL, sb->effector_weights),
+  };
 
-    BLI_threadpool_end(&threads);
-  }
-  else {
-    exec_scan_for_ext_spring_forces(&sb_threads[0]);
-  }
-  /* clean up */
-  MEM_freeN(sb_threads);
+  /* Every spring only writes its own external force. */
+  TaskParallelSettings settings;
+  BLI_parallel_range_settings_defaults(&settings);
+  settings.min_iter_per_thread = 256;
+  BLI_task_parallel_range(0, sb->totspring, &data, scan_for_ext_spring_forces_cb, &settings);
 
-  BKE_effectors_free(effectors);
+  BKE_effectors_free(data.effectors);
 }
 
 /* --- the spring external section*/
@@ -1622,6 +1607,15 @@ static int choose_winner(
   return winner;
 }
 
+static void vertex_collision_tri_cb(void *userdata,
+                                    int index,
+                                    const float UNUSED(co[3]),
+                                    float UNUSED(dist_sq))
+{
+  BLI_Buffer *tri_index = userdata;
+  BLI_buffer_append(tri_index, int, index);
+}
+
 static int sb_detect_vertex_collisionCached(float opco[3],
                                             float facenormal[3],
                                             float *damp,
@@ -1640,6 +1634,7 @@ static int sb_detect_vertex_collisionCached(float opco[3],
       /* n_mag, */ /* UNUSED */ force_mag_norm, minx, miny, minz, maxx, maxy, maxz,
       innerfacethickness = -0.5f, outerfacethickness = 0.2f, ee = 5.0f, ff = 0.1f, fa = 1;
   int a, deflected = 0, cavel = 0, ci = 0;
+  BLI_buffer_declare_static(int, tri_index, BLI_BUFFER_NOP, 64);
   /* init */
   *intrusion = 0.0f;
   hash = vertexowner->soft->scratch->colliderhash;
@@ -1662,9 +1657,6 @@ static int sb_detect_vertex_collisionCached(float opco[3],
         if (ccdm) {
           mvert = ccdm->mvert;
           mprevvert = ccdm->mprevvert;
-          vt = ccdm->tri;
-          mima = ccdm->mima;
-          a = ccdm->tri_num;
 
           minx = ccdm->bbmin[0];
           miny = ccdm->bbmin[1];
@@ -1696,12 +1688,22 @@ static int sb_detect_vertex_collisionCached(float opco[3],
         fa *= fa;
         fa = 1.0f / fa;
         avel[0] = avel[1] = avel[2] = 0.0f;
+
+        /* Only visit faces with an AABB around the vertex, in the order of the faces, so the
+         * result matches testing all faces. */
+        BLI_buffer_clear(&tri_index);
+        BLI_bvhtree_range_query(
+            ccdm->bvhtree, opco, FLT_EPSILON, vertex_collision_tri_cb, &tri_index);
+        if (tri_index.count > 1) {
+          qsort(tri_index.data, tri_index.count, sizeof(int), BLI_sortutil_cmp_int);
+        }
+
         /* use mesh*/
-        while (a--) {
+        for (a = 0; a < tri_index.count; a++) {
+          mima = &ccdm->mima[BLI_buffer_at(&tri_index, int, a)];
+          vt = &ccdm->tri[BLI_buffer_at(&tri_index, int, a)];
           if ((opco[0] < mima->minx) || (opco[0] > mima->maxx) || (opco[1] < mima->miny) ||
               (opco[1] > mima->maxy) || (opco[2] < mima->minz) || (opco[2] > mima->maxz)) {
-            mima++;
-            vt++;
             continue;
           }
 
@@ -1771,10 +1773,7 @@ static int sb_detect_vertex_collisionCached(float opco[3],
               ci++;
             }
           }
-
-          mima++;
-          vt++;
-        } /* while a */
+        } /* for a */
       }   /* if (ob->pd && ob->pd->deflect) */
       BLI_ghashIterator_step(ihash);
     }
@@ -1800,6 +1799,7 @@ static int sb_detect_vertex_collisionCached(float opco[3],
   }
 
   BLI_ghashIterator_free(ihash);
+  BLI_buffer_free(&tri_index);
   if (cavel) {
     mul_v3_fl(avel, 1.0f / (float)cavel);
   }
@@ -1877,39 +1877,15 @@ static void dfdv_goal(int ia, int ic, float factor)
 }
 #endif /* if 0 */
 
-static void sb_spring_force(
-    Object *ob, int bpi, BodySpring *bs, float iks, float UNUSED(forcetime))
+/* Force of the spring on its first point, the second point gets the opposite force. */
+static void sb_spring_force(Object *ob, BodySpring *bs, float r_force[3])
 {
   SoftBody *sb = ob->soft; /* is supposed to be there */
-  BodyPoint *bp1, *bp2;
+  BodyPoint *bp1 = &sb->bpoint[bs->v1];
+  BodyPoint *bp2 = &sb->bpoint[bs->v2];
 
   float dir[3], dvel[3];
-  float distance, forcefactor, kd, absvel, projvel, kw;
-#if 0 /* UNUSED */
-  int ia, ic;
-#endif
-  /* prepare depending on which side of the spring we are on */
-  if (bpi == bs->v1) {
-    bp1 = &sb->bpoint[bs->v1];
-    bp2 = &sb->bpoint[bs->v2];
-#if 0 /* UNUSED */
-    ia = 3 * bs->v1;
-    ic = 3 * bs->v2;
-#endif
-  }
-  else if (bpi == bs->v2) {
-    bp1 = &sb->bpoint[bs->v2];
-    bp2 = &sb->bpoint[bs->v1];
-#if 0 /* UNUSED */
-    ia = 3 * bs->v2;
-    ic = 3 * bs->v1;
-#endif
-  }
-  else {
-    /* TODO make this debug option */
-    CLOG_WARN(&LOG, "bodypoint <bpi> is not attached to spring  <*bs>");
-    return;
-  }
+  float distance, forcefactor, kd, absvel, projvel, kw, iks;
 
   /* do bp1 <--> bp2 elastic */
   sub_v3_v3v3(dir, bp1->pos, bp2->pos);
@@ -1945,7 +1921,7 @@ static void sb_spring_force(
       break;
   }
 
-  madd_v3_v3fl(bp1->force, dir, (bs->len - distance) * forcefactor);
+  mul_v3_v3fl(r_force, dir, (bs->len - distance) * forcefactor);
 
   /* do bp1 <--> bp2 viscous */
   sub_v3_v3v3(dvel, bp1->vec, bp2->vec);
@@ -1953,318 +1929,269 @@ static void sb_spring_force(
   absvel = normalize_v3(dvel);
   projvel = dot_v3v3(dir, dvel);
   kd *= absvel * projvel;
-  madd_v3_v3fl(bp1->force, dir, -kd);
+  madd_v3_v3fl(r_force, dir, -kd);
 }
 
-/* since this is definitely the most CPU consuming task here .. try to spread it */
-/* core function _softbody_calc_forces_slice_in_a_thread */
-/* result is int to be able to flag user break */
-static int _softbody_calc_forces_slice_in_a_thread(Scene *scene,
-                                                   Object *ob,
-                                                   float forcetime,
-                                                   float timenow,
-                                                   int ifirst,
-                                                   int ilast,
-                                                   int *UNUSED(ptr_to_break_func(void)),
-                                                   ListBase *effectors,
-                                                   int do_deflector,
-                                                   float fieldfactor,
-                                                   float windfactor)
-{
-  float iks;
-  int bb, do_selfcollision, do_springcollision, do_aero;
-  int number_of_points_here = ilast - ifirst;
-  SoftBody *sb = ob->soft; /* is supposed to be there */
-  BodyPoint *bp;
+typedef struct SoftbodyForceData {
+  Scene *scene;
+  Object *ob;
+  float forcetime;
+  float timenow;
+  ListBase *effectors;
+  int do_deflector;
+  int do_selfcollision;
+  int do_springcollision;
+  int do_aero;
+  float fieldfactor;
+  float windfactor;
 
-  /* initialize */
-  if (sb) {
-    /* check conditions for various options */
-    /* +++ could be done on object level to squeeze out the last bits of it */
-    do_selfcollision = ((ob->softflag & OB_SB_EDGES) && (sb->bspring) &&
-                        (ob->softflag & OB_SB_SELF));
-    do_springcollision = do_deflector && (ob->softflag & OB_SB_EDGES) &&
-                         (ob->softflag & OB_SB_EDGECOLL);
-    do_aero = ((sb->aeroedge) && (ob->softflag & OB_SB_EDGES));
-    /* --- could be done on object level to squeeze out the last bits of it */
-  }
-  else {
-    CLOG_ERROR(&LOG, "expected a SB here");
-    return 999;
-  }
-
-  /* debugerin */
-  if (sb->totpoint < ifirst) {
-    printf("Aye 998");
-    return 998;
-  }
-  /* debugerin */
-
-  bp = &sb->bpoint[ifirst];
-  for (bb = number_of_points_here; bb > 0; bb--, bp++) {
-    /* clear forces  accumulator */
-    bp->force[0] = bp->force[1] = bp->force[2] = 0.0;
-    /* naive ball self collision */
-    /* needs to be done if goal snaps or not */
-    if (do_selfcollision) {
-      int attached;
-      BodyPoint *obp;
-      BodySpring *bs;
-      int c, b;
-      float velcenter[3], dvel[3], def[3];
-      float distance;
-      float compare;
-      float bstune = sb->ballstiff;
-
-      /* Running in a slice we must not assume anything done with obp
-       * neither alter the data of obp. */
-      for (c = sb->totpoint, obp = sb->bpoint; c > 0; c--, obp++) {
-        compare = (obp->colball + bp->colball);
-        sub_v3_v3v3(def, bp->pos, obp->pos);
-        /* rather check the AABBoxes before ever calculating the real distance */
-        /* mathematically it is completely nuts, but performance is pretty much (3) times faster */
-        if ((fabsf(def[0]) > compare) || (fabsf(def[1]) > compare) || (fabsf(def[2]) > compare)) {
-          continue;
-        }
-        distance = normalize_v3(def);
-        if (distance < compare) {
-          /* exclude body points attached with a spring */
-          attached = 0;
-          for (b = obp->nofsprings; b > 0; b--) {
-            bs = sb->bspring + obp->springs[b - 1];
-            if ((ilast - bb == bs->v2) || (ilast - bb == bs->v1)) {
-              attached = 1;
-              continue;
-            }
-          }
-          if (!attached) {
-            float f = bstune / (distance) + bstune / (compare * compare) * distance -
-                      2.0f * bstune / compare;
+  /* Force of every spring on its first point, see #sb_spring_force. */
+  float (*spring_force)[3];
 
-            mid_v3_v3v3(velcenter, bp->vec, obp->vec);
-            sub_v3_v3v3(dvel, velcenter, bp->vec);
-            mul_v3_fl(dvel, _final_mass(ob, bp));
+  /* Force and speed of the effectors at every point. */
+  float (*effector_force)[3];
+  float (*effector_speed)[3];
 
-            madd_v3_v3fl(bp->force, def, f * (1.0f - sb->balldamp));
-            madd_v3_v3fl(bp->force, dvel, sb->balldamp);
-          }
-        }
+  /* Points for the self collision, and the largest collision ball. */
+  PointGrid *point_grid;
+  float colball_max;
+} SoftbodyForceData;
+
+typedef struct SoftbodyForceTLS {
+  bool do_fuzzy;
+} SoftbodyForceTLS;
+
+static void softbody_calc_spring_forces_cb(void *__restrict userdata,
+                                           const int a,
+                                           const TaskParallelTLS *__restrict UNUSED(tls))
+{
+  SoftbodyForceData *data = userdata;
+  sb_spring_force(data->ob, &data->ob->soft->bspring[a], data->spring_force[a]);
+}
+
+typedef struct SoftbodySelfCollisionData {
+  Object *ob;
+  BodyPoint *bp;
+  int bp_index;
+} SoftbodySelfCollisionData;
+
+static void softbody_self_collision_cb(void *userdata,
+                                       int index,
+                                       const float UNUSED(co[3]),
+                                       float UNUSED(dist_sq))
+{
+  SoftbodySelfCollisionData *data = userdata;
+  Object *ob = data->ob;
+  SoftBody *sb = ob->soft;
+  BodyPoint *bp = data->bp;
+  BodyPoint *obp = &sb->bpoint[index];
+  BodySpring *bs;
+  float velcenter[3], dvel[3], def[3];
+  float distance;
+  float compare = (obp->colball + bp->colball);
+  float bstune = sb->ballstiff;
+  int attached, b;
+
+  /* Running in parallel we must not assume anything done with obp
+   * neither alter the data of obp. */
+  sub_v3_v3v3(def, bp->pos, obp->pos);
+  distance = normalize_v3(def);
+  if (distance < compare) {
+    /* exclude body points attached with a spring */
+    attached = 0;
+    for (b = obp->nofsprings; b > 0; b--) {
+      bs = sb->bspring + obp->springs[b - 1];
+      if ((data->bp_index == bs->v2) || (data->bp_index == bs->v1)) {
+        attached = 1;
+        continue;
       }
     }
-    /* naive ball self collision done */
-
-    if (_final_goal(ob, bp) < SOFTGOALSNAP) { /* omit this bp when it snaps */
-      float auxvect[3];
-      float velgoal[3];
-
-      /* do goal stuff */
-      if (ob->softflag & OB_SB_GOAL) {
-        /* true elastic goal */
-        float ks, kd;
-        sub_v3_v3v3(auxvect, bp->pos, bp->origT);
-        ks = 1.0f / (1.0f - _final_goal(ob, bp) * sb->goalspring) - 1.0f;
-        bp->force[0] += -ks * (auxvect[0]);
-        bp->force[1] += -ks * (auxvect[1]);
-        bp->force[2] += -ks * (auxvect[2]);
-
-        /* calculate damping forces generated by goals*/
-        sub_v3_v3v3(velgoal, bp->origS, bp->origE);
-        kd = sb->goalfrict * sb_fric_force_scale(ob);
-        add_v3_v3v3(auxvect, velgoal, bp->vec);
-
-        if (forcetime >
-            0.0f) { /* make sure friction does not become rocket motor on time reversal */
-          bp->force[0] -= kd * (auxvect[0]);
-          bp->force[1] -= kd * (auxvect[1]);
-          bp->force[2] -= kd * (auxvect[2]);
-        }
-        else {
-          bp->force[0] -= kd * (velgoal[0] - bp->vec[0]);
-          bp->force[1] -= kd * (velgoal[1] - bp->vec[1]);
-          bp->force[2] -= kd * (velgoal[2] - bp->vec[2]);
-        }
-      }
-      /* done goal stuff */
+    if (!attached) {
+      float f = bstune / (distance) + bstune / (compare * compare) * distance -
+                2.0f * bstune / compare;
 
-      /* gravitation */
-      if (scene->physics_settings.flag & PHYS_GLOBAL_GRAVITY) {
-        float gravity[3];
-        copy_v3_v3(gravity, scene->physics_settings.gravity);
+      mid_v3_v3v3(velcenter, bp->vec, obp->vec);
+      sub_v3_v3v3(dvel, velcenter, bp->vec);
+      mul_v3_fl(dvel, _final_mass(ob, bp));
 
-        /* Individual mass of node here. */
-        mul_v3_fl(gravity,
-                  sb_grav_force_scale(ob) * _final_mass(ob, bp) *
-                      sb->effector_weights->global_gravity);
+      madd_v3_v3fl(bp->force, def, f * (1.0f - sb->balldamp));
+      madd_v3_v3fl(bp->force, dvel, sb->balldamp);
+    }
+  }
+}
 
-        add_v3_v3(bp->force, gravity);
+/* since this is definitely the most CPU consuming task here .. try to spread it */
+static void softbody_calc_point_forces_cb(void *__restrict userdata,
+                                          const int bp_index,
+                                          const TaskParallelTLS *__restrict tls)
+{
+  SoftbodyForceData *data = userdata;
+  SoftbodyForceTLS *force_tls = tls->userdata_chunk;
+  Scene *scene = data->scene;
+  Object *ob = data->ob;
+  SoftBody *sb = ob->soft; /* is supposed to be there */
+  BodyPoint *bp = &sb->bpoint[bp_index];
+  const float forcetime = data->forcetime;
+
+  /* clear forces  accumulator */
+  bp->force[0] = bp->force[1] = bp->force[2] = 0.0;
+  /* ball self collision */
+  /* needs to be done if goal snaps or not */
+  if (data->do_selfcollision) {
+    SoftbodySelfCollisionData self_data = {
+        .ob = ob,
+        .bp = bp,
+        .bp_index = bp_index,
+    };
+    BLI_point_grid_range_query(data->point_grid,
+                               bp->pos,
+                               bp->colball + data->colball_max,
+                               softbody_self_collision_cb,
+                               &self_data);
+  }
+  /* ball self collision done */
+
+  if (_final_goal(ob, bp) < SOFTGOALSNAP) { /* omit this bp when it snaps */
+    float auxvect[3];
+    float velgoal[3];
+
+    /* do goal stuff */
+    if (ob->softflag & OB_SB_GOAL) {
+      /* true elastic goal */
+      float ks, kd;
+      sub_v3_v3v3(auxvect, bp->pos, bp->origT);
+      ks = 1.0f / (1.0f - _final_goal(ob, bp) * sb->goalspring) - 1.0f;
+      bp->force[0] += -ks * (auxvect[0]);
+      bp->force[1] += -ks * (auxvect[1]);
+      bp->force[2] += -ks * (auxvect[2]);
+
+      /* calculate damping forces generated by goals*/
+      sub_v3_v3v3(velgoal, bp->origS, bp->origE);
+      kd = sb->goalfrict * sb_fric_force_scale(ob);
+      add_v3_v3v3(auxvect, velgoal, bp->vec);
+
+      if (forcetime >
+          0.0f) { /* make sure friction does not become rocket motor on time reversal */
+        bp->force[0] -= kd * (auxvect[0]);
+        bp->force[1] -= kd * (auxvect[1]);
+        bp->force[2] -= kd * (auxvect[2]);
       }
+      else {
+        bp->force[0] -= kd * (velgoal[0] - bp->vec[0]);
+        bp->force[1] -= kd * (velgoal[1] - bp->vec[1]);
+        bp->force[2] -= kd * (velgoal[2] - bp->vec[2]);
+      }
+    }
+    /* done goal stuff */
 
-      /* particle field & vortex */
-      if (effectors) {
-        EffectedPoint epoint;
-        float kd;
-        float force[3] = {0.0f, 0.0f, 0.0f};
-        float speed[3] = {0.0f, 0.0f, 0.0f};
+    /* gravitation */
+    if (scene->physics_settings.flag & PHYS_GLOBAL_GRAVITY) {
+      float gravity[3];
+      copy_v3_v3(gravity, scene->physics_settings.gravity);
 
-        /* just for calling function once */
-        float eval_sb_fric_force_scale = sb_fric_force_scale(ob);
+      /* Individual mass of node here. */
+      mul_v3_fl(gravity,
+                sb_grav_force_scale(ob) * _final_mass(ob, bp) *
+                    sb->effector_weights->global_gravity);
 
-        pd_point_from_soft(scene, bp->pos, bp->vec, sb->bpoint - bp, &epoint);
-        BKE_effectors_apply(effectors, NULL, sb->effector_weights, &epoint, force, NULL, speed);
+      add_v3_v3(bp->force, gravity);
+    }
 
-        /* apply forcefield*/
-        mul_v3_fl(force, fieldfactor * eval_sb_fric_force_scale);
-        add_v3_v3(bp->force, force);
+    /* particle field & vortex */
+    if (data->effectors) {
+      float kd;
+      float force[3], speed[3];
 
-        /* BP friction in moving media */
-        kd = sb->mediafrict * eval_sb_fric_force_scale;
-        bp->force[0] -= kd * (bp->vec[0] + windfactor * speed[0] / eval_sb_fric_force_scale);
-        bp->force[1] -= kd * (bp->vec[1] + windfactor * speed[1] / eval_sb_fric_force_scale);
-        bp->force[2] -= kd * (bp->vec[2] + windfactor * speed[2] / eval_sb_fric_force_scale);
-        /* now we'll have nice centrifugal effect for vortex */
-      }
-      else {
-        /* BP friction in media (not) moving*/
-        float kd = sb->mediafrict * sb_fric_force_scale(ob);
-        /* assume it to be proportional to actual velocity */
-        bp->force[0] -= bp->vec[0] * kd;
-        bp->force[1] -= bp->vec[1] * kd;
-        bp->force[2] -= bp->vec[2] * kd;
-        /* friction in media done */
-      }
-      /* +++cached collision targets */
-      bp->choke = 0.0f;
-      bp->choke2 = 0.0f;
-      bp->loc_flag &= ~SBF_DOFUZZY;
-      if (do_deflector && !(bp->loc_flag & SBF_OUTOFCOLLISION)) {
-        float cfforce[3], defforce[3] = {0.0f, 0.0f, 0.0f}, vel[3] = {0.0f, 0.0f, 0.0f},
-                          facenormal[3], cf = 1.0f, intrusion;
-        float kd = 1.0f;
-
-        if (sb_deflect_face(ob, bp->pos, facenormal, defforce, &cf, timenow, vel, &intrusion)) {
-          if (intrusion < 0.0f) {
-            sb->scratch->flag |= SBF_DOFUZZY;
-            bp->loc_flag |= SBF_DOFUZZY;
-            bp->choke = sb->choke * 0.01f;
-          }
+      /* just for calling function once */
+      float eval_sb_fric_force_scale = sb_fric_force_scale(ob);
+      const float windfactor = data->windfactor;
 
-          sub_v3_v3v3(cfforce, bp->vec, vel);
-          madd_v3_v3fl(bp->force, cfforce, -cf * 50.0f);
+      copy_v3_v3(force, data->effector_force[bp_index]);
+      copy_v3_v3(speed, data->effector_speed[bp_index]);
 
-          madd_v3_v3fl(bp->force, defforce, kd);
-        }
-      }
-      /* ---cached collision targets */
-
-      /* +++springs */
-      iks = 1.0f / (1.0f - sb->inspring) - 1.0f; /* inner spring constants function */
-      if (ob->softflag & OB_SB_EDGES) {
-        if (sb->bspring) { /* spring list exists at all ? */
-          int b;
-          BodySpring *bs;
-          for (b = bp->nofsprings; b > 0; b--) {
-            bs = sb->bspring + bp->springs[b - 1];
-            if (do_springcollision || do_aero) {
-              add_v3_v3(bp->force, bs->ext_force);
-              if (bs->flag & BSF_INTERSECT) {
-                bp->choke = bs->cf;
-              }
-            }
-            // sb_spring_force(Object *ob, int bpi, BodySpring *bs, float iks, float forcetime)
-            sb_spring_force(ob, ilast - bb, bs, iks, forcetime);
-          } /* loop springs */
-        }   /* existing spring list */
-      }     /*any edges*/
-      /* ---springs */
-    }       /*omit on snap */
-  }         /*loop all bp's*/
-  return 0; /*done fine*/
-}
-
-static void *exec_softbody_calc_forces(void *data)
-{
-  SB_thread_context *pctx = (SB_thread_context *)data;
-  _softbody_calc_forces_slice_in_a_thread(pctx->scene,
-                                          pctx->ob,
-                                          pctx->forcetime,
-                                          pctx->timenow,
-                                          pctx->ifirst,
-                                          pctx->ilast,
-                                          NULL,
-                                          pctx->effectors,
-                                          pctx->do_deflector,
-                                          pctx->fieldfactor,
-                                          pctx->windfactor);
-  return NULL;
-}
-
-static void sb_cf_threads_run(Scene *scene,
-                              Object *ob,
-                              float forcetime,
-                              float timenow,
-                              int totpoint,
-                              int *UNUSED(ptr_to_break_func(void)),
-                              struct ListBase *effectors,
-                              int do_deflector,
-                              float fieldfactor,
-                              float windfactor)
-{
-  ListBase threads;
-  SB_thread_context *sb_threads;
-  int i, totthread, left, dec;
-
-  /* wild guess .. may increase with better thread management 'above'
-   * or even be UI option sb->spawn_cf_threads_nopts. */
-  int lowpoints = 100;
-
-  /* figure the number of threads while preventing pretty pointless threading overhead */
-  totthread = BKE_scene_num_threads(scene);
-  /* what if we got zillions of CPUs running but less to spread*/
-  while ((totpoint / totthread < lowpoints) && (totthread > 1)) {
-    totthread--;
-  }
-
-  /* printf("sb_cf_threads_run spawning %d threads\n", totthread); */
-
-  sb_threads = MEM_callocN(sizeof(SB_thread_context) * totthread, "SBThread");
-  memset(sb_threads, 0, sizeof(SB_thread_context) * totthread);
-  left = totpoint;
-  dec = totpoint / totthread + 1;
-  for (i = 0; i < totthread; i++) {
-    sb_threads[i].scene = scene;
-    sb_threads[i].ob = ob;
-    sb_threads[i].forcetime = forcetime;
-    sb_threads[i].timenow = timenow;
-    sb_threads[i].ilast = left;
-    left = left - dec;
-    if (left > 0) {
-      sb_threads[i].ifirst = left;
+      /* apply forcefield*/
+      mul_v3_fl(force, data->fieldfactor * eval_sb_fric_force_scale);
+      add_v3_v3(bp->force, force);
+
+      /* BP friction in moving media */
+      kd = sb->mediafrict * eval_sb_fric_force_scale;
+      bp->force[0] -= kd * (bp->vec[0] + windfactor * speed[0] / eval_sb_fric_force_scale);
+      bp->force[1] -= kd * (bp->vec[1] + windfactor * speed[1] / eval_sb_fric_force_scale);
+      bp->force[2] -= kd * (bp->vec[2] + windfactor * speed[2] / eval_sb_fric_force_scale);
+      /* now we'll have nice centrifugal effect for vortex */
     }
     else {
-      sb_threads[i].ifirst = 0;
-    }
-    sb_threads[i].effectors = effectors;
-    sb_threads[i].do_deflector = do_deflector;
-    sb_threads[i].fieldfactor = fieldfactor;
-    sb_threads[i].windfactor = windfactor;
-    sb_threads[i].nr = i;
-    sb_threads[i].tot = totthread;
-  }
+      /* BP friction in media (not) moving*/
+      float kd = sb->mediafrict * sb_fric_force_scale(ob);
+      /* assume it to be proportional to actual velocity */
+      bp->force[0] -= bp->vec[0] * kd;
+      bp->force[1] -= bp->vec[1] * kd;
+      bp->force[2] -= bp->vec[2] * kd;
+      /* friction in media done */
+    }
+    /* +++cached collision targets */
+    bp->choke = 0.0f;
+    bp->choke2 = 0.0f;
+    bp->loc_flag &= ~SBF_DOFUZZY;
+    if (data->do_deflector && !(bp->loc_flag & SBF_OUTOFCOLLISION)) {
+      float cfforce[3], defforce[3] = {0.0f, 0.0f, 0.0f}, vel[3] = {0.0f, 0.0f, 0.0f},
+                        facenormal[3], cf = 1.0f, intrusion;
+      float kd = 1.0f;
+
+      if (sb_deflect_face(
+              ob, bp->pos, facenormal, defforce, &cf, data->timenow, vel, &intrusion)) {
+        if (intrusion < 0.0f) {
+          force_tls->do_fuzzy = true;
+          bp->loc_flag |= SBF_DOFUZZY;
+          bp->choke = sb->choke * 0.01f;
+        }
 
-  if (totthread > 1) {
-    BLI_threadpool_init(&threads, exec_softbody_calc_forces, totthread);
+        sub_v3_v3v3(cfforce, bp->vec, vel);
+        madd_v3_v3fl(bp->force, cfforce, -cf * 50.0f);
 
-    for (i = 0; i < totthread; i++) {
-      BLI_threadpool_insert(&threads, &sb_threads[i]);
+        madd_v3_v3fl(bp->force, defforce, kd);
+      }
     }
+    /* ---cached collision targets */
 
-    BLI_threadpool_end(&threads);
-  }
-  else {
-    exec_softbody_calc_forces(&sb_threads[0]);
-  }
-  /* clean up */
-  MEM_freeN(sb_threads);
+    /* +++springs */
+    if (data->spring_force) {
+      int b;
+      BodySpring *bs;
+      for (b = bp->nofsprings; b > 0; b--) {
+        const int spring_index = bp->springs[b - 1];
+        bs = sb->bspring + spring_index;
+        if (data->do_springcollision || data->do_aero) {
+          add_v3_v3(bp->force, bs->ext_force);
+          if (bs->flag & BSF_INTERSECT) {
+            bp->choke = bs->cf;
+          }
+        }
+        /* Every point only gathers the forces of its own springs, so nothing is written by
+         * more than one thread. */
+        if (bp_index == bs->v1) {
+          add_v3_v3(bp->force, data->spring_force[spring_index]);
+        }
+        else if (bp_index == bs->v2) {
+          sub_v3_v3(bp->force, data->spring_force[spring_index]);
+        }
+        else {
+          /* TODO make this debug option */
+          CLOG_WARN(&LOG, "bodypoint <bpi> is not attached to spring  <*bs>");
+        }
+      } /* loop springs */
+    }   /* existing spring list */
+    /* ---springs */
+  } /*omit on snap */
+}
+
+static void softbody_calc_point_forces_reduce(const void *__restrict UNUSED(userdata),
+                                              void *__restrict chunk_join,
+                                              void *__restrict chunk)
+{
+  SoftbodyForceTLS *join = chunk_join;
+  const SoftbodyForceTLS *force_tls = chunk;
+  join->do_fuzzy |= force_tls->do_fuzzy;
 }
 
 static void softbody_calc_forces(
@@ -2274,56 +2201,125 @@ static void softbody_calc_forces(
    * this will ruin adaptive stepsize AKA heun! (BM)
    */
   SoftBody *sb = ob->soft; /* is supposed to be there */
-  /*BodyPoint *bproot;*/   /* UNUSED */
-  /* float gravity; */     /* UNUSED */
-  /* float iks; */
-  float fieldfactor = -1.0f, windfactor = 0.25;
-  int do_deflector /*, do_selfcollision*/, do_springcollision, do_aero;
-
-  /* gravity = sb->grav * sb_grav_force_scale(ob); */ /* UNUSED */
+  SBScratch *scratch = sb->scratch;
+  SoftbodyForceData data = {
+      .scene = scene,
+      .ob = ob,
+      .forcetime = forcetime,
+      .timenow = timenow,
+      .fieldfactor = -1.0f,
+      .windfactor = 0.25f,
+  };
+  double start;
 
   /* check conditions for various options */
-  do_deflector = query_external_colliders(depsgraph, sb->collision_group);
-#if 0
-  do_selfcollision=((ob->softflag & OB_SB_EDGES) && (sb->bspring)&& (ob->softflag & OB_SB_SELF));
-#endif
-  do_springcollision = do_deflector && (ob->softflag & OB_SB_EDGES) &&
-                       (ob->softflag & OB_SB_EDGECOLL);
-  do_aero = ((sb->aeroedge) && (ob->softflag & OB_SB_EDGES));
+  data.do_deflector = query_external_colliders(depsgraph, sb->collision_group);
+  data.do_selfcollision = ((ob->softflag & OB_SB_EDGES) && (sb->bspring) &&
+                           (ob->softflag & OB_SB_SELF));
+  data.do_springcollision = data.do_deflector && (ob->softflag & OB_SB_EDGES) &&
+                            (ob->softflag & OB_SB_EDGECOLL);
+  data.do_aero = ((sb->aeroedge) && (ob->softflag & OB_SB_EDGES));
+
+  TaskParallelSettings settings;
+
+  start = PIL_check_seconds_timer();
+  if (data.do_springcollision || data.do_aero) {
+    scan_for_ext_spring_forces(depsgraph, scene, ob, timenow);
+  }
 
-  /* iks  = 1.0f/(1.0f-sb->inspring)-1.0f; */ /* inner spring constants function */ /* UNUSED */
-  /* bproot= sb->bpoint; */ /* need this for proper spring addressing */            /* UNUSED */
+  /* Springs are evaluated once instead of from both of their points. */
+  if ((ob->softflag & OB_SB_EDGES) && sb->bspring) {
+    data.spring_force = MEM_mallocN(sizeof(*data.spring_force) * sb->totspring, __func__);
 
-  if (do_springcollision || do_aero) {
-    sb_sfesf_threads_run(depsgraph, scene, ob, timenow, sb->totspring, NULL);
+    BLI_parallel_range_settings_defaults(&settings);
+    settings.min_iter_per_thread = 1024;
+    BLI_task_parallel_range(0, sb->totspring, &data, softbody_calc_spring_forces_cb, &settings);
   }
+  scratch->time_springs += PIL_check_seconds_timer() - start;
 
+  start = PIL_check_seconds_timer();
   /* after spring scan because it uses Effoctors too */
-  ListBase *effectors = BKE_effectors_create(depsgraph, ob, NULL, sb->effector_weights);
+  data.effectors = BKE_effectors_create(depsgraph, ob, NULL, sb->effector_weights);
+
+  if (data.effectors) {
+    /* Evaluate the effectors for all points at once. */
+    float(*pos)[3] = MEM_mallocN(sizeof(*pos) * sb->totpoint * 2, __func__);
+    float(*vec)[3] = pos + sb->totpoint;
+    BodyPoint *bp;
+    int a;
 
-  if (do_deflector) {
+    for (a = 0, bp = sb->bpoint; a < sb->totpoint; a++, bp++) {
+      copy_v3_v3(pos[a], bp->pos);
+      copy_v3_v3(vec[a], bp->vec);
+    }
+
+    data.effector_force = MEM_callocN(sizeof(*data.effector_force) * sb->totpoint * 2, __func__);
+    data.effector_speed = data.effector_force + sb->totpoint;
+
+    EffectedPoints epoints;
+    pd_points_from_soft(
+        scene, (const float(*)[3])pos, (const float(*)[3])vec, sb->totpoint, &epoints);
+    BKE_effectors_apply_points(data.effectors,
+                               NULL,
+                               sb->effector_weights,
+                               &epoints,
+                               data.effector_force,
+                               NULL,
+                               data.effector_speed);
+    MEM_freeN(pos);
+  }
+
+  if (data.do_deflector) {
     float defforce[3];
-    do_deflector = sb_detect_aabb_collisionCached(defforce, ob, timenow);
+    data.do_deflector = sb_detect_aabb_collisionCached(defforce, ob, timenow);
   }
 
-  sb_cf_threads_run(scene,
-                    ob,
-                    forcetime,
-                    timenow,
-                    sb->totpoint,
-                    NULL,
-                    effectors,
-                    do_deflector,
-                    fieldfactor,
-                    windfactor);
+  if (data.do_selfcollision) {
+    BodyPoint *bp;
+    int a;
+
+    for (a = sb->totpoint, bp = sb->bpoint; a > 0; a--, bp++) {
+      data.colball_max = max_ff(data.colball_max, bp->colball);
+    }
+
+    /* Points only collide within twice the largest ball. */
+    if (data.colball_max > 0.0f) {
+      data.point_grid = BLI_point_grid_new(sb->totpoint, 2.0f * data.colball_max);
+      for (a = 0, bp = sb->bpoint; a < sb->totpoint; a++, bp++) {
+        BLI_point_grid_insert(data.point_grid, a, bp->pos);
+      }
+      BLI_point_grid_balance(data.point_grid);
+    }
+    else {
+      data.do_selfcollision = false;
+    }
+  }
+
+  SoftbodyForceTLS force_tls = {false};
+  BLI_parallel_range_settings_defaults(&settings);
+  settings.min_iter_per_thread = 64;
+  settings.userdata_chunk = &force_tls;
+  settings.userdata_chunk_size = sizeof(force_tls);
+  settings.func_reduce = softbody_calc_point_forces_reduce;
+  BLI_task_parallel_range(0, sb->totpoint, &data, softbody_calc_point_forces_cb, &settings);
+
+  if (force_tls.do_fuzzy) {
+    scratch->flag |= SBF_DOFUZZY;
+  }
+  scratch->time_points += PIL_check_seconds_timer() - start;
 
   /* finally add forces caused by face collision */
   if (ob->softflag & OB_SB_FACECOLL) {
+    start = PIL_check_seconds_timer();
     scan_for_ext_face_forces(ob, timenow);
+    scratch->time_faces += PIL_check_seconds_timer() - start;
   }
 
   /* finish matrix and solve */
-  BKE_effectors_free(effectors);
+  BKE_effectors_free(data.effectors);
+  BLI_point_grid_free(data.point_grid);
+  MEM_SAFE_FREE(data.spring_force);
+  MEM_SAFE_FREE(data.effector_force);
 }
 
 static void softbody_apply_forces(Object *ob, float forcetime, int mode, float *err, int mid_flags)
@@ -3377,6 +3373,7 @@ static void softbody_step(
   double sct, sst;
 
   sst = PIL_check_seconds_timer();
+  sb->scratch->time_springs = sb->scratch->time_points = sb->scratch->time_faces = 0.0;
   /* Integration back in time is possible in theory, but pretty useless here.
    * So we refuse to do so. Since we do not know anything about 'outside' changes
    * especially colliders we refuse to go more than 10 frames.
@@ -3516,6 +3513,10 @@ static void softbody_step(
     sct = PIL_check_seconds_timer();
     if ((sct - sst > 0.5) || (G.debug & G_DEBUG)) {
       printf(" solver time %f sec %s\n", sct - sst, ob->id.name);
+      printf("  springs %f sec, points %f sec, faces %f sec\n",
+             sb->scratch->time_springs,
+             sb->scratch->time_points,
+             sb->scratch->time_faces);
     }
   }
 }
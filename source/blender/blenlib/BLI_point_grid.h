@@ -0,0 +1,59 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#pragma once
+
+/** \file
+ * \ingroup bli
+ *
+ * Uniform grid of points stored in a hash table, for fast range queries with a radius close to
+ * the cell size. Rebuilding is much cheaper than for a BVH tree, which makes it a good fit for
+ * points that move every step, like particle fluids.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct PointGrid;
+typedef struct PointGrid PointGrid;
+
+/**
+ * Callback for each point within the radius of a range query, same as #BVHTree_RangeQuery.
+ * \param co: Center of the query.
+ */
+typedef void (*PointGrid_RangeQuery)(void *userdata, int index, const float co[3], float dist_sq);
+
+/* construct: first insert points, then call balance */
+PointGrid *BLI_point_grid_new(int maxsize, float cell_size);
+void BLI_point_grid_free(PointGrid *grid);
+
+void BLI_point_grid_insert(PointGrid *grid, int index, const float co[3]);
+void BLI_point_grid_balance(PointGrid *grid);
+
+int BLI_point_grid_get_len(const PointGrid *grid);
+float BLI_point_grid_get_cell_size(const PointGrid *grid);
+
+/* Thread safe after balancing. */
+int BLI_point_grid_range_query(const PointGrid *grid,
+                               const float co[3],
+                               float radius,
+                               PointGrid_RangeQuery callback,
+                               void *userdata);
+
+#ifdef __cplusplus
+}
+#endif
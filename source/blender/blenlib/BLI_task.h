@@ -101,7 +101,7 @@ void BLI_task_pool_push(TaskPool *pool,
 
 /* work and wait until all tasks are done */
 void BLI_task_pool_work_and_wait(TaskPool *pool);
-/* cancel all tasks, keep worker threads running */
+/* cancel all tasks, keep worker threads running. New tasks can be pushed afterwards. */
 void BLI_task_pool_cancel(TaskPool *pool);
 
 /* for worker threads, test if canceled */
@@ -86,6 +86,7 @@ typedef struct BVHNode {
   int index;      /* face, edge, vertex index */
   char totnode;   /* how many nodes are used, used for speedup */
   char main_axis; /* Axis used to split this node */
+  bool changed;   /* bounds changed since the last #BLI_bvhtree_update_tree */
 } BVHNode;
 
 /* keep under 26 bytes for speed purposes */
@@ -1026,6 +1027,11 @@ bool BLI_bvhtree_update_node(
 
   node = tree->nodearray + index;
 
+  float bv_prev[26];
+  const size_t bv_offset = 2 * (size_t)tree->start_axis;
+  const size_t bv_size = sizeof(float) * 2 * (size_t)(tree->stop_axis - tree->start_axis);
+  memcpy(bv_prev, node->bv + bv_offset, bv_size);
+
   create_kdop_hull(tree, node, co, numpoints, 0);
 
   if (co_moving) {
@@ -1035,11 +1041,18 @@ bool BLI_bvhtree_update_node(
   /* inflate the bv with some epsilon */
   bvhtree_node_inflate(tree, node, tree->epsilon);
 
+  if (memcmp(bv_prev, node->bv + bv_offset, bv_size) != 0) {
+    node->changed = true;
+  }
+
   return true;
 }
 
 /**
  * Call #BLI_bvhtree_update_node() first for every node/point/triangle.
+ *
+ * Only branches containing nodes with changed bounds are refit, so the cost depends on how much
+ * of the tree moved.
  */
 void BLI_bvhtree_update_tree(BVHTree *tree)
 {
@@ -1050,8 +1063,32 @@ void BLI_bvhtree_update_tree(BVHTree *tree)
   BVHNode **root = tree->nodes + tree->totleaf;
   BVHNode **index = tree->nodes + tree->totleaf + tree->totbranch - 1;
 
+  const size_t bv_offset = 2 * (size_t)tree->start_axis;
+  const size_t bv_size = sizeof(float) * 2 * (size_t)(tree->stop_axis - tree->start_axis);
+
   for (; index >= root; index--) {
-    node_join(tree, *index);
+    BVHNode *node = *index;
+    bool children_changed = false;
+
+    for (int i = 0; i < tree->tree_type && node->children[i]; i++) {
+      if (node->children[i]->changed) {
+        node->children[i]->changed = false;
+        children_changed = true;
+      }
+    }
+
+    if (children_changed) {
+      float bv_prev[26];
+      memcpy(bv_prev, node->bv + bv_offset, bv_size);
+      node_join(tree, node);
+      if (memcmp(bv_prev, node->bv + bv_offset, bv_size) != 0) {
+        node->changed = true;
+      }
+    }
+  }
+
+  if (tree->totbranch > 0) {
+    (*root)->changed = false;
   }
 }
 /**
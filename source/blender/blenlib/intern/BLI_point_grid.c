@@ -0,0 +1,261 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+/** \file
+ * \ingroup bli
+ * \brief Uniform grid for range queries of points.
+ *
+ * Cells are mapped to the buckets of a hash table, so the memory used only depends on the
+ * number of points and not on their extent. Points are sorted by bucket with a counting sort
+ * and stored as separate arrays, so a range query reads few cache lines.
+ */
+
+#include "MEM_guardedalloc.h"
+
+#include "BLI_hash.h"
+#include "BLI_math.h"
+#include "BLI_point_grid.h"
+#include "BLI_task.h"
+#include "BLI_utildefines.h"
+
+#include "BLI_strict_flags.h"
+
+struct PointGrid {
+  float cell_size, cell_size_inv;
+  int totpoint, maxsize;
+
+  /* Points in insert order, freed when balancing. */
+  int *insert_index;
+  float (*insert_co)[3];
+
+  /* Points sorted by bucket. */
+  int *index;
+  float (*co)[3];
+  int (*cell)[3];
+
+  /* Points of a bucket are from bucket_offsets[bucket] to bucket_offsets[bucket + 1]. */
+  int *bucket_offsets;
+  uint bucket_mask;
+};
+
+BLI_INLINE void point_grid_cell(const PointGrid *grid, const float co[3], int r_cell[3])
+{
+  for (int i = 0; i < 3; i++) {
+    /* Clamp, so points far away don't overflow. */
+    r_cell[i] = (int)floorf(clamp_f(co[i] * grid->cell_size_inv, -1e9f, 1e9f));
+  }
+}
+
+BLI_INLINE uint point_grid_bucket(const PointGrid *grid, const int cell[3])
+{
+  const uint hash = BLI_hash_int_2d(BLI_hash_int_2d((uint)cell[0], (uint)cell[1]),
+                                    (uint)cell[2]);
+  return hash & grid->bucket_mask;
+}
+
+PointGrid *BLI_point_grid_new(int maxsize, float cell_size)
+{
+  BLI_assert(cell_size > 0.0f);
+
+  PointGrid *grid = MEM_callocN(sizeof(PointGrid), __func__);
+  grid->cell_size = cell_size;
+  grid->cell_size_inv = 1.0f / cell_size;
+  grid->maxsize = maxsize;
+  grid->insert_index = MEM_mallocN(sizeof(*grid->insert_index) * (size_t)max_ii(maxsize, 1),
+                                   "PointGrid insert index");
+  grid->insert_co = MEM_mallocN(sizeof(*grid->insert_co) * (size_t)max_ii(maxsize, 1),
+                                "PointGrid insert co");
+  return grid;
+}
+
+void BLI_point_grid_free(PointGrid *grid)
+{
+  if (grid == NULL) {
+    return;
+  }
+
+  MEM_SAFE_FREE(grid->insert_index);
+  MEM_SAFE_FREE(grid->insert_co);
+  MEM_SAFE_FREE(grid->index);
+  MEM_SAFE_FREE(grid->co);
+  MEM_SAFE_FREE(grid->cell);
+  MEM_SAFE_FREE(grid->bucket_offsets);
+  MEM_freeN(grid);
+}
+
+void BLI_point_grid_insert(PointGrid *grid, int index, const float co[3])
+{
+  BLI_assert(grid->insert_index != NULL);
+  BLI_assert(grid->totpoint < grid->maxsize);
+
+  grid->insert_index[grid->totpoint] = index;
+  copy_v3_v3(grid->insert_co[grid->totpoint], co);
+  grid->totpoint++;
+}
+
+typedef struct PointGridBalanceData {
+  PointGrid *grid;
+  uint *point_bucket;
+  int *point_dest;
+} PointGridBalanceData;
+
+static void point_grid_bucket_cb(void *__restrict userdata,
+                                 const int i,
+                                 const TaskParallelTLS *__restrict UNUSED(tls))
+{
+  PointGridBalanceData *data = userdata;
+  int cell[3];
+
+  point_grid_cell(data->grid, data->grid->insert_co[i], cell);
+  data->point_bucket[i] = point_grid_bucket(data->grid, cell);
+}
+
+static void point_grid_sort_cb(void *__restrict userdata,
+                               const int i,
+                               const TaskParallelTLS *__restrict UNUSED(tls))
+{
+  PointGridBalanceData *data = userdata;
+  PointGrid *grid = data->grid;
+  const int dest = data->point_dest[i];
+
+  grid->index[dest] = grid->insert_index[i];
+  copy_v3_v3(grid->co[dest], grid->insert_co[i]);
+  point_grid_cell(grid, grid->co[dest], grid->cell[dest]);
+}
+
+void BLI_point_grid_balance(PointGrid *grid)
+{
+  BLI_assert(grid->bucket_offsets == NULL);
+
+  const int totpoint = grid->totpoint;
+  const size_t alloc_len = (size_t)max_ii(totpoint, 1);
+  const uint totbucket = power_of_2_max_u((uint)max_ii(totpoint * 2, 1));
+
+  grid->bucket_mask = totbucket - 1;
+  grid->bucket_offsets = MEM_callocN(sizeof(int) * (totbucket + 1), "PointGrid buckets");
+  grid->index = MEM_mallocN(sizeof(*grid->index) * alloc_len, "PointGrid index");
+  grid->co = MEM_mallocN(sizeof(*grid->co) * alloc_len, "PointGrid co");
+  grid->cell = MEM_mallocN(sizeof(*grid->cell) * alloc_len, "PointGrid cell");
+
+  PointGridBalanceData data = {
+      .grid = grid,
+      .point_bucket = MEM_mallocN(sizeof(uint) * alloc_len, __func__),
+      .point_dest = MEM_mallocN(sizeof(int) * alloc_len, __func__),
+  };
+
+  TaskParallelSettings settings;
+  BLI_parallel_range_settings_defaults(&settings);
+  settings.min_iter_per_thread = 1024;
+
+  BLI_task_parallel_range(0, totpoint, &data, point_grid_bucket_cb, &settings);
+
+  /* Counting sort. This is serial, so points keep their insert order within a bucket and
+   * queries visit them in the same order regardless of the number of threads. */
+  int *bucket_offsets = grid->bucket_offsets;
+  for (int i = 0; i < totpoint; i++) {
+    bucket_offsets[data.point_bucket[i] + 1]++;
+  }
+  for (uint bucket = 0; bucket < totbucket; bucket++) {
+    bucket_offsets[bucket + 1] += bucket_offsets[bucket];
+  }
+  int *bucket_fill = MEM_mallocN(sizeof(int) * totbucket, __func__);
+  memcpy(bucket_fill, bucket_offsets, sizeof(int) * totbucket);
+  for (int i = 0; i < totpoint; i++) {
+    data.point_dest[i] = bucket_fill[data.point_bucket[i]]++;
+  }
+  MEM_freeN(bucket_fill);
+
+  BLI_task_parallel_range(0, totpoint, &data, point_grid_sort_cb, &settings);
+
+  MEM_freeN(data.point_bucket);
+  MEM_freeN(data.point_dest);
+  MEM_SAFE_FREE(grid->insert_index);
+  MEM_SAFE_FREE(grid->insert_co);
+}
+
+int BLI_point_grid_get_len(const PointGrid *grid)
+{
+  return grid->totpoint;
+}
+
+float BLI_point_grid_get_cell_size(const PointGrid *grid)
+{
+  return grid->cell_size;
+}
+
+/**
+ * Calls the callback for every point closer than the radius to co, and returns the number of
+ * points found. Any radius can be used, but a radius around the cell size is most efficient.
+ */
+int BLI_point_grid_range_query(const PointGrid *grid,
+                               const float co[3],
+                               float radius,
+                               PointGrid_RangeQuery callback,
+                               void *userdata)
+{
+  BLI_assert(grid->bucket_offsets != NULL);
+
+  const float radius_sq = radius * radius;
+  float co_min[3], co_max[3];
+  int cell_min[3], cell_max[3], cell[3];
+  int hits = 0;
+
+  for (int i = 0; i < 3; i++) {
+    co_min[i] = co[i] - radius;
+    co_max[i] = co[i] + radius;
+  }
+  point_grid_cell(grid, co_min, cell_min);
+  point_grid_cell(grid, co_max, cell_max);
+
+  /* With a radius much larger than the cell size, testing all points is faster. */
+  const uint64_t cells_len = (uint64_t)(cell_max[0] - cell_min[0] + 1) *
+                             (uint64_t)(cell_max[1] - cell_min[1] + 1) *
+                             (uint64_t)(cell_max[2] - cell_min[2] + 1);
+  if (cells_len > (uint64_t)grid->totpoint) {
+    for (int i = 0; i < grid->totpoint; i++) {
+      const float dist_sq = len_squared_v3v3(co, grid->co[i]);
+      if (dist_sq < radius_sq) {
+        hits++;
+        callback(userdata, grid->index[i], co, dist_sq);
+      }
+    }
+    return hits;
+  }
+
+  for (cell[2] = cell_min[2]; cell[2] <= cell_max[2]; cell[2]++) {
+    for (cell[1] = cell_min[1]; cell[1] <= cell_max[1]; cell[1]++) {
+      for (cell[0] = cell_min[0]; cell[0] <= cell_max[0]; cell[0]++) {
+        const uint bucket = point_grid_bucket(grid, cell);
+        const int end = grid->bucket_offsets[bucket + 1];
+
+        for (int i = grid->bucket_offsets[bucket]; i < end; i++) {
+          /* Buckets are shared by cells with the same hash. */
+          if (!equals_v3v3_int(grid->cell[i], cell)) {
+            continue;
+          }
+
+          const float dist_sq = len_squared_v3v3(co, grid->co[i]);
+          if (dist_sq < radius_sq) {
+            hits++;
+            callback(userdata, grid->index[i], co, dist_sq);
+          }
+        }
+      }
+    }
+  }
+
+  return hits;
+}
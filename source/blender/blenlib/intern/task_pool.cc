@@ -322,6 +322,14 @@ static void background_task_pool_run(TaskPool *pool, Task &&task)
   }
 }
 
+/* Once the background thread has finished, replace the queue which doesn't wait for tasks
+ * anymore, so that the pool can be used again. */
+static void background_task_pool_queue_reset(TaskPool *pool)
+{
+  BLI_thread_queue_free(pool->background_queue);
+  pool->background_queue = BLI_thread_queue_init();
+}
+
 static void background_task_pool_work_and_wait(TaskPool *pool)
 {
   /* Signal background thread to stop waiting for new tasks if none are
@@ -329,6 +337,7 @@ static void background_task_pool_work_and_wait(TaskPool *pool)
   BLI_thread_queue_nowait(pool->background_queue);
   BLI_thread_queue_wait_finish(pool->background_queue);
   BLI_threadpool_clear(&pool->background_threads);
+  background_task_pool_queue_reset(pool);
 }
 
 static void background_task_pool_cancel(TaskPool *pool)
@@ -344,6 +353,7 @@ static void background_task_pool_cancel(TaskPool *pool)
 
   /* Let background thread finish or cancel task it is working on. */
   BLI_threadpool_remove(&pool->background_threads, pool);
+  background_task_pool_queue_reset(pool);
   pool->background_is_canceling = false;
 }
 
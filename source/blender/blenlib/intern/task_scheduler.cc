@@ -68,7 +68,7 @@ void BLI_task_scheduler_init()
 void BLI_task_scheduler_exit()
 {
 #ifdef WITH_TBB_GLOBAL_CONTROL
-  OBJECT_GUARDED_DELETE(task_scheduler_global_control, tbb::global_control);
+  OBJECT_GUARDED_SAFE_DELETE(task_scheduler_global_control, tbb::global_control);
 #endif
 }
 
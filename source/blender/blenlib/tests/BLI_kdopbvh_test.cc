@@ -132,3 +132,49 @@ TEST(kdopbvh, OptimalFindNearest_500)
 {
   find_nearest_points_test(500, 1.0, 1000, 12, true);
 }
+
+/* Move some of the points and refit, only the branches containing them are updated. */
+static void update_points_test(int points_len, int move_step, int random_seed)
+{
+  struct RNG *rng = BLI_rng_new(random_seed);
+  BVHTree *tree = BLI_bvhtree_new(points_len, 0.0, 8, 8);
+
+  void *mem = MEM_mallocN(sizeof(float[3]) * points_len, __func__);
+  float(*points)[3] = (float(*)[3])mem;
+
+  for (int i = 0; i < points_len; i++) {
+    rng_v3_round(points[i], 3, rng, 1000, 1.0f);
+    BLI_bvhtree_insert(tree, i, points[i], 1);
+  }
+  BLI_bvhtree_balance(tree);
+
+  for (int update = 0; update < 3; update++) {
+    for (int i = 0; i < points_len; i += move_step) {
+      rng_v3_round(points[i], 3, rng, 1000, 2.0f);
+    }
+    for (int i = 0; i < points_len; i++) {
+      EXPECT_TRUE(BLI_bvhtree_update_node(tree, i, points[i], NULL, 1));
+    }
+    BLI_bvhtree_update_tree(tree);
+
+    for (int i = 0; i < points_len; i++) {
+      const int j = BLI_bvhtree_find_nearest(tree, points[i], NULL, NULL, NULL);
+      EXPECT_GE(j, 0);
+      EXPECT_LT(j, points_len);
+      EXPECT_EQ_ARRAY(points[i], points[j], 3);
+    }
+  }
+
+  BLI_bvhtree_free(tree);
+  BLI_rng_free(rng);
+  MEM_freeN(points);
+}
+
+TEST(kdopbvh, UpdatePoints_All)
+{
+  update_points_test(500, 1, 12);
+}
+TEST(kdopbvh, UpdatePoints_Some)
+{
+  update_points_test(500, 37, 12);
+}
@@ -0,0 +1,201 @@
+/* Apache License, Version 2.0 */
+
+#include "testing/testing.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <vector>
+
+#include "MEM_guardedalloc.h"
+
+#include "BLI_kdopbvh.h"
+#include "BLI_math_vector.h"
+#include "BLI_point_grid.h"
+#include "BLI_rand.h"
+
+#include "PIL_time.h"
+
+/* -------------------------------------------------------------------- */
+/* Helper Functions */
+
+static std::vector<float> random_points(int points_len, float scale, int random_seed)
+{
+  struct RNG *rng = BLI_rng_new(random_seed);
+  std::vector<float> points(points_len * 3);
+  for (float &f : points) {
+    f = (BLI_rng_get_float(rng) * 2.0f - 1.0f) * scale;
+  }
+  BLI_rng_free(rng);
+  return points;
+}
+
+static PointGrid *point_grid_from_points(const std::vector<float> &points, float cell_size)
+{
+  const int points_len = points.size() / 3;
+  PointGrid *grid = BLI_point_grid_new(points_len, cell_size);
+  for (int i = 0; i < points_len; i++) {
+    BLI_point_grid_insert(grid, i, &points[i * 3]);
+  }
+  BLI_point_grid_balance(grid);
+  return grid;
+}
+
+static void range_query_collect_cb(void *userdata, int index, const float co[3], float dist_sq)
+{
+  std::vector<std::pair<int, float>> *hits = (std::vector<std::pair<int, float>> *)userdata;
+  UNUSED_VARS(co);
+  hits->push_back({index, dist_sq});
+}
+
+static void range_query_count_cb(void *userdata,
+                                 int UNUSED(index),
+                                 const float UNUSED(co[3]),
+                                 float UNUSED(dist_sq))
+{
+  (*(int *)userdata)++;
+}
+
+/* Compare the result of range queries with a brute force search. */
+static void range_query_test(
+    int points_len, float scale, float cell_size, float radius, int random_seed)
+{
+  const std::vector<float> points = random_points(points_len, scale, random_seed);
+  const std::vector<float> queries = random_points(64, scale, random_seed + 1);
+  PointGrid *grid = point_grid_from_points(points, cell_size);
+
+  EXPECT_EQ(BLI_point_grid_get_len(grid), points_len);
+
+  for (int q = 0; q < 64; q++) {
+    const float *co = &queries[q * 3];
+    std::vector<std::pair<int, float>> hits;
+    const int hits_len = BLI_point_grid_range_query(
+        grid, co, radius, range_query_collect_cb, &hits);
+    EXPECT_EQ(hits_len, hits.size());
+
+    std::vector<std::pair<int, float>> expected;
+    for (int i = 0; i < points_len; i++) {
+      const float dist_sq = len_squared_v3v3(co, &points[i * 3]);
+      if (dist_sq < radius * radius) {
+        expected.push_back({i, dist_sq});
+      }
+    }
+
+    std::sort(hits.begin(), hits.end());
+    EXPECT_EQ(hits, expected);
+  }
+
+  BLI_point_grid_free(grid);
+}
+
+/* -------------------------------------------------------------------- */
+/* Tests */
+
+TEST(point_grid, Empty)
+{
+  PointGrid *grid = BLI_point_grid_new(0, 1.0f);
+  BLI_point_grid_balance(grid);
+  EXPECT_EQ(BLI_point_grid_get_len(grid), 0);
+
+  const float co[3] = {0.0f, 0.0f, 0.0f};
+  int hits = 0;
+  EXPECT_EQ(BLI_point_grid_range_query(grid, co, 1.0f, range_query_count_cb, &hits), 0);
+  EXPECT_EQ(hits, 0);
+  BLI_point_grid_free(grid);
+}
+
+TEST(point_grid, Single)
+{
+  PointGrid *grid = BLI_point_grid_new(1, 1.0f);
+  const float co[3] = {-0.5f, 0.25f, 3.0f};
+  BLI_point_grid_insert(grid, 7, co);
+  BLI_point_grid_balance(grid);
+
+  std::vector<std::pair<int, float>> hits;
+  const float query_co[3] = {-0.5f, 0.25f, 2.5f};
+  EXPECT_EQ(BLI_point_grid_range_query(grid, query_co, 0.6f, range_query_collect_cb, &hits), 1);
+  EXPECT_EQ(hits[0].first, 7);
+  EXPECT_FLOAT_EQ(hits[0].second, 0.25f);
+
+  /* Range excludes points at exactly the radius, same as BVH trees. */
+  EXPECT_EQ(BLI_point_grid_range_query(grid, query_co, 0.5f, range_query_collect_cb, &hits), 0);
+  BLI_point_grid_free(grid);
+}
+
+TEST(point_grid, RangeQuery_Small)
+{
+  range_query_test(100, 1.0f, 0.2f, 0.2f, 1234);
+}
+
+TEST(point_grid, RangeQuery_Large)
+{
+  range_query_test(20000, 1.0f, 0.05f, 0.05f, 1234);
+}
+
+/* Radius larger than the cell size visits more cells. */
+TEST(point_grid, RangeQuery_LargeRadius)
+{
+  range_query_test(10000, 1.0f, 0.05f, 0.23f, 4321);
+}
+
+/* Radius smaller than the cell size. */
+TEST(point_grid, RangeQuery_SmallRadius)
+{
+  range_query_test(10000, 1.0f, 0.3f, 0.04f, 4321);
+}
+
+/* Points spread far apart compared to the cell size, many cells share a bucket. */
+TEST(point_grid, RangeQuery_Sparse)
+{
+  range_query_test(10000, 10.0f, 0.01f, 0.5f, 99);
+}
+
+/* Range covering more cells than there are points. */
+TEST(point_grid, RangeQuery_Huge)
+{
+  range_query_test(1000, 1000.0f, 0.5f, 400.0f, 99);
+}
+
+/* Build and query about a million points with both a grid and a BVH tree, the way particle
+ * fluids do. Run with --gtest_also_run_disabled_tests. */
+TEST(point_grid, DISABLED_Performance)
+{
+  const int points_len = 1000000;
+  /* Spacing of the particles of about half the radius, like a fluid at rest. */
+  const float radius = 0.02f;
+  const std::vector<float> points = random_points(points_len, 0.5f, 1234);
+
+  double start = PIL_check_seconds_timer();
+  PointGrid *grid = point_grid_from_points(points, radius);
+  const double grid_build = PIL_check_seconds_timer() - start;
+
+  start = PIL_check_seconds_timer();
+  int grid_hits = 0;
+  for (int i = 0; i < points_len; i++) {
+    BLI_point_grid_range_query(grid, &points[i * 3], radius, range_query_count_cb, &grid_hits);
+  }
+  const double grid_query = PIL_check_seconds_timer() - start;
+  BLI_point_grid_free(grid);
+
+  start = PIL_check_seconds_timer();
+  BVHTree *tree = BLI_bvhtree_new(points_len, 0.0f, 4, 6);
+  for (int i = 0; i < points_len; i++) {
+    BLI_bvhtree_insert(tree, i, &points[i * 3], 1);
+  }
+  BLI_bvhtree_balance(tree);
+  const double tree_build = PIL_check_seconds_timer() - start;
+
+  start = PIL_check_seconds_timer();
+  int tree_hits = 0;
+  for (int i = 0; i < points_len; i++) {
+    BLI_bvhtree_range_query(tree, &points[i * 3], radius, range_query_count_cb, &tree_hits);
+  }
+  const double tree_query = PIL_check_seconds_timer() - start;
+  BLI_bvhtree_free(tree);
+
+  /* BVH tree leaves are padded by an epsilon, so it finds a few more points. */
+  EXPECT_LE(grid_hits, tree_hits);
+  EXPECT_NEAR(grid_hits, tree_hits, tree_hits / 1000);
+  printf("%d points, %d neighbors\n", points_len, grid_hits);
+  printf("grid: build %fs, query %fs\n", grid_build, grid_query);
+  printf("bvh:  build %fs, query %fs\n", tree_build, tree_query);
+}
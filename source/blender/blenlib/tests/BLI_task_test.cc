@@ -13,6 +13,8 @@
 #include "BLI_mempool.h"
 #include "BLI_task.h"
 
+#include "PIL_time.h"
+
 #define NUM_ITEMS 10000
 
 /* *** Parallel iterations over range of integer values. *** */
@@ -181,3 +183,56 @@ TEST(task, ListBaseIter)
   MEM_freeN(items_buffer);
   BLI_threadapi_exit();
 }
+
+/* *** Background pools used again after waiting or canceling. *** */
+
+static void task_pool_count_func(TaskPool *__restrict pool, void *UNUSED(taskdata))
+{
+  int *count = (int *)BLI_task_pool_user_data(pool);
+  atomic_add_and_fetch_int32(count, 1);
+}
+
+static void task_pool_wait_canceled_func(TaskPool *__restrict pool, void *UNUSED(taskdata))
+{
+  while (!BLI_task_pool_canceled(pool)) {
+    PIL_sleep_ms(1);
+  }
+}
+
+TEST(task, BackgroundPoolReuse)
+{
+  int count = 0;
+  BLI_threadapi_init();
+
+  /* Serial background pools always use their own thread, also when running with TBB. */
+  TaskPool *pool = BLI_task_pool_create_background_serial(&count, TASK_PRIORITY_LOW);
+
+  for (int i = 0; i < 10; i++) {
+    BLI_task_pool_push(pool, task_pool_count_func, NULL, false, NULL);
+    BLI_task_pool_work_and_wait(pool);
+    /* Give the thread time to finish, tasks pushed after that must still run. */
+    BLI_task_pool_push(pool, task_pool_count_func, NULL, false, NULL);
+    PIL_sleep_ms(5);
+    BLI_task_pool_push(pool, task_pool_count_func, NULL, false, NULL);
+    BLI_task_pool_work_and_wait(pool);
+  }
+  EXPECT_EQ(count, 30);
+
+  for (int i = 0; i < 10; i++) {
+    BLI_task_pool_push(pool, task_pool_wait_canceled_func, NULL, false, NULL);
+    BLI_task_pool_push(pool, task_pool_count_func, NULL, false, NULL);
+    PIL_sleep_ms(1);
+    BLI_task_pool_cancel(pool);
+
+    /* The queued task may have been canceled, tasks pushed afterwards run. */
+    const int count_canceled = count;
+    BLI_task_pool_push(pool, task_pool_count_func, NULL, false, NULL);
+    PIL_sleep_ms(5);
+    BLI_task_pool_push(pool, task_pool_count_func, NULL, false, NULL);
+    BLI_task_pool_work_and_wait(pool);
+    EXPECT_EQ(count, count_canceled + 2);
+  }
+
+  BLI_task_pool_free(pool);
+  BLI_threadapi_exit();
+}
@@ -2959,7 +2959,7 @@ static void direct_link_particlesystems(BlendDataReader *reader, ListBase *parti
     }
 
     psys->tree = NULL;
-    psys->bvhtree = NULL;
+    psys->point_grid = NULL;
 
     psys->orig_psys = NULL;
     psys->batch_cache = NULL;
@@ -3465,6 +3465,7 @@ static void direct_link_modifiers(BlendDataReader *reader, ListBase *lb, Object
         fmd->domain->tex_velocity_z = NULL;
         fmd->domain->tex_wt = NULL;
         fmd->domain->mesh_velocities = NULL;
+        fmd->domain->cache_prefetch = NULL;
         BLO_read_data_address(reader, &fmd->domain->coba);
 
         BLO_read_data_address(reader, &fmd->domain->effector_weights);
@@ -4331,6 +4332,7 @@ static void direct_link_scene(BlendDataReader *reader, Scene *sce)
     BLO_read_data_address(reader, &ed->act_seq);
     ed->cache = NULL;
     ed->prefetch_job = NULL;
+    ed->readahead = NULL;
 
     /* recursive link sequences, lb will be correctly initialized */
     link_recurs_seq(reader, &ed->seqbase);
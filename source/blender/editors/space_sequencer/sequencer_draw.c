@@ -78,6 +78,8 @@
 
 #include "BLF_api.h"
 
+#include "BLT_translation.h"
+
 #include "MEM_guardedalloc.h"
 
 /* Own include. */
@@ -2261,6 +2263,79 @@ static void draw_cache_view(const bContext *C)
   GPU_blend(GPU_BLEND_NONE);
 }
 
+static void sequencer_draw_stats_line(const char *text, int theme_color, int xoffset, int *yoffset)
+{
+  const int font_id = BLF_default();
+
+  UI_FontThemeColor(font_id, theme_color);
+  BLF_enable(font_id, BLF_SHADOW);
+  BLF_shadow(font_id, 5, (const float[4]){0.0f, 0.0f, 0.0f, 1.0f});
+  BLF_shadow_offset(font_id, 1, -1);
+
+  *yoffset -= 0.9f * U.widget_unit;
+
+#ifdef WITH_INTERNATIONAL
+  BLF_draw_default(xoffset, *yoffset, 0.0f, text, BLF_DRAW_STR_DUMMY_MAX);
+#else
+  BLF_draw_default_ascii(xoffset, *yoffset, 0.0f, text, BLF_DRAW_STR_DUMMY_MAX);
+#endif
+
+  BLF_disable(font_id, BLF_SHADOW);
+}
+
+/* Draw frame rate achieved by prefetching, below the playback frame rate if it is shown. */
+void sequencer_draw_prefetch_fps(Scene *scene, int xoffset, int *yoffset)
+{
+  const float fps = BKE_sequencer_prefetch_fps(scene);
+  char printable[32];
+
+  if (fps == 0.0f) {
+    return;
+  }
+
+  BLI_snprintf(printable, sizeof(printable), IFACE_("prefetch fps: %.2f"), fps);
+
+  /* Prefetching slower than playback can't keep the cache filled. */
+  sequencer_draw_stats_line(
+      printable, (fps + 0.5f < (float)(FPS)) ? TH_REDALERT : TH_TEXT_HI, xoffset, yoffset);
+}
+
+/* Draw disk cache hit rate and throughput. */
+void sequencer_draw_disk_cache_stats(Scene *scene, int xoffset, int *yoffset)
+{
+  SeqDiskCacheStats stats;
+  char printable[128];
+
+  if (!BKE_sequencer_cache_disk_stats_get(scene, &stats)) {
+    return;
+  }
+
+  const int reads = stats.read_hits + stats.read_misses;
+  const float hit_rate = (reads > 0) ? 100.0f * stats.read_hits / reads : 0.0f;
+  const float read_rate = (stats.read_time > 0.0) ?
+                              (float)(stats.bytes_read / stats.read_time) / (1024 * 1024) :
+                              0.0f;
+  const float write_rate = (stats.write_time > 0.0) ?
+                               (float)(stats.bytes_written / stats.write_time) / (1024 * 1024) :
+                               0.0f;
+
+  BLI_snprintf(printable,
+               sizeof(printable),
+               IFACE_("disk cache: %.0f%% hits, read %.0f MB/s, write %.0f MB/s"),
+               hit_rate,
+               read_rate,
+               write_rate);
+  sequencer_draw_stats_line(printable, TH_TEXT_HI, xoffset, yoffset);
+
+  if (stats.writes_dropped > 0) {
+    BLI_snprintf(printable,
+                 sizeof(printable),
+                 IFACE_("disk cache: %d images not written"),
+                 stats.writes_dropped);
+    sequencer_draw_stats_line(printable, TH_REDALERT, xoffset, yoffset);
+  }
+}
+
 /* Draw sequencer timeline. */
 void draw_timeline_seq(const bContext *C, ARegion *region)
 {
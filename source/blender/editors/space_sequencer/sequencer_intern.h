@@ -51,6 +51,8 @@ void sequencer_draw_preview(const struct bContext *C,
                             int offset,
                             bool draw_overlay,
                             bool draw_backdrop);
+void sequencer_draw_prefetch_fps(struct Scene *scene, int xoffset, int *yoffset);
+void sequencer_draw_disk_cache_stats(struct Scene *scene, int xoffset, int *yoffset);
 void color3ubv_from_seq(struct Scene *curscene, struct Sequence *seq, unsigned char col[3]);
 
 void sequencer_special_update_set(Sequence *seq);
@@ -734,11 +734,17 @@ static void sequencer_preview_region_draw(const bContext *C, ARegion *region)
 
   WM_gizmomap_draw(region->gizmo_map, C, WM_GIZMOMAP_DRAWSTEP_2D);
 
-  if ((U.uiflag & USER_SHOW_FPS) && ED_screen_animation_no_scrub(wm)) {
+  if (U.uiflag & USER_SHOW_FPS) {
     const rcti *rect = ED_region_visible_rect(region);
     int xoffset = rect->xmin + U.widget_unit;
     int yoffset = rect->ymax;
-    ED_scene_draw_fps(scene, xoffset, &yoffset);
+    if (ED_screen_animation_no_scrub(wm)) {
+      ED_scene_draw_fps(scene, xoffset, &yoffset);
+    }
+    else if (scene->ed && (scene->ed->cache_flag & SEQ_CACHE_PREFETCH_ENABLE)) {
+      sequencer_draw_prefetch_fps(scene, xoffset, &yoffset);
+    }
+    sequencer_draw_disk_cache_stats(scene, xoffset, &yoffset);
   }
 }
 
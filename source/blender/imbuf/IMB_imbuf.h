@@ -109,6 +109,13 @@ struct ImBuf *IMB_ibImageFromMemory(const unsigned char *mem,
                                     int flags,
                                     char colorspace[IM_MAX_SPACE],
                                     const char *descr);
+struct ImBuf *IMB_ibImageFromMemory_scaled(const unsigned char *mem,
+                                           size_t size,
+                                           int flags,
+                                           char colorspace[IM_MAX_SPACE],
+                                           const char *descr,
+                                           float scale,
+                                           int r_full_size[2]);
 
 /**
  *
@@ -121,6 +128,11 @@ struct ImBuf *IMB_testiffname(const char *filepath, int flags);
  * \attention Defined in readimage.c
  */
 struct ImBuf *IMB_loadiffname(const char *filepath, int flags, char colorspace[IM_MAX_SPACE]);
+struct ImBuf *IMB_loadiffname_scaled(const char *filepath,
+                                     int flags,
+                                     char colorspace[IM_MAX_SPACE],
+                                     float scale,
+                                     int r_full_size[2]);
 
 /**
  *
@@ -341,6 +353,10 @@ struct IndexBuildContext *IMB_anim_index_rebuild_context(struct anim *anim,
                                                          const bool overwrite,
                                                          struct GSet *file_list);
 
+/* Limit the threads used for decoding the movie, 0 (the default) lets FFmpeg decide.
+ * Used when several movies are built at once. */
+void IMB_anim_index_rebuild_set_num_threads(struct IndexBuildContext *context, int num_threads);
+
 /* Will rebuild all used indices and proxies at once. */
 void IMB_anim_index_rebuild(struct IndexBuildContext *context,
                             short *stop,
@@ -500,6 +516,13 @@ bool IMB_alpha_affects_rgb(const struct ImBuf *ibuf);
 /* create char buffer, color corrected if necessary, for ImBufs that lack one */
 void IMB_rect_from_float(struct ImBuf *ibuf);
 void IMB_float_from_rect(struct ImBuf *ibuf);
+
+/* half float storage, for ImBufs that lack one of the float or half float buffers */
+void IMB_half_from_float(struct ImBuf *ibuf);
+void IMB_float_from_half(struct ImBuf *ibuf);
+struct ImBuf *IMB_half_copy_from_float(const struct ImBuf *ibuf);
+struct ImBuf *IMB_float_copy_from_half(const struct ImBuf *ibuf);
+
 void IMB_color_to_bw(struct ImBuf *ibuf);
 void IMB_saturation(struct ImBuf *ibuf, float sat);
 
@@ -534,6 +557,8 @@ void IMB_buffer_float_from_byte(float *rect_to,
                                 int height,
                                 int stride_to,
                                 int stride_from);
+void IMB_buffer_half_from_float(unsigned short *rect_to, const float *rect_from, size_t num);
+void IMB_buffer_float_from_half(float *rect_to, const unsigned short *rect_from, size_t num);
 void IMB_buffer_float_from_float(float *rect_to,
                                  const float *rect_from,
                                  int channels_from,
@@ -708,6 +733,8 @@ void imb_freerectImBuf(struct ImBuf *ibuf);
 
 bool imb_addrectfloatImBuf(struct ImBuf *ibuf);
 void imb_freerectfloatImBuf(struct ImBuf *ibuf);
+bool imb_addrecthalfImBuf(struct ImBuf *ibuf);
+void imb_freerecthalfImBuf(struct ImBuf *ibuf);
 void imb_freemipmapImBuf(struct ImBuf *ibuf);
 
 bool imb_addtilesImBuf(struct ImBuf *ibuf);
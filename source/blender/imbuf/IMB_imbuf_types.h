@@ -169,6 +169,8 @@ typedef enum eImBufFlags {
   IB_thumbnail = 1 << 16,
   IB_multiview = 1 << 17,
   IB_halffloat = 1 << 18,
+  /** half float buffer, the OpenEXR reader fills it instead of the float buffer for half files */
+  IB_recthalf = 1 << 19,
 } eImBufFlags;
 
 /** \} */
@@ -207,6 +209,13 @@ typedef struct ImBuf {
    * \note Formats that support higher more than 8 but channels load as floats.
    */
   float *rect_float;
+  /** Image pixel buffer (half float representation):
+   * - same channels, color space and alpha as `rect_float`.
+   * - IEEE 754 binary16 values, half the memory of `rect_float` for caches holding HDR images.
+   * \note Most functions only operate on `rect` and `rect_float`, so this is a storage format.
+   * Use #IMB_float_from_half to get a float buffer before processing.
+   */
+  unsigned short *rect_half;
 
   /** Resolution in pixels per meter. Multiply by `0.0254` for DPI. */
   double ppm[2];
@@ -80,10 +80,24 @@
 
 #define MAXNUMSTREAMS 50
 
+/* Maximum number of horizontal bands a frame is split into for parallel color conversion. */
+#define ANIM_CONVERT_SLICES_MAX 16
+
 struct IDProperty;
+struct TaskPool;
 struct _AviMovie;
 struct anim_index;
 
+#ifdef WITH_FFMPEG
+/* Decoded frame kept around so scrubbing and playback don't have to decode it again. */
+typedef struct AnimDecodedFrame {
+  AVFrame *frame;
+  int64_t pts;
+  /* pts of the frame decoded right after this one, -1 when not known. */
+  int64_t next_pts;
+} AnimDecodedFrame;
+#endif
+
 struct anim {
   int ib_flags;
   int curtype;
@@ -130,8 +144,21 @@ struct anim {
   AVFrame *pFrameRGB;
   AVFrame *pFrameDeinterlaced;
   struct SwsContext *img_convert_ctx;
+  /* Per band conversion contexts, used to convert one frame from multiple threads. */
+  struct SwsContext *img_convert_ctx_slices[ANIM_CONVERT_SLICES_MAX];
+  int img_convert_slices_num;
+  int img_convert_slice_height;
   int videoStream;
 
+  /* Ring buffer of recently decoded frames. After every fetch a background task decodes the
+   * following frames, until half of the buffer holds frames after the fetched one. */
+  AnimDecodedFrame *decoded_frames;
+  int decoded_frames_num;
+  int decoded_frames_next;
+  /* When set, the newest decoded frame directly precedes the decoder position. */
+  bool decoded_frames_continuous;
+  struct TaskPool *decode_ahead_pool;
+
   struct ImBuf *last_frame;
   int64_t last_pts;
   int64_t next_pts;
@@ -126,6 +126,26 @@ void colorspace_set_default_role(char *colorspace, int size, int role);
 void colormanage_imbuf_set_default_spaces(struct ImBuf *ibuf);
 void colormanage_imbuf_make_linear(struct ImBuf *ibuf, const char *from_colorspace);
 
+/* ** Baked 3D LUT ** */
+
+typedef struct ColormanageLUT ColormanageLUT;
+
+/* Transform num_pixels packed RGB triplets in place. */
+typedef void (*ColormanageLUTEvaluateFn)(void *userdata, float *rgb, int num_pixels);
+
+ColormanageLUT *colormanage_lut_create(int size,
+                                       float domain_max,
+                                       ColormanageLUTEvaluateFn evaluate,
+                                       void *userdata);
+void colormanage_lut_free(ColormanageLUT *lut);
+void colormanage_lut_apply_v3(const ColormanageLUT *lut, float rgb[3]);
+void colormanage_lut_apply(const ColormanageLUT *lut,
+                           float *buffer,
+                           int width,
+                           int height,
+                           int channels,
+                           bool predivide);
+
 #ifdef __cplusplus
 }
 #endif
@@ -40,6 +40,14 @@ typedef struct ImFileType {
                         int flags,
                         char colorspace[IM_MAX_SPACE]);
   struct ImBuf *(*load_filepath)(const char *filepath, int flags, char colorspace[IM_MAX_SPACE]);
+  /* Load at a reduced size, for formats that can do that faster than loading at full size.
+   * Returns NULL when not possible, the size of the full image is returned in r_full_size. */
+  struct ImBuf *(*load_scaled)(const unsigned char *mem,
+                               size_t size,
+                               int flags,
+                               float scale,
+                               char colorspace[IM_MAX_SPACE],
+                               int r_full_size[2]);
   int (*save)(struct ImBuf *ibuf, const char *filepath, int flags);
   void (*load_tile)(struct ImBuf *ibuf,
                     const unsigned char *mem,
@@ -111,6 +111,21 @@ void imb_freerectfloatImBuf(ImBuf *ibuf)
   ibuf->mall &= ~IB_rectfloat;
 }
 
+void imb_freerecthalfImBuf(ImBuf *ibuf)
+{
+  if (ibuf == NULL) {
+    return;
+  }
+
+  if (ibuf->rect_half && (ibuf->mall & IB_recthalf)) {
+    MEM_freeN(ibuf->rect_half);
+  }
+  ibuf->rect_half = NULL;
+
+  ibuf->mall &= ~IB_recthalf;
+  ibuf->flags &= ~IB_recthalf;
+}
+
 /* any free rect frees mipmaps to be sure, creation is in render on first request */
 void imb_freerectImBuf(ImBuf *ibuf)
 {
@@ -202,6 +217,7 @@ void imb_freerectImbuf_all(ImBuf *ibuf)
 {
   imb_freerectImBuf(ibuf);
   imb_freerectfloatImBuf(ibuf);
+  imb_freerecthalfImBuf(ibuf);
   imb_freetilesImBuf(ibuf);
   IMB_freezbufImBuf(ibuf);
   IMB_freezbuffloatImBuf(ibuf);
@@ -403,6 +419,25 @@ bool imb_addrectfloatImBuf(ImBuf *ibuf)
   return false;
 }
 
+/* Half float buffer with the same number of channels as the float buffer. */
+bool imb_addrecthalfImBuf(ImBuf *ibuf)
+{
+  if (ibuf == NULL) {
+    return false;
+  }
+
+  imb_freerecthalfImBuf(ibuf);
+
+  if ((ibuf->rect_half = imb_alloc_pixels(
+           ibuf->x, ibuf->y, ibuf->channels, sizeof(unsigned short), __func__))) {
+    ibuf->mall |= IB_recthalf;
+    ibuf->flags |= IB_recthalf;
+    return true;
+  }
+
+  return false;
+}
+
 /* question; why also add zbuf? */
 bool imb_addrectImBuf(ImBuf *ibuf)
 {
@@ -519,6 +554,12 @@ bool IMB_initImBuf(
     }
   }
 
+  if (flags & IB_recthalf) {
+    if (imb_addrecthalfImBuf(ibuf) == false) {
+      return false;
+    }
+  }
+
   if (flags & IB_zbuf) {
     if (addzbufImBuf(ibuf) == false) {
       return false;
@@ -554,6 +595,9 @@ ImBuf *IMB_dupImBuf(const ImBuf *ibuf1)
   if (ibuf1->rect_float) {
     flags |= IB_rectfloat;
   }
+  if (ibuf1->rect_half) {
+    flags |= IB_recthalf;
+  }
   if (ibuf1->zbuf) {
     flags |= IB_zbuf;
   }
@@ -564,11 +608,20 @@ ImBuf *IMB_dupImBuf(const ImBuf *ibuf1)
   x = ibuf1->x;
   y = ibuf1->y;
 
-  ibuf2 = IMB_allocImBuf(x, y, ibuf1->planes, flags);
+  ibuf2 = IMB_allocImBuf(x, y, ibuf1->planes, flags & ~IB_recthalf);
   if (ibuf2 == NULL) {
     return NULL;
   }
 
+  /* Half float buffer size depends on the number of channels. */
+  if (flags & IB_recthalf) {
+    ibuf2->channels = ibuf1->channels;
+    if (imb_addrecthalfImBuf(ibuf2) == false) {
+      IMB_freeImBuf(ibuf2);
+      return NULL;
+    }
+  }
+
   if (flags & IB_rect) {
     memcpy(ibuf2->rect, ibuf1->rect, ((size_t)x) * y * sizeof(int));
   }
@@ -578,6 +631,12 @@ ImBuf *IMB_dupImBuf(const ImBuf *ibuf1)
         ibuf2->rect_float, ibuf1->rect_float, ((size_t)ibuf1->channels) * x * y * sizeof(float));
   }
 
+  if (flags & IB_recthalf) {
+    memcpy(ibuf2->rect_half,
+           ibuf1->rect_half,
+           ((size_t)ibuf1->channels) * x * y * sizeof(unsigned short));
+  }
+
   if (flags & IB_zbuf) {
     memcpy(ibuf2->zbuf, ibuf1->zbuf, ((size_t)x) * y * sizeof(int));
   }
@@ -602,6 +661,7 @@ ImBuf *IMB_dupImBuf(const ImBuf *ibuf1)
   /* fix pointers */
   tbuf.rect = ibuf2->rect;
   tbuf.rect_float = ibuf2->rect_float;
+  tbuf.rect_half = ibuf2->rect_half;
   tbuf.encodedbuffer = ibuf2->encodedbuffer;
   tbuf.zbuf = ibuf2->zbuf;
   tbuf.zbuf_float = ibuf2->zbuf_float;
@@ -641,6 +701,10 @@ size_t IMB_get_size_in_memory(ImBuf *ibuf)
     channel_size += sizeof(float);
   }
 
+  if (ibuf->rect_half) {
+    channel_size += sizeof(unsigned short);
+  }
+
   size += channel_size * ibuf->x * ibuf->y * ibuf->channels;
 
   if (ibuf->miptot) {
@@ -53,12 +53,18 @@
 #  include <io.h>
 #endif
 
+#include "BLI_math_base.h"
 #include "BLI_path_util.h"
 #include "BLI_string.h"
+#include "BLI_task.h"
+#include "BLI_threads.h"
 #include "BLI_utildefines.h"
 
+#include "MEM_CacheLimiterC-Api.h"
 #include "MEM_guardedalloc.h"
 
+#include "atomic_ops.h"
+
 #ifdef WITH_AVI
 #  include "AVI_avi.h"
 #endif
@@ -78,6 +84,8 @@
 
 #  include <libavcodec/avcodec.h>
 #  include <libavformat/avformat.h>
+#  include <libavutil/imgutils.h>
+#  include <libavutil/pixdesc.h>
 #  include <libavutil/rational.h>
 #  include <libswscale/swscale.h>
 
@@ -500,11 +508,198 @@ static ImBuf *avi_fetchibuf(struct anim *anim, int position)
 
 #ifdef WITH_FFMPEG
 
+/* Decoded frames are kept outside of the memory cache. Together, the ring buffers of all open
+ * movies use at most this part of the memory cache limit, split evenly between them. */
+#  define ANIM_DECODED_FRAMES_CACHE_PART 4
+#  define ANIM_DECODED_FRAMES_MIN 2
+#  define ANIM_DECODED_FRAMES_MAX 64
+
+/* Number of open movies with a decoded frames ring buffer. */
+static int ffmpeg_decoded_frames_anims_num = 0;
+
+/* Don't split frames into bands smaller than this for parallel color conversion. */
+#  define ANIM_CONVERT_SLICE_HEIGHT_MIN 64
+
 BLI_INLINE bool need_aligned_ffmpeg_buffer(struct anim *anim)
 {
   return (anim->x & 31) != 0;
 }
 
+static struct SwsContext *ffmpeg_sws_context_create(struct anim *anim, int height, int flags)
+{
+  struct SwsContext *sws_ctx = sws_getContext(anim->x,
+                                              height,
+                                              anim->pCodecCtx->pix_fmt,
+                                              anim->x,
+                                              height,
+                                              AV_PIX_FMT_RGBA,
+                                              flags,
+                                              NULL,
+                                              NULL,
+                                              NULL);
+  if (sws_ctx == NULL) {
+    return NULL;
+  }
+
+#  ifdef FFMPEG_SWSCALE_COLOR_SPACE_SUPPORT
+  /* The following for color space determination */
+  int srcRange, dstRange, brightness, contrast, saturation;
+  int *table;
+  const int *inv_table;
+
+  /* Try do detect if input has 0-255 YCbCR range (JFIF Jpeg MotionJpeg) */
+  if (!sws_getColorspaceDetails(sws_ctx,
+                                (int **)&inv_table,
+                                &srcRange,
+                                &table,
+                                &dstRange,
+                                &brightness,
+                                &contrast,
+                                &saturation)) {
+    srcRange = srcRange || anim->pCodecCtx->color_range == AVCOL_RANGE_JPEG;
+    inv_table = sws_getCoefficients(anim->pCodecCtx->colorspace);
+
+    if (sws_setColorspaceDetails(sws_ctx,
+                                 (int *)inv_table,
+                                 srcRange,
+                                 table,
+                                 dstRange,
+                                 brightness,
+                                 contrast,
+                                 saturation)) {
+      fprintf(stderr, "Warning: Could not set libswscale colorspace details.\n");
+    }
+  }
+  else {
+    fprintf(stderr, "Warning: Could not set libswscale colorspace details.\n");
+  }
+#  endif
+
+  return sws_ctx;
+}
+
+/* Pixel formats which can be converted band by band, every plane has to be addressable by row. */
+static bool ffmpeg_pix_fmt_supports_slices(enum AVPixelFormat pix_fmt)
+{
+  const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get(pix_fmt);
+  if (desc == NULL) {
+    return false;
+  }
+  uint64_t unsupported_flags = AV_PIX_FMT_FLAG_PAL | AV_PIX_FMT_FLAG_BITSTREAM |
+                               AV_PIX_FMT_FLAG_HWACCEL;
+#  ifdef AV_PIX_FMT_FLAG_PSEUDOPAL
+  unsupported_flags |= AV_PIX_FMT_FLAG_PSEUDOPAL;
+#  endif
+  return (desc->flags & unsupported_flags) == 0;
+}
+
+/* Split the frame into horizontal bands, each converted by its own context so that
+ * sws_scale() can run on all of them at once. Falls back to the single full frame
+ * context when the frame is too small or the pixel format can't be sliced. */
+static void ffmpeg_sws_slices_create(struct anim *anim)
+{
+  const int threads_num = BLI_system_thread_count();
+  int slices_num = min_ii(threads_num, ANIM_CONVERT_SLICES_MAX);
+  slices_num = min_ii(slices_num, anim->y / ANIM_CONVERT_SLICE_HEIGHT_MIN);
+
+  anim->img_convert_slices_num = 0;
+  anim->img_convert_slice_height = anim->y;
+
+  if (slices_num < 2 || !ffmpeg_pix_fmt_supports_slices(anim->pCodecCtx->pix_fmt)) {
+    return;
+  }
+
+  /* Keep bands a multiple of 16 rows so chroma sub-sampled planes are split on whole rows. */
+  int slice_height = (anim->y + slices_num - 1) / slices_num;
+  slice_height = (slice_height + 15) & ~15;
+  slices_num = (anim->y + slice_height - 1) / slice_height;
+
+  if (slices_num < 2) {
+    return;
+  }
+
+  for (int i = 0; i < slices_num; i++) {
+    const int y0 = i * slice_height;
+    const int height = min_ii(slice_height, anim->y - y0);
+    anim->img_convert_ctx_slices[i] = ffmpeg_sws_context_create(
+        anim, height, SWS_FAST_BILINEAR | SWS_FULL_CHR_H_INT);
+
+    if (anim->img_convert_ctx_slices[i] == NULL) {
+      for (int j = 0; j < i; j++) {
+        sws_freeContext(anim->img_convert_ctx_slices[j]);
+        anim->img_convert_ctx_slices[j] = NULL;
+      }
+      return;
+    }
+  }
+
+  anim->img_convert_slices_num = slices_num;
+  anim->img_convert_slice_height = slice_height;
+}
+
+/* Number of frames of the ring buffer, for this movie's part of the memory budget. */
+static int ffmpeg_decoded_frames_num_get(struct anim *anim)
+{
+  const int frame_size = av_image_get_buffer_size(
+      anim->pCodecCtx->pix_fmt, anim->pCodecCtx->width, anim->pCodecCtx->height, 1);
+  const int anims_num = max_ii(atomic_add_and_fetch_int32(&ffmpeg_decoded_frames_anims_num, 0),
+                               1);
+
+  if (frame_size <= 0) {
+    return ANIM_DECODED_FRAMES_MIN;
+  }
+
+  const size_t budget = MEM_CacheLimiter_get_maximum() / ANIM_DECODED_FRAMES_CACHE_PART /
+                        (size_t)anims_num;
+  const size_t frames_num = budget / (size_t)frame_size;
+
+  return (int)CLAMPIS(frames_num, ANIM_DECODED_FRAMES_MIN, ANIM_DECODED_FRAMES_MAX);
+}
+
+static void ffmpeg_decoded_frames_create(struct anim *anim)
+{
+  atomic_add_and_fetch_int32(&ffmpeg_decoded_frames_anims_num, 1);
+
+  const int frames_num = ffmpeg_decoded_frames_num_get(anim);
+
+  anim->decoded_frames = MEM_callocN(sizeof(AnimDecodedFrame) * frames_num,
+                                     "anim decoded frames");
+  anim->decoded_frames_num = frames_num;
+  anim->decoded_frames_next = 0;
+  anim->decoded_frames_continuous = false;
+
+  for (int i = 0; i < frames_num; i++) {
+    anim->decoded_frames[i].pts = -1;
+    anim->decoded_frames[i].next_pts = -1;
+  }
+}
+
+static void ffmpeg_decoded_frames_free(struct anim *anim)
+{
+  if (anim->decoded_frames == NULL) {
+    return;
+  }
+
+  for (int i = 0; i < anim->decoded_frames_num; i++) {
+    av_frame_free(&anim->decoded_frames[i].frame);
+  }
+  MEM_freeN(anim->decoded_frames);
+  anim->decoded_frames = NULL;
+  anim->decoded_frames_num = 0;
+
+  atomic_sub_and_fetch_int32(&ffmpeg_decoded_frames_anims_num, 1);
+}
+
+/* Resize the ring buffer when the memory budget changed, because movies were opened or closed
+ * or the memory cache limit changed. */
+static void ffmpeg_decoded_frames_update(struct anim *anim)
+{
+  if (anim->decoded_frames && ffmpeg_decoded_frames_num_get(anim) != anim->decoded_frames_num) {
+    ffmpeg_decoded_frames_free(anim);
+    ffmpeg_decoded_frames_create(anim);
+  }
+}
+
 static int startffmpeg(struct anim *anim)
 {
   int i, video_stream_index;
@@ -518,13 +713,6 @@ static int startffmpeg(struct anim *anim)
   double frs_den;
   int streamcount;
 
-#  ifdef FFMPEG_SWSCALE_COLOR_SPACE_SUPPORT
-  /* The following for color space determination */
-  int srcRange, dstRange, brightness, contrast, saturation;
-  int *table;
-  const int *inv_table;
-#  endif
-
   if (anim == NULL) {
     return (-1);
   }
@@ -573,6 +761,10 @@ static int startffmpeg(struct anim *anim)
 
   pCodecCtx->workaround_bugs = 1;
 
+  /* Decode on all cores, frame threading is what makes long-GOP formats decode in real-time. */
+  pCodecCtx->thread_count = 0;
+  pCodecCtx->thread_type = FF_THREAD_FRAME | FF_THREAD_SLICE;
+
   if (avcodec_open2(pCodecCtx, pCodec, NULL) < 0) {
     avformat_close_input(&pFormatCtx);
     return -1;
@@ -692,16 +884,8 @@ static int startffmpeg(struct anim *anim)
     anim->preseek = 0;
   }
 
-  anim->img_convert_ctx = sws_getContext(anim->x,
-                                         anim->y,
-                                         anim->pCodecCtx->pix_fmt,
-                                         anim->x,
-                                         anim->y,
-                                         AV_PIX_FMT_RGBA,
-                                         SWS_FAST_BILINEAR | SWS_PRINT_INFO | SWS_FULL_CHR_H_INT,
-                                         NULL,
-                                         NULL,
-                                         NULL);
+  anim->img_convert_ctx = ffmpeg_sws_context_create(
+      anim, anim->y, SWS_FAST_BILINEAR | SWS_PRINT_INFO | SWS_FULL_CHR_H_INT);
 
   if (!anim->img_convert_ctx) {
     fprintf(stderr, "Can't transform color space??? Bailing out...\n");
@@ -714,54 +898,64 @@ static int startffmpeg(struct anim *anim)
     return -1;
   }
 
-#  ifdef FFMPEG_SWSCALE_COLOR_SPACE_SUPPORT
-  /* Try do detect if input has 0-255 YCbCR range (JFIF Jpeg MotionJpeg) */
-  if (!sws_getColorspaceDetails(anim->img_convert_ctx,
-                                (int **)&inv_table,
-                                &srcRange,
-                                &table,
-                                &dstRange,
-                                &brightness,
-                                &contrast,
-                                &saturation)) {
-    srcRange = srcRange || anim->pCodecCtx->color_range == AVCOL_RANGE_JPEG;
-    inv_table = sws_getCoefficients(anim->pCodecCtx->colorspace);
-
-    if (sws_setColorspaceDetails(anim->img_convert_ctx,
-                                 (int *)inv_table,
-                                 srcRange,
-                                 table,
-                                 dstRange,
-                                 brightness,
-                                 contrast,
-                                 saturation)) {
-      fprintf(stderr, "Warning: Could not set libswscale colorspace details.\n");
-    }
-  }
-  else {
-    fprintf(stderr, "Warning: Could not set libswscale colorspace details.\n");
-  }
-#  endif
+  ffmpeg_sws_slices_create(anim);
+  ffmpeg_decoded_frames_create(anim);
+  anim->decode_ahead_pool = BLI_task_pool_create_background(anim, TASK_PRIORITY_LOW);
 
   return 0;
 }
 
-/* postprocess the image in anim->pFrame and do color conversion
+typedef struct FFmpegConvertSliceData {
+  struct anim *anim;
+  AVFrame *input;
+  const AVPixFmtDescriptor *desc;
+  uint8_t *dst;
+  int dst_stride;
+} FFmpegConvertSliceData;
+
+static void ffmpeg_convert_slice_task(void *__restrict userdata,
+                                      const int slice,
+                                      const TaskParallelTLS *__restrict UNUSED(tls))
+{
+  FFmpegConvertSliceData *data = userdata;
+  struct anim *anim = data->anim;
+  AVFrame *input = data->input;
+  const int y0 = slice * anim->img_convert_slice_height;
+  const int height = min_ii(anim->img_convert_slice_height, anim->y - y0);
+  const uint8_t *src[4] = {NULL};
+
+  for (int plane = 0; plane < 4; plane++) {
+    if (input->data[plane] == NULL) {
+      continue;
+    }
+    /* Only the chroma planes are vertically sub-sampled. */
+    const int shift = (plane == 1 || plane == 2) ? data->desc->log2_chroma_h : 0;
+    src[plane] = input->data[plane] + (y0 >> shift) * input->linesize[plane];
+  }
+
+  /* Image is flipped vertically, the band ends up counting upwards from the bottom row. */
+  const int dstStride[4] = {-data->dst_stride, 0, 0, 0};
+  uint8_t *dst[4] = {data->dst + (anim->y - 1 - y0) * data->dst_stride, 0, 0, 0};
+
+  sws_scale(anim->img_convert_ctx_slices[slice],
+            (const uint8_t *const *)src,
+            input->linesize,
+            0,
+            height,
+            dst,
+            dstStride);
+}
+
+/* postprocess the decoded input frame and do color conversion
  * and deinterlacing stuff.
  *
- * Output is anim->last_frame
+ * Output is ibuf
  */
 
-static void ffmpeg_postprocess(struct anim *anim)
+static void ffmpeg_postprocess(struct anim *anim, AVFrame *input, ImBuf *ibuf)
 {
-  AVFrame *input = anim->pFrame;
-  ImBuf *ibuf = anim->last_frame;
   int filter_y = 0;
 
-  if (!anim->pFrameComplete) {
-    return;
-  }
-
   /* This means the data wasn't read properly,
    * this check stops crashing */
   if (input->data[0] == 0 && input->data[1] == 0 && input->data[2] == 0 && input->data[3] == 0) {
@@ -781,7 +975,7 @@ static void ffmpeg_postprocess(struct anim *anim)
 
   if (anim->ib_flags & IB_animdeinterlace) {
     if (avpicture_deinterlace((AVPicture *)anim->pFrameDeinterlaced,
-                              (const AVPicture *)anim->pFrame,
+                              (const AVPicture *)input,
                               anim->pCodecCtx->pix_fmt,
                               anim->pCodecCtx->width,
                               anim->pCodecCtx->height) < 0) {
@@ -846,6 +1040,21 @@ static void ffmpeg_postprocess(struct anim *anim)
       top -= 8 * w;
     }
   }
+  else if (anim->img_convert_slices_num > 1) {
+    FFmpegConvertSliceData data = {
+        .anim = anim,
+        .input = input,
+        .desc = av_pix_fmt_desc_get(anim->pCodecCtx->pix_fmt),
+        .dst = anim->pFrameRGB->data[0],
+        .dst_stride = anim->pFrameRGB->linesize[0],
+    };
+
+    TaskParallelSettings settings;
+    BLI_parallel_range_settings_defaults(&settings);
+    settings.min_iter_per_thread = 1;
+    BLI_task_parallel_range(
+        0, anim->img_convert_slices_num, &data, ffmpeg_convert_slice_task, &settings);
+  }
   else {
     int *dstStride = anim->pFrameRGB->linesize;
     uint8_t **dst = anim->pFrameRGB->data;
@@ -876,6 +1085,81 @@ static void ffmpeg_postprocess(struct anim *anim)
   }
 }
 
+/* Store a copy of anim->pFrame, the decoder reuses its own buffers for the next frame. */
+static void ffmpeg_decoded_frames_add(struct anim *anim)
+{
+  AnimDecodedFrame *frames = anim->decoded_frames;
+  const int64_t pts = anim->next_pts;
+
+  if (frames == NULL) {
+    return;
+  }
+
+  if (anim->decoded_frames_continuous) {
+    const int newest = (anim->decoded_frames_next + anim->decoded_frames_num - 1) %
+                       anim->decoded_frames_num;
+    if (frames[newest].frame) {
+      frames[newest].next_pts = pts;
+    }
+  }
+
+  /* Same frame decoded again after seeking, drop the old copy. */
+  for (int i = 0; i < anim->decoded_frames_num; i++) {
+    if (frames[i].frame && frames[i].pts == pts) {
+      av_frame_free(&frames[i].frame);
+      frames[i].pts = -1;
+      frames[i].next_pts = -1;
+    }
+  }
+
+  AnimDecodedFrame *entry = &frames[anim->decoded_frames_next];
+  av_frame_free(&entry->frame);
+  entry->frame = av_frame_clone(anim->pFrame);
+  entry->pts = pts;
+  entry->next_pts = -1;
+
+  anim->decoded_frames_next = (anim->decoded_frames_next + 1) % anim->decoded_frames_num;
+  anim->decoded_frames_continuous = (entry->frame != NULL);
+}
+
+/* Find the frame which is shown at pts_to_search. */
+static AnimDecodedFrame *ffmpeg_decoded_frames_find(struct anim *anim, int64_t pts_to_search)
+{
+  for (int i = 0; i < anim->decoded_frames_num; i++) {
+    AnimDecodedFrame *entry = &anim->decoded_frames[i];
+    if (entry->frame == NULL) {
+      continue;
+    }
+    if (entry->pts == pts_to_search ||
+        (entry->next_pts != -1 && entry->pts < pts_to_search && pts_to_search < entry->next_pts)) {
+      return entry;
+    }
+  }
+  return NULL;
+}
+
+/* Closest match when the exact frame could not be decoded: the first frame after
+ * pts_to_search, or the last frame of the stream. */
+static AnimDecodedFrame *ffmpeg_decoded_frames_find_nearest(struct anim *anim,
+                                                            int64_t pts_to_search)
+{
+  AnimDecodedFrame *after = NULL, *last = NULL;
+
+  for (int i = 0; i < anim->decoded_frames_num; i++) {
+    AnimDecodedFrame *entry = &anim->decoded_frames[i];
+    if (entry->frame == NULL) {
+      continue;
+    }
+    if (entry->pts >= pts_to_search && (after == NULL || entry->pts < after->pts)) {
+      after = entry;
+    }
+    if (last == NULL || entry->pts > last->pts) {
+      last = entry;
+    }
+  }
+  return after ? after : last;
+}
+
 /* decode one video frame also considering the packet read into next_packet */
 
 static int ffmpeg_decode_video_frame(struct anim *anim)
@@ -917,6 +1201,7 @@ static int ffmpeg_decode_video_frame(struct anim *anim)
                (anim->pFrame->pkt_pts == AV_NOPTS_VALUE) ? -1 :
                                                            (long long int)anim->pFrame->pkt_pts,
                (long long int)anim->next_pts);
+        ffmpeg_decoded_frames_add(anim);
         break;
       }
     }
@@ -951,6 +1236,7 @@ static int ffmpeg_decode_video_frame(struct anim *anim)
              (anim->pFrame->pts == AV_NOPTS_VALUE) ? -1 : (long long int)anim->pFrame->pts,
              (anim->pFrame->pkt_pts == AV_NOPTS_VALUE) ? -1 : (long long int)anim->pFrame->pkt_pts,
              (long long int)anim->next_pts);
+      ffmpeg_decoded_frames_add(anim);
       rval = 0;
     }
   }
@@ -1006,6 +1292,42 @@ static void ffmpeg_decode_video_frame_scan(struct anim *anim, int64_t pts_to_sea
   }
 }
 
+/* Keep decoding the frames following the last fetched one in the background, so that
+ * playback only has to pick them from the decoded frames ring buffer. Half of the buffer
+ * is used for look-ahead, the other half keeps recent frames around for scrubbing back. */
+static void ffmpeg_decode_ahead_task(TaskPool *__restrict pool, void *UNUSED(taskdata))
+{
+  struct anim *anim = BLI_task_pool_user_data(pool);
+  int frames_ahead = 0;
+
+  for (int i = 0; i < anim->decoded_frames_num; i++) {
+    if (anim->decoded_frames[i].frame && anim->decoded_frames[i].pts > anim->last_pts) {
+      frames_ahead++;
+    }
+  }
+
+  for (int count = anim->decoded_frames_num / 2 - frames_ahead; count > 0; count--) {
+    if (BLI_task_pool_canceled(pool)) {
+      break;
+    }
+    if (!ffmpeg_decode_video_frame(anim)) {
+      break;
+    }
+  }
+}
+
+static void ffmpeg_decode_ahead_start(struct anim *anim)
+{
+  BLI_task_pool_push(anim->decode_ahead_pool, ffmpeg_decode_ahead_task, NULL, false, NULL);
+}
+
+/* Decoder state is not thread safe, stop decoding ahead before touching it. A queued task is
+ * dropped, a running one stops after the frame it is decoding. */
+static void ffmpeg_decode_ahead_stop(struct anim *anim)
+{
+  BLI_task_pool_cancel(anim->decode_ahead_pool);
+}
+
 static int match_format(const char *name, AVFormatContext *pFormatCtx)
 {
   const char *p;
@@ -1065,6 +1387,9 @@ static ImBuf *ffmpeg_fetchibuf(struct anim *anim, int position, IMB_Timecode_Typ
 
   av_log(anim->pFormatCtx, AV_LOG_DEBUG, "FETCH: pos=%d\n", position);
 
+  ffmpeg_decode_ahead_stop(anim);
+  ffmpeg_decoded_frames_update(anim);
+
   if (tc != IMB_TC_NONE) {
     tc_index = IMB_anim_open_index(anim, tc);
   }
@@ -1098,24 +1423,26 @@ static ImBuf *ffmpeg_fetchibuf(struct anim *anim, int position, IMB_Timecode_Typ
          frame_rate,
          st_time);
 
-  if (anim->last_frame && anim->last_pts <= pts_to_search && anim->next_pts > pts_to_search) {
+  AnimDecodedFrame *decoded = ffmpeg_decoded_frames_find(anim, pts_to_search);
+  /* The decoder hasn't passed the frame we are looking for yet. */
+  const bool decoder_before_pts = anim->next_pts != -1 && anim->next_pts <= pts_to_search;
+
+  if (decoded) {
     av_log(anim->pFormatCtx,
            AV_LOG_DEBUG,
-           "FETCH: frame repeat: last: %lld next: %lld\n",
-           (long long int)anim->last_pts,
-           (long long int)anim->next_pts);
-    IMB_refImBuf(anim->last_frame);
-    anim->curposition = position;
-    return anim->last_frame;
+           "FETCH: frame already decoded: pts: %lld next: %lld\n",
+           (long long int)decoded->pts,
+           (long long int)decoded->next_pts);
   }
-
-  if (position > anim->curposition + 1 && anim->preseek && !tc_index &&
-      position - (anim->curposition + 1) < anim->preseek) {
+  else if (decoder_before_pts && !tc_index && position > anim->curposition &&
+           position - anim->curposition <= MAX2(anim->preseek, 1)) {
     av_log(anim->pFormatCtx, AV_LOG_DEBUG, "FETCH: within preseek interval (no index)\n");
 
     ffmpeg_decode_video_frame_scan(anim, pts_to_search);
   }
-  else if (tc_index && IMB_indexer_can_scan(tc_index, old_frame_index, new_frame_index)) {
+  else if (decoder_before_pts && tc_index &&
+           (position == anim->curposition + 1 ||
+            IMB_indexer_can_scan(tc_index, old_frame_index, new_frame_index))) {
     av_log(anim->pFormatCtx,
            AV_LOG_DEBUG,
            "FETCH: within preseek interval "
@@ -1123,7 +1450,12 @@ static ImBuf *ffmpeg_fetchibuf(struct anim *anim, int position, IMB_Timecode_Typ
 
     ffmpeg_decode_video_frame_scan(anim, pts_to_search);
   }
-  else if (position != anim->curposition + 1) {
+  else if (position == 0 && anim->curposition == -1) {
+    /* first frame without seeking special case... */
+    ffmpeg_decode_video_frame(anim);
+    ffmpeg_decode_video_frame_scan(anim, pts_to_search);
+  }
+  else {
     long long pos;
     int ret;
 
@@ -1184,62 +1516,68 @@ static ImBuf *ffmpeg_fetchibuf(struct anim *anim, int position, IMB_Timecode_Typ
     avcodec_flush_buffers(anim->pCodecCtx);
 
     anim->next_pts = -1;
+    anim->decoded_frames_continuous = false;
 
     if (anim->next_packet.stream_index == anim->videoStream) {
       av_free_packet(&anim->next_packet);
       anim->next_packet.stream_index = -1;
     }
 
-    /* memset(anim->pFrame, ...) ?? */
-
     if (ret >= 0) {
       ffmpeg_decode_video_frame_scan(anim, pts_to_search);
     }
   }
-  else if (position == 0 && anim->curposition == -1) {
-    /* first frame without seeking special case... */
-    ffmpeg_decode_video_frame(anim);
+
+  if (decoded == NULL) {
+    decoded = ffmpeg_decoded_frames_find(anim, pts_to_search);
   }
-  else {
-    av_log(anim->pFormatCtx, AV_LOG_DEBUG, "FETCH: no seek necessary, just continue...\n");
+  if (decoded == NULL) {
+    decoded = ffmpeg_decoded_frames_find_nearest(anim, pts_to_search);
   }
 
-  IMB_freeImBuf(anim->last_frame);
-
-  /* Certain versions of FFmpeg have a bug in libswscale which ends up in crash
-   * when destination buffer is not properly aligned. For example, this happens
-   * in FFmpeg 4.3.1. It got fixed later on, but for compatibility reasons is
-   * still best to avoid crash.
-   *
-   * This is achieved by using own allocation call rather than relying on
-   * IMB_allocImBuf() to do so since the IMB_allocImBuf() is not guaranteed
-   * to perform aligned allocation.
-   *
-   * In theory this could give better performance, since SIMD operations on
-   * aligned data are usually faster.
-   *
-   * Note that even though sometimes vertical flip is required it does not
-   * affect on alignment of data passed to sws_scale because if the X dimension
-   * is not 32 byte aligned special intermediate buffer is allocated.
-   *
-   * The issue was reported to FFmpeg under ticket #8747 in the FFmpeg tracker
-   * and is fixed in the newer versions than 4.3.1. */
-  anim->last_frame = IMB_allocImBuf(anim->x, anim->y, 32, 0);
-  anim->last_frame->rect = MEM_mallocN_aligned((size_t)4 * anim->x * anim->y, 32, "ffmpeg ibuf");
-  anim->last_frame->mall |= IB_rect;
-
-  anim->last_frame->rect_colorspace = colormanage_colorspace_get_named(anim->colorspace);
+  if (anim->last_frame == NULL || decoded == NULL || decoded->pts != anim->last_pts) {
+    IMB_freeImBuf(anim->last_frame);
 
-  ffmpeg_postprocess(anim);
+    /* Certain versions of FFmpeg have a bug in libswscale which ends up in crash
+     * when destination buffer is not properly aligned. For example, this happens
+     * in FFmpeg 4.3.1. It got fixed later on, but for compatibility reasons is
+     * still best to avoid crash.
+     *
+     * This is achieved by using own allocation call rather than relying on
+     * IMB_allocImBuf() to do so since the IMB_allocImBuf() is not guaranteed
+     * to perform aligned allocation.
+     *
+     * In theory this could give better performance, since SIMD operations on
+     * aligned data are usually faster.
+     *
+     * Note that even though sometimes vertical flip is required it does not
+     * affect on alignment of data passed to sws_scale because if the X dimension
+     * is not 32 byte aligned special intermediate buffer is allocated.
+     *
+     * The issue was reported to FFmpeg under ticket #8747 in the FFmpeg tracker
+     * and is fixed in the newer versions than 4.3.1. */
+    anim->last_frame = IMB_allocImBuf(anim->x, anim->y, 32, 0);
+    anim->last_frame->rect = MEM_mallocN_aligned(
+        (size_t)4 * anim->x * anim->y, 32, "ffmpeg ibuf");
+    anim->last_frame->mall |= IB_rect;
 
-  anim->last_pts = anim->next_pts;
+    anim->last_frame->rect_colorspace = colormanage_colorspace_get_named(anim->colorspace);
 
-  ffmpeg_decode_video_frame(anim);
+    if (decoded) {
+      ffmpeg_postprocess(anim, decoded->frame, anim->last_frame);
+    }
+    else {
+      memset(anim->last_frame->rect, 0, (size_t)4 * anim->x * anim->y);
+    }
+  }
 
+  anim->last_pts = decoded ? decoded->pts : -1;
   anim->curposition = position;
 
   IMB_refImBuf(anim->last_frame);
 
+  ffmpeg_decode_ahead_start(anim);
+
   return anim->last_frame;
 }
 
@@ -1250,6 +1588,10 @@ static void free_anim_ffmpeg(struct anim *anim)
   }
 
   if (anim->pCodecCtx) {
+    BLI_task_pool_free(anim->decode_ahead_pool);
+    anim->decode_ahead_pool = NULL;
+    ffmpeg_decoded_frames_free(anim);
+
     avcodec_close(anim->pCodecCtx);
     avformat_close_input(&anim->pFormatCtx);
 
@@ -1272,6 +1614,11 @@ static void free_anim_ffmpeg(struct anim *anim)
     av_frame_free(&anim->pFrameDeinterlaced);
 
     sws_freeContext(anim->img_convert_ctx);
+    for (int i = 0; i < anim->img_convert_slices_num; i++) {
+      sws_freeContext(anim->img_convert_ctx_slices[i]);
+      anim->img_convert_ctx_slices[i] = NULL;
+    }
+    anim->img_convert_slices_num = 0;
     IMB_freeImBuf(anim->last_frame);
     if (anim->next_packet.stream_index != -1) {
       av_free_packet(&anim->next_packet);
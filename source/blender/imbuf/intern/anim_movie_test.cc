@@ -0,0 +1,264 @@
+/* Apache License, Version 2.0 */
+
+#include "testing/testing.h"
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "BLI_fileops.h"
+#include "BLI_sys_types.h"
+#include "BLI_threads.h"
+
+#include "MEM_CacheLimiterC-Api.h"
+
+#include "IMB_imbuf.h"
+#include "IMB_imbuf_types.h"
+
+extern "C" {
+#include <libavcodec/avcodec.h>
+#include <libavformat/avformat.h>
+#include <libavutil/log.h>
+}
+
+namespace blender::imbuf::tests {
+
+static const int MOVIE_WIDTH = 64;
+static const int MOVIE_HEIGHT = 48;
+static const int MOVIE_FRAMES = 48;
+static const int MOVIE_GOP_SIZE = 12;
+
+/* Every frame is a flat gray, brighter for every frame, so frames can be told apart. */
+static int movie_frame_luma(int frame)
+{
+  return 16 + frame * 4;
+}
+
+static bool movie_write_packets(AVFormatContext *format_ctx,
+                                AVCodecContext *codec_ctx,
+                                AVStream *stream,
+                                AVFrame *frame)
+{
+  if (avcodec_send_frame(codec_ctx, frame) < 0) {
+    return false;
+  }
+
+  AVPacket *packet = av_packet_alloc();
+  bool ok = true;
+
+  while (avcodec_receive_packet(codec_ctx, packet) >= 0) {
+    av_packet_rescale_ts(packet, codec_ctx->time_base, stream->time_base);
+    packet->stream_index = stream->index;
+    if (av_interleaved_write_frame(format_ctx, packet) < 0) {
+      ok = false;
+    }
+  }
+
+  av_packet_free(&packet);
+  return ok;
+}
+
+/* Encode a short MPEG-4 movie, with a keyframe every MOVIE_GOP_SIZE frames. */
+static bool movie_write(const char *filepath)
+{
+  AVFormatContext *format_ctx = nullptr;
+  if (avformat_alloc_output_context2(&format_ctx, nullptr, "mov", filepath) < 0) {
+    return false;
+  }
+
+  AVCodec *codec = avcodec_find_encoder(AV_CODEC_ID_MPEG4);
+  AVStream *stream = avformat_new_stream(format_ctx, nullptr);
+  AVCodecContext *codec_ctx = avcodec_alloc_context3(codec);
+
+  codec_ctx->width = MOVIE_WIDTH;
+  codec_ctx->height = MOVIE_HEIGHT;
+  codec_ctx->pix_fmt = AV_PIX_FMT_YUV420P;
+  codec_ctx->time_base = {1, 24};
+  codec_ctx->gop_size = MOVIE_GOP_SIZE;
+  codec_ctx->max_b_frames = 0;
+  codec_ctx->qmin = codec_ctx->qmax = 2;
+  if (format_ctx->oformat->flags & AVFMT_GLOBALHEADER) {
+    codec_ctx->flags |= AV_CODEC_FLAG_GLOBAL_HEADER;
+  }
+
+  bool ok = avcodec_open2(codec_ctx, codec, nullptr) >= 0 &&
+            avcodec_parameters_from_context(stream->codecpar, codec_ctx) >= 0 &&
+            avio_open(&format_ctx->pb, filepath, AVIO_FLAG_WRITE) >= 0;
+  stream->time_base = codec_ctx->time_base;
+
+  if (ok) {
+    ok = avformat_write_header(format_ctx, nullptr) >= 0;
+  }
+
+  AVFrame *frame = av_frame_alloc();
+  frame->format = codec_ctx->pix_fmt;
+  frame->width = codec_ctx->width;
+  frame->height = codec_ctx->height;
+  ok = ok && av_frame_get_buffer(frame, 0) >= 0;
+
+  for (int i = 0; ok && i < MOVIE_FRAMES; i++) {
+    ok = av_frame_make_writable(frame) >= 0;
+    for (int y = 0; ok && y < MOVIE_HEIGHT; y++) {
+      memset(frame->data[0] + y * frame->linesize[0], movie_frame_luma(i), MOVIE_WIDTH);
+    }
+    for (int y = 0; ok && y < MOVIE_HEIGHT / 2; y++) {
+      memset(frame->data[1] + y * frame->linesize[1], 128, MOVIE_WIDTH / 2);
+      memset(frame->data[2] + y * frame->linesize[2], 128, MOVIE_WIDTH / 2);
+    }
+    frame->pts = i;
+    ok = ok && movie_write_packets(format_ctx, codec_ctx, stream, frame);
+  }
+  /* Flush the encoder. */
+  ok = ok && movie_write_packets(format_ctx, codec_ctx, stream, nullptr);
+  ok = ok && av_write_trailer(format_ctx) >= 0;
+
+  av_frame_free(&frame);
+  avcodec_free_context(&codec_ctx);
+  avio_closep(&format_ctx->pb);
+  avformat_free_context(format_ctx);
+  return ok;
+}
+
+class AnimMovieTest : public ::testing::Test {
+ protected:
+  static void SetUpTestCase()
+  {
+    av_log_set_level(AV_LOG_QUIET);
+    BLI_threadapi_init();
+    IMB_ffmpeg_init();
+
+    filepath = (std::filesystem::temp_directory_path() / "imbuf_anim_movie_test.mov").string();
+    ASSERT_TRUE(movie_write(filepath.c_str()));
+
+    /* Reference frames, each decoded by a freshly opened movie. */
+    reference_frames.resize(MOVIE_FRAMES);
+    for (int i = 0; i < MOVIE_FRAMES; i++) {
+      struct anim *anim = open_anim();
+      ASSERT_NE(anim, nullptr);
+      ImBuf *ibuf = IMB_anim_absolute(anim, i, IMB_TC_NONE, IMB_PROXY_NONE);
+      ASSERT_NE(ibuf, nullptr);
+      reference_frames[i].assign(ibuf->rect, ibuf->rect + MOVIE_WIDTH * MOVIE_HEIGHT);
+      IMB_freeImBuf(ibuf);
+      IMB_free_anim(anim);
+    }
+  }
+
+  static void TearDownTestCase()
+  {
+    BLI_delete(filepath.c_str(), false, false);
+    reference_frames.clear();
+    BLI_threadapi_exit();
+  }
+
+  void SetUp() override
+  {
+    old_maximum = MEM_CacheLimiter_get_maximum();
+  }
+
+  void TearDown() override
+  {
+    MEM_CacheLimiter_set_maximum(old_maximum);
+  }
+
+  static struct anim *open_anim()
+  {
+    char colorspace[IM_MAX_SPACE] = "sRGB";
+    return IMB_open_anim(filepath.c_str(), IB_rect, 0, colorspace);
+  }
+
+  /* Fetch the frames in order from a single movie, which decodes ahead in between fetches. */
+  static void expect_frames(const std::vector<int> &frames)
+  {
+    struct anim *anim = open_anim();
+    ASSERT_NE(anim, nullptr);
+
+    for (int frame : frames) {
+      ImBuf *ibuf = IMB_anim_absolute(anim, frame, IMB_TC_NONE, IMB_PROXY_NONE);
+      ASSERT_NE(ibuf, nullptr) << "frame " << frame;
+      ASSERT_EQ(ibuf->x, MOVIE_WIDTH);
+      ASSERT_EQ(ibuf->y, MOVIE_HEIGHT);
+      EXPECT_EQ(memcmp(ibuf->rect,
+                       reference_frames[frame].data(),
+                       sizeof(uint) * MOVIE_WIDTH * MOVIE_HEIGHT),
+                0)
+          << "frame " << frame;
+      IMB_freeImBuf(ibuf);
+    }
+
+    IMB_free_anim(anim);
+  }
+
+  size_t old_maximum;
+
+  static std::string filepath;
+  static std::vector<std::vector<uint>> reference_frames;
+};
+
+std::string AnimMovieTest::filepath;
+std::vector<std::vector<uint>> AnimMovieTest::reference_frames;
+
+static std::vector<int> random_frames(int num)
+{
+  std::mt19937 rng(1234);
+  std::uniform_int_distribution<int> frame_dist(0, MOVIE_FRAMES - 1);
+  std::uniform_int_distribution<int> step_dist(-2, 3);
+  std::vector<int> frames;
+
+  /* Mix of jumps and short steps around the previous frame, both ways. */
+  int frame = 0;
+  for (int i = 0; i < num; i++) {
+    if (i % 3 == 0) {
+      frame = frame_dist(rng);
+    }
+    else {
+      frame = std::clamp(frame + step_dist(rng), 0, MOVIE_FRAMES - 1);
+    }
+    frames.push_back(frame);
+  }
+  return frames;
+}
+
+TEST_F(AnimMovieTest, ReferenceFrames)
+{
+  /* Frames are told apart by their gray level, which the encoder keeps within a few steps. */
+  for (int i = 0; i < MOVIE_FRAMES; i++) {
+    const uchar *pixel = (const uchar *)&reference_frames[i][MOVIE_WIDTH * MOVIE_HEIGHT / 2];
+    const int expected = (movie_frame_luma(i) - 16) * 255 / 219;
+    EXPECT_NEAR(pixel[0], expected, 6) << "frame " << i;
+  }
+}
+
+TEST_F(AnimMovieTest, PlayForward)
+{
+  std::vector<int> frames;
+  for (int i = 0; i < MOVIE_FRAMES; i++) {
+    frames.push_back(i);
+  }
+  expect_frames(frames);
+}
+
+TEST_F(AnimMovieTest, ScrubBackward)
+{
+  std::vector<int> frames;
+  for (int i = MOVIE_FRAMES - 1; i >= 0; i--) {
+    frames.push_back(i);
+  }
+  expect_frames(frames);
+}
+
+TEST_F(AnimMovieTest, RandomSeek)
+{
+  expect_frames(random_frames(200));
+}
+
+/* With a tiny memory cache limit the ring buffer only holds the smallest number of frames. */
+TEST_F(AnimMovieTest, RandomSeekSmallBudget)
+{
+  MEM_CacheLimiter_set_maximum(1);
+  expect_frames(random_frames(200));
+}
+
+}  // namespace blender::imbuf::tests
@@ -32,6 +32,7 @@
 #include "DNA_movieclip_types.h"
 #include "DNA_scene_types.h"
 #include "DNA_space_types.h"
+#include "DNA_userdef_types.h"
 
 #include "IMB_filetype.h"
 #include "IMB_filter.h"
@@ -43,6 +44,7 @@
 #include "MEM_guardedalloc.h"
 
 #include "BLI_blenlib.h"
+#include "BLI_hash_mm2a.h"
 #include "BLI_math.h"
 #include "BLI_math_color.h"
 #include "BLI_rect.h"
@@ -130,6 +132,37 @@ static struct global_glsl_state {
   struct OCIO_GLSLDrawState *ocio_glsl_state;
 } global_glsl_state = {NULL};
 
+/* Display transforms baked into a 3D LUT, used when the CPU display LUT option is enabled. */
+typedef struct DisplayLUTCacheEntry {
+  struct DisplayLUTCacheEntry *next, *prev;
+
+  /* Settings the LUT was baked for. */
+  char look[MAX_COLORSPACE_NAME];
+  char view[MAX_COLORSPACE_NAME];
+  char display[MAX_COLORSPACE_NAME];
+  float exposure, gamma;
+  bool use_curve_mapping;
+  uint32_t curve_mapping_hash;
+
+  /* Exact processor, used for baking and for pixels outside of the LUT domain. */
+  ColormanageProcessor *cm_processor;
+  /* NULL while the LUT is being baked. */
+  ColormanageLUT *lut;
+  int users;
+} DisplayLUTCacheEntry;
+
+/* Resolution and input range of baked display LUTs. */
+#define DISPLAY_LUT_SIZE 65
+#define DISPLAY_LUT_DOMAIN_MAX 64.0f
+/* Baking costs about as much as transforming this many pixels the exact way. */
+#define DISPLAY_LUT_MIN_PIXELS (256 * 256)
+#define DISPLAY_LUT_CACHE_MAX 4
+
+static ListBase global_display_luts = {NULL, NULL};
+static ThreadMutex display_lut_lock = BLI_MUTEX_INITIALIZER;
+/* Signaled when a LUT finished baking. */
+static ThreadCondition display_lut_baked;
+
 static struct global_color_picking_state {
   /* Cached processor for color picking conversion. */
   OCIO_ConstProcessorRcPtr *processor_to;
@@ -666,6 +699,8 @@ void colormanagement_init(void)
 
   OCIO_init();
 
+  BLI_condition_init(&display_lut_baked);
+
   ocio_env = BLI_getenv("OCIO");
 
   if (ocio_env && ocio_env[0] != '\0') {
@@ -757,6 +792,15 @@ void colormanagement_exit(void)
   memset(&global_glsl_state, 0, sizeof(global_glsl_state));
   memset(&global_color_picking_state, 0, sizeof(global_color_picking_state));
 
+  LISTBASE_FOREACH_MUTABLE (DisplayLUTCacheEntry *, entry, &global_display_luts) {
+    BLI_assert(entry->users == 0);
+    colormanage_lut_free(entry->lut);
+    IMB_colormanagement_processor_free(entry->cm_processor);
+    MEM_freeN(entry);
+  }
+  BLI_listbase_clear(&global_display_luts);
+  BLI_condition_end(&display_lut_baked);
+
   colormanage_free_config();
 }
 
@@ -1486,6 +1530,7 @@ const float *IMB_colormangement_get_xyz_to_rgb()
 
 typedef struct DisplayBufferThread {
   ColormanageProcessor *cm_processor;
+  const ColormanageLUT *lut;
 
   const float *buffer;
   unsigned char *byte_buffer;
@@ -1509,6 +1554,7 @@ typedef struct DisplayBufferThread {
 typedef struct DisplayBufferInitData {
   ImBuf *ibuf;
   ColormanageProcessor *cm_processor;
+  const ColormanageLUT *lut;
   const float *buffer;
   unsigned char *byte_buffer;
 
@@ -1540,6 +1586,7 @@ static void display_buffer_init_handle(void *handle_v,
   memset(handle, 0, sizeof(DisplayBufferThread));
 
   handle->cm_processor = init_data->cm_processor;
+  handle->lut = init_data->lut;
 
   if (init_data->buffer) {
     handle->buffer = init_data->buffer + offset;
@@ -1701,6 +1748,9 @@ static void *do_display_buffer_apply_thread(void *handle_v)
        * only generate byte buffers
        */
     }
+    else if (handle->lut && channels >= 3) {
+      colormanage_lut_apply(handle->lut, linear_buffer, width, height, channels, predivide);
+    }
     else {
       /* apply processor */
       IMB_colormanagement_processor_apply(
@@ -1748,12 +1798,14 @@ static void display_buffer_apply_threaded(ImBuf *ibuf,
                                           unsigned char *byte_buffer,
                                           float *display_buffer,
                                           unsigned char *display_buffer_byte,
-                                          ColormanageProcessor *cm_processor)
+                                          ColormanageProcessor *cm_processor,
+                                          const ColormanageLUT *lut)
 {
   DisplayBufferInitData init_data;
 
   init_data.ibuf = ibuf;
   init_data.cm_processor = cm_processor;
+  init_data.lut = lut;
   init_data.buffer = buffer;
   init_data.byte_buffer = byte_buffer;
   init_data.display_buffer = display_buffer;
@@ -1784,6 +1836,178 @@ static void display_buffer_apply_threaded(ImBuf *ibuf,
                                do_display_buffer_apply_thread);
 }
 
+static void display_lut_evaluate(void *userdata, float *rgb, int num_pixels)
+{
+  ColormanageProcessor *cm_processor = userdata;
+
+  if (cm_processor->curve_mapping) {
+    for (int i = 0; i < num_pixels; i++) {
+      curve_mapping_apply_pixel(cm_processor->curve_mapping, rgb + 3 * i, 3);
+    }
+  }
+
+  if (cm_processor->processor) {
+    if (num_pixels == 1) {
+      OCIO_processorApplyRGB(cm_processor->processor, rgb);
+    }
+    else {
+      OCIO_PackedImageDesc *img = OCIO_createOCIO_PackedImageDesc(rgb,
+                                                                  num_pixels,
+                                                                  1,
+                                                                  3,
+                                                                  sizeof(float),
+                                                                  3 * sizeof(float),
+                                                                  (size_t)3 * sizeof(float) *
+                                                                      num_pixels);
+      OCIO_processorApply(cm_processor->processor, img);
+      OCIO_PackedImageDescRelease(img);
+    }
+  }
+}
+
+/* Hash of the curve mapping settings that affect evaluation, so equal curves share a LUT no
+ * matter which settings they belong to or how often they were edited. */
+static uint32_t display_lut_curve_mapping_hash(const CurveMapping *curve_mapping)
+{
+  BLI_HashMurmur2A mm2;
+  BLI_hash_mm2a_init(&mm2, 0);
+
+  BLI_hash_mm2a_add_int(&mm2, curve_mapping->flag & (CUMA_DO_CLIP | CUMA_EXTEND_EXTRAPOLATE));
+  BLI_hash_mm2a_add_int(&mm2, curve_mapping->tone);
+  BLI_hash_mm2a_add(&mm2, (const uchar *)&curve_mapping->clipr, sizeof(curve_mapping->clipr));
+  BLI_hash_mm2a_add(&mm2, (const uchar *)curve_mapping->black, sizeof(curve_mapping->black));
+  BLI_hash_mm2a_add(&mm2, (const uchar *)curve_mapping->white, sizeof(curve_mapping->white));
+
+  for (int i = 0; i < CM_TOT; i++) {
+    const CurveMap *cuma = &curve_mapping->cm[i];
+    BLI_hash_mm2a_add_int(&mm2, cuma->totpoint);
+    for (int a = 0; a < cuma->totpoint; a++) {
+      const CurveMapPoint *point = &cuma->curve[a];
+      BLI_hash_mm2a_add(&mm2, (const uchar *)&point->x, sizeof(point->x));
+      BLI_hash_mm2a_add(&mm2, (const uchar *)&point->y, sizeof(point->y));
+      BLI_hash_mm2a_add_int(&mm2, point->flag & (CUMA_HANDLE_VECTOR | CUMA_HANDLE_AUTO_ANIM));
+    }
+  }
+
+  return BLI_hash_mm2a_end(&mm2);
+}
+
+static bool display_lut_entry_matches(const DisplayLUTCacheEntry *entry,
+                                      const ColorManagedViewSettings *view_settings,
+                                      const ColorManagedDisplaySettings *display_settings,
+                                      const CurveMapping *curve_mapping,
+                                      uint32_t curve_mapping_hash)
+{
+  return entry->exposure == view_settings->exposure && entry->gamma == view_settings->gamma &&
+         STREQ(entry->look, view_settings->look) &&
+         STREQ(entry->view, view_settings->view_transform) &&
+         STREQ(entry->display, display_settings->display_device) &&
+         entry->use_curve_mapping == (curve_mapping != NULL) &&
+         (curve_mapping == NULL || entry->curve_mapping_hash == curve_mapping_hash);
+}
+
+/**
+ * Get the display transform baked into a 3D LUT, baking it if needed.
+ * Returns NULL when the exact processor should be used instead.
+ * The entry must be released with #display_lut_release.
+ */
+static DisplayLUTCacheEntry *display_lut_acquire(
+    const ImBuf *ibuf,
+    const ColorManagedViewSettings *view_settings,
+    const ColorManagedDisplaySettings *display_settings)
+{
+  ColorManagedViewSettings default_view_settings;
+
+  if (!U.experimental.use_display_lut || ibuf->channels < 3 ||
+      (size_t)ibuf->x * ibuf->y < DISPLAY_LUT_MIN_PIXELS) {
+    return NULL;
+  }
+
+  if (view_settings == NULL) {
+    IMB_colormanagement_init_default_view_settings(&default_view_settings, display_settings);
+    view_settings = &default_view_settings;
+  }
+
+  const CurveMapping *curve_mapping = (view_settings->flag & COLORMANAGE_VIEW_USE_CURVES) ?
+                                          view_settings->curve_mapping :
+                                          NULL;
+
+  /* Curves are applied to premultiplied color before the display transform divides by alpha,
+   * that order can't be baked into a single LUT. */
+  if (curve_mapping && ibuf->rect_float && IMB_alpha_affects_rgb(ibuf)) {
+    return NULL;
+  }
+
+  const uint32_t curve_mapping_hash = curve_mapping ?
+                                          display_lut_curve_mapping_hash(curve_mapping) :
+                                          0;
+
+  BLI_mutex_lock(&display_lut_lock);
+  LISTBASE_FOREACH (DisplayLUTCacheEntry *, entry, &global_display_luts) {
+    if (display_lut_entry_matches(
+            entry, view_settings, display_settings, curve_mapping, curve_mapping_hash)) {
+      BLI_remlink(&global_display_luts, entry);
+      BLI_addhead(&global_display_luts, entry);
+      entry->users++;
+      /* Another thread is baking the same LUT. */
+      while (entry->lut == NULL) {
+        BLI_condition_wait(&display_lut_baked, &display_lut_lock);
+      }
+      BLI_mutex_unlock(&display_lut_lock);
+      return entry;
+    }
+  }
+
+  /* Add the entry before baking, so other threads wait for it instead of baking it again. */
+  DisplayLUTCacheEntry *new_entry = MEM_callocN(sizeof(DisplayLUTCacheEntry), __func__);
+  STRNCPY(new_entry->look, view_settings->look);
+  STRNCPY(new_entry->view, view_settings->view_transform);
+  STRNCPY(new_entry->display, display_settings->display_device);
+  new_entry->exposure = view_settings->exposure;
+  new_entry->gamma = view_settings->gamma;
+  new_entry->use_curve_mapping = (curve_mapping != NULL);
+  new_entry->curve_mapping_hash = curve_mapping_hash;
+  new_entry->users = 1;
+  BLI_addhead(&global_display_luts, new_entry);
+  BLI_mutex_unlock(&display_lut_lock);
+
+  /* Bake outside of the lock, other views can keep drawing meanwhile. */
+  ColormanageProcessor *cm_processor = IMB_colormanagement_display_processor_new(
+      view_settings, display_settings);
+  ColormanageLUT *lut = colormanage_lut_create(
+      DISPLAY_LUT_SIZE, DISPLAY_LUT_DOMAIN_MAX, display_lut_evaluate, cm_processor);
+
+  BLI_mutex_lock(&display_lut_lock);
+  new_entry->cm_processor = cm_processor;
+  new_entry->lut = lut;
+  BLI_condition_notify_all(&display_lut_baked);
+
+  /* Evict least recently used LUTs which are not in use. */
+  int num_entries = BLI_listbase_count(&global_display_luts);
+  DisplayLUTCacheEntry *entry = global_display_luts.last;
+  while (entry && num_entries > DISPLAY_LUT_CACHE_MAX) {
+    DisplayLUTCacheEntry *prev = entry->prev;
+    if (entry->users == 0) {
+      BLI_remlink(&global_display_luts, entry);
+      colormanage_lut_free(entry->lut);
+      IMB_colormanagement_processor_free(entry->cm_processor);
+      MEM_freeN(entry);
+      num_entries--;
+    }
+    entry = prev;
+  }
+  BLI_mutex_unlock(&display_lut_lock);
+
+  return new_entry;
+}
+
+static void display_lut_release(DisplayLUTCacheEntry *entry)
+{
+  BLI_mutex_lock(&display_lut_lock);
+  entry->users--;
+  BLI_mutex_unlock(&display_lut_lock);
+}
+
 static bool is_ibuf_rect_in_display_space(ImBuf *ibuf,
                                           const ColorManagedViewSettings *view_settings,
                                           const ColorManagedDisplaySettings *display_settings)
@@ -1814,6 +2038,7 @@ static void colormanage_display_buffer_process_ex(
     const ColorManagedDisplaySettings *display_settings)
 {
   ColormanageProcessor *cm_processor = NULL;
+  DisplayLUTCacheEntry *display_lut = NULL;
   bool skip_transform = false;
 
   /* if we're going to transform byte buffer, check whether transformation would
@@ -1827,6 +2052,7 @@ static void colormanage_display_buffer_process_ex(
 
   if (skip_transform == false) {
     cm_processor = IMB_colormanagement_display_processor_new(view_settings, display_settings);
+    display_lut = display_lut_acquire(ibuf, view_settings, display_settings);
   }
 
   display_buffer_apply_threaded(ibuf,
@@ -1834,7 +2060,12 @@ static void colormanage_display_buffer_process_ex(
                                 (unsigned char *)ibuf->rect,
                                 display_buffer,
                                 display_buffer_byte,
-                                cm_processor);
+                                cm_processor,
+                                display_lut ? display_lut->lut : NULL);
+
+  if (display_lut) {
+    display_lut_release(display_lut);
+  }
 
   if (cm_processor) {
     IMB_colormanagement_processor_free(cm_processor);
@@ -0,0 +1,373 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+/** \file
+ * \ingroup imbuf
+ *
+ * Baked 3D LUT for applying a color transform on the CPU.
+ *
+ * Input values go through a 1D shaper before the 3D lookup. The shaper spends half of the grid
+ * evenly over stops of the input range, and the other half where the transform changes most along
+ * the neutral axis. That puts grid points on the toe and shoulder of view transforms, where a
+ * uniform grid would smooth out curvature and clipping. Pixels are looked up with tetrahedral
+ * interpolation, values outside of the LUT domain are passed to the exact transform instead.
+ */
+
+#include <math.h>
+
+#include "MEM_guardedalloc.h"
+
+#include "BLI_math_base.h"
+#include "BLI_math_vector.h"
+#include "BLI_task.h"
+#include "BLI_utildefines.h"
+
+#include "IMB_colormanagement_intern.h"
+
+#ifdef __SSE2__
+#  include <emmintrin.h>
+#endif
+
+/* Offset added before taking the logarithm, gives the shaper a near linear toe around zero. */
+#define COLORMANAGE_LUT_SHAPER_OFFSET (1.0f / 1024.0f)
+/* Number of samples of the shaper curve. */
+#define COLORMANAGE_LUT_SHAPER_SIZE 1024
+/* Part of the grid distributed by how much the transform changes. */
+#define COLORMANAGE_LUT_SHAPER_ADAPTIVE 0.5f
+/* Number of pixels outside of the LUT domain passed to the exact transform at once. */
+#define COLORMANAGE_LUT_BATCH_SIZE 256
+
+struct ColormanageLUT {
+  int size;
+  float domain_max;
+
+  /* Maps log2(x + offset) to shaper sample positions. */
+  float shaper_log_min;
+  float shaper_log_scale;
+  /* Grid coordinate for each shaper sample, strictly increasing from 0 to size - 1. */
+  float *shaper;
+
+  /* size^3 entries with X varying fastest, RGB plus padding so an entry can be loaded as one
+   * SSE register. */
+  float (*table)[4];
+
+  ColormanageLUTEvaluateFn evaluate;
+  void *userdata;
+};
+
+BLI_INLINE float lut_shaper_sample_from_value(const ColormanageLUT *lut, float value)
+{
+  return (log2f(value + COLORMANAGE_LUT_SHAPER_OFFSET) - lut->shaper_log_min) *
+         lut->shaper_log_scale;
+}
+
+BLI_INLINE float lut_shaper_value_from_sample(const ColormanageLUT *lut, float sample)
+{
+  return exp2f(sample / lut->shaper_log_scale + lut->shaper_log_min) -
+         COLORMANAGE_LUT_SHAPER_OFFSET;
+}
+
+BLI_INLINE float lut_shaper_to_grid(const ColormanageLUT *lut, float value)
+{
+  const float sample = lut_shaper_sample_from_value(lut, value);
+  const int index = clamp_i((int)sample, 0, COLORMANAGE_LUT_SHAPER_SIZE - 2);
+  const float fac = sample - (float)index;
+  return lut->shaper[index] + fac * (lut->shaper[index + 1] - lut->shaper[index]);
+}
+
+static float lut_shaper_from_grid(const ColormanageLUT *lut, float grid)
+{
+  /* Binary search for the shaper segment containing the grid coordinate. */
+  int low = 0, high = COLORMANAGE_LUT_SHAPER_SIZE - 1;
+  while (high - low > 1) {
+    const int mid = (low + high) / 2;
+    if (lut->shaper[mid] <= grid) {
+      low = mid;
+    }
+    else {
+      high = mid;
+    }
+  }
+
+  const float fac = (grid - lut->shaper[low]) / (lut->shaper[high] - lut->shaper[low]);
+  return lut_shaper_value_from_sample(lut, (float)low + fac);
+}
+
+/* -------------------------------------------------------------------- */
+/** \name LUT Baking
+ * \{ */
+
+static void lut_bake_shaper(ColormanageLUT *lut)
+{
+  const int num_samples = COLORMANAGE_LUT_SHAPER_SIZE;
+  float *rgb = MEM_mallocN(sizeof(float[3]) * num_samples, __func__);
+  float *weight = MEM_mallocN(sizeof(float) * num_samples, __func__);
+
+  lut->shaper_log_min = log2f(COLORMANAGE_LUT_SHAPER_OFFSET);
+  lut->shaper_log_scale = (float)(num_samples - 1) /
+                          (log2f(lut->domain_max + COLORMANAGE_LUT_SHAPER_OFFSET) -
+                           lut->shaper_log_min);
+
+  /* Response of the transform along the neutral axis. */
+  for (int i = 0; i < num_samples; i++) {
+    const float value = lut_shaper_value_from_sample(lut, (float)i);
+    rgb[i * 3 + 0] = rgb[i * 3 + 1] = rgb[i * 3 + 2] = value;
+  }
+  lut->evaluate(lut->userdata, rgb, num_samples);
+
+  float total_change = 0.0f;
+  for (int i = 0; i < num_samples - 1; i++) {
+    const float *a = &rgb[i * 3], *b = &rgb[(i + 1) * 3];
+    const float change = fabsf(b[0] - a[0]) + fabsf(b[1] - a[1]) + fabsf(b[2] - a[2]);
+    /* NaN from the transform shouldn't break the shaper. */
+    weight[i] = (change == change) ? change : 0.0f;
+    total_change += weight[i];
+  }
+
+  const float adaptive = (total_change > 0.0f) ? COLORMANAGE_LUT_SHAPER_ADAPTIVE : 0.0f;
+  float accum = 0.0f;
+  lut->shaper[0] = 0.0f;
+  for (int i = 0; i < num_samples - 1; i++) {
+    accum += (1.0f - adaptive) / (num_samples - 1) +
+             ((adaptive > 0.0f) ? adaptive * weight[i] / total_change : 0.0f);
+    lut->shaper[i + 1] = accum;
+  }
+  for (int i = 1; i < num_samples; i++) {
+    lut->shaper[i] *= (float)(lut->size - 1) / accum;
+  }
+  lut->shaper[num_samples - 1] = (float)(lut->size - 1);
+
+  MEM_freeN(rgb);
+  MEM_freeN(weight);
+}
+
+static void lut_bake_slice(void *__restrict userdata,
+                           const int z,
+                           const TaskParallelTLS *__restrict UNUSED(tls))
+{
+  ColormanageLUT *lut = userdata;
+  const int size = lut->size;
+  float *rgb = MEM_mallocN(sizeof(float[3]) * size * size, __func__);
+  float *value = rgb;
+
+  for (int y = 0; y < size; y++) {
+    for (int x = 0; x < size; x++, value += 3) {
+      value[0] = lut_shaper_from_grid(lut, (float)x);
+      value[1] = lut_shaper_from_grid(lut, (float)y);
+      value[2] = lut_shaper_from_grid(lut, (float)z);
+    }
+  }
+
+  lut->evaluate(lut->userdata, rgb, size * size);
+
+  float(*entry)[4] = lut->table + (size_t)z * size * size;
+  value = rgb;
+  for (int i = 0; i < size * size; i++, entry++, value += 3) {
+    (*entry)[0] = value[0];
+    (*entry)[1] = value[1];
+    (*entry)[2] = value[2];
+    (*entry)[3] = 0.0f;
+  }
+
+  MEM_freeN(rgb);
+}
+
+/**
+ * Bake a LUT of size^3 samples of the given transform, covering input values in
+ * [0, domain_max]. The evaluate function is also used for pixels outside of that range
+ * and must remain valid and thread safe as long as the LUT is used.
+ */
+ColormanageLUT *colormanage_lut_create(int size,
+                                       float domain_max,
+                                       ColormanageLUTEvaluateFn evaluate,
+                                       void *userdata)
+{
+  BLI_assert(size >= 2);
+
+  ColormanageLUT *lut = MEM_callocN(sizeof(ColormanageLUT), "colormanage LUT");
+  lut->size = size;
+  lut->domain_max = domain_max;
+  lut->evaluate = evaluate;
+  lut->userdata = userdata;
+
+  lut->shaper = MEM_mallocN(sizeof(*lut->shaper) * COLORMANAGE_LUT_SHAPER_SIZE,
+                            "colormanage LUT shaper");
+  lut_bake_shaper(lut);
+
+  lut->table = MEM_mallocN_aligned(
+      sizeof(*lut->table) * (size_t)size * size * size, 16, "colormanage LUT table");
+
+  TaskParallelSettings settings;
+  BLI_parallel_range_settings_defaults(&settings);
+  settings.min_iter_per_thread = 1;
+  BLI_task_parallel_range(0, size, lut, lut_bake_slice, &settings);
+
+  return lut;
+}
+
+void colormanage_lut_free(ColormanageLUT *lut)
+{
+  MEM_freeN(lut->shaper);
+  MEM_freeN(lut->table);
+  MEM_freeN(lut);
+}
+
+/** \} */
+
+/* -------------------------------------------------------------------- */
+/** \name LUT Evaluation
+ * \{ */
+
+BLI_INLINE bool lut_in_domain(const ColormanageLUT *lut, const float rgb[3])
+{
+  /* Written so NaN ends up outside of the domain. */
+  return (rgb[0] >= 0.0f && rgb[0] <= lut->domain_max) &&
+         (rgb[1] >= 0.0f && rgb[1] <= lut->domain_max) &&
+         (rgb[2] >= 0.0f && rgb[2] <= lut->domain_max);
+}
+
+/* Tetrahedral interpolation, only valid for values within the LUT domain. */
+static void lut_interpolate(const ColormanageLUT *lut, float rgb[3])
+{
+  const int size = lut->size;
+  const int stride[3] = {1, size, size * size};
+  float f[3];
+  int base = 0;
+
+  for (int i = 0; i < 3; i++) {
+    const float grid = lut_shaper_to_grid(lut, rgb[i]);
+    const int index = min_ii((int)grid, size - 2);
+    f[i] = grid - (float)index;
+    base += index * stride[i];
+  }
+
+  /* Sort the fractions, the largest one picks the first edge of the tetrahedron to walk. */
+  int axis[3] = {0, 1, 2};
+  if (f[axis[0]] < f[axis[1]]) {
+    SWAP(int, axis[0], axis[1]);
+  }
+  if (f[axis[1]] < f[axis[2]]) {
+    SWAP(int, axis[1], axis[2]);
+  }
+  if (f[axis[0]] < f[axis[1]]) {
+    SWAP(int, axis[0], axis[1]);
+  }
+
+  const float a = f[axis[0]], b = f[axis[1]], c = f[axis[2]];
+  const float *c0 = lut->table[base];
+  const float *c1 = lut->table[base + stride[axis[0]]];
+  const float *c2 = lut->table[base + stride[axis[0]] + stride[axis[1]]];
+  const float *c3 = lut->table[base + stride[0] + stride[1] + stride[2]];
+
+#ifdef __SSE2__
+  __m128 result = _mm_mul_ps(_mm_set1_ps(1.0f - a), _mm_load_ps(c0));
+  result = _mm_add_ps(result, _mm_mul_ps(_mm_set1_ps(a - b), _mm_load_ps(c1)));
+  result = _mm_add_ps(result, _mm_mul_ps(_mm_set1_ps(b - c), _mm_load_ps(c2)));
+  result = _mm_add_ps(result, _mm_mul_ps(_mm_set1_ps(c), _mm_load_ps(c3)));
+
+  float result_v4[4];
+  _mm_storeu_ps(result_v4, result);
+  rgb[0] = result_v4[0];
+  rgb[1] = result_v4[1];
+  rgb[2] = result_v4[2];
+#else
+  for (int i = 0; i < 3; i++) {
+    rgb[i] = (1.0f - a) * c0[i] + (a - b) * c1[i] + (b - c) * c2[i] + c * c3[i];
+  }
+#endif
+}
+
+void colormanage_lut_apply_v3(const ColormanageLUT *lut, float rgb[3])
+{
+  if (lut_in_domain(lut, rgb)) {
+    lut_interpolate(lut, rgb);
+  }
+  else {
+    lut->evaluate(lut->userdata, rgb, 1);
+  }
+}
+
+/* Pixels outside of the LUT domain, passed to the exact transform together. */
+typedef struct LUTEvaluateBatch {
+  float rgb[COLORMANAGE_LUT_BATCH_SIZE][3];
+  float *pixel[COLORMANAGE_LUT_BATCH_SIZE];
+  /* Alpha to multiply the result with, 1 when the pixel was not divided by alpha. */
+  float alpha[COLORMANAGE_LUT_BATCH_SIZE];
+  int num_pixels;
+} LUTEvaluateBatch;
+
+static void lut_evaluate_batch_flush(const ColormanageLUT *lut, LUTEvaluateBatch *batch)
+{
+  if (batch->num_pixels == 0) {
+    return;
+  }
+
+  lut->evaluate(lut->userdata, &batch->rgb[0][0], batch->num_pixels);
+
+  for (int i = 0; i < batch->num_pixels; i++) {
+    mul_v3_v3fl(batch->pixel[i], batch->rgb[i], batch->alpha[i]);
+  }
+  batch->num_pixels = 0;
+}
+
+/**
+ * Apply the LUT to a buffer of 3 or 4 channel pixels. With predivide, color is divided by alpha
+ * before the lookup and multiplied back afterwards, matching OCIO_processorApply_predivide().
+ */
+void colormanage_lut_apply(const ColormanageLUT *lut,
+                           float *buffer,
+                           int width,
+                           int height,
+                           int channels,
+                           bool predivide)
+{
+  BLI_assert(ELEM(channels, 3, 4));
+
+  const size_t num_pixels = (size_t)width * height;
+  float *pixel = buffer;
+  LUTEvaluateBatch batch;
+  batch.num_pixels = 0;
+
+  predivide = predivide && (channels == 4);
+
+  for (size_t i = 0; i < num_pixels; i++, pixel += channels) {
+    float rgb[3];
+    float alpha = 1.0f;
+
+    copy_v3_v3(rgb, pixel);
+    if (predivide && pixel[3] != 1.0f && pixel[3] != 0.0f) {
+      alpha = pixel[3];
+      mul_v3_fl(rgb, 1.0f / alpha);
+    }
+
+    if (lut_in_domain(lut, rgb)) {
+      lut_interpolate(lut, rgb);
+      mul_v3_v3fl(pixel, rgb, alpha);
+    }
+    else {
+      copy_v3_v3(batch.rgb[batch.num_pixels], rgb);
+      batch.pixel[batch.num_pixels] = pixel;
+      batch.alpha[batch.num_pixels] = alpha;
+      if (++batch.num_pixels == COLORMANAGE_LUT_BATCH_SIZE) {
+        lut_evaluate_batch_flush(lut, &batch);
+      }
+    }
+  }
+
+  lut_evaluate_batch_flush(lut, &batch);
+}
+
+/** \} */
@@ -0,0 +1,239 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+#include "testing/testing.h"
+
+#include <cmath>
+#include <cstring>
+#include <random>
+#include <vector>
+
+#include "BLI_math_vector.h"
+#include "BLI_utildefines.h"
+
+#include "IMB_colormanagement_intern.h"
+
+namespace blender::imbuf::tests {
+
+/* Lookups must stay within half a step of an 8 bit display buffer. */
+static const float BYTE_EPSILON = 0.5f / 255.0f;
+static const int LUT_SIZE = 65;
+static const float LUT_DOMAIN_MAX = 64.0f;
+
+static float srgb_encode(float value)
+{
+  if (value < 0.0031308f) {
+    return (value < 0.0f) ? 0.0f : value * 12.92f;
+  }
+  return 1.055f * powf(value, 1.0f / 2.4f) - 0.055f;
+}
+
+/* Standard view: sRGB transfer function, clipped to the display range. */
+static void evaluate_standard(void *UNUSED(userdata), float *rgb, int num_pixels)
+{
+  for (int i = 0; i < num_pixels * 3; i++) {
+    rgb[i] = std::min(srgb_encode(rgb[i]), 1.0f);
+  }
+}
+
+/* Tone mapped HDR view with cross talk between channels, closer to what Filmic does. */
+static void evaluate_tonemap(void *userdata, float *rgb, int num_pixels)
+{
+  const float exposure = *(const float *)userdata;
+
+  for (int i = 0; i < num_pixels; i++, rgb += 3) {
+    const float r = rgb[0] * exposure, g = rgb[1] * exposure, b = rgb[2] * exposure;
+    const float mixed[3] = {0.8f * r + 0.15f * g + 0.05f * b,
+                            0.1f * r + 0.8f * g + 0.1f * b,
+                            0.05f * r + 0.15f * g + 0.8f * b};
+    for (int c = 0; c < 3; c++) {
+      const float value = std::max(mixed[c], 0.0f);
+      rgb[c] = srgb_encode(value / (1.0f + value));
+    }
+  }
+}
+
+static void random_pixel(std::mt19937 &rng, float max_value, float rgb[3])
+{
+  /* Spread samples over stops, like image content is. */
+  std::uniform_real_distribution<float> stops(-14.0f, log2f(max_value));
+  for (int c = 0; c < 3; c++) {
+    rgb[c] = exp2f(stops(rng));
+  }
+}
+
+static float max_lut_error(ColormanageLUTEvaluateFn evaluate, void *userdata, float max_value)
+{
+  ColormanageLUT *lut = colormanage_lut_create(LUT_SIZE, LUT_DOMAIN_MAX, evaluate, userdata);
+  std::mt19937 rng(1234);
+  float max_error = 0.0f;
+
+  for (int i = 0; i < 100000; i++) {
+    float expected[3], result[3];
+    random_pixel(rng, max_value, expected);
+    copy_v3_v3(result, expected);
+
+    evaluate(userdata, expected, 1);
+    colormanage_lut_apply_v3(lut, result);
+
+    for (int c = 0; c < 3; c++) {
+      max_error = std::max(max_error, fabsf(result[c] - expected[c]));
+    }
+  }
+
+  colormanage_lut_free(lut);
+  return max_error;
+}
+
+TEST(colormanage_lut, StandardAccuracy)
+{
+  EXPECT_LT(max_lut_error(evaluate_standard, nullptr, 1.0f), BYTE_EPSILON);
+}
+
+TEST(colormanage_lut, TonemapAccuracy)
+{
+  float exposure = 1.0f;
+  EXPECT_LT(max_lut_error(evaluate_tonemap, &exposure, LUT_DOMAIN_MAX), BYTE_EPSILON);
+
+  exposure = 8.0f;
+  EXPECT_LT(max_lut_error(evaluate_tonemap, &exposure, LUT_DOMAIN_MAX), BYTE_EPSILON);
+}
+
+TEST(colormanage_lut, GridPointsExact)
+{
+  float exposure = 1.0f;
+  ColormanageLUT *lut = colormanage_lut_create(
+      LUT_SIZE, LUT_DOMAIN_MAX, evaluate_tonemap, &exposure);
+
+  const float corners[][3] = {{0.0f, 0.0f, 0.0f},
+                              {LUT_DOMAIN_MAX, LUT_DOMAIN_MAX, LUT_DOMAIN_MAX},
+                              {0.0f, LUT_DOMAIN_MAX, 0.0f}};
+  for (const float *corner : corners) {
+    float expected[3], result[3];
+    copy_v3_v3(expected, corner);
+    copy_v3_v3(result, corner);
+    evaluate_tonemap(&exposure, expected, 1);
+    colormanage_lut_apply_v3(lut, result);
+    EXPECT_V3_NEAR(result, expected, 1e-4f);
+  }
+
+  colormanage_lut_free(lut);
+}
+
+TEST(colormanage_lut, OutOfDomainIsExact)
+{
+  float exposure = 1.0f;
+  ColormanageLUT *lut = colormanage_lut_create(
+      LUT_SIZE, LUT_DOMAIN_MAX, evaluate_tonemap, &exposure);
+
+  const float values[][3] = {
+      {-0.5f, 0.2f, 0.3f}, {0.1f, 1000.0f, 0.3f}, {0.1f, 0.2f, LUT_DOMAIN_MAX * 1.01f}};
+  for (const float *value : values) {
+    float expected[3], result[3];
+    copy_v3_v3(expected, value);
+    copy_v3_v3(result, value);
+    evaluate_tonemap(&exposure, expected, 1);
+    colormanage_lut_apply_v3(lut, result);
+    EXPECT_V3_NEAR(result, expected, 0.0f);
+  }
+
+  colormanage_lut_free(lut);
+}
+
+TEST(colormanage_lut, BufferPredivide)
+{
+  ColormanageLUT *lut = colormanage_lut_create(
+      LUT_SIZE, LUT_DOMAIN_MAX, evaluate_standard, nullptr);
+
+  float buffer[3][4] = {
+      {0.1f, 0.2f, 0.3f, 1.0f},
+      {0.05f, 0.1f, 0.15f, 0.5f},
+      {0.4f, 0.5f, 0.6f, 0.0f},
+  };
+  float expected[3][4];
+  memcpy(expected, buffer, sizeof(buffer));
+
+  colormanage_lut_apply(lut, &buffer[0][0], 3, 1, 4, true);
+
+  for (int i = 0; i < 3; i++) {
+    const float alpha = expected[i][3];
+    const bool divide = (alpha != 0.0f && alpha != 1.0f);
+    if (divide) {
+      mul_v3_fl(expected[i], 1.0f / alpha);
+    }
+    evaluate_standard(nullptr, expected[i], 1);
+    if (divide) {
+      mul_v3_fl(expected[i], alpha);
+    }
+    EXPECT_V4_NEAR(buffer[i], expected[i], BYTE_EPSILON);
+  }
+
+  colormanage_lut_free(lut);
+}
+
+/* Pixels outside of the domain are passed to the exact transform together, not one by one. */
+TEST(colormanage_lut, BufferOutOfDomainBatched)
+{
+  struct CountedTransform {
+    float exposure = 1.0f;
+    int num_calls = 0;
+    int num_pixels = 0;
+
+    static void evaluate(void *userdata, float *rgb, int num_pixels)
+    {
+      CountedTransform *transform = (CountedTransform *)userdata;
+      transform->num_calls++;
+      transform->num_pixels += num_pixels;
+      evaluate_tonemap(&transform->exposure, rgb, num_pixels);
+    }
+  } transform;
+
+  ColormanageLUT *lut = colormanage_lut_create(
+      LUT_SIZE, LUT_DOMAIN_MAX, CountedTransform::evaluate, &transform);
+
+  /* Every other pixel is out of the domain, half of them with alpha to divide by. */
+  const int width = 1000;
+  std::vector<float> buffer(width * 4), expected(width * 4);
+  for (int i = 0; i < width; i++) {
+    float *pixel = &buffer[i * 4];
+    const float value = (i % 2) ? LUT_DOMAIN_MAX * 2.0f + i : 0.001f * i;
+    pixel[0] = value;
+    pixel[1] = value * 0.5f;
+    pixel[2] = (i % 4 == 1) ? -0.1f : value * 0.25f;
+    pixel[3] = (i % 3) ? 1.0f : 0.5f;
+  }
+  expected = buffer;
+
+  transform.num_calls = 0;
+  transform.num_pixels = 0;
+  colormanage_lut_apply(lut, buffer.data(), width, 1, 4, true);
+  EXPECT_EQ(transform.num_pixels, width / 2);
+  EXPECT_LT(transform.num_calls, width / 2 / 100);
+
+  for (int i = 0; i < width; i++) {
+    float *value = &expected[i * 4];
+    const float alpha = value[3];
+    mul_v3_fl(value, 1.0f / alpha);
+    evaluate_tonemap(&transform.exposure, value, 1);
+    mul_v3_fl(value, alpha);
+    const float *result = &buffer[i * 4];
+    /* Pixels outside of the domain are exact. */
+    EXPECT_V4_NEAR(result, value, (i % 2) ? 1e-6f : BYTE_EPSILON);
+  }
+
+  colormanage_lut_free(lut);
+}
+
+}  // namespace blender::imbuf::tests
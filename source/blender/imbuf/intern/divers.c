@@ -28,6 +28,7 @@
 #include "IMB_filter.h"
 #include "IMB_imbuf.h"
 #include "IMB_imbuf_types.h"
+#include "IMB_metadata.h"
 #include "imbuf.h"
 
 #include "IMB_colormanagement.h"
@@ -35,6 +36,10 @@
 
 #include "MEM_guardedalloc.h"
 
+#ifdef __SSE2__
+#  include <emmintrin.h>
+#endif
+
 /* -------------------------------------------------------------------- */
 /** \name Floyd-Steinberg dithering
  * \{ */
@@ -834,6 +839,305 @@ void IMB_float_from_rect(ImBuf *ibuf)
 
 /** \} */
 
+/* -------------------------------------------------------------------- */
+/** \name Half Float Conversion
+ *
+ * IEEE 754 binary16 conversion, rounding to nearest even. Infinity and NaN are preserved,
+ * values above the half float range become infinity.
+ * \{ */
+
+typedef union FloatBits {
+  float f;
+  uint u;
+} FloatBits;
+
+MINLINE unsigned short half_from_float(float value)
+{
+  FloatBits bits = {value};
+  const uint sign = bits.u & 0x80000000u;
+  uint x = bits.u ^ sign;
+  unsigned short half;
+
+  if (x >= (143u << 23)) {
+    /* Too large for a half float, infinity or NaN. */
+    half = (x > 0x7f800000u) ? 0x7e00 : 0x7c00;
+  }
+  else if (x < (113u << 23)) {
+    /* Denormal or zero, let float addition do the rounding of the mantissa. */
+    bits.u = x;
+    bits.f += 0.5f;
+    half = (unsigned short)(bits.u - (126u << 23));
+  }
+  else {
+    /* Normal, rebias the exponent and round the mantissa. */
+    const uint mantissa_odd = (x >> 13) & 1u;
+    x += ((uint)(15 - 127) << 23) + 0xfffu + mantissa_odd;
+    half = (unsigned short)(x >> 13);
+  }
+
+  return half | (unsigned short)(sign >> 16);
+}
+
+MINLINE float float_from_half(unsigned short half)
+{
+  const uint shifted_exponent = 0x7c00u << 13;
+  FloatBits bits;
+  bits.u = ((uint)half & 0x7fffu) << 13;
+  const uint exponent = bits.u & shifted_exponent;
+  bits.u += (127u - 15u) << 23;
+
+  if (exponent == shifted_exponent) {
+    /* Infinity or NaN. */
+    bits.u += (128u - 16u) << 23;
+  }
+  else if (exponent == 0) {
+    /* Zero or denormal, renormalize with a float subtraction of normal numbers only, so this
+     * is not affected by denormals being flushed to zero. */
+    bits.u += 1u << 23;
+    bits.f -= 6.103515625e-05f;
+  }
+
+  bits.u |= ((uint)half & 0x8000u) << 16;
+  return bits.f;
+}
+
+#ifdef __SSE2__
+MINLINE __m128i half_select_sse2(__m128i mask, __m128i a, __m128i b)
+{
+  return _mm_or_si128(_mm_and_si128(mask, a), _mm_andnot_si128(mask, b));
+}
+
+/* Same as half_from_float, for 4 values. Result is in the low 16 bits of each integer. */
+MINLINE __m128i half_from_float_sse2(__m128 value)
+{
+  const __m128i one = _mm_set1_epi32(1);
+  __m128i x = _mm_castps_si128(value);
+  const __m128i sign = _mm_and_si128(x, _mm_set1_epi32((int)0x80000000u));
+  x = _mm_xor_si128(x, sign);
+
+  const __m128i is_overflow = _mm_cmpgt_epi32(x, _mm_set1_epi32((143 << 23) - 1));
+  const __m128i is_nan = _mm_cmpgt_epi32(x, _mm_set1_epi32(0x7f800000));
+  const __m128i infinity_or_nan = _mm_or_si128(_mm_set1_epi32(0x7c00),
+                                               _mm_and_si128(is_nan, _mm_set1_epi32(0x0200)));
+
+  const __m128i is_denormal = _mm_cmplt_epi32(x, _mm_set1_epi32(113 << 23));
+  const __m128i denormal = _mm_sub_epi32(
+      _mm_castps_si128(_mm_add_ps(_mm_castsi128_ps(x), _mm_set1_ps(0.5f))),
+      _mm_set1_epi32(126 << 23));
+
+  const __m128i mantissa_odd = _mm_and_si128(_mm_srli_epi32(x, 13), one);
+  const __m128i bias = _mm_set1_epi32((int)(((uint)(15 - 127) << 23) + 0xfffu));
+  const __m128i normal = _mm_srli_epi32(_mm_add_epi32(_mm_add_epi32(x, bias), mantissa_odd), 13);
+
+  __m128i half = half_select_sse2(is_denormal, denormal, normal);
+  half = half_select_sse2(is_overflow, infinity_or_nan, half);
+  return _mm_or_si128(half, _mm_srli_epi32(sign, 16));
+}
+
+/* Same as float_from_half, for 4 values in the low 16 bits of each integer. */
+MINLINE __m128 float_from_half_sse2(__m128i half)
+{
+  const __m128i shifted_exponent = _mm_set1_epi32(0x7c00 << 13);
+  __m128i bits = _mm_slli_epi32(_mm_and_si128(half, _mm_set1_epi32(0x7fff)), 13);
+  const __m128i exponent = _mm_and_si128(bits, shifted_exponent);
+  bits = _mm_add_epi32(bits, _mm_set1_epi32((127 - 15) << 23));
+
+  const __m128i is_infinity_or_nan = _mm_cmpeq_epi32(exponent, shifted_exponent);
+  bits = _mm_add_epi32(bits, _mm_and_si128(is_infinity_or_nan, _mm_set1_epi32((128 - 16) << 23)));
+
+  const __m128i is_denormal = _mm_cmpeq_epi32(exponent, _mm_setzero_si128());
+  const __m128i renormalized = _mm_add_epi32(bits, _mm_set1_epi32(1 << 23));
+  const __m128 min_normal = _mm_set1_ps(6.103515625e-05f);
+  const __m128 denormal = _mm_sub_ps(_mm_castsi128_ps(renormalized), min_normal);
+  bits = half_select_sse2(is_denormal, _mm_castps_si128(denormal), bits);
+
+  bits = _mm_or_si128(bits, _mm_slli_epi32(_mm_and_si128(half, _mm_set1_epi32(0x8000)), 16));
+  return _mm_castsi128_ps(bits);
+}
+#endif
+
+void IMB_buffer_half_from_float(unsigned short *rect_to, const float *rect_from, size_t num)
+{
+  size_t i = 0;
+
+#ifdef __SSE2__
+  for (; i + 8 <= num; i += 8) {
+    __m128i low = half_from_float_sse2(_mm_loadu_ps(rect_from + i));
+    __m128i high = half_from_float_sse2(_mm_loadu_ps(rect_from + i + 4));
+    /* Sign extend, so packing with signed saturation keeps all 16 bits. */
+    low = _mm_srai_epi32(_mm_slli_epi32(low, 16), 16);
+    high = _mm_srai_epi32(_mm_slli_epi32(high, 16), 16);
+    _mm_storeu_si128((__m128i *)(rect_to + i), _mm_packs_epi32(low, high));
+  }
+#endif
+
+  for (; i < num; i++) {
+    rect_to[i] = half_from_float(rect_from[i]);
+  }
+}
+
+void IMB_buffer_float_from_half(float *rect_to, const unsigned short *rect_from, size_t num)
+{
+  size_t i = 0;
+
+#ifdef __SSE2__
+  const __m128i zero = _mm_setzero_si128();
+  for (; i + 8 <= num; i += 8) {
+    const __m128i half = _mm_loadu_si128((const __m128i *)(rect_from + i));
+    _mm_storeu_ps(rect_to + i, float_from_half_sse2(_mm_unpacklo_epi16(half, zero)));
+    _mm_storeu_ps(rect_to + i + 4, float_from_half_sse2(_mm_unpackhi_epi16(half, zero)));
+  }
+#endif
+
+  for (; i < num; i++) {
+    rect_to[i] = float_from_half(rect_from[i]);
+  }
+}
+
+typedef struct HalfConvertThreadData {
+  float *rect_float;
+  unsigned short *rect_half;
+  size_t scanline_size;
+  bool to_half;
+} HalfConvertThreadData;
+
+static void imb_half_convert_thread_do(void *data_v, int start_scanline, int num_scanlines)
+{
+  HalfConvertThreadData *data = (HalfConvertThreadData *)data_v;
+  const size_t offset = (size_t)start_scanline * data->scanline_size;
+  const size_t num = (size_t)num_scanlines * data->scanline_size;
+
+  if (data->to_half) {
+    IMB_buffer_half_from_float(data->rect_half + offset, data->rect_float + offset, num);
+  }
+  else {
+    IMB_buffer_float_from_half(data->rect_float + offset, data->rect_half + offset, num);
+  }
+}
+
+static void imb_half_convert(const ImBuf *ibuf,
+                             float *rect_float,
+                             unsigned short *rect_half,
+                             bool to_half)
+{
+  HalfConvertThreadData data;
+  data.rect_float = rect_float;
+  data.rect_half = rect_half;
+  data.scanline_size = (size_t)ibuf->x * ibuf->channels;
+  data.to_half = to_half;
+
+  if ((size_t)ibuf->x * ibuf->y < 64 * 64) {
+    imb_half_convert_thread_do(&data, 0, ibuf->y);
+  }
+  else {
+    IMB_processor_apply_threaded_scanlines(ibuf->y, imb_half_convert_thread_do, &data);
+  }
+}
+
+/* Create half float buffer from the float buffer. */
+void IMB_half_from_float(ImBuf *ibuf)
+{
+  if (ibuf->rect_float == NULL) {
+    return;
+  }
+
+  if (ibuf->rect_half == NULL) {
+    if (imb_addrecthalfImBuf(ibuf) == false) {
+      return;
+    }
+  }
+
+  imb_half_convert(ibuf, ibuf->rect_float, ibuf->rect_half, true);
+}
+
+/* Create float buffer from the half float buffer, same color space and alpha. */
+void IMB_float_from_half(ImBuf *ibuf)
+{
+  if (ibuf->rect_half == NULL) {
+    return;
+  }
+
+  if (ibuf->rect_float == NULL) {
+    float *rect_float = imb_alloc_pixels(
+        ibuf->x, ibuf->y, ibuf->channels, sizeof(float), __func__);
+    if (rect_float == NULL) {
+      return;
+    }
+    ibuf->rect_float = rect_float;
+    ibuf->mall |= IB_rectfloat;
+    ibuf->flags |= IB_rectfloat;
+  }
+
+  imb_half_convert(ibuf, ibuf->rect_float, ibuf->rect_half, false);
+}
+
+/* New image buffer with the same size and settings, without pixels. */
+static ImBuf *imb_half_copy_settings(const ImBuf *ibuf)
+{
+  const int buffer_flags = IB_rect | IB_rectfloat | IB_recthalf | IB_zbuf | IB_zbuffloat |
+                           IB_tiles | IB_mem;
+  ImBuf *copy = IMB_allocImBuf(ibuf->x, ibuf->y, ibuf->planes, 0);
+
+  if (copy == NULL) {
+    return NULL;
+  }
+
+  copy->channels = ibuf->channels;
+  copy->flags = ibuf->flags & ~buffer_flags;
+  copy->ftype = ibuf->ftype;
+  copy->foptions = ibuf->foptions;
+  copy_v2_v2_db(copy->ppm, ibuf->ppm);
+  copy->dither = ibuf->dither;
+  copy->float_colorspace = ibuf->float_colorspace;
+  IMB_metadata_copy(copy, (ImBuf *)ibuf);
+
+  return copy;
+}
+
+/* Copy of a float image buffer, with only a half float buffer. Byte and Z buffers are not
+ * copied. Used for caching, at half the memory of the float buffer. */
+ImBuf *IMB_half_copy_from_float(const ImBuf *ibuf)
+{
+  if (ibuf->rect_float == NULL) {
+    return NULL;
+  }
+
+  ImBuf *copy = imb_half_copy_settings(ibuf);
+  if (copy == NULL || imb_addrecthalfImBuf(copy) == false) {
+    IMB_freeImBuf(copy);
+    return NULL;
+  }
+
+  imb_half_convert(copy, ibuf->rect_float, copy->rect_half, true);
+  return copy;
+}
+
+/* Copy of a half float image buffer, with only a float buffer. */
+ImBuf *IMB_float_copy_from_half(const ImBuf *ibuf)
+{
+  if (ibuf->rect_half == NULL) {
+    return NULL;
+  }
+
+  ImBuf *copy = imb_half_copy_settings(ibuf);
+  if (copy == NULL) {
+    return NULL;
+  }
+
+  copy->rect_float = imb_alloc_pixels(ibuf->x, ibuf->y, ibuf->channels, sizeof(float), __func__);
+  if (copy->rect_float == NULL) {
+    IMB_freeImBuf(copy);
+    return NULL;
+  }
+  copy->mall |= IB_rectfloat;
+  copy->flags |= IB_rectfloat;
+
+  imb_half_convert(copy, copy->rect_float, ibuf->rect_half, false);
+  return copy;
+}
+
+/** \} */
+
 /* -------------------------------------------------------------------- */
 /** \name Color to Grayscale
  * \{ */
@@ -0,0 +1,92 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+#include "testing/testing.h"
+
+#include <cmath>
+#include <limits>
+#include <vector>
+
+#include "IMB_imbuf.h"
+
+namespace blender::imbuf::tests {
+
+/* Convert a single value, through the buffer functions that use SIMD for 8 values or more. */
+static unsigned short half_from_float(float value)
+{
+  std::vector<float> values(9, value);
+  std::vector<unsigned short> halfs(values.size());
+  IMB_buffer_half_from_float(halfs.data(), values.data(), values.size());
+  EXPECT_EQ(halfs.front(), halfs.back());
+  return halfs.front();
+}
+
+static float float_from_half(unsigned short half)
+{
+  std::vector<unsigned short> halfs(9, half);
+  std::vector<float> values(halfs.size());
+  IMB_buffer_float_from_half(values.data(), halfs.data(), halfs.size());
+  EXPECT_EQ(std::isnan(values.front()), std::isnan(values.back()));
+  if (!std::isnan(values.front())) {
+    EXPECT_EQ(values.front(), values.back());
+  }
+  return values.front();
+}
+
+TEST(imbuf_half, KnownValues)
+{
+  EXPECT_EQ(half_from_float(0.0f), 0x0000);
+  EXPECT_EQ(half_from_float(-0.0f), 0x8000);
+  EXPECT_EQ(half_from_float(1.0f), 0x3c00);
+  EXPECT_EQ(half_from_float(-2.0f), 0xc000);
+  EXPECT_EQ(half_from_float(65504.0f), 0x7bff);
+  /* Smallest denormal. */
+  EXPECT_EQ(half_from_float(5.9604645e-08f), 0x0001);
+  /* Out of range. */
+  EXPECT_EQ(half_from_float(100000.0f), 0x7c00);
+  EXPECT_EQ(half_from_float(-std::numeric_limits<float>::infinity()), 0xfc00);
+  EXPECT_EQ(half_from_float(1e-10f), 0x0000);
+  EXPECT_EQ(half_from_float(std::numeric_limits<float>::quiet_NaN()) & 0x7e00, 0x7e00);
+}
+
+TEST(imbuf_half, RoundToNearestEven)
+{
+  /* Halfway between 1.0 and the next half float, rounds down to the even mantissa. */
+  EXPECT_EQ(half_from_float(1.0f + 1.0f / 2048.0f), 0x3c00);
+  /* Halfway between the next two, rounds up to the even mantissa. */
+  EXPECT_EQ(half_from_float(1.0f + 3.0f / 2048.0f), 0x3c02);
+  /* Largest half float rounds up to infinity when halfway to the next exponent. */
+  EXPECT_EQ(half_from_float(65520.0f), 0x7c00);
+  EXPECT_EQ(half_from_float(65519.0f), 0x7bff);
+}
+
+TEST(imbuf_half, AllHalfsRoundTrip)
+{
+  for (int i = 0; i < 65536; i++) {
+    const unsigned short half = (unsigned short)i;
+    const float value = float_from_half(half);
+    if (std::isnan(value)) {
+      EXPECT_EQ(half & 0x7c00, 0x7c00);
+      continue;
+    }
+    EXPECT_EQ(half_from_float(value), half) << "half " << i;
+  }
+
+  EXPECT_EQ(float_from_half(0x0001), 5.9604645e-08f);
+  EXPECT_EQ(float_from_half(0x3555), 0.333251953125f);
+  EXPECT_EQ(float_from_half(0x7c00), std::numeric_limits<float>::infinity());
+}
+
+}  // namespace blender::imbuf::tests
@@ -29,6 +29,7 @@
 #include "BLI_ghash.h"
 #include "BLI_path_util.h"
 #include "BLI_string.h"
+#include "BLI_task.h"
 #include "BLI_utildefines.h"
 #ifdef _WIN32
 #  include "BLI_winstuff.h"
@@ -436,6 +437,7 @@ static void get_tc_filename(struct anim *anim, IMB_Timecode_Type tc, char *fname
 
 typedef struct IndexBuildContext {
   int anim_type;
+  int num_threads;
 } IndexBuildContext;
 
 /* ----------------------------------------------------------------------
@@ -528,6 +530,10 @@ static struct proxy_output_ctx *alloc_proxy_output_ffmpeg(
     rv->c->flags |= CODEC_FLAG_GLOBAL_HEADER;
   }
 
+  /* All proxy sizes are already encoded side by side on the task scheduler,
+   * threads of the encoder itself would only compete with them. */
+  rv->c->thread_count = 1;
+
   if (avio_open(&rv->of->pb, fname, AVIO_FLAG_WRITE) < 0) {
     fprintf(stderr,
             "Couldn't open outputfile! "
@@ -682,6 +688,7 @@ static void free_proxy_output_ffmpeg(struct proxy_output_ctx *ctx, int rollback)
 
 typedef struct FFmpegIndexBuilderContext {
   int anim_type;
+  int num_threads;
 
   AVFormatContext *iFormatCtx;
   AVCodecContext *iCodecCtx;
@@ -708,6 +715,11 @@ typedef struct FFmpegIndexBuilderContext {
   double pts_time_base;
   int frameno, frameno_gapless;
   int start_pts_set;
+
+  /* Proxy outputs being built, encoded in parallel for every decoded frame. */
+  struct proxy_output_ctx *proxy_ctx_active[IMB_PROXY_MAX_SLOT];
+  int num_proxy_ctx_active;
+  AVFrame *proxy_in_frame;
 } FFmpegIndexBuilderContext;
 
 static IndexBuildContext *index_ffmpeg_create_context(struct anim *anim,
@@ -774,12 +786,6 @@ static IndexBuildContext *index_ffmpeg_create_context(struct anim *anim,
 
   context->iCodecCtx->workaround_bugs = 1;
 
-  if (avcodec_open2(context->iCodecCtx, context->iCodec, NULL) < 0) {
-    avformat_close_input(&context->iFormatCtx);
-    MEM_freeN(context);
-    return NULL;
-  }
-
   for (i = 0; i < num_proxy_sizes; i++) {
     if (proxy_sizes_in_use & proxy_sizes[i]) {
       context->proxy_ctx[i] = alloc_proxy_output_ffmpeg(
@@ -792,6 +798,9 @@ static IndexBuildContext *index_ffmpeg_create_context(struct anim *anim,
       if (!context->proxy_ctx[i]) {
         proxy_sizes_in_use &= ~proxy_sizes[i];
       }
+      else {
+        context->proxy_ctx_active[context->num_proxy_ctx_active++] = context->proxy_ctx[i];
+      }
     }
   }
 
@@ -833,6 +842,14 @@ static void index_rebuild_ffmpeg_finish(FFmpegIndexBuilderContext *context, int
   MEM_freeN(context);
 }
 
+static void index_rebuild_ffmpeg_proxy_task(void *__restrict userdata,
+                                            const int i,
+                                            const TaskParallelTLS *__restrict UNUSED(tls))
+{
+  FFmpegIndexBuilderContext *context = userdata;
+  add_to_proxy_output_ffmpeg(context->proxy_ctx_active[i], context->proxy_in_frame);
+}
+
 static void index_rebuild_ffmpeg_proc_decoded_frame(FFmpegIndexBuilderContext *context,
                                                     AVPacket *curr_packet,
                                                     AVFrame *in_frame)
@@ -842,9 +859,15 @@ static void index_rebuild_ffmpeg_proc_decoded_frame(FFmpegIndexBuilderContext *c
   unsigned long long s_dts = context->seek_pos_dts;
   unsigned long long pts = av_get_pts_from_frame(context->iFormatCtx, in_frame);
 
-  for (i = 0; i < context->num_proxy_sizes; i++) {
-    add_to_proxy_output_ffmpeg(context->proxy_ctx[i], in_frame);
-  }
+  /* Every proxy size has its own scaler, encoder and muxer, so they can all be
+   * fed the same decoded frame at once. */
+  context->proxy_in_frame = in_frame;
+
+  TaskParallelSettings settings;
+  BLI_parallel_range_settings_defaults(&settings);
+  settings.min_iter_per_thread = 1;
+  BLI_task_parallel_range(
+      0, context->num_proxy_ctx_active, context, index_rebuild_ffmpeg_proxy_task, &settings);
 
   if (!context->start_pts_set) {
     context->start_pts = pts;
@@ -898,6 +921,15 @@ static int index_rebuild_ffmpeg(FFmpegIndexBuilderContext *context,
 
   memset(&next_packet, 0, sizeof(AVPacket));
 
+  /* The decoder is opened here rather than when creating the context, so it uses the number of
+   * threads set after that, see #IMB_anim_index_rebuild_set_num_threads. */
+  context->iCodecCtx->thread_count = context->num_threads;
+  context->iCodecCtx->thread_type = FF_THREAD_FRAME | FF_THREAD_SLICE;
+
+  if (avcodec_open2(context->iCodecCtx, context->iCodec, NULL) < 0) {
+    return 0;
+  }
+
   in_frame = av_frame_alloc();
 
   stream_size = avio_size(context->iFormatCtx->pb);
@@ -974,6 +1006,7 @@ static int index_rebuild_ffmpeg(FFmpegIndexBuilderContext *context,
 #ifdef WITH_AVI
 typedef struct FallbackIndexBuilderContext {
   int anim_type;
+  int num_threads;
 
   struct anim *anim;
   AviMovie *proxy_ctx[IMB_PROXY_MAX_SLOT];
@@ -1217,6 +1250,11 @@ IndexBuildContext *IMB_anim_index_rebuild_context(struct anim *anim,
   UNUSED_VARS(tcs_in_use, proxy_sizes_in_use, quality);
 }
 
+void IMB_anim_index_rebuild_set_num_threads(struct IndexBuildContext *context, int num_threads)
+{
+  context->num_threads = num_threads;
+}
+
 void IMB_anim_index_rebuild(struct IndexBuildContext *context,
                             short *stop,
                             short *do_update,
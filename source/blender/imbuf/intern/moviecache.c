@@ -51,6 +51,7 @@
 #endif
 
 static MEM_CacheLimiterC *limitor = NULL;
+/* Serializes putting buffers, lookups only lock the shard of the limiter the item is in. */
 static pthread_mutex_t limitor_lock = BLI_MUTEX_INITIALIZER;
 
 typedef struct MovieCache {
@@ -75,6 +76,10 @@ typedef struct MovieCache {
 
   int totseg, *points, proxy, render_flags; /* for visual statistics optimization */
   int pad;
+
+  /* Items can be destroyed by cache limiting from any thread putting buffers in a cache, this
+   * protects them while they are looked up. */
+  ThreadMutex item_lock;
 } MovieCache;
 
 typedef struct MovieCacheKey {
@@ -171,6 +176,8 @@ static void IMB_moviecache_destructor(void *p)
   if (item && item->ibuf) {
     MovieCache *cache = item->cache_owner;
 
+    BLI_mutex_lock(&cache->item_lock);
+
     PRINT("%s: cache '%s' destroy item %p buffer %p\n", __func__, cache->name, item, item->ibuf);
 
     IMB_freeImBuf(item->ibuf);
@@ -183,6 +190,8 @@ static void IMB_moviecache_destructor(void *p)
       MEM_freeN(cache->points);
       cache->points = NULL;
     }
+
+    BLI_mutex_unlock(&cache->item_lock);
   }
 }
 
@@ -248,6 +257,8 @@ void IMB_moviecache_init(void)
 {
   limitor = new_MEM_CacheLimiter(IMB_moviecache_destructor, get_item_size);
 
+  /* Only buffers of caches with a priority callback are ranked by priority, buffers of other
+   * caches are evicted in least recently used order. */
   MEM_CacheLimiter_ItemPriority_Func_set(limitor, get_item_priority);
   MEM_CacheLimiter_ItemDestroyable_Func_set(limitor, get_item_destroyable);
 }
@@ -283,6 +294,8 @@ MovieCache *IMB_moviecache_create(const char *name,
   cache->cmpfp = cmpfp;
   cache->proxy = -1;
 
+  BLI_mutex_init(&cache->item_lock);
+
   return cache;
 }
 
@@ -343,6 +356,9 @@ static void do_moviecache_put(MovieCache *cache, void *userkey, ImBuf *ibuf, boo
   }
 
   item->c_handle = MEM_CacheLimiter_insert(limitor, item);
+  if (cache->getitempriorityfp) {
+    MEM_CacheLimiter_use_priority(item->c_handle);
+  }
 
   MEM_CacheLimiter_ref(item->c_handle);
   MEM_CacheLimiter_enforce_limits(limitor);
@@ -405,15 +421,18 @@ ImBuf *IMB_moviecache_get(MovieCache *cache, void *userkey)
   item = (MovieCacheItem *)BLI_ghash_lookup(cache->hash, &key);
 
   if (item) {
+    ImBuf *ibuf = NULL;
+
+    BLI_mutex_lock(&cache->item_lock);
     if (item->ibuf) {
-      BLI_mutex_lock(&limitor_lock);
       MEM_CacheLimiter_touch(item->c_handle);
-      BLI_mutex_unlock(&limitor_lock);
 
       IMB_refImBuf(item->ibuf);
-
-      return item->ibuf;
+      ibuf = item->ibuf;
     }
+    BLI_mutex_unlock(&cache->item_lock);
+
+    return ibuf;
   }
 
   return NULL;
@@ -441,6 +460,8 @@ void IMB_moviecache_free(MovieCache *cache)
   BLI_mempool_destroy(cache->items_pool);
   BLI_mempool_destroy(cache->userkeys_pool);
 
+  BLI_mutex_end(&cache->item_lock);
+
   if (cache->points) {
     MEM_freeN(cache->points);
   }
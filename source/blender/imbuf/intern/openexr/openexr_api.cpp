@@ -25,6 +25,7 @@
 #include <errno.h>
 #include <fstream>
 #include <iostream>
+#include <memory>
 #include <set>
 #include <stddef.h>
 #include <stdexcept>
@@ -55,6 +56,7 @@
 #include <ImfOutputPart.h>
 #include <ImfPartHelper.h>
 #include <ImfPartType.h>
+#include <ImfTiledInputPart.h>
 #include <ImfTiledOutputPart.h>
 
 #include "DNA_scene_types.h" /* For OpenEXR compression constants */
@@ -77,7 +79,10 @@ _CRTIMP void __cdecl _invalid_parameter_noinfo(void)
 #endif
 }
 #include "BLI_blenlib.h"
+#include "BLI_math_base.h"
 #include "BLI_math_color.h"
+#include "BLI_math_vector.h"
+#include "BLI_task.h"
 #include "BLI_threads.h"
 
 #include "BKE_idprop.h"
@@ -1890,6 +1895,281 @@ bool IMB_exr_has_multilayer(void *handle)
   return imb_exr_is_multi(*data->ifile);
 }
 
+/* Channels of the file read into the RGBA pixels of an image buffer. */
+typedef struct ExrRGBAChannels {
+  /* Channel names, empty for channels which are not read. */
+  std::string names[4];
+  /* Values for channels missing in the file. */
+  float fill[4];
+  int num_rgb_channels;
+  bool has_luma;
+  bool has_chroma;
+} ExrRGBAChannels;
+
+static void exr_rgba_channels(MultiPartInputFile &file, ExrRGBAChannels *r_channels)
+{
+  for (int i = 0; i < 4; i++) {
+    r_channels->names[i].clear();
+    r_channels->fill[i] = 0.0f;
+  }
+  /* 1.0 is fill value, this still needs to be assigned even when there is no alpha. */
+  r_channels->fill[3] = 1.0f;
+  r_channels->num_rgb_channels = 0;
+  r_channels->has_luma = false;
+  r_channels->has_chroma = false;
+
+  const char *rgb_channels[3];
+  r_channels->num_rgb_channels = exr_has_rgb(file, rgb_channels);
+  if (r_channels->num_rgb_channels > 0) {
+    for (int i = 0; i < r_channels->num_rgb_channels; i++) {
+      r_channels->names[i] = exr_rgba_channelname(file, rgb_channels[i]);
+    }
+  }
+  else if (exr_has_luma(file)) {
+    r_channels->has_luma = true;
+    r_channels->has_chroma = exr_has_chroma(file);
+    r_channels->names[0] = exr_rgba_channelname(file, "Y");
+    r_channels->names[1] = exr_rgba_channelname(file, "BY");
+    r_channels->names[2] = exr_rgba_channelname(file, "RY");
+    r_channels->fill[1] = r_channels->fill[2] = 0.5f;
+  }
+  r_channels->names[3] = exr_rgba_channelname(file, "A");
+}
+
+static void exr_read_metadata(MultiPartInputFile &file, ImBuf *ibuf)
+{
+  const Header &header = file.header(0);
+  Header::ConstIterator iter;
+
+  IMB_metadata_ensure(&ibuf->metadata);
+  for (iter = header.begin(); iter != header.end(); iter++) {
+    const StringAttribute *attr = file.header(0).findTypedAttribute<StringAttribute>(iter.name());
+
+    /* not all attributes are string attributes so we might get some NULLs here */
+    if (attr) {
+      IMB_metadata_set_field(ibuf->metadata, iter.name(), attr->value().c_str());
+      ibuf->flags |= IB_metadata;
+    }
+  }
+}
+
+/* Convert luma/chroma and single channel images read into RGBA pixels to RGB. */
+static void exr_rgba_postprocess(ImBuf *ibuf, int num_rgb_channels, bool is_ycc)
+{
+  if (num_rgb_channels == 0 && is_ycc) {
+    for (size_t a = 0; a < (size_t)ibuf->x * ibuf->y; a++) {
+      float *color = ibuf->rect_float + a * 4;
+      ycc_to_rgb(color[0] * 255.0f,
+                 color[1] * 255.0f,
+                 color[2] * 255.0f,
+                 &color[0],
+                 &color[1],
+                 &color[2],
+                 BLI_YCC_ITU_BT709);
+    }
+  }
+  else if (num_rgb_channels <= 1) {
+    /* Convert 1 to 3 channels. */
+    for (size_t a = 0; a < (size_t)ibuf->x * ibuf->y; a++) {
+      float *color = ibuf->rect_float + a * 4;
+      if (num_rgb_channels <= 1) {
+        color[1] = color[0];
+      }
+      if (num_rgb_channels <= 2) {
+        color[2] = color[0];
+      }
+    }
+  }
+}
+
+/* Lines decoded at once for scaled reads. A multiple of the lines per chunk of all compression
+ * types, so chunks are not decoded twice. */
+#define EXR_SCALED_READ_BAND_LINES 256
+
+typedef struct ExrScaledReadData {
+  /* RGBA pixels of the band of lines that was read. */
+  const float *band;
+  int band_xmin, band_ymin;
+  int band_width;
+  /* Boundaries of the source pixels box filtered into each pixel of the image buffer. */
+  const int *src_x;
+  const int *src_y;
+  ImBuf *ibuf;
+} ExrScaledReadData;
+
+static void exr_scaled_read_row(void *__restrict userdata,
+                                const int dst_y,
+                                const TaskParallelTLS *__restrict UNUSED(tls))
+{
+  const ExrScaledReadData *data = (const ExrScaledReadData *)userdata;
+  ImBuf *ibuf = data->ibuf;
+  const int y0 = data->src_y[dst_y], y1 = data->src_y[dst_y + 1];
+  /* EXR lines are top to bottom, image buffers bottom to top. */
+  float *dst = ibuf->rect_float + (size_t)(ibuf->y - 1 - dst_y) * ibuf->x * 4;
+
+  for (int dst_x = 0; dst_x < ibuf->x; dst_x++, dst += 4) {
+    const int x0 = data->src_x[dst_x], x1 = data->src_x[dst_x + 1];
+    float sum[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+
+    for (int y = y0; y < y1; y++) {
+      const float *src = data->band + ((size_t)(y - data->band_ymin) * data->band_width +
+                                       (x0 - data->band_xmin)) *
+                                          4;
+      for (int x = x0; x < x1; x++, src += 4) {
+        add_v4_v4(sum, src);
+      }
+    }
+
+    mul_v4_v4fl(dst, sum, 1.0f / (float)((x1 - x0) * (y1 - y0)));
+  }
+}
+
+/* Split src_len pixels starting at src_min into dst_len boxes of at least one pixel. */
+static void exr_scaled_read_boundaries(int src_min, int src_len, int dst_len, int *r_bounds)
+{
+  BLI_assert(dst_len <= src_len);
+  for (int i = 0; i <= dst_len; i++) {
+    r_bounds[i] = src_min + (int)(((int64_t)i * src_len) / dst_len);
+  }
+}
+
+/**
+ * Read the RGBA channels of the data window into the float buffer of the image, box filtered
+ * down to the size of the image buffer.
+ *
+ * Tiled files with mipmap or ripmap levels are read from the smallest level that is still at
+ * least as large as the image buffer. Other files are read at full resolution in bands of lines,
+ * using the OpenEXR thread pool for decoding, so the full resolution image never has to be in
+ * memory at once.
+ */
+static void exr_read_rgba_scaled(MultiPartInputFile &file,
+                                 const ExrRGBAChannels &channels,
+                                 ImBuf *ibuf)
+{
+  const Box2i &dw = file.header(0).dataWindow();
+
+  std::unique_ptr<TiledInputPart> tiled_in;
+  std::unique_ptr<InputPart> scanline_in;
+  int level_x = 0, level_y = 0;
+  int tile_height = 0;
+  Box2i level_dw = dw;
+
+  if (file.header(0).hasTileDescription()) {
+    tiled_in.reset(new TiledInputPart(file, 0));
+    tile_height = tiled_in->tileYSize();
+
+    if (tiled_in->levelMode() != ONE_LEVEL) {
+      while (level_x + 1 < tiled_in->numXLevels() &&
+             tiled_in->levelWidth(level_x + 1) >= ibuf->x) {
+        level_x++;
+      }
+      while (level_y + 1 < tiled_in->numYLevels() &&
+             tiled_in->levelHeight(level_y + 1) >= ibuf->y) {
+        level_y++;
+      }
+      if (tiled_in->levelMode() == MIPMAP_LEVELS) {
+        level_x = level_y = min_ii(level_x, level_y);
+      }
+      level_dw = tiled_in->dataWindowForLevel(level_x, level_y);
+    }
+  }
+  else {
+    scanline_in.reset(new InputPart(file, 0));
+  }
+
+  const int level_width = level_dw.max.x - level_dw.min.x + 1;
+  const int level_height = level_dw.max.y - level_dw.min.y + 1;
+
+  std::vector<int> src_x(ibuf->x + 1), src_y(ibuf->y + 1);
+  exr_scaled_read_boundaries(level_dw.min.x, level_width, ibuf->x, src_x.data());
+  exr_scaled_read_boundaries(level_dw.min.y, level_height, ibuf->y, src_y.data());
+
+  int max_box_height = 0;
+  for (int y = 0; y < ibuf->y; y++) {
+    max_box_height = max_ii(max_box_height, src_y[y + 1] - src_y[y]);
+  }
+
+  /* Whole lines are always decoded, tiled files also need room for aligning to tiles. */
+  const int band_width = level_width;
+  const int max_band_height = max_ii(EXR_SCALED_READ_BAND_LINES, max_box_height) +
+                              2 * tile_height;
+  float *band = (float *)MEM_callocN(sizeof(float[4]) * band_width * max_band_height,
+                                     "exr scaled read band");
+
+  TaskParallelSettings settings;
+  BLI_parallel_range_settings_defaults(&settings);
+
+  try {
+    for (int dst_y = 0; dst_y < ibuf->y;) {
+      /* Band of whole image buffer rows, so rows can be filtered independently. */
+      int dst_y_end = dst_y + 1;
+      while (dst_y_end < ibuf->y &&
+             src_y[dst_y_end + 1] - src_y[dst_y] <= EXR_SCALED_READ_BAND_LINES) {
+        dst_y_end++;
+      }
+
+      int band_ymin = src_y[dst_y];
+      int band_ymax = src_y[dst_y_end] - 1;
+      int tile_ymin = 0, tile_ymax = 0;
+      if (tiled_in) {
+        tile_ymin = (band_ymin - level_dw.min.y) / tile_height;
+        tile_ymax = (band_ymax - level_dw.min.y) / tile_height;
+        band_ymin = level_dw.min.y + tile_ymin * tile_height;
+        band_ymax = min_ii(level_dw.max.y, level_dw.min.y + (tile_ymax + 1) * tile_height - 1);
+      }
+      BLI_assert(band_ymax - band_ymin + 1 <= max_band_height);
+
+      /* Inverse correct first pixel for data-window coordinates. */
+      const size_t xstride = sizeof(float[4]);
+      const size_t ystride = xstride * band_width;
+      char *first = (char *)band - (ptrdiff_t)xstride * level_dw.min.x -
+                    (ptrdiff_t)ystride * band_ymin;
+
+      FrameBuffer frameBuffer;
+      for (int i = 0; i < 4; i++) {
+        if (!channels.names[i].empty()) {
+          frameBuffer.insert(channels.names[i],
+                             Slice(Imf::FLOAT,
+                                   first + i * sizeof(float),
+                                   xstride,
+                                   ystride,
+                                   1,
+                                   1,
+                                   channels.fill[i]));
+        }
+      }
+
+      if (tiled_in) {
+        tiled_in->setFrameBuffer(frameBuffer);
+        tiled_in->readTiles(
+            0, tiled_in->numXTiles(level_x) - 1, tile_ymin, tile_ymax, level_x, level_y);
+      }
+      else {
+        scanline_in->setFrameBuffer(frameBuffer);
+        scanline_in->readPixels(band_ymin, band_ymax);
+      }
+
+      ExrScaledReadData data;
+      data.band = band;
+      data.band_xmin = level_dw.min.x;
+      data.band_ymin = band_ymin;
+      data.band_width = band_width;
+      data.src_x = src_x.data();
+      data.src_y = src_y.data();
+      data.ibuf = ibuf;
+      BLI_task_parallel_range(dst_y, dst_y_end, &data, exr_scaled_read_row, &settings);
+
+      dst_y = dst_y_end;
+    }
+  }
+  catch (...) {
+    MEM_freeN(band);
+    throw;
+  }
+
+  MEM_freeN(band);
+}
+
 struct ImBuf *imb_load_openexr(const unsigned char *mem,
                                size_t size,
                                int flags,
@@ -1945,20 +2225,7 @@ struct ImBuf *imb_load_openexr(const unsigned char *mem,
       if (!(flags & IB_test)) {
 
         if (flags & IB_metadata) {
-          const Header &header = file->header(0);
-          Header::ConstIterator iter;
-
-          IMB_metadata_ensure(&ibuf->metadata);
-          for (iter = header.begin(); iter != header.end(); iter++) {
-            const StringAttribute *attr = file->header(0).findTypedAttribute<StringAttribute>(
-                iter.name());
-
-            /* not all attributes are string attributes so we might get some NULLs here */
-            if (attr) {
-              IMB_metadata_set_field(ibuf->metadata, iter.name(), attr->value().c_str());
-              ibuf->flags |= IB_metadata;
-            }
-          }
+          exr_read_metadata(*file, ibuf);
         }
 
         /* Only enters with IB_multilayer flag set. */
@@ -1971,42 +2238,48 @@ struct ImBuf *imb_load_openexr(const unsigned char *mem,
           }
         }
         else {
-          const char *rgb_channels[3];
-          const int num_rgb_channels = exr_has_rgb(*file, rgb_channels);
-          const bool has_luma = exr_has_luma(*file);
+          ExrRGBAChannels channels;
+          exr_rgba_channels(*file, &channels);
+
           FrameBuffer frameBuffer;
-          float *first;
-          int xstride = sizeof(float[4]);
+          char *first;
+
+          /* Half float files are read without widening when the caller asks for a half float
+           * buffer, as long as no channels have to be converted afterwards. */
+          const bool use_half = (flags & IB_recthalf) && exr_is_half_float(*file) &&
+                                channels.num_rgb_channels == 3 && !channels.has_luma;
+          const PixelType pixel_type = (use_half) ? Imf::HALF : Imf::FLOAT;
+          const int channel_size = (use_half) ? sizeof(unsigned short) : sizeof(float);
+          int xstride = channel_size * 4;
           int ystride = -xstride * width;
 
-          imb_addrectfloatImBuf(ibuf);
+          if (use_half) {
+            imb_addrecthalfImBuf(ibuf);
+            first = (char *)ibuf->rect_half;
+          }
+          else {
+            imb_addrectfloatImBuf(ibuf);
+            first = (char *)ibuf->rect_float;
+          }
 
           /* Inverse correct first pixel for data-window
            * coordinates (- dw.min.y because of y flip). */
-          first = ibuf->rect_float - 4 * (dw.min.x - dw.min.y * width);
+          first -= (ptrdiff_t)xstride * (dw.min.x - (ptrdiff_t)dw.min.y * width);
           /* but, since we read y-flipped (negative y stride) we move to last scanline */
-          first += 4 * (height - 1) * width;
-
-          if (num_rgb_channels > 0) {
-            for (int i = 0; i < num_rgb_channels; i++) {
-              frameBuffer.insert(exr_rgba_channelname(*file, rgb_channels[i]),
-                                 Slice(Imf::FLOAT, (char *)(first + i), xstride, ystride));
+          first += (ptrdiff_t)xstride * (height - 1) * width;
+
+          for (int i = 0; i < 4; i++) {
+            if (!channels.names[i].empty()) {
+              frameBuffer.insert(channels.names[i],
+                                 Slice(pixel_type,
+                                       first + i * channel_size,
+                                       xstride,
+                                       ystride,
+                                       1,
+                                       1,
+                                       channels.fill[i]));
             }
           }
-          else if (has_luma) {
-            frameBuffer.insert(exr_rgba_channelname(*file, "Y"),
-                               Slice(Imf::FLOAT, (char *)first, xstride, ystride));
-            frameBuffer.insert(
-                exr_rgba_channelname(*file, "BY"),
-                Slice(Imf::FLOAT, (char *)(first + 1), xstride, ystride, 1, 1, 0.5f));
-            frameBuffer.insert(
-                exr_rgba_channelname(*file, "RY"),
-                Slice(Imf::FLOAT, (char *)(first + 2), xstride, ystride, 1, 1, 0.5f));
-          }
-
-          /* 1.0 is fill value, this still needs to be assigned even when (is_alpha == 0) */
-          frameBuffer.insert(exr_rgba_channelname(*file, "A"),
-                             Slice(Imf::FLOAT, (char *)(first + 3), xstride, ystride, 1, 1, 1.0f));
 
           if (exr_has_zbuffer(*file)) {
             float *firstz;
@@ -2035,29 +2308,9 @@ struct ImBuf *imb_load_openexr(const unsigned char *mem,
           }
 #endif
 
-          if (num_rgb_channels == 0 && has_luma && exr_has_chroma(*file)) {
-            for (size_t a = 0; a < (size_t)ibuf->x * ibuf->y; a++) {
-              float *color = ibuf->rect_float + a * 4;
-              ycc_to_rgb(color[0] * 255.0f,
-                         color[1] * 255.0f,
-                         color[2] * 255.0f,
-                         &color[0],
-                         &color[1],
-                         &color[2],
-                         BLI_YCC_ITU_BT709);
-            }
-          }
-          else if (num_rgb_channels <= 1) {
-            /* Convert 1 to 3 channels. */
-            for (size_t a = 0; a < (size_t)ibuf->x * ibuf->y; a++) {
-              float *color = ibuf->rect_float + a * 4;
-              if (num_rgb_channels <= 1) {
-                color[1] = color[0];
-              }
-              if (num_rgb_channels <= 2) {
-                color[2] = color[0];
-              }
-            }
+          if (!use_half) {
+            exr_rgba_postprocess(
+                ibuf, channels.num_rgb_channels, channels.has_luma && channels.has_chroma);
           }
 
           /* file is no longer needed */
@@ -2088,6 +2341,94 @@ struct ImBuf *imb_load_openexr(const unsigned char *mem,
   }
 }
 
+/**
+ * Read an image at a reduced size, for previews. Only the RGBA channels are read and they are box
+ * filtered down while decoding. Returns NULL when the file can't be read scaled, callers should
+ * fall back to #imb_load_openexr then.
+ */
+struct ImBuf *imb_load_openexr_scaled(const unsigned char *mem,
+                                      size_t size,
+                                      int flags,
+                                      float scale,
+                                      char colorspace[IM_MAX_SPACE],
+                                      int r_full_size[2])
+{
+  struct ImBuf *ibuf = NULL;
+  IMemStream *membuf = NULL;
+  MultiPartInputFile *file = NULL;
+
+  if (imb_is_a_openexr(mem) == 0) {
+    return NULL;
+  }
+
+  /* Test reads and multilayer handles always need the whole file. */
+  if (flags & (IB_test | IB_multilayer)) {
+    return NULL;
+  }
+
+  colorspace_set_default_role(colorspace, IM_MAX_SPACE, COLOR_ROLE_DEFAULT_FLOAT);
+
+  try {
+    membuf = new IMemStream((unsigned char *)mem, size);
+    file = new MultiPartInputFile(*membuf);
+
+    const Box2i dw = file->header(0).dataWindow();
+    const int width = dw.max.x - dw.min.x + 1;
+    const int height = dw.max.y - dw.min.y + 1;
+    const int scaled_width = max_ii(1, (int)(width * scale));
+    const int scaled_height = max_ii(1, (int)(height * scale));
+
+    /* Multilayer files are read through the normal loader, which reports the error. */
+    if ((scaled_width < width || scaled_height < height) && !imb_exr_is_multi(*file)) {
+      ExrRGBAChannels channels;
+      exr_rgba_channels(*file, &channels);
+
+      const bool is_alpha = file->header(0).channels().findChannel(channels.names[3]) != NULL;
+
+      ibuf = IMB_allocImBuf(scaled_width, scaled_height, is_alpha ? 32 : 24, IB_rectfloat);
+      ibuf->flags |= exr_is_half_float(*file) ? IB_halffloat : 0;
+
+      if (hasXDensity(file->header(0))) {
+        /* Convert inches to meters, for the scaled down size. */
+        ibuf->ppm[0] = (double)xDensity(file->header(0)) / 0.0254 * scaled_width / width;
+        ibuf->ppm[1] = ibuf->ppm[0] * (double)file->header(0).pixelAspectRatio();
+      }
+
+      ibuf->ftype = IMB_FTYPE_OPENEXR;
+
+      if (flags & IB_metadata) {
+        exr_read_metadata(*file, ibuf);
+      }
+
+      exr_read_rgba_scaled(*file, channels, ibuf);
+      exr_rgba_postprocess(
+          ibuf, channels.num_rgb_channels, channels.has_luma && channels.has_chroma);
+
+      if (flags & IB_alphamode_detect) {
+        ibuf->flags |= IB_alphamode_premul;
+      }
+
+      r_full_size[0] = width;
+      r_full_size[1] = height;
+    }
+
+    delete file;
+    delete membuf;
+
+    return ibuf;
+  }
+  catch (const std::exception &exc) {
+    std::cerr << exc.what() << std::endl;
+    if (ibuf) {
+      IMB_freeImBuf(ibuf);
+    }
+    delete file;
+    delete membuf;
+
+    return NULL;
+  }
+}
+
 void imb_initopenexr(void)
 {
   int num_threads = BLI_system_thread_count();
@@ -37,6 +37,12 @@ int imb_is_a_openexr(const unsigned char *mem);
 int imb_save_openexr(struct ImBuf *ibuf, const char *name, int flags);
 
 struct ImBuf *imb_load_openexr(const unsigned char *mem, size_t size, int flags, char *colorspace);
+struct ImBuf *imb_load_openexr_scaled(const unsigned char *mem,
+                                      size_t size,
+                                      int flags,
+                                      float scale,
+                                      char *colorspace,
+                                      int r_full_size[2]);
 
 #ifdef __cplusplus
 }
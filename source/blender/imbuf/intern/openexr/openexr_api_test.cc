@@ -0,0 +1,196 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+#include "testing/testing.h"
+
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#include "MEM_guardedalloc.h"
+
+#include "BLI_fileops.h"
+#include "BLI_threads.h"
+
+#include "DNA_scene_types.h"
+
+#include "IMB_imbuf.h"
+#include "IMB_imbuf_types.h"
+
+#include "openexr_api.h"
+#include "openexr_multi.h"
+
+namespace blender::imbuf::tests {
+
+/* Tall enough to be read in several bands of lines. */
+static const int IMAGE_WIDTH = 600;
+static const int IMAGE_HEIGHT = 1000;
+
+class OpenEXRScaledTest : public ::testing::Test {
+ protected:
+  static void SetUpTestCase()
+  {
+    BLI_threadapi_init();
+    dir = std::filesystem::temp_directory_path().string();
+  }
+
+  static void TearDownTestCase()
+  {
+    BLI_threadapi_exit();
+  }
+
+  void TearDown() override
+  {
+    BLI_delete(filepath.c_str(), false, false);
+    MEM_SAFE_FREE(mem);
+  }
+
+  /* Write a gradient with different values in every channel. */
+  void write_image(int compress)
+  {
+    filepath = dir + "/imbuf_openexr_scaled_test.exr";
+
+    ImBuf *ibuf = IMB_allocImBuf(IMAGE_WIDTH, IMAGE_HEIGHT, 32, IB_rectfloat);
+    for (int y = 0; y < IMAGE_HEIGHT; y++) {
+      for (int x = 0; x < IMAGE_WIDTH; x++) {
+        float *pixel = ibuf->rect_float + ((size_t)y * IMAGE_WIDTH + x) * 4;
+        pixel[0] = x * 0.01f;
+        pixel[1] = y * 0.01f;
+        pixel[2] = (x * y) % 7;
+        pixel[3] = ((x + y) % 2) ? 1.0f : 0.5f;
+      }
+    }
+    ibuf->foptions.flag = compress;
+    ASSERT_TRUE(imb_save_openexr(ibuf, filepath.c_str(), 0));
+    IMB_freeImBuf(ibuf);
+
+    read_file();
+  }
+
+  /* Write a multilayer file with a single Combined pass. */
+  void write_multilayer_image()
+  {
+    filepath = dir + "/imbuf_openexr_scaled_test_multilayer.exr";
+
+    std::vector<float> rect((size_t)IMAGE_WIDTH * IMAGE_HEIGHT * 4, 0.5f);
+    void *handle = IMB_exr_get_handle();
+    const char *passnames[4] = {"Combined.R", "Combined.G", "Combined.B", "Combined.A"};
+    for (int i = 0; i < 4; i++) {
+      IMB_exr_add_channel(
+          handle, "ViewLayer", passnames[i], "", 4, 4 * IMAGE_WIDTH, rect.data() + i, false);
+    }
+    ASSERT_TRUE(IMB_exr_begin_write(
+        handle, filepath.c_str(), IMAGE_WIDTH, IMAGE_HEIGHT, R_IMF_EXR_CODEC_ZIP, NULL));
+    IMB_exr_write_channels(handle);
+    IMB_exr_close(handle);
+
+    read_file();
+  }
+
+  void read_file()
+  {
+    mem = (unsigned char *)BLI_file_read_binary_as_mem(filepath.c_str(), 0, &size);
+    ASSERT_NE(mem, nullptr);
+  }
+
+  /* Expect the scaled image to be the full image box filtered down by an integer factor. */
+  void expect_box_filtered(float scale, int factor)
+  {
+    char colorspace[IM_MAX_SPACE] = "";
+    ImBuf *full = imb_load_openexr(mem, size, IB_rect, colorspace);
+    ASSERT_NE(full, nullptr);
+
+    int full_size[2] = {0, 0};
+    ImBuf *scaled = imb_load_openexr_scaled(mem, size, IB_rect, scale, colorspace, full_size);
+    ASSERT_NE(scaled, nullptr);
+    ASSERT_NE(scaled->rect_float, nullptr);
+    EXPECT_EQ(scaled->x, IMAGE_WIDTH / factor);
+    EXPECT_EQ(scaled->y, IMAGE_HEIGHT / factor);
+    EXPECT_EQ(scaled->planes, 32);
+    EXPECT_EQ(full_size[0], IMAGE_WIDTH);
+    EXPECT_EQ(full_size[1], IMAGE_HEIGHT);
+
+    for (int y = 0; y < scaled->y; y++) {
+      for (int x = 0; x < scaled->x; x++) {
+        float expected[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+        for (int sy = y * factor; sy < (y + 1) * factor; sy++) {
+          for (int sx = x * factor; sx < (x + 1) * factor; sx++) {
+            const float *pixel = full->rect_float + ((size_t)sy * full->x + sx) * 4;
+            for (int i = 0; i < 4; i++) {
+              expected[i] += pixel[i] / (factor * factor);
+            }
+          }
+        }
+
+        const float *pixel = scaled->rect_float + ((size_t)y * scaled->x + x) * 4;
+        for (int i = 0; i < 4; i++) {
+          ASSERT_NEAR(pixel[i], expected[i], 1e-4f) << "pixel " << x << ", " << y;
+        }
+      }
+    }
+
+    IMB_freeImBuf(scaled);
+    IMB_freeImBuf(full);
+  }
+
+  static std::string dir;
+  std::string filepath;
+  unsigned char *mem = nullptr;
+  size_t size = 0;
+};
+
+std::string OpenEXRScaledTest::dir;
+
+TEST_F(OpenEXRScaledTest, Half)
+{
+  write_image(R_IMF_EXR_CODEC_ZIP);
+  expect_box_filtered(0.5f, 2);
+}
+
+TEST_F(OpenEXRScaledTest, Quarter)
+{
+  write_image(R_IMF_EXR_CODEC_ZIP);
+  expect_box_filtered(0.25f, 4);
+}
+
+/* Uncompressed files have a single line per chunk. */
+TEST_F(OpenEXRScaledTest, Uncompressed)
+{
+  write_image(R_IMF_EXR_CODEC_NONE);
+  expect_box_filtered(0.25f, 4);
+}
+
+/* Nothing to gain from reading at full size, callers fall back to the normal loader. */
+TEST_F(OpenEXRScaledTest, FullSize)
+{
+  write_image(R_IMF_EXR_CODEC_ZIP);
+
+  char colorspace[IM_MAX_SPACE] = "";
+  int full_size[2];
+  EXPECT_EQ(imb_load_openexr_scaled(mem, size, IB_rect, 1.0f, colorspace, full_size), nullptr);
+}
+
+/* Multilayer files without IB_multilayer fail to load, scaled or not. */
+TEST_F(OpenEXRScaledTest, Multilayer)
+{
+  write_multilayer_image();
+
+  char colorspace[IM_MAX_SPACE] = "";
+  int full_size[2];
+  EXPECT_EQ(imb_load_openexr_scaled(mem, size, IB_rect, 0.5f, colorspace, full_size), nullptr);
+  EXPECT_EQ(imb_load_openexr(mem, size, IB_rect, colorspace), nullptr);
+}
+
+}  // namespace blender::imbuf::tests
@@ -96,11 +96,18 @@ static void imb_handle_alpha(ImBuf *ibuf,
   colormanage_imbuf_make_linear(ibuf, effective_colorspace);
 }
 
-ImBuf *IMB_ibImageFromMemory(const unsigned char *mem,
-                             size_t size,
-                             int flags,
-                             char colorspace[IM_MAX_SPACE],
-                             const char *descr)
+/**
+ * \param scale: Load the image scaled down by this factor if the file type supports reading at
+ * a reduced size, otherwise the image is loaded at full size.
+ * \param r_full_size: Size of the image in the file.
+ */
+ImBuf *IMB_ibImageFromMemory_scaled(const unsigned char *mem,
+                                    size_t size,
+                                    int flags,
+                                    char colorspace[IM_MAX_SPACE],
+                                    const char *descr,
+                                    float scale,
+                                    int r_full_size[2])
 {
   ImBuf *ibuf;
   const ImFileType *type;
@@ -116,10 +123,19 @@ ImBuf *IMB_ibImageFromMemory(const unsigned char *mem,
   }
 
   for (type = IMB_FILE_TYPES; type < IMB_FILE_TYPES_LAST; type++) {
+    if (scale < 1.0f && type->load_scaled) {
+      ibuf = type->load_scaled(mem, size, flags, scale, effective_colorspace, r_full_size);
+      if (ibuf) {
+        imb_handle_alpha(ibuf, flags, colorspace, effective_colorspace);
+        return ibuf;
+      }
+    }
     if (type->load) {
       ibuf = type->load(mem, size, flags, effective_colorspace);
       if (ibuf) {
         imb_handle_alpha(ibuf, flags, colorspace, effective_colorspace);
+        r_full_size[0] = ibuf->x;
+        r_full_size[1] = ibuf->y;
         return ibuf;
       }
     }
@@ -132,6 +148,16 @@ ImBuf *IMB_ibImageFromMemory(const unsigned char *mem,
   return NULL;
 }
 
+ImBuf *IMB_ibImageFromMemory(const unsigned char *mem,
+                             size_t size,
+                             int flags,
+                             char colorspace[IM_MAX_SPACE],
+                             const char *descr)
+{
+  int full_size[2];
+  return IMB_ibImageFromMemory_scaled(mem, size, flags, colorspace, descr, 1.0f, full_size);
+}
+
 static ImBuf *IMB_ibImageFromFile(const char *filepath,
                                   int flags,
                                   char colorspace[IM_MAX_SPACE],
@@ -168,8 +194,13 @@ static bool imb_is_filepath_format(const char *filepath)
   return BLI_path_extension_check_array(filepath, imb_ext_image_filepath_only);
 }
 
-ImBuf *IMB_loadifffile(
-    int file, const char *filepath, int flags, char colorspace[IM_MAX_SPACE], const char *descr)
+static ImBuf *imb_loadifffile_scaled(int file,
+                                     const char *filepath,
+                                     int flags,
+                                     char colorspace[IM_MAX_SPACE],
+                                     const char *descr,
+                                     float scale,
+                                     int r_full_size[2])
 {
   ImBuf *ibuf;
   unsigned char *mem;
@@ -180,7 +211,12 @@ ImBuf *IMB_loadifffile(
   }
 
   if (imb_is_filepath_format(filepath)) {
-    return IMB_ibImageFromFile(filepath, flags, colorspace, descr);
+    ibuf = IMB_ibImageFromFile(filepath, flags, colorspace, descr);
+    if (ibuf) {
+      r_full_size[0] = ibuf->x;
+      r_full_size[1] = ibuf->y;
+    }
+    return ibuf;
   }
 
   size = BLI_file_descriptor_size(file);
@@ -194,7 +230,7 @@ ImBuf *IMB_loadifffile(
     return NULL;
   }
 
-  ibuf = IMB_ibImageFromMemory(mem, size, flags, colorspace, descr);
+  ibuf = IMB_ibImageFromMemory_scaled(mem, size, flags, colorspace, descr, scale, r_full_size);
 
   imb_mmap_lock();
   if (munmap(mem, size)) {
@@ -205,6 +241,13 @@ ImBuf *IMB_loadifffile(
   return ibuf;
 }
 
+ImBuf *IMB_loadifffile(
+    int file, const char *filepath, int flags, char colorspace[IM_MAX_SPACE], const char *descr)
+{
+  int full_size[2];
+  return imb_loadifffile_scaled(file, filepath, flags, colorspace, descr, 1.0f, full_size);
+}
+
 static void imb_cache_filename(char *filename, const char *name, int flags)
 {
   /* read .tx instead if it exists and is not older */
@@ -222,7 +265,16 @@ static void imb_cache_filename(char *filename, const char *name, int flags)
   BLI_strncpy(filename, name, IMB_FILENAME_SIZE);
 }
 
-ImBuf *IMB_loadiffname(const char *filepath, int flags, char colorspace[IM_MAX_SPACE])
+/**
+ * Load an image scaled down, for previews. Only file types which can read a reduced size faster
+ * than the full image do so, other images are loaded at full size. Check the size of the
+ * returned image against r_full_size to find out.
+ */
+ImBuf *IMB_loadiffname_scaled(const char *filepath,
+                              int flags,
+                              char colorspace[IM_MAX_SPACE],
+                              float scale,
+                              int r_full_size[2])
 {
   ImBuf *ibuf;
   int file, a;
@@ -237,7 +289,8 @@ ImBuf *IMB_loadiffname(const char *filepath, int flags, char colorspace[IM_MAX_S
     return NULL;
   }
 
-  ibuf = IMB_loadifffile(file, filepath, flags, colorspace, filepath_tx);
+  ibuf = imb_loadifffile_scaled(
+      file, filepath, flags, colorspace, filepath_tx, scale, r_full_size);
 
   if (ibuf) {
     BLI_strncpy(ibuf->name, filepath, sizeof(ibuf->name));
@@ -252,6 +305,12 @@ ImBuf *IMB_loadiffname(const char *filepath, int flags, char colorspace[IM_MAX_S
   return ibuf;
 }
 
+ImBuf *IMB_loadiffname(const char *filepath, int flags, char colorspace[IM_MAX_SPACE])
+{
+  int full_size[2];
+  return IMB_loadiffname_scaled(filepath, flags, colorspace, 1.0f, full_size);
+}
+
 ImBuf *IMB_testiffname(const char *filepath, int flags)
 {
   ImBuf *ibuf;
@@ -1615,6 +1615,42 @@ static void scalefast_Z_ImBuf(ImBuf *ibuf, int newx, int newy)
   }
 }
 
+/* Half float buffers are filtered as float, and converted back after scaling. */
+typedef enum eScaleHalf {
+  SCALE_HALF_NONE = 0,
+  /* Float buffer exists too, only the half float buffer has to be recreated. */
+  SCALE_HALF_WITH_FLOAT,
+  /* Float buffer is temporary, and freed after scaling. */
+  SCALE_HALF_ONLY,
+} eScaleHalf;
+
+static eScaleHalf scale_half_begin(ImBuf *ibuf)
+{
+  if (ibuf->rect_half == NULL) {
+    return SCALE_HALF_NONE;
+  }
+
+  const eScaleHalf mode = (ibuf->rect_float) ? SCALE_HALF_WITH_FLOAT : SCALE_HALF_ONLY;
+  if (mode == SCALE_HALF_ONLY) {
+    IMB_float_from_half(ibuf);
+  }
+  imb_freerecthalfImBuf(ibuf);
+
+  return mode;
+}
+
+static void scale_half_end(ImBuf *ibuf, eScaleHalf mode)
+{
+  if (mode == SCALE_HALF_NONE) {
+    return;
+  }
+
+  IMB_half_from_float(ibuf);
+  if (mode == SCALE_HALF_ONLY) {
+    imb_freerectfloatImBuf(ibuf);
+  }
+}
+
 /**
  * Return true if \a ibuf is modified.
  */
@@ -1623,7 +1659,7 @@ bool IMB_scaleImBuf(struct ImBuf *ibuf, unsigned int newx, unsigned int newy)
   if (ibuf == NULL) {
     return false;
   }
-  if (ibuf->rect == NULL && ibuf->rect_float == NULL) {
+  if (ibuf->rect == NULL && ibuf->rect_float == NULL && ibuf->rect_half == NULL) {
     return false;
   }
 
@@ -1631,6 +1667,8 @@ bool IMB_scaleImBuf(struct ImBuf *ibuf, unsigned int newx, unsigned int newy)
     return false;
   }
 
+  const eScaleHalf scale_half = scale_half_begin(ibuf);
+
   /* Scale-up / scale-down functions below change ibuf->x and ibuf->y
    * so we first scale the Z-buffer (if any). */
   scalefast_Z_ImBuf(ibuf, newx, newy);
@@ -1654,6 +1692,8 @@ bool IMB_scaleImBuf(struct ImBuf *ibuf, unsigned int newx, unsigned int newy)
     scaleupy(ibuf, newy);
   }
 
+  scale_half_end(ibuf, scale_half);
+
   return true;
 }
 
@@ -1668,8 +1708,9 @@ bool IMB_scalefastImBuf(struct ImBuf *ibuf, unsigned int newx, unsigned int newy
 {
   unsigned int *rect, *_newrect, *newrect;
   struct imbufRGBA *rectf, *_newrectf, *newrectf;
+  unsigned short *_newrecth, *newrecth;
   int x, y;
-  bool do_float = false, do_rect = false;
+  bool do_float = false, do_rect = false, do_half = false;
   size_t ofsx, ofsy, stepx, stepy;
 
   rect = NULL;
@@ -1678,6 +1719,8 @@ bool IMB_scalefastImBuf(struct ImBuf *ibuf, unsigned int newx, unsigned int newy
   rectf = NULL;
   _newrectf = NULL;
   newrectf = NULL;
+  _newrecth = NULL;
+  newrecth = NULL;
 
   if (ibuf == NULL) {
     return false;
@@ -1688,7 +1731,10 @@ bool IMB_scalefastImBuf(struct ImBuf *ibuf, unsigned int newx, unsigned int newy
   if (ibuf->rect_float) {
     do_float = true;
   }
-  if (do_rect == false && do_float == false) {
+  if (ibuf->rect_half) {
+    do_half = true;
+  }
+  if (do_rect == false && do_float == false && do_half == false) {
     return false;
   }
 
@@ -1715,6 +1761,20 @@ bool IMB_scalefastImBuf(struct ImBuf *ibuf, unsigned int newx, unsigned int newy
     newrectf = _newrectf;
   }
 
+  if (do_half) {
+    _newrecth = imb_alloc_pixels(newx, newy, ibuf->channels, sizeof(unsigned short), __func__);
+    if (_newrecth == NULL) {
+      if (_newrect) {
+        MEM_freeN(_newrect);
+      }
+      if (_newrectf) {
+        MEM_freeN(_newrectf);
+      }
+      return false;
+    }
+    newrecth = _newrecth;
+  }
+
   stepx = round(65536.0 * (ibuf->x - 1.0) / (newx - 1.0));
   stepy = round(65536.0 * (ibuf->y - 1.0) / (newy - 1.0));
   ofsy = 32768;
@@ -1739,6 +1799,18 @@ bool IMB_scalefastImBuf(struct ImBuf *ibuf, unsigned int newx, unsigned int newy
         *newrectf++ = rectf[ofsx >> 16];
       }
     }
+
+    if (do_half) {
+      const size_t pixel_size = sizeof(unsigned short) * ibuf->channels;
+      const unsigned short *recth = ibuf->rect_half +
+                                    (ofsy >> 16) * (size_t)ibuf->x * ibuf->channels;
+      ofsx = 32768;
+
+      for (x = newx; x > 0; x--, ofsx += stepx) {
+        memcpy(newrecth, recth + (ofsx >> 16) * ibuf->channels, pixel_size);
+        newrecth += ibuf->channels;
+      }
+    }
   }
 
   if (do_rect) {
@@ -1753,6 +1825,13 @@ bool IMB_scalefastImBuf(struct ImBuf *ibuf, unsigned int newx, unsigned int newy
     ibuf->rect_float = (float *)_newrectf;
   }
 
+  if (do_half) {
+    imb_freerecthalfImBuf(ibuf);
+    ibuf->mall |= IB_recthalf;
+    ibuf->flags |= IB_recthalf;
+    ibuf->rect_half = _newrecth;
+  }
+
   scalefast_Z_ImBuf(ibuf, newx, newy);
 
   ibuf->x = newx;
@@ -1839,6 +1918,7 @@ static void *do_scale_thread(void *data_v)
 void IMB_scaleImBuf_threaded(ImBuf *ibuf, unsigned int newx, unsigned int newy)
 {
   ScaleTreadInitData init_data = {NULL};
+  const eScaleHalf scale_half = scale_half_begin(ibuf);
 
   /* prepare initialization data */
   init_data.ibuf = ibuf;
@@ -1875,4 +1955,6 @@ void IMB_scaleImBuf_threaded(ImBuf *ibuf, unsigned int newx, unsigned int newy)
     ibuf->mall |= IB_rectfloat;
     ibuf->rect_float = init_data.float_buffer;
   }
+
+  scale_half_end(ibuf, scale_half);
 }
@@ -511,6 +511,8 @@ typedef struct FluidDomainSettings {
   struct Object *guide_parent;
   /** Vertex velocities of simulated fluid mesh. */
   struct FluidDomainVertexVelocity *mesh_velocities;
+  /** Background reading of the next cache frames during playback. */
+  struct FluidCachePrefetch *cache_prefetch;
   struct EffectorWeights *effector_weights;
 
   /* Domain object data. */
@@ -379,8 +379,8 @@ typedef struct ParticleSystem {
 
   /** Used for interactions with self and other systems. */
   struct KDTree_3d *tree;
-  /** Used for interactions with self and other systems. */
-  struct BVHTree *bvhtree;
+  /** Used for fluid interactions with self and other systems. */
+  struct PointGrid *point_grid;
 
   struct ParticleDrawData *pdd;
 
@@ -156,6 +156,9 @@ typedef struct PointCache {
 
 #define PTCACHE_FLAG_INFO_DIRTY (1 << 14)
 
+/* disk cache stores all frames in one file */
+#define PTCACHE_SINGLE_FILE (1 << 15)
+
 /* PTCACHE_OUTDATED + PTCACHE_FRAMES_SKIPPED */
 #define PTCACHE_REDO_NEEDED 258
 
@@ -282,6 +282,8 @@ typedef struct Editing {
 
   /* Must be initialized only by BKE_sequencer_cache_create() */
   int64_t disk_cache_timestamp;
+
+  struct SeqReadAhead *readahead;
 } Editing;
 
 /* ************* Effect Variable Structs ********* */
@@ -690,6 +692,9 @@ enum {
 
   SEQ_CACHE_PREFETCH_ENABLE = (1 << 10),
   SEQ_CACHE_DISK_CACHE_ENABLE = (1 << 11),
+
+  /* Store float images in the RAM cache as half float. */
+  SEQ_CACHE_HALF_FLOAT = (1 << 12),
 };
 
 #ifdef __cplusplus
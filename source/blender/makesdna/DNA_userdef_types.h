@@ -636,7 +636,8 @@ typedef struct UserDef_Experimental {
   char use_sculpt_vertex_colors;
   char use_switch_object_operator;
   char use_sculpt_tools_tilt;
-  char _pad[7];
+  char use_display_lut;
+  char _pad[6];
   /** `makesdna` does not allow empty structs. */
 } UserDef_Experimental;
 
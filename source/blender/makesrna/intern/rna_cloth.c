@@ -543,6 +543,29 @@ static void rna_def_cloth_solver_result(BlenderRNA *brna)
   RNA_def_property_clear_flag(prop, PROP_EDITABLE);
   RNA_def_property_ui_text(prop, "Average Iterations", "Average iterations during substeps");
 
+  prop = RNA_def_property(srna, "avg_time_solve", PROP_FLOAT, PROP_NONE);
+  RNA_def_property_float_sdna(prop, NULL, "avg_time_solve");
+  RNA_def_property_clear_flag(prop, PROP_EDITABLE);
+  RNA_def_property_ui_text(prop,
+                           "Average Solve Time",
+                           "Average time in seconds spent solving velocities during substeps");
+
+  prop = RNA_def_property(srna, "avg_time_collision_overlap", PROP_FLOAT, PROP_NONE);
+  RNA_def_property_float_sdna(prop, NULL, "avg_time_collision_overlap");
+  RNA_def_property_clear_flag(prop, PROP_EDITABLE);
+  RNA_def_property_ui_text(prop,
+                           "Average Collision Overlap Time",
+                           "Average time in seconds spent updating collision BVH trees and "
+                           "finding overlapping triangles during substeps");
+
+  prop = RNA_def_property(srna, "avg_time_collision_response", PROP_FLOAT, PROP_NONE);
+  RNA_def_property_float_sdna(prop, NULL, "avg_time_collision_response");
+  RNA_def_property_clear_flag(prop, PROP_EDITABLE);
+  RNA_def_property_ui_text(prop,
+                           "Average Collision Response Time",
+                           "Average time in seconds spent computing and applying collision "
+                           "impulses during substeps");
+
   RNA_define_verify_sdna(1);
 }
 
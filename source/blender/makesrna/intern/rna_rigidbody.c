@@ -943,6 +943,16 @@ static void rna_def_rigidbody_world(BlenderRNA *brna)
       "stability a little so use only when necessary)");
   RNA_def_property_update(prop, NC_SCENE, "rna_RigidBodyWorld_reset");
 
+  /* multithreading */
+  prop = RNA_def_property(srna, "use_multithreading", PROP_BOOLEAN, PROP_NONE);
+  RNA_def_property_boolean_sdna(prop, NULL, "flag", RBW_FLAG_USE_MULTITHREADING);
+  RNA_def_property_ui_text(prop,
+                           "Multithreading",
+                           "Use multiple threads for collision detection and constraint solving "
+                           "(faster with many objects, but results can differ slightly between "
+                           "simulation runs)");
+  RNA_def_property_update(prop, NC_SCENE, "rna_RigidBodyWorld_reset");
+
   /* cache */
   prop = RNA_def_property(srna, "point_cache", PROP_POINTER, PROP_NONE);
   RNA_def_property_flag(prop, PROP_NEVER_NULL);
@@ -114,11 +114,16 @@ void BKE_sequence_iterator_end(SeqIterator *iter);
  * **********************************************************************
  */
 
+/* Prefetch threads use IDs from SEQ_TASK_PREFETCH_RENDER up to SEQ_TASK_MAX, one per thread. */
+#define SEQ_PREFETCH_THREADS_MAX 8
+
 typedef enum eSeqTaskId {
   SEQ_TASK_MAIN_RENDER,
   SEQ_TASK_PREFETCH_RENDER,
 } eSeqTaskId;
 
+#define SEQ_TASK_MAX (SEQ_TASK_PREFETCH_RENDER + SEQ_PREFETCH_THREADS_MAX)
+
 typedef struct SeqRenderData {
   struct Main *bmain;
   struct Depsgraph *depsgraph;
@@ -228,6 +233,10 @@ void BKE_sequencer_proxy_rebuild(struct SeqIndexBuildContext *context,
                                  short *stop,
                                  short *do_update,
                                  float *progress);
+void BKE_sequencer_proxy_rebuild_queue(ListBase *queue,
+                                       short *stop,
+                                       short *do_update,
+                                       float *progress);
 void BKE_sequencer_proxy_rebuild_finish(struct SeqIndexBuildContext *context, bool stop);
 void BKE_sequencer_proxy_set(struct Sequence *seq, bool value);
 bool BKE_sequencer_check_scene_recursion(struct Scene *scene, struct ReportList *reports);
@@ -251,6 +260,21 @@ void BKE_sequencer_cache_iterate(struct Scene *scene,
                                                     int cache_type,
                                                     float cost));
 
+typedef struct SeqDiskCacheStats {
+  int read_hits;
+  int read_misses;
+  int writes;
+  /* Images not written, because writing couldn't keep up with rendering. */
+  int writes_dropped;
+  /* Size of uncompressed image data and time spent reading and writing it. */
+  size_t bytes_read;
+  size_t bytes_written;
+  double read_time;
+  double write_time;
+} SeqDiskCacheStats;
+
+bool BKE_sequencer_cache_disk_stats_get(struct Scene *scene, SeqDiskCacheStats *r_stats);
+
 /* **********************************************************************
  * prefetch.c
  *
@@ -261,6 +285,7 @@ void BKE_sequencer_cache_iterate(struct Scene *scene,
 void BKE_sequencer_prefetch_stop_all(void);
 void BKE_sequencer_prefetch_stop(struct Scene *scene);
 bool BKE_sequencer_prefetch_need_redraw(struct Main *bmain, struct Scene *scene);
+float BKE_sequencer_prefetch_fps(struct Scene *scene);
 
 /* **********************************************************************
  * sequencer.c
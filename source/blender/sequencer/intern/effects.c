@@ -134,6 +134,14 @@ static ImBuf *prepare_effect_imbufs(const SeqRenderData *context,
   int x = context->rectx;
   int y = context->recty;
 
+  /* Effects operate on float, half float inputs are widened. */
+  ImBuf *inputs[3] = {ibuf1, ibuf2, ibuf3};
+  for (int i = 0; i < 3; i++) {
+    if (inputs[i] && inputs[i]->rect_half && !inputs[i]->rect_float) {
+      IMB_float_from_half(inputs[i]);
+    }
+  }
+
   if (!ibuf1 && !ibuf2 && !ibuf3) {
     /* hmmm, global float option ? */
     out = IMB_allocImBuf(x, y, 32, IB_rect);
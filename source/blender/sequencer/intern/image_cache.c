@@ -24,6 +24,12 @@
 #include <stddef.h>
 #include <time.h>
 
+#ifndef WIN32
+#  include <sys/mman.h>
+#else
+#  include "mmap_win.h"
+#endif
+
 #include "MEM_guardedalloc.h"
 
 #include "DNA_scene_types.h"
@@ -42,6 +48,7 @@
 #include "BLI_listbase.h"
 #include "BLI_mempool.h"
 #include "BLI_path_util.h"
+#include "BLI_task.h"
 #include "BLI_threads.h"
 
 #include "BKE_global.h"
@@ -49,6 +56,20 @@
 #include "BKE_scene.h"
 #include "BKE_sequencer.h"
 
+#include "PIL_time.h"
+
+#include "atomic_ops.h"
+
+#include "zlib.h"
+
+#ifdef WITH_LZO
+#  ifdef WITH_SYSTEM_LZO
+#    include <lzo/lzo1x.h>
+#  else
+#    include "minilzo.h"
+#  endif
+#endif
+
 #include "sequencer.h"
 
 /**
@@ -83,8 +104,12 @@
  * For each cached non-temp image, image data and supplementary info are written to HDD.
  * Multiple(DCACHE_IMAGES_PER_FILE) images share the same file.
  * Each of these files contains header DiskCacheHeader followed by image data.
- * Zlib compression with user definable level can be used to compress image data(per image)
- * Images are written in order in which they are rendered.
+ * Image data is split into blocks of DCACHE_BLOCK_SIZE, which are compressed independently
+ * so they can be compressed and decompressed in parallel. Data of each image starts with a table
+ * of compressed block sizes, followed by the blocks. Blocks which don't compress are stored as
+ * they are. Compression codec (LZO for low compression level, Zlib for high) is stored per image.
+ * Images are written in order in which they are rendered, by a background thread, so rendering
+ * doesn't wait for compression and disk. If writing can't keep up, images are not written.
  * Overwriting of individual entry is not possible.
  * Stored images are deleted by invalidation, or when size of all files exceeds maximum
  * size specified in user preferences.
@@ -96,11 +121,22 @@
 /* <cache type>-<resolution X>x<resolution Y>-<rendersize>%(<view_id>)-<frame no>.dcf */
 #define DCACHE_FNAME_FORMAT "%d-%dx%d-%d%%(%d)-%d.dcf"
 #define DCACHE_IMAGES_PER_FILE 100
-#define DCACHE_CURRENT_VERSION 1
+#define DCACHE_CURRENT_VERSION 2
 #define COLORSPACE_NAME_MAX 64 /* XXX: defined in imb intern */
+#define DCACHE_BLOCK_SIZE (1024 * 1024)
+/* Compressed size of a block can exceed its size, when it is not possible to compress it. */
+#define DCACHE_BLOCK_BOUND (DCACHE_BLOCK_SIZE + DCACHE_BLOCK_SIZE / 16 + 64 + 3)
+#define DCACHE_MAX_PENDING_WRITES 8
+
+enum {
+  DCACHE_CODEC_NONE = 0,
+  DCACHE_CODEC_LZO = 1,
+  DCACHE_CODEC_ZLIB = 2,
+};
 
 typedef struct DiskCacheHeaderEntry {
   unsigned char encoding;
+  unsigned char codec;
   uint64_t frameno;
   uint64_t size_compressed;
   uint64_t size_raw;
@@ -118,8 +154,23 @@ typedef struct SeqDiskCache {
   ListBase files;
   ThreadMutex read_write_mutex;
   size_t size_total;
+  /* Images are written by background thread. */
+  TaskPool *write_pool;
+  int pending_writes;
+  /* Incremented on invalidation, queued images of older generation are not written. */
+  int generation;
+  /* Protected by read_write_mutex. */
+  SeqDiskCacheStats stats;
 } SeqDiskCache;
 
+typedef struct DiskCacheWriteTask {
+  SeqDiskCache *disk_cache;
+  char path[FILE_MAX];
+  float frameno;
+  int generation;
+  ImBuf *ibuf;
+} DiskCacheWriteTask;
+
 typedef struct DiskCacheFile {
   struct DiskCacheFile *next, *prev;
   char path[FILE_MAX];
@@ -134,20 +185,30 @@ typedef struct DiskCacheFile {
   int start_frame;
 } DiskCacheFile;
 
+/* Number of half float images kept converted to float, so repeated hits of the same image share
+ * one float copy. */
+#define SEQ_CACHE_FLOAT_COPIES 2
+
 typedef struct SeqCache {
   Main *bmain;
   struct GHash *hash;
   ThreadMutex iterator_mutex;
   struct BLI_mempool *keys_pool;
   struct BLI_mempool *items_pool;
-  struct SeqCacheKey *last_key;
+  /* Last stored key of each task, for linking keys of a rendered stack. */
+  struct SeqCacheKey *last_key[SEQ_TASK_MAX];
   size_t memory_used;
   SeqDiskCache *disk_cache;
+  /* Items with a float copy, the oldest one is replaced first. */
+  struct SeqCacheItem *float_items[SEQ_CACHE_FLOAT_COPIES];
+  int float_items_next;
 } SeqCache;
 
 typedef struct SeqCacheItem {
   struct SeqCache *cache_owner;
   struct ImBuf *ibuf;
+  /* Float copy of a half float image, see #seq_cache_ibuf_from_stored. */
+  struct ImBuf *float_ibuf;
 } SeqCacheItem;
 
 typedef struct SeqCacheKey {
@@ -174,6 +235,25 @@ static char *seq_disk_cache_base_dir(void)
   return U.sequencer_disk_cache_dir;
 }
 
+static int seq_disk_cache_codec(void)
+{
+  switch (U.sequencer_disk_cache_compression) {
+    case USER_SEQ_DISK_CACHE_COMPRESSION_NONE:
+      return DCACHE_CODEC_NONE;
+    case USER_SEQ_DISK_CACHE_COMPRESSION_LOW:
+#ifdef WITH_LZO
+      return DCACHE_CODEC_LZO;
+#else
+      return DCACHE_CODEC_ZLIB;
+#endif
+    case USER_SEQ_DISK_CACHE_COMPRESSION_HIGH:
+      return DCACHE_CODEC_ZLIB;
+  }
+
+  return DCACHE_CODEC_NONE;
+}
+
+/* Zlib compression level. */
 static int seq_disk_cache_compression_level(void)
 {
   switch (U.sequencer_disk_cache_compression) {
@@ -466,6 +546,11 @@ static void seq_disk_cache_invalidate(Scene *scene,
   int end;
   SeqDiskCache *disk_cache = scene->ed->cache->disk_cache;
 
+  /* Pending images are invalid too. Image which is being written holds the mutex, so it is
+   * written before files are deleted, remaining images are skipped by the write task.
+   * The pool is not canceled, background serial pool can not run tasks after cancel. */
+  atomic_add_and_fetch_int32(&disk_cache->generation, 1);
+
   BLI_mutex_lock(&disk_cache->read_write_mutex);
 
   start = seq_changed->startdisp - DCACHE_IMAGES_PER_FILE;
@@ -476,29 +561,326 @@ static void seq_disk_cache_invalidate(Scene *scene,
   BLI_mutex_unlock(&disk_cache->read_write_mutex);
 }
 
-static size_t deflate_imbuf_to_file(ImBuf *ibuf,
-                                    FILE *file,
-                                    int level,
-                                    DiskCacheHeaderEntry *header_entry)
+typedef struct DiskCacheBlocks {
+  int codec;
+  int level;
+  size_t size_raw;
+  int num_blocks;
+  uint32_t *block_sizes;
+  /* Uncompressed data. */
+  unsigned char *data_raw;
+  /* Compressed blocks, with stride of DCACHE_BLOCK_BOUND when compressing, packed otherwise. */
+  unsigned char *data_compressed;
+  /* Compressed blocks point to memory mapped file, they are not freed. */
+  bool data_mapped;
+  size_t *block_offsets;
+  bool error;
+} DiskCacheBlocks;
+
+/* Memory mapping is not thread safe on Windows. */
+static ThreadMutex seq_disk_cache_mmap_lock = BLI_MUTEX_INITIALIZER;
+
+static size_t seq_disk_cache_block_size(const DiskCacheBlocks *blocks, int block)
+{
+  const size_t offset = (size_t)block * DCACHE_BLOCK_SIZE;
+  return MIN2(DCACHE_BLOCK_SIZE, blocks->size_raw - offset);
+}
+
+static void seq_disk_cache_compress_block(void *__restrict userdata,
+                                          const int block,
+                                          const TaskParallelTLS *__restrict UNUSED(tls))
+{
+  DiskCacheBlocks *blocks = (DiskCacheBlocks *)userdata;
+  const size_t size = seq_disk_cache_block_size(blocks, block);
+  const unsigned char *in = blocks->data_raw + (size_t)block * DCACHE_BLOCK_SIZE;
+  unsigned char *out = blocks->data_compressed + (size_t)block * DCACHE_BLOCK_BOUND;
+  size_t out_len = 0;
+
+  switch (blocks->codec) {
+#ifdef WITH_LZO
+    case DCACHE_CODEC_LZO: {
+      void *wrkmem = MEM_mallocN(LZO1X_1_MEM_COMPRESS, "seq disk cache lzo wrkmem");
+      lzo_uint len = 0;
+      if (lzo1x_1_compress(in, (lzo_uint)size, out, &len, wrkmem) == LZO_E_OK) {
+        out_len = len;
+      }
+      MEM_freeN(wrkmem);
+      break;
+    }
+#endif
+    case DCACHE_CODEC_ZLIB: {
+      uLongf len = DCACHE_BLOCK_BOUND;
+      if (compress2(out, &len, in, (uLong)size, blocks->level) == Z_OK) {
+        out_len = len;
+      }
+      break;
+    }
+  }
+
+  /* Block is stored uncompressed. */
+  if (out_len == 0 || out_len >= size) {
+    memcpy(out, in, size);
+    out_len = size;
+  }
+
+  blocks->block_sizes[block] = (uint32_t)out_len;
+}
+
+static void seq_disk_cache_decompress_block(void *__restrict userdata,
+                                            const int block,
+                                            const TaskParallelTLS *__restrict UNUSED(tls))
+{
+  DiskCacheBlocks *blocks = (DiskCacheBlocks *)userdata;
+  const size_t size = seq_disk_cache_block_size(blocks, block);
+  const unsigned char *in = blocks->data_compressed + blocks->block_offsets[block];
+  const size_t in_len = blocks->block_sizes[block];
+  unsigned char *out = blocks->data_raw + (size_t)block * DCACHE_BLOCK_SIZE;
+  size_t out_len = 0;
+
+  if (in_len == size) {
+    memcpy(out, in, size);
+    return;
+  }
+
+  switch (blocks->codec) {
+#ifdef WITH_LZO
+    case DCACHE_CODEC_LZO: {
+      lzo_uint len = size;
+      if (lzo1x_decompress_safe(in, (lzo_uint)in_len, out, &len, NULL) == LZO_E_OK) {
+        out_len = len;
+      }
+      break;
+    }
+#endif
+    case DCACHE_CODEC_ZLIB: {
+      uLongf len = size;
+      if (uncompress(out, &len, in, (uLong)in_len) == Z_OK) {
+        out_len = len;
+      }
+      break;
+    }
+  }
+
+  if (out_len != size) {
+    blocks->error = true;
+  }
+}
+
+static unsigned char *seq_disk_cache_imbuf_data(ImBuf *ibuf)
 {
   if (ibuf->rect) {
-    return BLI_gzip_mem_to_file_at_pos(
-        ibuf->rect, header_entry->size_raw, file, header_entry->offset, level);
+    return (unsigned char *)ibuf->rect;
   }
+  return (unsigned char *)ibuf->rect_float;
+}
 
-  return BLI_gzip_mem_to_file_at_pos(
-      ibuf->rect_float, header_entry->size_raw, file, header_entry->offset, level);
+static int seq_disk_cache_num_blocks(size_t size_raw)
+{
+  return (int)((size_raw + DCACHE_BLOCK_SIZE - 1) / DCACHE_BLOCK_SIZE);
 }
 
-static size_t inflate_file_to_imbuf(ImBuf *ibuf, FILE *file, DiskCacheHeaderEntry *header_entry)
+static size_t seq_disk_cache_imbuf_size(ImBuf *ibuf)
 {
   if (ibuf->rect) {
-    return BLI_ungzip_file_to_mem_at_pos(
-        ibuf->rect, header_entry->size_raw, file, header_entry->offset);
+    return (size_t)ibuf->x * ibuf->y * ibuf->channels;
   }
+  return (size_t)ibuf->x * ibuf->y * ibuf->channels * 4;
+}
 
-  return BLI_ungzip_file_to_mem_at_pos(
-      ibuf->rect_float, header_entry->size_raw, file, header_entry->offset);
+/* Compress image data in parallel. Blocks have to be freed with
+ * seq_disk_cache_blocks_free(). */
+static void seq_disk_cache_compress_imbuf(ImBuf *ibuf, DiskCacheBlocks *blocks)
+{
+  memset(blocks, 0, sizeof(*blocks));
+  blocks->codec = seq_disk_cache_codec();
+  blocks->level = seq_disk_cache_compression_level();
+  blocks->size_raw = seq_disk_cache_imbuf_size(ibuf);
+  blocks->num_blocks = seq_disk_cache_num_blocks(blocks->size_raw);
+  blocks->data_raw = seq_disk_cache_imbuf_data(ibuf);
+  blocks->block_sizes = MEM_mallocN(sizeof(uint32_t) * blocks->num_blocks,
+                                    "seq disk cache block sizes");
+
+  if (blocks->codec == DCACHE_CODEC_NONE) {
+    for (int i = 0; i < blocks->num_blocks; i++) {
+      blocks->block_sizes[i] = (uint32_t)seq_disk_cache_block_size(blocks, i);
+    }
+    return;
+  }
+
+  blocks->data_compressed = MEM_mallocN((size_t)DCACHE_BLOCK_BOUND * blocks->num_blocks,
+                                        "seq disk cache compressed blocks");
+
+  TaskParallelSettings settings;
+  BLI_parallel_range_settings_defaults(&settings);
+  settings.min_iter_per_thread = 1;
+  BLI_task_parallel_range(0, blocks->num_blocks, blocks, seq_disk_cache_compress_block, &settings);
+}
+
+static void seq_disk_cache_blocks_free(DiskCacheBlocks *blocks)
+{
+  if (blocks->data_mapped) {
+    blocks->data_compressed = NULL;
+  }
+  MEM_SAFE_FREE(blocks->block_sizes);
+  MEM_SAFE_FREE(blocks->data_compressed);
+  MEM_SAFE_FREE(blocks->block_offsets);
+}
+
+/* Write block table and blocks to file, returns number of bytes written or 0 on failure. */
+static size_t seq_disk_cache_write_blocks(FILE *file,
+                                          DiskCacheHeaderEntry *header_entry,
+                                          DiskCacheBlocks *blocks)
+{
+  const size_t table_size = sizeof(uint32_t) * blocks->num_blocks;
+  size_t bytes_written = table_size;
+
+  fseek(file, header_entry->offset, 0);
+  if (fwrite(blocks->block_sizes, table_size, 1, file) != 1) {
+    return 0;
+  }
+
+  for (int i = 0; i < blocks->num_blocks; i++) {
+    const unsigned char *data;
+    if (blocks->codec == DCACHE_CODEC_NONE) {
+      data = blocks->data_raw + (size_t)i * DCACHE_BLOCK_SIZE;
+    }
+    else {
+      data = blocks->data_compressed + (size_t)i * DCACHE_BLOCK_BOUND;
+    }
+
+    if (fwrite(data, blocks->block_sizes[i], 1, file) != 1) {
+      return 0;
+    }
+    bytes_written += blocks->block_sizes[i];
+  }
+
+  return bytes_written;
+}
+
+static void seq_disk_cache_init_blocks(DiskCacheHeaderEntry *header_entry,
+                                       ImBuf *ibuf,
+                                       DiskCacheBlocks *blocks)
+{
+  memset(blocks, 0, sizeof(*blocks));
+  blocks->codec = header_entry->codec;
+  blocks->size_raw = header_entry->size_raw;
+  blocks->num_blocks = seq_disk_cache_num_blocks(blocks->size_raw);
+  blocks->data_raw = seq_disk_cache_imbuf_data(ibuf);
+}
+
+/* Find blocks in compressed data, once block table is read. */
+static bool seq_disk_cache_init_block_offsets(DiskCacheHeaderEntry *header_entry,
+                                              DiskCacheBlocks *blocks)
+{
+  const size_t table_size = sizeof(uint32_t) * blocks->num_blocks;
+
+  if ((ENDIAN_ORDER == B_ENDIAN) && header_entry->encoding == 0) {
+    BLI_endian_switch_uint32_array(blocks->block_sizes, blocks->num_blocks);
+  }
+
+  blocks->block_offsets = MEM_mallocN(sizeof(size_t) * blocks->num_blocks,
+                                      "seq disk cache block offsets");
+
+  size_t offset = 0;
+  for (int i = 0; i < blocks->num_blocks; i++) {
+    blocks->block_offsets[i] = offset;
+    offset += blocks->block_sizes[i];
+  }
+
+  return offset == header_entry->size_compressed - table_size;
+}
+
+/* Read compressed data of image from file. Decompression can be done without holding a lock. */
+static bool seq_disk_cache_read_blocks(FILE *file,
+                                       DiskCacheHeaderEntry *header_entry,
+                                       ImBuf *ibuf,
+                                       DiskCacheBlocks *blocks)
+{
+  seq_disk_cache_init_blocks(header_entry, ibuf, blocks);
+
+  const size_t table_size = sizeof(uint32_t) * blocks->num_blocks;
+  if (header_entry->size_compressed < table_size) {
+    return false;
+  }
+
+  blocks->block_sizes = MEM_mallocN(table_size, "seq disk cache block sizes");
+  blocks->data_compressed = MEM_mallocN(header_entry->size_compressed - table_size + 1,
+                                        "seq disk cache compressed blocks");
+
+  fseek(file, header_entry->offset, 0);
+  if (fread(blocks->block_sizes, table_size, 1, file) != 1) {
+    return false;
+  }
+  if (fread(blocks->data_compressed, header_entry->size_compressed - table_size, 1, file) != 1) {
+    return false;
+  }
+
+  return seq_disk_cache_init_block_offsets(header_entry, blocks);
+}
+
+/* Map whole file, returns NULL if it can't be mapped. */
+static unsigned char *seq_disk_cache_map_file(FILE *file, size_t *r_map_len)
+{
+  const int fd = fileno(file);
+  const size_t map_len = BLI_file_descriptor_size(fd);
+
+  if (map_len == 0 || map_len == (size_t)-1) {
+    return NULL;
+  }
+
+  BLI_mutex_lock(&seq_disk_cache_mmap_lock);
+  unsigned char *map = mmap(NULL, map_len, PROT_READ, MAP_SHARED, fd, 0);
+  BLI_mutex_unlock(&seq_disk_cache_mmap_lock);
+
+  if (map == (unsigned char *)MAP_FAILED) {
+    return NULL;
+  }
+
+  *r_map_len = map_len;
+  return map;
+}
+
+static void seq_disk_cache_unmap_file(unsigned char *map, size_t map_len)
+{
+  BLI_mutex_lock(&seq_disk_cache_mmap_lock);
+  munmap(map, map_len);
+  BLI_mutex_unlock(&seq_disk_cache_mmap_lock);
+}
+
+/* Use compressed data of image in mapped file, without copying it. The file can be written to,
+ * so data has to be decompressed while holding a lock. */
+static bool seq_disk_cache_map_blocks(unsigned char *map,
+                                      size_t map_len,
+                                      DiskCacheHeaderEntry *header_entry,
+                                      ImBuf *ibuf,
+                                      DiskCacheBlocks *blocks)
+{
+  seq_disk_cache_init_blocks(header_entry, ibuf, blocks);
+
+  const size_t table_size = sizeof(uint32_t) * blocks->num_blocks;
+  if (header_entry->size_compressed < table_size || header_entry->offset > map_len ||
+      header_entry->size_compressed > map_len - header_entry->offset) {
+    return false;
+  }
+
+  /* Block table is copied, it may need to be converted to native endian. */
+  blocks->block_sizes = MEM_mallocN(table_size, "seq disk cache block sizes");
+  memcpy(blocks->block_sizes, map + header_entry->offset, table_size);
+  blocks->data_compressed = map + header_entry->offset + table_size;
+  blocks->data_mapped = true;
+
+  return seq_disk_cache_init_block_offsets(header_entry, blocks);
+}
+
+static bool seq_disk_cache_decompress_blocks(DiskCacheBlocks *blocks)
+{
+  TaskParallelSettings settings;
+  BLI_parallel_range_settings_defaults(&settings);
+  settings.min_iter_per_thread = 1;
+  BLI_task_parallel_range(
+      0, blocks->num_blocks, blocks, seq_disk_cache_decompress_block, &settings);
+
+  return !blocks->error;
 }
 
 static void seq_disk_cache_read_header(FILE *file, DiskCacheHeader *header)
@@ -522,7 +904,10 @@ static size_t seq_disk_cache_write_header(FILE *file, DiskCacheHeader *header)
   return fwrite(header, sizeof(*header), 1, file);
 }
 
-static int seq_disk_cache_add_header_entry(SeqCacheKey *key, ImBuf *ibuf, DiskCacheHeader *header)
+static int seq_disk_cache_add_header_entry(float frameno,
+                                           ImBuf *ibuf,
+                                           DiskCacheBlocks *blocks,
+                                           DiskCacheHeader *header)
 {
   int i;
   uint64_t offset = sizeof(*header);
@@ -554,17 +939,17 @@ static int seq_disk_cache_add_header_entry(SeqCacheKey *key, ImBuf *ibuf, DiskCa
     header->entry[i].encoding = 0;
   }
 
+  header->entry[i].codec = blocks->codec;
   header->entry[i].offset = offset;
-  header->entry[i].frameno = key->nfra;
+  header->entry[i].frameno = frameno;
 
   /* Store colorspace name of ibuf. */
   const char *colorspace_name;
+  header->entry[i].size_raw = seq_disk_cache_imbuf_size(ibuf);
   if (ibuf->rect) {
-    header->entry[i].size_raw = ibuf->x * ibuf->y * ibuf->channels;
     colorspace_name = IMB_colormanagement_get_rect_colorspace(ibuf);
   }
   else {
-    header->entry[i].size_raw = ibuf->x * ibuf->y * ibuf->channels * 4;
     colorspace_name = IMB_colormanagement_get_float_colorspace(ibuf);
   }
   BLI_strncpy(
@@ -584,17 +969,39 @@ static int seq_disk_cache_get_header_entry(SeqCacheKey *key, DiskCacheHeader *he
   return -1;
 }
 
-static bool seq_disk_cache_write_file(SeqDiskCache *disk_cache, SeqCacheKey *key, ImBuf *ibuf)
+static bool seq_disk_cache_write_file(SeqDiskCache *disk_cache,
+                                      const char *path,
+                                      float frameno,
+                                      int generation,
+                                      ImBuf *ibuf)
 {
-  char path[FILE_MAX];
+  if (atomic_fetch_and_add_int32(&disk_cache->generation, 0) != generation) {
+    return false;
+  }
+
+  const double begin = PIL_check_seconds_timer();
+
+  /* Compress before file is locked, offset of data in file is not needed for this. */
+  DiskCacheBlocks blocks;
+  seq_disk_cache_compress_imbuf(ibuf, &blocks);
+
+  BLI_mutex_lock(&disk_cache->read_write_mutex);
+
+  /* Cache may have been invalidated while compressing. */
+  if (disk_cache->generation != generation) {
+    BLI_mutex_unlock(&disk_cache->read_write_mutex);
+    seq_disk_cache_blocks_free(&blocks);
+    return false;
+  }
 
-  seq_disk_cache_get_file_path(disk_cache, key, path, sizeof(path));
   BLI_make_existing_file(path);
 
   FILE *file = BLI_fopen(path, "rb+");
   if (!file) {
     file = BLI_fopen(path, "wb+");
     if (!file) {
+      BLI_mutex_unlock(&disk_cache->read_write_mutex);
+      seq_disk_cache_blocks_free(&blocks);
       return false;
     }
     seq_disk_cache_add_file_to_list(disk_cache, path);
@@ -603,9 +1010,8 @@ static bool seq_disk_cache_write_file(SeqDiskCache *disk_cache, SeqCacheKey *key
   DiskCacheHeader header;
   memset(&header, 0, sizeof(header));
   seq_disk_cache_read_header(file, &header);
-  int entry_index = seq_disk_cache_add_header_entry(key, ibuf, &header);
-  size_t bytes_written = deflate_imbuf_to_file(
-      ibuf, file, seq_disk_cache_compression_level(), &header.entry[entry_index]);
+  int entry_index = seq_disk_cache_add_header_entry(frameno, ibuf, &blocks, &header);
+  size_t bytes_written = seq_disk_cache_write_blocks(file, &header.entry[entry_index], &blocks);
 
   if (bytes_written != 0) {
     /* Last step is writing header, as image data can be overwritten,
@@ -613,25 +1019,79 @@ static bool seq_disk_cache_write_file(SeqDiskCache *disk_cache, SeqCacheKey *key
      */
     header.entry[entry_index].size_compressed = bytes_written;
     seq_disk_cache_write_header(file, &header);
-    seq_disk_cache_update_file(disk_cache, path);
-    fclose(file);
+    seq_disk_cache_update_file(disk_cache, (char *)path);
 
-    return true;
+    disk_cache->stats.writes++;
+    disk_cache->stats.bytes_written += header.entry[entry_index].size_raw;
+    disk_cache->stats.write_time += PIL_check_seconds_timer() - begin;
   }
 
-  return false;
+  fclose(file);
+  BLI_mutex_unlock(&disk_cache->read_write_mutex);
+  seq_disk_cache_blocks_free(&blocks);
+
+  return bytes_written != 0;
 }
 
-static ImBuf *seq_disk_cache_read_file(SeqDiskCache *disk_cache, SeqCacheKey *key)
+static void seq_disk_cache_write_task(TaskPool *__restrict UNUSED(pool), void *taskdata)
+{
+  DiskCacheWriteTask *task = (DiskCacheWriteTask *)taskdata;
+
+  seq_disk_cache_write_file(
+      task->disk_cache, task->path, task->frameno, task->generation, task->ibuf);
+  seq_disk_cache_enforce_limits(task->disk_cache);
+}
+
+static void seq_disk_cache_write_task_free(TaskPool *__restrict UNUSED(pool), void *taskdata)
+{
+  DiskCacheWriteTask *task = (DiskCacheWriteTask *)taskdata;
+
+  IMB_freeImBuf(task->ibuf);
+  atomic_sub_and_fetch_int32(&task->disk_cache->pending_writes, 1);
+  MEM_freeN(task);
+}
+
+/* Queue image to be written by background thread. Image is not written when too many images are
+ * waiting to be written, rendering should not wait for disk. */
+static void seq_disk_cache_write_file_async(SeqDiskCache *disk_cache,
+                                            SeqCacheKey *key,
+                                            ImBuf *ibuf)
+{
+  if (atomic_add_and_fetch_int32(&disk_cache->pending_writes, 1) > DCACHE_MAX_PENDING_WRITES) {
+    atomic_sub_and_fetch_int32(&disk_cache->pending_writes, 1);
+    BLI_mutex_lock(&disk_cache->read_write_mutex);
+    disk_cache->stats.writes_dropped++;
+    BLI_mutex_unlock(&disk_cache->read_write_mutex);
+    return;
+  }
+
+  DiskCacheWriteTask *task = MEM_callocN(sizeof(DiskCacheWriteTask), "DiskCacheWriteTask");
+  task->disk_cache = disk_cache;
+  task->frameno = key->nfra;
+  task->generation = atomic_fetch_and_add_int32(&disk_cache->generation, 0);
+  task->ibuf = ibuf;
+  IMB_refImBuf(ibuf);
+  seq_disk_cache_get_file_path(disk_cache, key, task->path, sizeof(task->path));
+
+  BLI_task_pool_push(disk_cache->write_pool,
+                     seq_disk_cache_write_task,
+                     task,
+                     true,
+                     seq_disk_cache_write_task_free);
+}
+
+static ImBuf *seq_disk_cache_read_file_ex(SeqDiskCache *disk_cache, SeqCacheKey *key)
 {
   char path[FILE_MAX];
   DiskCacheHeader header;
 
   seq_disk_cache_get_file_path(disk_cache, key, path, sizeof(path));
-  BLI_make_existing_file(path);
+
+  BLI_mutex_lock(&disk_cache->read_write_mutex);
 
   FILE *file = BLI_fopen(path, "rb");
   if (!file) {
+    BLI_mutex_unlock(&disk_cache->read_write_mutex);
     return NULL;
   }
 
@@ -641,40 +1101,80 @@ static ImBuf *seq_disk_cache_read_file(SeqDiskCache *disk_cache, SeqCacheKey *ke
   /* Item not found. */
   if (entry_index < 0) {
     fclose(file);
+    BLI_mutex_unlock(&disk_cache->read_write_mutex);
     return NULL;
   }
 
+  DiskCacheHeaderEntry *header_entry = &header.entry[entry_index];
   ImBuf *ibuf;
   uint64_t size_char = (uint64_t)key->context.rectx * key->context.recty * 4;
   uint64_t size_float = (uint64_t)key->context.rectx * key->context.recty * 16;
-  size_t expected_size;
 
-  if (header.entry[entry_index].size_raw == size_char) {
-    expected_size = size_char;
+  if (header_entry->size_raw == size_char) {
     ibuf = IMB_allocImBuf(key->context.rectx, key->context.recty, 32, IB_rect);
-    IMB_colormanagement_assign_rect_colorspace(ibuf, header.entry[entry_index].colorspace_name);
+    IMB_colormanagement_assign_rect_colorspace(ibuf, header_entry->colorspace_name);
   }
-  else if (header.entry[entry_index].size_raw == size_float) {
-    expected_size = size_float;
+  else if (header_entry->size_raw == size_float) {
     ibuf = IMB_allocImBuf(key->context.rectx, key->context.recty, 32, IB_rectfloat);
-    IMB_colormanagement_assign_float_colorspace(ibuf, header.entry[entry_index].colorspace_name);
+    IMB_colormanagement_assign_float_colorspace(ibuf, header_entry->colorspace_name);
   }
   else {
     fclose(file);
+    BLI_mutex_unlock(&disk_cache->read_write_mutex);
     return NULL;
   }
 
-  size_t bytes_read = inflate_file_to_imbuf(ibuf, file, &header.entry[entry_index]);
+  /* Decompress directly from mapped file when possible, otherwise read compressed data to memory
+   * and decompress it after the file is unlocked. */
+  DiskCacheBlocks blocks;
+  size_t map_len = 0;
+  unsigned char *map = seq_disk_cache_map_file(file, &map_len);
+  bool ok;
+
+  if (map) {
+    ok = seq_disk_cache_map_blocks(map, map_len, header_entry, ibuf, &blocks) &&
+         seq_disk_cache_decompress_blocks(&blocks);
+    seq_disk_cache_unmap_file(map, map_len);
+  }
+  else {
+    ok = seq_disk_cache_read_blocks(file, header_entry, ibuf, &blocks);
+  }
+
+  if (ok) {
+    BLI_file_touch(path);
+    seq_disk_cache_update_file(disk_cache, path);
+  }
+  fclose(file);
+  BLI_mutex_unlock(&disk_cache->read_write_mutex);
 
   /* Sanity check. */
-  if (bytes_read != expected_size) {
-    fclose(file);
+  if (!ok || (!map && !seq_disk_cache_decompress_blocks(&blocks))) {
+    seq_disk_cache_blocks_free(&blocks);
     IMB_freeImBuf(ibuf);
     return NULL;
   }
-  BLI_file_touch(path);
-  seq_disk_cache_update_file(disk_cache, path);
-  fclose(file);
+
+  seq_disk_cache_blocks_free(&blocks);
+
+  return ibuf;
+}
+
+static ImBuf *seq_disk_cache_read_file(SeqDiskCache *disk_cache, SeqCacheKey *key)
+{
+  const double begin = PIL_check_seconds_timer();
+  ImBuf *ibuf = seq_disk_cache_read_file_ex(disk_cache, key);
+  const double time = PIL_check_seconds_timer() - begin;
+
+  BLI_mutex_lock(&disk_cache->read_write_mutex);
+  if (ibuf) {
+    disk_cache->stats.read_hits++;
+    disk_cache->stats.bytes_read += IMB_get_size_in_memory(ibuf);
+  }
+  else {
+    disk_cache->stats.read_misses++;
+  }
+  disk_cache->stats.read_time += time;
+  BLI_mutex_unlock(&disk_cache->read_write_mutex);
 
   return ibuf;
 }
@@ -683,6 +1183,9 @@ static ImBuf *seq_disk_cache_read_file(SeqDiskCache *disk_cache, SeqCacheKey *ke
 #undef DCACHE_IMAGES_PER_FILE
 #undef COLORSPACE_NAME_MAX
 #undef DCACHE_CURRENT_VERSION
+#undef DCACHE_BLOCK_SIZE
+#undef DCACHE_BLOCK_BOUND
+#undef DCACHE_MAX_PENDING_WRITES
 
 static bool seq_cmp_render_data(const SeqRenderData *a, const SeqRenderData *b)
 {
@@ -776,11 +1279,46 @@ static void seq_cache_keyfree(void *val)
   BLI_mempool_free(key->cache_owner->keys_pool, key);
 }
 
+static void seq_cache_item_free_float_copy(SeqCacheItem *item)
+{
+  SeqCache *cache = item->cache_owner;
+
+  if (item->float_ibuf) {
+    cache->memory_used -= IMB_get_size_in_memory(item->float_ibuf);
+    IMB_freeImBuf(item->float_ibuf);
+    item->float_ibuf = NULL;
+  }
+
+  for (int i = 0; i < SEQ_CACHE_FLOAT_COPIES; i++) {
+    if (cache->float_items[i] == item) {
+      cache->float_items[i] = NULL;
+    }
+  }
+}
+
+static void seq_cache_item_keep_float_copy(SeqCacheItem *item, ImBuf *float_ibuf)
+{
+  SeqCache *cache = item->cache_owner;
+  SeqCacheItem *oldest_item = cache->float_items[cache->float_items_next];
+
+  if (oldest_item) {
+    seq_cache_item_free_float_copy(oldest_item);
+  }
+
+  IMB_refImBuf(float_ibuf);
+  item->float_ibuf = float_ibuf;
+  cache->memory_used += IMB_get_size_in_memory(float_ibuf);
+  cache->float_items[cache->float_items_next] = item;
+  cache->float_items_next = (cache->float_items_next + 1) % SEQ_CACHE_FLOAT_COPIES;
+}
+
 static void seq_cache_valfree(void *val)
 {
   SeqCacheItem *item = (SeqCacheItem *)val;
   SeqCache *cache = item->cache_owner;
 
+  seq_cache_item_free_float_copy(item);
+
   if (item->ibuf) {
     cache->memory_used -= IMB_get_size_in_memory(item->ibuf);
     IMB_freeImBuf(item->ibuf);
@@ -795,10 +1333,11 @@ static void seq_cache_put(SeqCache *cache, SeqCacheKey *key, ImBuf *ibuf)
   item = BLI_mempool_alloc(cache->items_pool);
   item->cache_owner = cache;
   item->ibuf = ibuf;
+  item->float_ibuf = NULL;
 
   if (BLI_ghash_reinsert(cache->hash, key, item, seq_cache_keyfree, seq_cache_valfree)) {
     IMB_refImBuf(ibuf);
-    cache->last_key = key;
+    cache->last_key[key->task_id] = key;
     cache->memory_used += IMB_get_size_in_memory(ibuf);
   }
 }
@@ -808,14 +1347,59 @@ static ImBuf *seq_cache_get(SeqCache *cache, SeqCacheKey *key)
   SeqCacheItem *item = BLI_ghash_lookup(cache->hash, key);
 
   if (item && item->ibuf) {
-    IMB_refImBuf(item->ibuf);
+    ImBuf *ibuf = (item->float_ibuf) ? item->float_ibuf : item->ibuf;
+    IMB_refImBuf(ibuf);
 
-    return item->ibuf;
+    return ibuf;
   }
 
   return NULL;
 }
 
+static bool seq_cache_contains(SeqCache *cache, SeqCacheKey *key)
+{
+  SeqCacheItem *item = BLI_ghash_lookup(cache->hash, key);
+  return item && item->ibuf;
+}
+
+/* Images stored as half float are converted back to float for rendering. The cached image may
+ * be used by other threads, so it is copied instead of adding a float buffer to it. The copy is
+ * kept with the item for the following hits, like redraws of the same frame. */
+static ImBuf *seq_cache_ibuf_from_stored(Scene *scene, SeqCacheKey *key, ImBuf *ibuf)
+{
+  if (ibuf->rect_half == NULL || ibuf->rect_float != NULL) {
+    return ibuf;
+  }
+
+  /* Convert outside of the lock, other threads keep using the cache meanwhile. */
+  ImBuf *float_ibuf = IMB_float_copy_from_half(ibuf);
+
+  if (float_ibuf) {
+    seq_cache_lock(scene);
+    SeqCache *cache = seq_cache_get_from_scene(scene);
+    SeqCacheItem *item = (cache) ? BLI_ghash_lookup(cache->hash, key) : NULL;
+    /* The image may have been replaced or converted by another thread meanwhile. */
+    if (item && item->ibuf == ibuf && item->float_ibuf == NULL) {
+      seq_cache_item_keep_float_copy(item, float_ibuf);
+    }
+    seq_cache_unlock(scene);
+  }
+
+  IMB_freeImBuf(ibuf);
+  return float_ibuf;
+}
+
+/* Float images stored for later use take half the memory as half float. */
+static ImBuf *seq_cache_ibuf_to_stored(Scene *scene, ImBuf *ibuf)
+{
+  if ((scene->ed->cache_flag & SEQ_CACHE_HALF_FLOAT) == 0 || ibuf->rect_float == NULL) {
+    return ibuf;
+  }
+
+  ImBuf *half_ibuf = IMB_half_copy_from_float(ibuf);
+  return (half_ibuf) ? half_ibuf : ibuf;
+}
+
 static void seq_cache_relink_keys(SeqCacheKey *link_next, SeqCacheKey *link_prev)
 {
   if (link_next) {
@@ -1037,17 +1621,16 @@ static void seq_disk_cache_create(Main *bmain, Scene *scene)
   BLI_mutex_lock(&cache_create_lock);
   SeqCache *cache = seq_cache_get_from_scene(scene);
 
-  if (cache == NULL) {
-    return;
-  }
-
-  if (cache->disk_cache != NULL) {
+  if (cache == NULL || cache->disk_cache != NULL) {
+    BLI_mutex_unlock(&cache_create_lock);
     return;
   }
 
   cache->disk_cache = MEM_callocN(sizeof(SeqDiskCache), "SeqDiskCache");
   cache->disk_cache->bmain = bmain;
   BLI_mutex_init(&cache->disk_cache->read_write_mutex);
+  cache->disk_cache->write_pool = BLI_task_pool_create_background_serial(NULL,
+                                                                         TASK_PRIORITY_LOW);
   seq_disk_cache_handle_versioning(cache->disk_cache);
   seq_disk_cache_get_files(cache->disk_cache, seq_disk_cache_base_dir());
   cache->disk_cache->timestamp = scene->ed->disk_cache_timestamp;
@@ -1062,7 +1645,7 @@ static void seq_cache_create(Main *bmain, Scene *scene)
     cache->keys_pool = BLI_mempool_create(sizeof(SeqCacheKey), 0, 64, BLI_MEMPOOL_NOP);
     cache->items_pool = BLI_mempool_create(sizeof(SeqCacheItem), 0, 64, BLI_MEMPOOL_NOP);
     cache->hash = BLI_ghash_new(seq_cache_hashhash, seq_cache_hashcmp, "SeqCache hash");
-    cache->last_key = NULL;
+    memset(cache->last_key, 0, sizeof(cache->last_key));
     cache->bmain = bmain;
     BLI_mutex_init(&cache->iterator_mutex);
     scene->ed->cache = cache;
@@ -1112,6 +1695,8 @@ void BKE_sequencer_cache_destruct(Scene *scene)
   BLI_mutex_end(&cache->iterator_mutex);
 
   if (cache->disk_cache != NULL) {
+    /* Finish writing images, which are still queued. */
+    BLI_task_pool_free(cache->disk_cache->write_pool);
     BLI_freelistN(&cache->disk_cache->files);
     BLI_mutex_end(&cache->disk_cache->read_write_mutex);
     MEM_freeN(cache->disk_cache);
@@ -1146,7 +1731,7 @@ void BKE_sequencer_cache_cleanup(Scene *scene)
     BLI_ghashIterator_step(&gh_iter);
     BLI_ghash_remove(cache->hash, key, seq_cache_keyfree, seq_cache_valfree);
   }
-  cache->last_key = NULL;
+  memset(cache->last_key, 0, sizeof(cache->last_key));
   seq_cache_unlock(scene);
 }
 
@@ -1210,7 +1795,7 @@ void BKE_sequencer_cache_cleanup_sequence(Scene *scene,
       BLI_ghash_remove(cache->hash, key, seq_cache_keyfree, seq_cache_valfree);
     }
   }
-  cache->last_key = NULL;
+  memset(cache->last_key, 0, sizeof(cache->last_key));
   seq_cache_unlock(scene);
 }
 
@@ -1255,7 +1840,7 @@ struct ImBuf *BKE_sequencer_cache_get(
   seq_cache_unlock(scene);
 
   if (ibuf) {
-    return ibuf;
+    return seq_cache_ibuf_from_stored(scene, &key, ibuf);
   }
 
   /* Try disk cache: */
@@ -1264,9 +1849,7 @@ struct ImBuf *BKE_sequencer_cache_get(
       seq_disk_cache_create(context->bmain, context->scene);
     }
 
-    BLI_mutex_lock(&cache->disk_cache->read_write_mutex);
     ibuf = seq_disk_cache_read_file(cache->disk_cache, &key);
-    BLI_mutex_unlock(&cache->disk_cache->read_write_mutex);
     if (ibuf) {
       if (key.type == SEQ_CACHE_STORE_FINAL_OUT) {
         BKE_sequencer_cache_put_if_possible(context, seq, cfra, type, ibuf, 0.0f, true);
@@ -1280,6 +1863,46 @@ struct ImBuf *BKE_sequencer_cache_get(
   return ibuf;
 }
 
+/* Check for an image in RAM cache without taking a reference to it. */
+bool BKE_sequencer_cache_contains(const SeqRenderData *context,
+                                  Sequence *seq,
+                                  float cfra,
+                                  int type)
+{
+  if (context->skip_cache || context->is_proxy_render || !seq) {
+    return false;
+  }
+
+  Scene *scene = context->scene;
+
+  if (context->is_prefetch_render) {
+    context = BKE_sequencer_prefetch_get_original_context(context);
+    scene = context->scene;
+    seq = BKE_sequencer_prefetch_get_original_sequence(seq, scene);
+  }
+
+  if (!seq) {
+    return false;
+  }
+
+  seq_cache_lock(scene);
+  SeqCache *cache = seq_cache_get_from_scene(scene);
+  bool contains = false;
+
+  if (cache) {
+    SeqCacheKey key;
+    key.seq = seq;
+    key.context = *context;
+    key.nfra = seq_cache_cfra_to_frame_index(seq, cfra);
+    key.type = type;
+
+    contains = seq_cache_contains(cache, &key);
+  }
+  seq_cache_unlock(scene);
+
+  return contains;
+}
+
 bool BKE_sequencer_cache_put_if_possible(const SeqRenderData *context,
                                          Sequence *seq,
                                          float cfra,
@@ -1305,8 +1928,8 @@ bool BKE_sequencer_cache_put_if_possible(const SeqRenderData *context,
     return true;
   }
 
-  seq_cache_set_temp_cache_linked(scene, scene->ed->cache->last_key);
-  scene->ed->cache->last_key = NULL;
+  seq_cache_set_temp_cache_linked(scene, scene->ed->cache->last_key[context->task_id]);
+  scene->ed->cache->last_key[context->task_id] = NULL;
   return false;
 }
 
@@ -1331,19 +1954,10 @@ void BKE_sequencer_cache_put(const SeqRenderData *context,
     BLI_assert(seq != NULL);
   }
 
-  /* Prevent reinserting, it breaks cache key linking. */
-  ImBuf *test = BKE_sequencer_cache_get(context, seq, cfra, type, true);
-  if (test) {
-    IMB_freeImBuf(test);
-    return;
-  }
-
   if (!scene->ed->cache) {
     seq_cache_create(context->bmain, scene);
   }
 
-  seq_cache_lock(scene);
-
   SeqCache *cache = seq_cache_get_from_scene(scene);
   int flag;
 
@@ -1362,6 +1976,11 @@ void BKE_sequencer_cache_put(const SeqRenderData *context,
     cost = SEQ_CACHE_COST_MAX;
   }
 
+  /* Temporary images are used right away, so only convert the ones stored for later use. */
+  ImBuf *stored_ibuf = (flag & type) ? seq_cache_ibuf_to_stored(scene, i) : i;
+
+  seq_cache_lock(scene);
+
   SeqCacheKey *key;
   key = BLI_mempool_alloc(cache->keys_pool);
   key->cache_owner = cache;
@@ -1369,6 +1988,17 @@ void BKE_sequencer_cache_put(const SeqRenderData *context,
   key->context = *context;
   key->nfra = seq_cache_cfra_to_frame_index(seq, cfra);
   key->type = type;
+
+  /* Prevent reinserting, it breaks cache key linking. */
+  if (seq_cache_contains(cache, key)) {
+    BLI_mempool_free(cache->keys_pool, key);
+    seq_cache_unlock(scene);
+    if (stored_ibuf != i) {
+      IMB_freeImBuf(stored_ibuf);
+    }
+    return;
+  }
+
   key->cost = cost;
   key->link_prev = NULL;
   key->link_next = NULL;
@@ -1378,45 +2008,63 @@ void BKE_sequencer_cache_put(const SeqRenderData *context,
   /* Item stored for later use */
   if (flag & type) {
     key->is_temp_cache = false;
-    key->link_prev = cache->last_key;
+    key->link_prev = cache->last_key[key->task_id];
   }
 
-  SeqCacheKey *temp_last_key = cache->last_key;
-  seq_cache_put(cache, key, i);
+  SeqCacheKey *temp_last_key = cache->last_key[key->task_id];
+  seq_cache_put(cache, key, stored_ibuf);
 
   /* Restore pointer to previous item as this one will be freed when stack is rendered. */
   if (key->is_temp_cache) {
-    cache->last_key = temp_last_key;
+    cache->last_key[key->task_id] = temp_last_key;
   }
 
   /* Set last_key's reference to this key so we can look up chain backwards.
    * Item is already put in cache, so cache->last_key points to current key.
    */
   if (flag & type && temp_last_key) {
-    temp_last_key->link_next = cache->last_key;
+    temp_last_key->link_next = cache->last_key[key->task_id];
   }
 
   /* Reset linking. */
   if (key->type == SEQ_CACHE_STORE_FINAL_OUT) {
-    cache->last_key = NULL;
+    cache->last_key[key->task_id] = NULL;
   }
 
   seq_cache_unlock(scene);
 
+  /* Cache holds its own reference. */
+  if (stored_ibuf != i) {
+    IMB_freeImBuf(stored_ibuf);
+  }
+
   if (!key->is_temp_cache && !skip_disk_cache) {
     if (seq_disk_cache_is_enabled(context->bmain)) {
       if (cache->disk_cache == NULL) {
         seq_disk_cache_create(context->bmain, context->scene);
       }
 
-      BLI_mutex_lock(&cache->disk_cache->read_write_mutex);
-      seq_disk_cache_write_file(cache->disk_cache, key, i);
-      BLI_mutex_unlock(&cache->disk_cache->read_write_mutex);
-      seq_disk_cache_enforce_limits(cache->disk_cache);
+      seq_disk_cache_write_file_async(cache->disk_cache, key, i);
     }
   }
 }
 
+/* Statistics of disk cache since it was created, returns false if disk cache is not used. */
+bool BKE_sequencer_cache_disk_stats_get(Scene *scene, SeqDiskCacheStats *r_stats)
+{
+  SeqCache *cache = seq_cache_get_from_scene(scene);
+
+  if (cache == NULL || cache->disk_cache == NULL) {
+    return false;
+  }
+
+  BLI_mutex_lock(&cache->disk_cache->read_write_mutex);
+  *r_stats = cache->disk_cache->stats;
+  BLI_mutex_unlock(&cache->disk_cache->read_write_mutex);
+
+  return true;
+}
+
 void BKE_sequencer_cache_iterate(
     struct Scene *scene,
     void *userdata,
@@ -1441,7 +2089,7 @@ void BKE_sequencer_cache_iterate(
     interrupt = callback_iter(userdata, key->seq, key->nfra, key->type, key->cost);
   }
 
-  cache->last_key = NULL;
+  memset(cache->last_key, 0, sizeof(cache->last_key));
   seq_cache_unlock(scene);
 }
 
@@ -0,0 +1,303 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+#include "testing/testing.h"
+
+#include <cstring>
+#include <filesystem>
+#include <string>
+
+#include "MEM_guardedalloc.h"
+
+#include "DNA_scene_types.h"
+#include "DNA_sequence_types.h"
+#include "DNA_userdef_types.h"
+
+#include "BLI_fileops.h"
+#include "BLI_string.h"
+#include "BLI_threads.h"
+
+#include "BKE_main.h"
+#include "BKE_sequencer.h"
+
+#include "IMB_imbuf.h"
+#include "IMB_imbuf_types.h"
+
+#include "sequencer.h"
+
+namespace blender::sequencer::tests {
+
+/* Big enough for float images to be stored on disk in several blocks. */
+static const int TEST_WIDTH = 640;
+static const int TEST_HEIGHT = 480;
+static const int TEST_FRAMES = 10;
+
+/* Image strip with its images put in the cache directly, without rendering. */
+class ImageCacheTest : public ::testing::Test {
+ protected:
+  static void SetUpTestCase()
+  {
+    BLI_threadapi_init();
+  }
+
+  static void TearDownTestCase()
+  {
+    BLI_threadapi_exit();
+  }
+
+  void SetUp() override
+  {
+    old_userdef = U;
+    U.memcachelimit = 1024;
+    bmain = BKE_main_new();
+
+    memset(&scene, 0, sizeof(scene));
+    memset(&ed, 0, sizeof(ed));
+    memset(&seq, 0, sizeof(seq));
+    BLI_strncpy(scene.id.name, "SCScene", sizeof(scene.id.name));
+    scene.ed = &ed;
+
+    BLI_strncpy(seq.name, "SQStrip", sizeof(seq.name));
+    seq.type = SEQ_TYPE_IMAGE;
+    seq.start = 1;
+    seq.len = TEST_FRAMES;
+    seq.startdisp = 1;
+    seq.enddisp = TEST_FRAMES + 1;
+
+    memset(&context, 0, sizeof(context));
+    context.bmain = bmain;
+    context.scene = &scene;
+    context.rectx = TEST_WIDTH;
+    context.recty = TEST_HEIGHT;
+    context.preview_render_size = 100;
+    context.task_id = SEQ_TASK_MAIN_RENDER;
+  }
+
+  void TearDown() override
+  {
+    BKE_sequencer_cache_destruct(&scene);
+    BKE_main_free(bmain);
+    U = old_userdef;
+  }
+
+  /* Values are exact in half float. */
+  static ImBuf *float_image(int frame)
+  {
+    ImBuf *ibuf = IMB_allocImBuf(TEST_WIDTH, TEST_HEIGHT, 32, IB_rectfloat);
+    for (size_t i = 0; i < (size_t)TEST_WIDTH * TEST_HEIGHT * 4; i++) {
+      ibuf->rect_float[i] = frame + (i % 64) * 0.125f;
+    }
+    return ibuf;
+  }
+
+  static ImBuf *byte_image(int frame)
+  {
+    ImBuf *ibuf = IMB_allocImBuf(TEST_WIDTH, TEST_HEIGHT, 32, IB_rect);
+    unsigned char *rect = (unsigned char *)ibuf->rect;
+    for (size_t i = 0; i < (size_t)TEST_WIDTH * TEST_HEIGHT * 4; i++) {
+      rect[i] = (unsigned char)(frame + i / 7);
+    }
+    return ibuf;
+  }
+
+  static bool pixels_equal(const ImBuf *a, const ImBuf *b)
+  {
+    if (a->rect_float && b->rect_float) {
+      return memcmp(a->rect_float,
+                    b->rect_float,
+                    sizeof(float[4]) * TEST_WIDTH * TEST_HEIGHT) == 0;
+    }
+    if (a->rect && b->rect) {
+      return memcmp(a->rect, b->rect, sizeof(unsigned int) * TEST_WIDTH * TEST_HEIGHT) == 0;
+    }
+    return false;
+  }
+
+  void put(int frame, ImBuf *ibuf)
+  {
+    BKE_sequencer_cache_put(&context, &seq, frame, SEQ_CACHE_STORE_RAW, ibuf, 0.0f, false);
+  }
+
+  ImBuf *get(int frame)
+  {
+    return BKE_sequencer_cache_get(&context, &seq, frame, SEQ_CACHE_STORE_RAW, false);
+  }
+
+  UserDef old_userdef;
+  Main *bmain;
+  Scene scene;
+  Editing ed;
+  Sequence seq;
+  SeqRenderData context;
+};
+
+/* Images stored as half float are converted once, following hits share the float copy. */
+TEST_F(ImageCacheTest, HalfFloatHitsShareFloatCopy)
+{
+  ed.cache_flag = SEQ_CACHE_STORE_RAW | SEQ_CACHE_HALF_FLOAT;
+
+  ImBuf *ibuf = float_image(1);
+  put(1, ibuf);
+
+  ImBuf *first = get(1);
+  ImBuf *second = get(1);
+  ASSERT_NE(first, nullptr);
+  ASSERT_NE(first->rect_float, nullptr);
+  EXPECT_EQ(first, second);
+  EXPECT_TRUE(pixels_equal(first, ibuf));
+
+  IMB_freeImBuf(second);
+  IMB_freeImBuf(first);
+  IMB_freeImBuf(ibuf);
+}
+
+/* Only the most recently converted images keep their float copy. */
+TEST_F(ImageCacheTest, HalfFloatCopiesAreLimited)
+{
+  ed.cache_flag = SEQ_CACHE_STORE_RAW | SEQ_CACHE_HALF_FLOAT;
+
+  ImBuf *ibufs[TEST_FRAMES];
+  ImBuf *hits[TEST_FRAMES];
+  for (int frame = 1; frame <= TEST_FRAMES; frame++) {
+    ibufs[frame - 1] = float_image(frame);
+    put(frame, ibufs[frame - 1]);
+  }
+  for (int frame = 1; frame <= TEST_FRAMES; frame++) {
+    hits[frame - 1] = get(frame);
+    ASSERT_NE(hits[frame - 1], nullptr);
+    EXPECT_TRUE(pixels_equal(hits[frame - 1], ibufs[frame - 1]));
+  }
+
+  ImBuf *first_again = get(1);
+  ImBuf *last_again = get(TEST_FRAMES);
+  EXPECT_NE(first_again, hits[0]);
+  EXPECT_EQ(last_again, hits[TEST_FRAMES - 1]);
+  EXPECT_TRUE(pixels_equal(first_again, ibufs[0]));
+
+  IMB_freeImBuf(first_again);
+  IMB_freeImBuf(last_again);
+  for (int i = 0; i < TEST_FRAMES; i++) {
+    IMB_freeImBuf(hits[i]);
+    IMB_freeImBuf(ibufs[i]);
+  }
+}
+
+/* Disk cache enabled in a temporary directory. */
+class ImageCacheDiskTest : public ImageCacheTest {
+ protected:
+  void SetUp() override
+  {
+    ImageCacheTest::SetUp();
+
+    dir = std::filesystem::temp_directory_path().string() + "/sequencer_image_cache_test/";
+    BLI_strncpy(U.sequencer_disk_cache_dir, dir.c_str(), sizeof(U.sequencer_disk_cache_dir));
+    U.sequencer_disk_cache_size_limit = 1;
+    U.sequencer_disk_cache_flag = SEQ_CACHE_DISK_CACHE_ENABLE;
+    U.sequencer_disk_cache_compression = USER_SEQ_DISK_CACHE_COMPRESSION_LOW;
+    BLI_strncpy(bmain->name, "image_cache_test.blend", sizeof(bmain->name));
+    ed.cache_flag = SEQ_CACHE_STORE_RAW;
+  }
+
+  void TearDown() override
+  {
+    ImageCacheTest::TearDown();
+    BLI_delete(dir.c_str(), true, true);
+  }
+
+  /* Images are written by a background thread, which is finished when the cache is freed.
+   * Next cache reads images from disk. */
+  void flush_to_disk()
+  {
+    BKE_sequencer_cache_destruct(&scene);
+  }
+
+  void expect_round_trip()
+  {
+    ImBuf *ibufs[4] = {float_image(1), float_image(2), byte_image(3), byte_image(4)};
+    for (int frame = 1; frame <= 4; frame++) {
+      put(frame, ibufs[frame - 1]);
+    }
+    flush_to_disk();
+
+    for (int frame = 1; frame <= 4; frame++) {
+      ImBuf *ibuf = get(frame);
+      ASSERT_NE(ibuf, nullptr) << "frame " << frame;
+      EXPECT_TRUE(pixels_equal(ibuf, ibufs[frame - 1])) << "frame " << frame;
+      IMB_freeImBuf(ibuf);
+    }
+
+    for (int i = 0; i < 4; i++) {
+      IMB_freeImBuf(ibufs[i]);
+    }
+  }
+
+  std::string dir;
+};
+
+TEST_F(ImageCacheDiskTest, RoundTripUncompressed)
+{
+  U.sequencer_disk_cache_compression = USER_SEQ_DISK_CACHE_COMPRESSION_NONE;
+  expect_round_trip();
+}
+
+TEST_F(ImageCacheDiskTest, RoundTripLowCompression)
+{
+  U.sequencer_disk_cache_compression = USER_SEQ_DISK_CACHE_COMPRESSION_LOW;
+  expect_round_trip();
+}
+
+TEST_F(ImageCacheDiskTest, RoundTripHighCompression)
+{
+  U.sequencer_disk_cache_compression = USER_SEQ_DISK_CACHE_COMPRESSION_HIGH;
+  expect_round_trip();
+}
+
+/* Images which are queued or being written when the strip is invalidated are not read back,
+ * images put after invalidation are written. */
+TEST_F(ImageCacheDiskTest, InvalidateDuringWrite)
+{
+  /* Less images than can be queued, so the last image is not dropped. */
+  const int frames = 5;
+  ImBuf *ibufs[frames];
+  for (int frame = 1; frame <= frames; frame++) {
+    ibufs[frame - 1] = float_image(frame);
+  }
+
+  for (int frame = 1; frame < frames; frame++) {
+    put(frame, ibufs[frame - 1]);
+  }
+  BKE_sequencer_cache_cleanup_sequence(&scene, &seq, &seq, SEQ_CACHE_STORE_RAW, true);
+  put(frames, ibufs[frames - 1]);
+  flush_to_disk();
+
+  for (int frame = 1; frame < frames; frame++) {
+    ImBuf *ibuf = get(frame);
+    EXPECT_EQ(ibuf, nullptr) << "frame " << frame;
+    if (ibuf) {
+      IMB_freeImBuf(ibuf);
+    }
+  }
+
+  ImBuf *ibuf = get(frames);
+  ASSERT_NE(ibuf, nullptr);
+  EXPECT_TRUE(pixels_equal(ibuf, ibufs[frames - 1]));
+  IMB_freeImBuf(ibuf);
+
+  for (int i = 0; i < frames; i++) {
+    IMB_freeImBuf(ibufs[i]);
+  }
+}
+
+}  // namespace blender::sequencer::tests
@@ -0,0 +1,416 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+/** \file
+ * \ingroup bke
+ *
+ * Read-ahead of image sequence files.
+ *
+ * Reading a frame file is split from decoding it. While image strips are played back, files of
+ * the next frames in playback direction are read into memory by dedicated I/O threads, so that
+ * on slow or high latency storage decoding does not have to wait for the file system. Only raw
+ * file contents are kept here, decoded images are stored in the sequencer cache as usual.
+ */
+
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "MEM_guardedalloc.h"
+
+#include "DNA_scene_types.h"
+#include "DNA_sequence_types.h"
+#include "DNA_space_types.h" /* for FILE_MAX. */
+
+#include "BLI_fileops.h"
+#include "BLI_listbase.h"
+#include "BLI_path_util.h"
+#include "BLI_string.h"
+#include "BLI_threads.h"
+#include "BLI_utildefines.h"
+
+#include "IMB_imbuf.h"
+#include "IMB_imbuf_types.h"
+
+#include "BKE_global.h"
+#include "BKE_main.h"
+#include "BKE_sequencer.h"
+
+#include "PIL_time.h"
+
+#include "atomic_ops.h"
+
+#include "sequencer.h"
+
+/* Number of frames read ahead of the current frame of each strip. */
+#define SEQ_READAHEAD_FRAMES 8
+/* Reads are mostly waiting for the file system, so use more threads than a single one even
+ * though they don't do much work. */
+#define SEQ_READAHEAD_THREADS 4
+/* Memory used by files that are read but not taken yet. */
+#define SEQ_READAHEAD_MEMORY_LIMIT ((size_t)512 * 1024 * 1024)
+/* Artificial delay of every file read with G.debug_value 4040, to simulate network storage. */
+#define SEQ_READAHEAD_DEBUG_DELAY_MS 100
+
+typedef struct ReadAheadFile {
+  struct ReadAheadFile *next, *prev;
+
+  char filepath[FILE_MAX];
+  /* Timeline frame this file was requested for. */
+  int frame;
+
+  /* File contents, set once the file is read. */
+  unsigned char *mem;
+  size_t size;
+
+  /* The I/O thread finished reading the file. */
+  bool is_read;
+  /* A render is waiting for the file to be read, it frees the file afterwards. */
+  bool is_taken;
+  /* File is not needed anymore, the I/O thread frees it. */
+  bool is_discarded;
+} ReadAheadFile;
+
+/* Playback direction of a strip, guessed from the frames it is rendered at. */
+typedef struct ReadAheadStrip {
+  struct ReadAheadStrip *next, *prev;
+
+  /* Only used for comparison, never accessed. */
+  const Sequence *seq;
+  int last_frame;
+  int direction;
+} ReadAheadStrip;
+
+typedef struct SeqReadAhead {
+  ListBase threads;
+  ThreadQueue *queue;
+
+  /* Protects everything below. */
+  ThreadMutex mutex;
+  ThreadCondition read_finished;
+
+  /* Files queued for reading or read and not taken yet. */
+  ListBase files;
+  ListBase strips;
+  size_t memory_used;
+} SeqReadAhead;
+
+static unsigned char *seq_readahead_read_file(const char *filepath, size_t *r_size)
+{
+  if (G.debug_value == 4040) {
+    PIL_sleep_ms(SEQ_READAHEAD_DEBUG_DELAY_MS);
+  }
+
+  return BLI_file_read_binary_as_mem(filepath, 0, r_size);
+}
+
+static void seq_readahead_file_free(ReadAheadFile *file)
+{
+  MEM_SAFE_FREE(file->mem);
+  MEM_freeN(file);
+}
+
+static void *seq_readahead_thread(void *data)
+{
+  SeqReadAhead *readahead = data;
+  ReadAheadFile *file;
+
+  while ((file = BLI_thread_queue_pop(readahead->queue))) {
+    BLI_mutex_lock(&readahead->mutex);
+    const bool is_discarded = file->is_discarded;
+    BLI_mutex_unlock(&readahead->mutex);
+
+    if (is_discarded) {
+      seq_readahead_file_free(file);
+      continue;
+    }
+
+    /* The file path is not modified after queuing, so it can be read without lock. */
+    size_t size = 0;
+    unsigned char *mem = seq_readahead_read_file(file->filepath, &size);
+
+    BLI_mutex_lock(&readahead->mutex);
+    if (file->is_discarded) {
+      BLI_mutex_unlock(&readahead->mutex);
+      MEM_SAFE_FREE(mem);
+      seq_readahead_file_free(file);
+      continue;
+    }
+
+    file->mem = mem;
+    file->size = size;
+    file->is_read = true;
+
+    if (file->is_taken) {
+      BLI_condition_notify_all(&readahead->read_finished);
+    }
+    else {
+      readahead->memory_used += size;
+    }
+    BLI_mutex_unlock(&readahead->mutex);
+  }
+
+  return NULL;
+}
+
+static SeqReadAhead *seq_readahead_get(Scene *scene)
+{
+  if (scene && scene->ed) {
+    return scene->ed->readahead;
+  }
+  return NULL;
+}
+
+static SeqReadAhead *seq_readahead_ensure(Scene *scene)
+{
+  SeqReadAhead *readahead = seq_readahead_get(scene);
+  if (readahead != NULL) {
+    return readahead;
+  }
+
+  readahead = MEM_callocN(sizeof(SeqReadAhead), "SeqReadAhead");
+  readahead->queue = BLI_thread_queue_init();
+  BLI_mutex_init(&readahead->mutex);
+  BLI_condition_init(&readahead->read_finished);
+
+  BLI_threadpool_init(&readahead->threads, seq_readahead_thread, SEQ_READAHEAD_THREADS);
+  for (int i = 0; i < SEQ_READAHEAD_THREADS; i++) {
+    BLI_threadpool_insert(&readahead->threads, readahead);
+  }
+
+  /* Renders of other threads may look for read files as soon as it is assigned. */
+  SeqReadAhead *existing = atomic_cas_ptr((void **)&scene->ed->readahead, NULL, readahead);
+  if (existing != NULL) {
+    BLI_thread_queue_nowait(readahead->queue);
+    BLI_threadpool_end(&readahead->threads);
+    BLI_thread_queue_free(readahead->queue);
+    BLI_condition_end(&readahead->read_finished);
+    BLI_mutex_end(&readahead->mutex);
+    MEM_freeN(readahead);
+    return existing;
+  }
+
+  return readahead;
+}
+
+/* Remove a file from the list, must be called with lock. */
+static void seq_readahead_discard(SeqReadAhead *readahead, ReadAheadFile *file)
+{
+  BLI_remlink(&readahead->files, file);
+
+  if (file->is_read) {
+    readahead->memory_used -= file->size;
+    seq_readahead_file_free(file);
+  }
+  else {
+    file->is_discarded = true;
+  }
+}
+
+static ReadAheadFile *seq_readahead_find(SeqReadAhead *readahead, const char *filepath)
+{
+  LISTBASE_FOREACH (ReadAheadFile *, file, &readahead->files) {
+    if (STREQ(file->filepath, filepath)) {
+      return file;
+    }
+  }
+  return NULL;
+}
+
+static ReadAheadStrip *seq_readahead_strip_ensure(SeqReadAhead *readahead,
+                                                  const Sequence *seq,
+                                                  int frame)
+{
+  LISTBASE_FOREACH (ReadAheadStrip *, strip, &readahead->strips) {
+    if (strip->seq == seq) {
+      return strip;
+    }
+  }
+
+  ReadAheadStrip *strip = MEM_callocN(sizeof(ReadAheadStrip), "ReadAheadStrip");
+  strip->seq = seq;
+  strip->last_frame = frame;
+  strip->direction = 1;
+  BLI_addtail(&readahead->strips, strip);
+  return strip;
+}
+
+static void seq_readahead_filepath_get(Sequence *seq, int frame, char r_filepath[FILE_MAX])
+{
+  StripElem *s_elem = BKE_sequencer_give_stripelem(seq, frame);
+  if (s_elem == NULL) {
+    r_filepath[0] = '\0';
+    return;
+  }
+
+  BLI_join_dirfile(r_filepath, FILE_MAX, seq->strip->dir, s_elem->name);
+  BLI_path_abs(r_filepath, BKE_main_blendfile_path_from_global());
+}
+
+/* Files of formats which can't be loaded from memory are not read ahead. */
+static bool seq_readahead_file_supported(const char *filepath)
+{
+  return filepath[0] != '\0' &&
+         !BLI_path_extension_check_array(filepath, imb_ext_image_filepath_only);
+}
+
+/**
+ * Queue reading files of the frames following \a cfra in the playback direction of the image
+ * strip, and discard files which are too far from the current frame to be used.
+ */
+void BKE_sequencer_image_readahead_update(const SeqRenderData *context, Sequence *seq, float cfra)
+{
+  /* Prefetch renders are already ahead of playback, and proxies are built in parallel. */
+  if (context->is_prefetch_render || context->is_proxy_render || seq->type != SEQ_TYPE_IMAGE) {
+    return;
+  }
+
+  SeqReadAhead *readahead = seq_readahead_ensure(context->scene);
+  const int frame = (int)cfra;
+
+  BLI_mutex_lock(&readahead->mutex);
+
+  LISTBASE_FOREACH_MUTABLE (ReadAheadFile *, file, &readahead->files) {
+    if (abs(file->frame - frame) > SEQ_READAHEAD_FRAMES) {
+      seq_readahead_discard(readahead, file);
+    }
+  }
+
+  /* Forget strips which are not played anymore, the pointers may be reused. */
+  LISTBASE_FOREACH_MUTABLE (ReadAheadStrip *, strip, &readahead->strips) {
+    if (strip->seq != seq && abs(strip->last_frame - frame) > SEQ_READAHEAD_FRAMES) {
+      BLI_freelinkN(&readahead->strips, strip);
+    }
+  }
+
+  ReadAheadStrip *strip = seq_readahead_strip_ensure(readahead, seq, frame);
+  if (frame != strip->last_frame) {
+    strip->direction = (frame > strip->last_frame) ? 1 : -1;
+    strip->last_frame = frame;
+  }
+
+  for (int i = 1; i <= SEQ_READAHEAD_FRAMES; i++) {
+    const int next_frame = frame + i * strip->direction;
+
+    if (next_frame < seq->startdisp || next_frame >= seq->enddisp ||
+        readahead->memory_used >= SEQ_READAHEAD_MEMORY_LIMIT) {
+      break;
+    }
+
+    /* Rendered images are not read again. */
+    if (BKE_sequencer_cache_contains(context, seq, next_frame, SEQ_CACHE_STORE_RAW) ||
+        BKE_sequencer_cache_contains(context, seq, next_frame, SEQ_CACHE_STORE_PREPROCESSED)) {
+      continue;
+    }
+
+    char filepath[FILE_MAX];
+    seq_readahead_filepath_get(seq, next_frame, filepath);
+
+    if (!seq_readahead_file_supported(filepath) || seq_readahead_find(readahead, filepath)) {
+      continue;
+    }
+
+    ReadAheadFile *file = MEM_callocN(sizeof(ReadAheadFile), "ReadAheadFile");
+    BLI_strncpy(file->filepath, filepath, sizeof(file->filepath));
+    file->frame = next_frame;
+    BLI_addtail(&readahead->files, file);
+    BLI_thread_queue_push(readahead->queue, file);
+  }
+
+  BLI_mutex_unlock(&readahead->mutex);
+}
+
+/**
+ * Take contents of an image file which was read ahead, waiting for the read to finish if it is
+ * in progress.
+ *
+ * \return File contents to be freed by the caller, or NULL if the file was not read ahead or
+ * couldn't be read. The image is then loaded from the file path as usual.
+ */
+unsigned char *BKE_sequencer_image_readahead_read(const SeqRenderData *context,
+                                                  const char *filepath,
+                                                  size_t *r_size)
+{
+  *r_size = 0;
+
+  if (!seq_readahead_file_supported(filepath)) {
+    return NULL;
+  }
+
+  Scene *scene = context->scene;
+  if (context->is_prefetch_render) {
+    scene = BKE_sequencer_prefetch_get_original_context(context)->scene;
+  }
+
+  SeqReadAhead *readahead = seq_readahead_get(scene);
+  ReadAheadFile *file = NULL;
+
+  if (readahead != NULL) {
+    BLI_mutex_lock(&readahead->mutex);
+    file = seq_readahead_find(readahead, filepath);
+    if (file != NULL) {
+      BLI_remlink(&readahead->files, file);
+
+      if (file->is_read) {
+        readahead->memory_used -= file->size;
+      }
+      else {
+        file->is_taken = true;
+        while (!file->is_read) {
+          BLI_condition_wait(&readahead->read_finished, &readahead->mutex);
+        }
+      }
+    }
+    BLI_mutex_unlock(&readahead->mutex);
+  }
+
+  if (file == NULL) {
+    return NULL;
+  }
+
+  unsigned char *mem = file->mem;
+  *r_size = file->size;
+  file->mem = NULL;
+  seq_readahead_file_free(file);
+
+  return mem;
+}
+
+void BKE_sequencer_image_readahead_free(Scene *scene)
+{
+  SeqReadAhead *readahead = seq_readahead_get(scene);
+  if (readahead == NULL) {
+    return;
+  }
+
+  BLI_mutex_lock(&readahead->mutex);
+  LISTBASE_FOREACH_MUTABLE (ReadAheadFile *, file, &readahead->files) {
+    seq_readahead_discard(readahead, file);
+  }
+  BLI_mutex_unlock(&readahead->mutex);
+
+  /* Discarded files still in the queue are freed by the threads before they finish. */
+  BLI_thread_queue_nowait(readahead->queue);
+  BLI_threadpool_end(&readahead->threads);
+  BLI_thread_queue_free(readahead->queue);
+
+  BLI_condition_end(&readahead->read_finished);
+  BLI_mutex_end(&readahead->mutex);
+  BLI_freelistN(&readahead->strips);
+  MEM_freeN(readahead);
+
+  scene->ed->readahead = NULL;
+}
@@ -0,0 +1,227 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+#include "testing/testing.h"
+
+#include <cstring>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#include "MEM_guardedalloc.h"
+
+#include "DNA_scene_types.h"
+#include "DNA_sequence_types.h"
+
+#include "BLI_fileops.h"
+#include "BLI_path_util.h"
+#include "BLI_string.h"
+#include "BLI_threads.h"
+
+#include "BKE_global.h"
+#include "BKE_main.h"
+#include "BKE_sequencer.h"
+
+#include "sequencer.h"
+
+namespace blender::sequencer::tests {
+
+static const int TEST_FRAMES = 40;
+static const size_t TEST_FILE_SIZE = 1024;
+
+/* Image strip with a file for every frame in the temporary directory. */
+class ImageReadAheadTest : public ::testing::Test {
+ protected:
+  static void SetUpTestCase()
+  {
+    BLI_threadapi_init();
+  }
+
+  static void TearDownTestCase()
+  {
+    BLI_threadapi_exit();
+  }
+
+  void SetUp() override
+  {
+    old_main = G_MAIN;
+    old_debug_value = G.debug_value;
+    G_MAIN = BKE_main_new();
+
+    dir = (std::filesystem::temp_directory_path() / "blender_image_readahead_test").string();
+    BLI_dir_create_recursive(dir.c_str());
+
+    memset(&scene, 0, sizeof(scene));
+    memset(&ed, 0, sizeof(ed));
+    memset(&seq, 0, sizeof(seq));
+    memset(&strip, 0, sizeof(strip));
+    scene.ed = &ed;
+
+    BLI_strncpy(strip.dir, dir.c_str(), sizeof(strip.dir));
+    BLI_path_slash_ensure(strip.dir);
+    elems.resize(TEST_FRAMES);
+    strip.stripdata = elems.data();
+    for (int i = 0; i < TEST_FRAMES; i++) {
+      BLI_snprintf(elems[i].name, sizeof(elems[i].name), "frame_%04d.png", i + 1);
+      write_file(i + 1);
+    }
+
+    seq.type = SEQ_TYPE_IMAGE;
+    seq.strip = &strip;
+    seq.start = 1;
+    seq.len = TEST_FRAMES;
+    seq.startdisp = 1;
+    seq.enddisp = TEST_FRAMES + 1;
+
+    memset(&context, 0, sizeof(context));
+    context.scene = &scene;
+  }
+
+  void TearDown() override
+  {
+    BKE_sequencer_image_readahead_free(&scene);
+    BLI_delete(dir.c_str(), true, true);
+
+    BKE_main_free(G_MAIN);
+    G_MAIN = old_main;
+    G.debug_value = old_debug_value;
+  }
+
+  std::string filepath(int frame)
+  {
+    char path[FILE_MAX];
+    BLI_join_dirfile(path, sizeof(path), strip.dir, elems[frame - 1].name);
+    return path;
+  }
+
+  static std::vector<unsigned char> file_contents(int frame)
+  {
+    std::vector<unsigned char> contents(TEST_FILE_SIZE);
+    for (size_t i = 0; i < TEST_FILE_SIZE; i++) {
+      contents[i] = (unsigned char)(frame * 31 + i);
+    }
+    return contents;
+  }
+
+  void write_file(int frame)
+  {
+    const std::string path = filepath(frame);
+    FILE *file = BLI_fopen(path.c_str(), "wb");
+    ASSERT_NE(file, nullptr);
+    const std::vector<unsigned char> contents = file_contents(frame);
+    fwrite(contents.data(), 1, contents.size(), file);
+    fclose(file);
+  }
+
+  /* The file of the frame was read ahead, it's handed out once. */
+  void expect_hit(int frame)
+  {
+    size_t size = 0;
+    unsigned char *mem = BKE_sequencer_image_readahead_read(
+        &context, filepath(frame).c_str(), &size);
+    ASSERT_NE(mem, nullptr) << "frame " << frame;
+    ASSERT_EQ(size, TEST_FILE_SIZE);
+    EXPECT_EQ(memcmp(mem, file_contents(frame).data(), size), 0) << "frame " << frame;
+    MEM_freeN(mem);
+
+    expect_miss(frame);
+  }
+
+  /* The file of the frame wasn't read ahead, it's left to be loaded from the file path. */
+  void expect_miss(int frame)
+  {
+    size_t size = 0;
+    unsigned char *mem = BKE_sequencer_image_readahead_read(
+        &context, filepath(frame).c_str(), &size);
+    EXPECT_EQ(mem, nullptr) << "frame " << frame;
+    EXPECT_EQ(size, 0u);
+    if (mem) {
+      MEM_freeN(mem);
+    }
+  }
+
+  Main *old_main;
+  int old_debug_value;
+  std::string dir;
+  Scene scene;
+  Editing ed;
+  Sequence seq;
+  Strip strip;
+  std::vector<StripElem> elems;
+  SeqRenderData context;
+};
+
+TEST_F(ImageReadAheadTest, Hit)
+{
+  BKE_sequencer_image_readahead_update(&context, &seq, 1.0f);
+  for (int frame = 2; frame <= 9; frame++) {
+    expect_hit(frame);
+  }
+}
+
+/* Taking a file waits for it to be read. */
+TEST_F(ImageReadAheadTest, HitWhileReading)
+{
+  /* Every read is delayed. */
+  G.debug_value = 4040;
+  BKE_sequencer_image_readahead_update(&context, &seq, 1.0f);
+  for (int frame = 9; frame >= 2; frame--) {
+    expect_hit(frame);
+  }
+}
+
+TEST_F(ImageReadAheadTest, Miss)
+{
+  /* Nothing is read before playback. */
+  expect_miss(1);
+
+  /* The current frame, frames behind it and frames too far ahead are not read. */
+  BKE_sequencer_image_readahead_update(&context, &seq, 10.0f);
+  expect_miss(10);
+  expect_miss(9);
+  expect_miss(19);
+
+  /* Playing backward reads the frames before the current frame. */
+  BKE_sequencer_image_readahead_update(&context, &seq, 9.0f);
+  expect_hit(8);
+  expect_hit(1);
+
+  /* Frames outside of the strip are not read. */
+  expect_miss(TEST_FRAMES);
+  BKE_sequencer_image_readahead_update(&context, &seq, TEST_FRAMES);
+  expect_miss(TEST_FRAMES);
+}
+
+/* Files which are too far from the current frame are dropped. */
+TEST_F(ImageReadAheadTest, Discard)
+{
+  G.debug_value = 4040;
+  BKE_sequencer_image_readahead_update(&context, &seq, 1.0f);
+
+  /* Jumping drops the files of the previous frames, also the ones still being read. */
+  BKE_sequencer_image_readahead_update(&context, &seq, 30.0f);
+  for (int frame = 2; frame <= 9; frame++) {
+    expect_miss(frame);
+  }
+  expect_hit(31);
+
+  /* Freeing drops all files. */
+  BKE_sequencer_image_readahead_free(&scene);
+  for (int frame = 32; frame <= 38; frame++) {
+    expect_miss(frame);
+  }
+}
+
+}  // namespace blender::sequencer::tests
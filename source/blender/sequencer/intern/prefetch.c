@@ -31,9 +31,11 @@
 #include "DNA_scene_types.h"
 #include "DNA_screen_types.h"
 #include "DNA_sequence_types.h"
+#include "DNA_userdef_types.h"
 #include "DNA_windowmanager_types.h"
 
 #include "BLI_listbase.h"
+#include "BLI_math_base.h"
 #include "BLI_threads.h"
 
 #include "IMB_imbuf.h"
@@ -54,35 +56,57 @@
 #include "DEG_depsgraph_debug.h"
 #include "DEG_depsgraph_query.h"
 
+#include "PIL_time.h"
+
+#include "atomic_ops.h"
+
 #include "sequencer.h"
 
+/* Evaluated copies of all prefetch threads use at most this part of the cache memory limit. */
+#define SEQ_PREFETCH_MEMORY_FRACTION 4
+
+/* Each prefetch thread renders its own frame, with an isolated depsgraph and
+ * evaluated scene so animation can be evaluated for that frame. */
+typedef struct PrefetchThread {
+  struct PrefetchJob *pfjob;
+
+  struct Main *bmain_eval;
+  struct Scene *scene_eval;
+  struct Depsgraph *depsgraph;
+
+  /* context */
+  struct SeqRenderData context;
+  struct SeqRenderData context_cpy;
+
+  /* Frame being rendered by this thread. */
+  float cfra;
+} PrefetchThread;
+
 typedef struct PrefetchJob {
   struct PrefetchJob *next, *prev;
 
   struct Main *bmain;
-  struct Main *bmain_eval;
   struct Scene *scene;
-  struct Scene *scene_eval;
-  struct Depsgraph *depsgraph;
 
   ThreadMutex prefetch_suspend_mutex;
   ThreadCondition prefetch_suspend_cond;
 
   ListBase threads;
-
-  /* context */
-  struct SeqRenderData context;
-  struct SeqRenderData context_cpy;
-  struct ListBase *seqbasep;
-  struct ListBase *seqbasep_cpy;
+  PrefetchThread thread_data[SEQ_PREFETCH_THREADS_MAX];
+  int num_threads;
+  int num_threads_running;
+  int num_threads_waiting;
 
   /* prefetch area */
   float cfra;
   int num_frames_prefetched;
 
+  /* statistics */
+  double start_time;
+  int num_frames_rendered;
+
   /* control */
   bool running;
-  bool waiting;
   bool stop;
 } PrefetchJob;
 
@@ -134,7 +158,8 @@ static bool seq_prefetch_job_is_waiting(Scene *scene)
     return false;
   }
 
-  return pfjob->waiting;
+  return pfjob->num_threads_waiting > 0 &&
+         pfjob->num_threads_waiting == pfjob->num_threads_running;
 }
 
 static Sequence *sequencer_prefetch_get_original_sequence(Sequence *seq, ListBase *seqbase)
@@ -166,8 +191,10 @@ Sequence *BKE_sequencer_prefetch_get_original_sequence(Sequence *seq, Scene *sce
 SeqRenderData *BKE_sequencer_prefetch_get_original_context(const SeqRenderData *context)
 {
   PrefetchJob *pfjob = seq_prefetch_job_get(context->scene);
+  const int thread_index = context->task_id - SEQ_TASK_PREFETCH_RENDER;
 
-  return &pfjob->context;
+  BLI_assert(thread_index >= 0 && thread_index < pfjob->num_threads);
+  return &pfjob->thread_data[thread_index].context;
 }
 
 static bool seq_prefetch_is_cache_full(Scene *scene)
@@ -181,13 +208,14 @@ static bool seq_prefetch_is_cache_full(Scene *scene)
   return BKE_sequencer_cache_recycle_item(pfjob->scene) == false;
 }
 
+/* Next frame to be prefetched, frames before it are rendered or being rendered. */
 static float seq_prefetch_cfra(PrefetchJob *pfjob)
 {
   return pfjob->cfra + pfjob->num_frames_prefetched;
 }
-static AnimationEvalContext seq_prefetch_anim_eval_context(PrefetchJob *pfjob)
+static AnimationEvalContext seq_prefetch_anim_eval_context(PrefetchThread *thread)
 {
-  return BKE_animsys_eval_context_construct(pfjob->depsgraph, seq_prefetch_cfra(pfjob));
+  return BKE_animsys_eval_context_construct(thread->depsgraph, thread->cfra);
 }
 
 void BKE_sequencer_prefetch_get_time_range(Scene *scene, int *start, int *end)
@@ -198,37 +226,38 @@ void BKE_sequencer_prefetch_get_time_range(Scene *scene, int *start, int *end)
   *end = seq_prefetch_cfra(pfjob);
 }
 
-static void seq_prefetch_free_depsgraph(PrefetchJob *pfjob)
+static void seq_prefetch_free_depsgraph(PrefetchThread *thread)
 {
-  if (pfjob->depsgraph != NULL) {
-    DEG_graph_free(pfjob->depsgraph);
+  if (thread->depsgraph != NULL) {
+    DEG_graph_free(thread->depsgraph);
   }
-  pfjob->depsgraph = NULL;
-  pfjob->scene_eval = NULL;
+  thread->depsgraph = NULL;
+  thread->scene_eval = NULL;
 }
 
-static void seq_prefetch_update_depsgraph(PrefetchJob *pfjob)
+static void seq_prefetch_update_depsgraph(PrefetchThread *thread)
 {
-  DEG_evaluate_on_framechange(pfjob->depsgraph, seq_prefetch_cfra(pfjob));
+  DEG_evaluate_on_framechange(thread->depsgraph, thread->cfra);
 }
 
-static void seq_prefetch_init_depsgraph(PrefetchJob *pfjob)
+static void seq_prefetch_init_depsgraph(PrefetchThread *thread)
 {
-  Main *bmain = pfjob->bmain_eval;
-  Scene *scene = pfjob->scene;
+  Main *bmain = thread->bmain_eval;
+  Scene *scene = thread->pfjob->scene;
   ViewLayer *view_layer = BKE_view_layer_default_render(scene);
 
-  pfjob->depsgraph = DEG_graph_new(bmain, scene, view_layer, DAG_EVAL_RENDER);
-  DEG_debug_name_set(pfjob->depsgraph, "SEQUENCER PREFETCH");
+  thread->depsgraph = DEG_graph_new(bmain, scene, view_layer, DAG_EVAL_RENDER);
+  DEG_debug_name_set(thread->depsgraph, "SEQUENCER PREFETCH");
 
   /* Make sure there is a correct evaluated scene pointer. */
-  DEG_graph_build_for_render_pipeline(pfjob->depsgraph);
+  DEG_graph_build_for_render_pipeline(thread->depsgraph);
 
   /* Update immediately so we have proper evaluated scene. */
-  seq_prefetch_update_depsgraph(pfjob);
+  thread->cfra = seq_prefetch_cfra(thread->pfjob);
+  seq_prefetch_update_depsgraph(thread);
 
-  pfjob->scene_eval = DEG_get_evaluated_scene(pfjob->depsgraph);
-  pfjob->scene_eval->ed->cache_flag = 0;
+  thread->scene_eval = DEG_get_evaluated_scene(thread->depsgraph);
+  thread->scene_eval->ed->cache_flag = 0;
 }
 
 static void seq_prefetch_update_area(PrefetchJob *pfjob)
@@ -276,7 +305,7 @@ void BKE_sequencer_prefetch_stop(Scene *scene)
   pfjob->stop = true;
 
   while (pfjob->running) {
-    BLI_condition_notify_one(&pfjob->prefetch_suspend_cond);
+    BLI_condition_notify_all(&pfjob->prefetch_suspend_cond);
   }
 }
 
@@ -285,32 +314,52 @@ static void seq_prefetch_update_context(const SeqRenderData *context)
   PrefetchJob *pfjob;
   pfjob = seq_prefetch_job_get(context->scene);
 
-  BKE_sequencer_new_render_data(pfjob->bmain_eval,
-                                pfjob->depsgraph,
-                                pfjob->scene_eval,
-                                context->rectx,
-                                context->recty,
-                                context->preview_render_size,
-                                false,
-                                &pfjob->context_cpy);
-  pfjob->context_cpy.is_prefetch_render = true;
-  pfjob->context_cpy.task_id = SEQ_TASK_PREFETCH_RENDER;
-
-  BKE_sequencer_new_render_data(pfjob->bmain,
-                                pfjob->depsgraph,
-                                pfjob->scene,
-                                context->rectx,
-                                context->recty,
-                                context->preview_render_size,
-                                false,
-                                &pfjob->context);
-  pfjob->context.is_prefetch_render = false;
-
-  /* Same ID as prefetch context, because context will be swapped, but we still
-   * want to assign this ID to cache entries created in this thread.
-   * This is to allow "temp cache" work correctly for both threads.
-   */
-  pfjob->context.task_id = SEQ_TASK_PREFETCH_RENDER;
+  for (int i = 0; i < pfjob->num_threads; i++) {
+    PrefetchThread *thread = &pfjob->thread_data[i];
+
+    BKE_sequencer_new_render_data(thread->bmain_eval,
+                                  thread->depsgraph,
+                                  thread->scene_eval,
+                                  context->rectx,
+                                  context->recty,
+                                  context->preview_render_size,
+                                  false,
+                                  &thread->context_cpy);
+    thread->context_cpy.is_prefetch_render = true;
+    thread->context_cpy.task_id = SEQ_TASK_PREFETCH_RENDER + i;
+
+    BKE_sequencer_new_render_data(pfjob->bmain,
+                                  thread->depsgraph,
+                                  pfjob->scene,
+                                  context->rectx,
+                                  context->recty,
+                                  context->preview_render_size,
+                                  false,
+                                  &thread->context);
+    thread->context.is_prefetch_render = false;
+
+    /* Same ID as prefetch context, because context will be swapped, but we still
+     * want to assign this ID to cache entries created in this thread.
+     * This is to allow "temp cache" work correctly for all threads.
+     */
+    thread->context.task_id = SEQ_TASK_PREFETCH_RENDER + i;
+  }
+}
+
+/* Prefetch threads render whole frames, effects are threaded on their own too, so don't use
+ * all cores for prefetching. Every thread has its own evaluated copy of the scene, so big scenes
+ * use less threads, to keep memory for cached images. */
+static int seq_prefetch_num_threads(size_t thread_memory)
+{
+  const int num_threads = clamp_i(BLI_system_thread_count() / 4, 1, SEQ_PREFETCH_THREADS_MAX);
+  const size_t memory_max = ((size_t)U.memcachelimit) * 1024 * 1024 /
+                            SEQ_PREFETCH_MEMORY_FRACTION;
+
+  if (thread_memory == 0) {
+    return num_threads;
+  }
+
+  return (int)clamp_z(memory_max / thread_memory, 1, (size_t)num_threads);
 }
 
 static void seq_prefetch_update_scene(Scene *scene)
@@ -322,16 +371,28 @@ static void seq_prefetch_update_scene(Scene *scene)
   }
 
   pfjob->scene = scene;
-  seq_prefetch_free_depsgraph(pfjob);
-  seq_prefetch_init_depsgraph(pfjob);
+  for (int i = 0; i < pfjob->num_threads; i++) {
+    seq_prefetch_free_depsgraph(&pfjob->thread_data[i]);
+  }
+
+  /* Memory used by the copy of the first thread decides how many threads can be used. */
+  size_t mem_used_prev = MEM_get_memory_in_use();
+  seq_prefetch_init_depsgraph(&pfjob->thread_data[0]);
+  size_t mem_used_curr = MEM_get_memory_in_use();
+  size_t thread_memory = mem_used_prev < mem_used_curr ? mem_used_curr - mem_used_prev : 0;
+
+  pfjob->num_threads = seq_prefetch_num_threads(thread_memory);
+  for (int i = 1; i < pfjob->num_threads; i++) {
+    seq_prefetch_init_depsgraph(&pfjob->thread_data[i]);
+  }
 }
 
 static void seq_prefetch_resume(Scene *scene)
 {
   PrefetchJob *pfjob = seq_prefetch_job_get(scene);
 
-  if (pfjob && pfjob->waiting) {
-    BLI_condition_notify_one(&pfjob->prefetch_suspend_cond);
+  if (pfjob && pfjob->num_threads_waiting > 0) {
+    BLI_condition_notify_all(&pfjob->prefetch_suspend_cond);
   }
 }
 
@@ -344,24 +405,24 @@ void BKE_sequencer_prefetch_free(Scene *scene)
 
   BKE_sequencer_prefetch_stop(scene);
 
-  BLI_threadpool_remove(&pfjob->threads, pfjob);
   BLI_threadpool_end(&pfjob->threads);
   BLI_mutex_end(&pfjob->prefetch_suspend_mutex);
   BLI_condition_end(&pfjob->prefetch_suspend_cond);
-  seq_prefetch_free_depsgraph(pfjob);
-  BKE_main_free(pfjob->bmain_eval);
+  for (int i = 0; i < SEQ_PREFETCH_THREADS_MAX; i++) {
+    seq_prefetch_free_depsgraph(&pfjob->thread_data[i]);
+    BKE_main_free(pfjob->thread_data[i].bmain_eval);
+  }
   MEM_freeN(pfjob);
   scene->ed->prefetch_job = NULL;
 }
 
-static bool seq_prefetch_do_skip_frame(Scene *scene)
+static bool seq_prefetch_do_skip_frame(PrefetchThread *thread)
 {
-  Editing *ed = scene->ed;
-  PrefetchJob *pfjob = seq_prefetch_job_get(scene);
-  float cfra = seq_prefetch_cfra(pfjob);
+  Editing *ed = thread->pfjob->scene->ed;
+  float cfra = thread->cfra;
   Sequence *seq_arr[MAXSEQ + 1];
   int count = BKE_sequencer_get_shown_sequences(ed->seqbasep, cfra, 0, seq_arr);
-  SeqRenderData *ctx = &pfjob->context_cpy;
+  SeqRenderData *ctx = &thread->context_cpy;
   ImBuf *ibuf = NULL;
 
   /* Disable prefetching 3D scene strips, but check for disk cache. */
@@ -417,34 +478,56 @@ static bool seq_prefetch_do_skip_frame(Scene *scene)
 static bool seq_prefetch_need_suspend(PrefetchJob *pfjob)
 {
   return seq_prefetch_is_cache_full(pfjob->scene) || seq_prefetch_is_scrubbing(pfjob->bmain) ||
-         (seq_prefetch_cfra(pfjob) >= pfjob->scene->r.efra);
+         (seq_prefetch_cfra(pfjob) > pfjob->scene->r.efra);
 }
 
-static void seq_prefetch_do_suspend(PrefetchJob *pfjob)
+/* Claim the next frame to render for this thread. Threads are suspended while there is nothing
+ * to be prefetched. Returns false when the thread should stop. */
+static bool seq_prefetch_claim_frame(PrefetchThread *thread)
 {
+  PrefetchJob *pfjob = thread->pfjob;
+  bool claimed = false;
+
   BLI_mutex_lock(&pfjob->prefetch_suspend_mutex);
+  seq_prefetch_update_area(pfjob);
+
   while (seq_prefetch_need_suspend(pfjob) &&
          (pfjob->scene->ed->cache_flag & SEQ_CACHE_PREFETCH_ENABLE) && !pfjob->stop) {
-    pfjob->waiting = true;
+    pfjob->num_threads_waiting++;
     BLI_condition_wait(&pfjob->prefetch_suspend_cond, &pfjob->prefetch_suspend_mutex);
+    pfjob->num_threads_waiting--;
     seq_prefetch_update_area(pfjob);
   }
-  pfjob->waiting = false;
+
+  if ((pfjob->scene->ed->cache_flag & SEQ_CACHE_PREFETCH_ENABLE) && !pfjob->stop &&
+      seq_prefetch_cfra(pfjob) <= pfjob->scene->r.efra) {
+    /* Avoid "collision" with main thread, but make sure to fetch at least few frames */
+    if (!(pfjob->num_frames_prefetched > 5 &&
+          (seq_prefetch_cfra(pfjob) - pfjob->scene->r.cfra) < 2)) {
+      thread->cfra = seq_prefetch_cfra(pfjob);
+      pfjob->num_frames_prefetched++;
+      claimed = true;
+    }
+  }
+
   BLI_mutex_unlock(&pfjob->prefetch_suspend_mutex);
+
+  return claimed;
 }
 
-static void *seq_prefetch_frames(void *job)
+static void *seq_prefetch_frames(void *thread_data)
 {
-  PrefetchJob *pfjob = (PrefetchJob *)job;
+  PrefetchThread *thread = (PrefetchThread *)thread_data;
+  PrefetchJob *pfjob = thread->pfjob;
 
-  while (seq_prefetch_cfra(pfjob) <= pfjob->scene->r.efra) {
-    pfjob->scene_eval->ed->prefetch_job = NULL;
+  while (seq_prefetch_claim_frame(thread)) {
+    thread->scene_eval->ed->prefetch_job = NULL;
 
-    seq_prefetch_update_depsgraph(pfjob);
-    AnimData *adt = BKE_animdata_from_id(&pfjob->context_cpy.scene->id);
-    AnimationEvalContext anim_eval_context = seq_prefetch_anim_eval_context(pfjob);
+    seq_prefetch_update_depsgraph(thread);
+    AnimData *adt = BKE_animdata_from_id(&thread->context_cpy.scene->id);
+    AnimationEvalContext anim_eval_context = seq_prefetch_anim_eval_context(thread);
     BKE_animsys_evaluate_animdata(
-        &pfjob->context_cpy.scene->id, adt, &anim_eval_context, ADT_RECALC_ALL, false);
+        &thread->context_cpy.scene->id, adt, &anim_eval_context, ADT_RECALC_ALL, false);
 
     /* This is quite hacky solution:
      * We need cross-reference original scene with copy for cache.
@@ -452,39 +535,28 @@ static void *seq_prefetch_frames(void *job)
      * Scene copy don't reference original scene. Perhaps, this could be done by depsgraph.
      * Set to NULL before return!
      */
-    pfjob->scene_eval->ed->prefetch_job = pfjob;
+    thread->scene_eval->ed->prefetch_job = pfjob;
 
-    if (seq_prefetch_do_skip_frame(pfjob->scene)) {
-      pfjob->num_frames_prefetched++;
+    if (seq_prefetch_do_skip_frame(thread)) {
       continue;
     }
 
-    ImBuf *ibuf = BKE_sequencer_give_ibuf(&pfjob->context_cpy, seq_prefetch_cfra(pfjob), 0);
-    BKE_sequencer_cache_free_temp_cache(
-        pfjob->scene, pfjob->context.task_id, seq_prefetch_cfra(pfjob));
+    ImBuf *ibuf = BKE_sequencer_give_ibuf(&thread->context_cpy, thread->cfra, 0);
+    BKE_sequencer_cache_free_temp_cache(pfjob->scene, thread->context.task_id, thread->cfra);
     IMB_freeImBuf(ibuf);
 
-    /* Suspend thread if there is nothing to be prefetched. */
-    seq_prefetch_do_suspend(pfjob);
-
-    /* Avoid "collision" with main thread, but make sure to fetch at least few frames */
-    if (pfjob->num_frames_prefetched > 5 &&
-        (seq_prefetch_cfra(pfjob) - pfjob->scene->r.cfra) < 2) {
-      break;
-    }
+    atomic_add_and_fetch_int32(&pfjob->num_frames_rendered, 1);
+  }
 
-    if (!(pfjob->scene->ed->cache_flag & SEQ_CACHE_PREFETCH_ENABLE) || pfjob->stop) {
-      break;
-    }
+  BKE_sequencer_cache_free_temp_cache(pfjob->scene, thread->context.task_id, thread->cfra);
+  thread->scene_eval->ed->prefetch_job = NULL;
 
-    seq_prefetch_update_area(pfjob);
-    pfjob->num_frames_prefetched++;
+  BLI_mutex_lock(&pfjob->prefetch_suspend_mutex);
+  pfjob->num_threads_running--;
+  if (pfjob->num_threads_running == 0) {
+    pfjob->running = false;
   }
-
-  BKE_sequencer_cache_free_temp_cache(
-      pfjob->scene, pfjob->context.task_id, seq_prefetch_cfra(pfjob));
-  pfjob->running = false;
-  pfjob->scene_eval->ed->prefetch_job = NULL;
+  BLI_mutex_unlock(&pfjob->prefetch_suspend_mutex);
 
   return NULL;
 }
@@ -498,28 +570,41 @@ static PrefetchJob *seq_prefetch_start(const SeqRenderData *context, float cfra)
       pfjob = (PrefetchJob *)MEM_callocN(sizeof(PrefetchJob), "PrefetchJob");
       context->scene->ed->prefetch_job = pfjob;
 
-      BLI_threadpool_init(&pfjob->threads, seq_prefetch_frames, 1);
+      /* Threads and their evaluated copies are created by #seq_prefetch_update_scene. */
+      BLI_threadpool_init(&pfjob->threads, seq_prefetch_frames, SEQ_PREFETCH_THREADS_MAX);
       BLI_mutex_init(&pfjob->prefetch_suspend_mutex);
       BLI_condition_init(&pfjob->prefetch_suspend_cond);
 
-      pfjob->bmain_eval = BKE_main_new();
       pfjob->scene = context->scene;
-      seq_prefetch_init_depsgraph(pfjob);
+      for (int i = 0; i < SEQ_PREFETCH_THREADS_MAX; i++) {
+        PrefetchThread *thread = &pfjob->thread_data[i];
+        thread->pfjob = pfjob;
+        thread->bmain_eval = BKE_main_new();
+      }
     }
   }
-  seq_prefetch_update_scene(context->scene);
-  seq_prefetch_update_context(context);
-  pfjob->bmain = context->bmain;
+
+  /* Threads of a previous run must be finished before their data is changed. */
+  BLI_threadpool_clear(&pfjob->threads);
 
   pfjob->cfra = cfra;
   pfjob->num_frames_prefetched = 1;
 
-  pfjob->waiting = false;
+  seq_prefetch_update_scene(context->scene);
+  seq_prefetch_update_context(context);
+  pfjob->bmain = context->bmain;
+
+  pfjob->num_threads_waiting = 0;
+  pfjob->num_threads_running = pfjob->num_threads;
   pfjob->stop = false;
   pfjob->running = true;
 
-  BLI_threadpool_remove(&pfjob->threads, pfjob);
-  BLI_threadpool_insert(&pfjob->threads, pfjob);
+  pfjob->start_time = PIL_check_seconds_timer();
+  pfjob->num_frames_rendered = 0;
+
+  for (int i = 0; i < pfjob->num_threads; i++) {
+    BLI_threadpool_insert(&pfjob->threads, &pfjob->thread_data[i]);
+  }
 
   return pfjob;
 }
@@ -550,6 +635,23 @@ void BKE_sequencer_prefetch_start(const SeqRenderData *context, float cfra, floa
   }
 }
 
+/* Frames per second achieved by prefetching since it was started, 0 when not running. */
+float BKE_sequencer_prefetch_fps(Scene *scene)
+{
+  PrefetchJob *pfjob = seq_prefetch_job_get(scene);
+
+  if (!pfjob || !pfjob->running || seq_prefetch_job_is_waiting(scene)) {
+    return 0.0f;
+  }
+
+  const double elapsed = PIL_check_seconds_timer() - pfjob->start_time;
+  if (elapsed <= 0.0) {
+    return 0.0f;
+  }
+
+  return (float)(pfjob->num_frames_rendered / elapsed);
+}
+
 bool BKE_sequencer_prefetch_need_redraw(Main *bmain, Scene *scene)
 {
   bool playing = seq_prefetch_is_playing(bmain);
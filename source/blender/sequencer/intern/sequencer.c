@@ -28,7 +28,6 @@
 #include <stddef.h>
 #include <stdlib.h>
 #include <string.h>
-#include <time.h>
 
 #include "MEM_guardedalloc.h"
 
@@ -50,6 +49,7 @@
 #include "BLI_session_uuid.h"
 #include "BLI_string.h"
 #include "BLI_string_utf8.h"
+#include "BLI_task.h"
 #include "BLI_threads.h"
 #include "BLI_utildefines.h"
 
@@ -80,6 +80,8 @@
 #include "DEG_depsgraph.h"
 #include "DEG_depsgraph_query.h"
 
+#include "PIL_time.h"
+
 #include "RNA_access.h"
 
 #include "RE_pipeline.h"
@@ -96,6 +98,8 @@
 
 #include "RE_engine.h"
 
+#include "atomic_ops.h"
+
 #include "sequencer.h"
 
 #ifdef WITH_AUDASPACE
@@ -116,7 +120,7 @@ static ImBuf *seq_render_preprocess_ibuf(const SeqRenderData *context,
                                          Sequence *seq,
                                          ImBuf *ibuf,
                                          float cfra,
-                                         clock_t begin,
+                                         double begin,
                                          bool use_preprocess,
                                          const bool is_proxy_image);
 static ImBuf *seq_render_strip(const SeqRenderData *context,
@@ -128,7 +132,12 @@ static ImBuf *seq_render_mask(const SeqRenderData *context, Mask *mask, float nr
 static int seq_num_files(Scene *scene, char views_format, const bool is_multiview);
 static void seq_anim_add_suffix(Scene *scene, struct anim *anim, const int view_id);
 
-static ThreadMutex seq_render_mutex = BLI_MUTEX_INITIALIZER;
+/* Prefetch threads render frames concurrently using their own copies of the scene, while
+ * rendering in the main thread and rendering strips which use global state is exclusive.
+ * Every thread passes the turnstile before taking the lock, and an exclusive render holds it
+ * while waiting, so prefetch threads can not starve the main thread. */
+static ThreadMutex seq_render_turnstile = BLI_MUTEX_INITIALIZER;
+static ThreadRWMutex seq_render_rwlock = BLI_RWLOCK_INITIALIZER;
 
 /* **** XXX ******** */
 #define SELECT 1
@@ -508,6 +517,7 @@ void BKE_sequencer_editing_free(Scene *scene, const bool do_id_user)
   }
 
   BKE_sequencer_prefetch_free(scene);
+  BKE_sequencer_image_readahead_free(scene);
   BKE_sequencer_cache_destruct(scene);
 
   SEQ_ALL_BEGIN (ed, seq) {
@@ -2241,6 +2251,129 @@ void BKE_sequencer_proxy_rebuild(SeqIndexBuildContext *context,
   }
 }
 
+typedef struct SeqProxyRebuildQueueData {
+  SeqIndexBuildContext **contexts;
+  float *contexts_progress;
+  int num_contexts;
+  short *stop;
+  int32_t num_running;
+} SeqProxyRebuildQueueData;
+
+static void seq_proxy_rebuild_queue_context(SeqProxyRebuildQueueData *data, int i)
+{
+  short context_do_update = false;
+
+  if (!*data->stop && !G.is_break) {
+    BKE_sequencer_proxy_rebuild(
+        data->contexts[i], data->stop, &context_do_update, &data->contexts_progress[i]);
+  }
+  data->contexts_progress[i] = 1.0f;
+}
+
+static void seq_proxy_rebuild_queue_movie_task(TaskPool *__restrict pool, void *taskdata)
+{
+  SeqProxyRebuildQueueData *data = BLI_task_pool_user_data(pool);
+
+  seq_proxy_rebuild_queue_context(data, POINTER_AS_INT(taskdata));
+  atomic_sub_and_fetch_int32(&data->num_running, 1);
+}
+
+/* Strips other than movies go through the render pipeline, so they are built one after the
+ * other in a single task. */
+static void seq_proxy_rebuild_queue_render_task(TaskPool *__restrict pool,
+                                                void *UNUSED(taskdata))
+{
+  SeqProxyRebuildQueueData *data = BLI_task_pool_user_data(pool);
+
+  for (int i = 0; i < data->num_contexts; i++) {
+    if (data->contexts[i]->seq->type != SEQ_TYPE_MOVIE) {
+      seq_proxy_rebuild_queue_context(data, i);
+    }
+  }
+  atomic_sub_and_fetch_int32(&data->num_running, 1);
+}
+
+/**
+ * Rebuild all contexts of the queue. Movie strips decode and encode with their own FFmpeg
+ * contexts, so they are built side by side on the task scheduler, next to a single task building
+ * the other strips. The calling thread reports progress, the average over all contexts.
+ */
+void BKE_sequencer_proxy_rebuild_queue(ListBase *queue,
+                                       short *stop,
+                                       short *do_update,
+                                       float *progress)
+{
+  const int num_contexts = BLI_listbase_count(queue);
+  SeqProxyRebuildQueueData data = {NULL};
+  TaskPool *task_pool;
+  LinkData *link;
+  int num_movies = 0;
+  int i;
+
+  if (num_contexts == 0) {
+    return;
+  }
+
+  data.contexts = MEM_malloc_arrayN(num_contexts, sizeof(*data.contexts), __func__);
+  data.contexts_progress = MEM_calloc_arrayN(num_contexts, sizeof(float), __func__);
+  data.num_contexts = num_contexts;
+  data.stop = stop;
+
+  for (link = queue->first, i = 0; link; link = link->next, i++) {
+    data.contexts[i] = link->data;
+    if (data.contexts[i]->seq->type == SEQ_TYPE_MOVIE) {
+      num_movies++;
+    }
+  }
+
+  /* Movies share the threads between their decoders, so FFmpeg doesn't start a full set of
+   * threads for every movie on top of the task scheduler. */
+  const int num_decode_threads = max_ii(1, BLI_system_thread_count() / max_ii(1, num_movies));
+
+  task_pool = BLI_task_pool_create(&data, TASK_PRIORITY_LOW);
+
+  for (i = 0; i < num_contexts; i++) {
+    SeqIndexBuildContext *context = data.contexts[i];
+
+    if (context->seq->type == SEQ_TYPE_MOVIE) {
+      if (context->index_context) {
+        IMB_anim_index_rebuild_set_num_threads(context->index_context, num_decode_threads);
+      }
+      atomic_add_and_fetch_int32(&data.num_running, 1);
+      BLI_task_pool_push(
+          task_pool, seq_proxy_rebuild_queue_movie_task, POINTER_FROM_INT(i), false, NULL);
+    }
+  }
+
+  if (num_movies != num_contexts) {
+    atomic_add_and_fetch_int32(&data.num_running, 1);
+    BLI_task_pool_push(task_pool, seq_proxy_rebuild_queue_render_task, NULL, false, NULL);
+  }
+
+  /* Report progress of all strips while they are being built. */
+  while (true) {
+    const bool done = atomic_add_and_fetch_int32(&data.num_running, 0) == 0;
+    float total_progress = 0.0f;
+
+    for (i = 0; i < num_contexts; i++) {
+      total_progress += atomic_add_and_fetch_fl(&data.contexts_progress[i], 0.0f);
+    }
+    *progress = total_progress / num_contexts;
+    *do_update = true;
+
+    if (done) {
+      break;
+    }
+    PIL_sleep_ms(50);
+  }
+
+  BLI_task_pool_work_and_wait(task_pool);
+  BLI_task_pool_free(task_pool);
+
+  MEM_freeN(data.contexts);
+  MEM_freeN(data.contexts_progress);
+}
+
 void BKE_sequencer_proxy_rebuild_finish(SeqIndexBuildContext *context, bool stop)
 {
   if (context->index_context) {
@@ -3014,15 +3147,69 @@ static ImBuf *seq_render_effect_strip_impl(const SeqRenderData *context,
   return out;
 }
 
+/**
+ * Scale at which images can be read for previews. Images read at a reduced size are used like
+ * proxies, so this is only done for preview sizes where proxies are not scaled again.
+ */
+static float seq_render_image_strip_read_scale(const SeqRenderData *context, Sequence *seq)
+{
+  if (context->for_render || context->is_proxy_render) {
+    return 1.0f;
+  }
+  /* Filtering fields needs the original lines. */
+  if (seq->flag & SEQ_FILTERY) {
+    return 1.0f;
+  }
+  if (!ELEM(context->preview_render_size,
+            SEQ_RENDER_SIZE_PROXY_25,
+            SEQ_RENDER_SIZE_PROXY_50,
+            SEQ_RENDER_SIZE_PROXY_75)) {
+    return 1.0f;
+  }
+  return (float)BKE_sequencer_rendersize_to_scale_factor(context->preview_render_size);
+}
+
+/* Decode the image from file contents that may have been read ahead. */
+static ImBuf *seq_render_image_strip_file(const SeqRenderData *context,
+                                          Sequence *seq,
+                                          const char *name,
+                                          int flag,
+                                          float scale,
+                                          int r_full_size[2])
+{
+  size_t size;
+  unsigned char *mem = BKE_sequencer_image_readahead_read(context, name, &size);
+
+  if (mem == NULL) {
+    return IMB_loadiffname_scaled(
+        name, flag, seq->strip->colorspace_settings.name, scale, r_full_size);
+  }
+
+  ImBuf *ibuf = IMB_ibImageFromMemory_scaled(
+      mem, size, flag, seq->strip->colorspace_settings.name, name, scale, r_full_size);
+  MEM_freeN(mem);
+
+  if (ibuf != NULL) {
+    BLI_strncpy(ibuf->name, name, sizeof(ibuf->name));
+  }
+
+  return ibuf;
+}
+
 /**
  * Render individual view for multi-view or single (default view) for mono-view.
+ *
+ * \param scale: Read the image at this scale if the file format supports that.
+ * \param r_full_size: Size of the image in the file.
  */
 static ImBuf *seq_render_image_strip_view(const SeqRenderData *context,
                                           Sequence *seq,
                                           char *name,
                                           char *prefix,
                                           const char *ext,
-                                          int view_id)
+                                          int view_id,
+                                          float scale,
+                                          int r_full_size[2])
 {
 
   ImBuf *ibuf = NULL;
@@ -3033,13 +3220,14 @@ static ImBuf *seq_render_image_strip_view(const SeqRenderData *context,
   }
 
   if (prefix[0] == '\0') {
-    ibuf = IMB_loadiffname(name, flag, seq->strip->colorspace_settings.name);
+    ibuf = seq_render_image_strip_file(context, seq, name, flag, scale, r_full_size);
   }
   else {
     char str[FILE_MAX];
     BKE_scene_multiview_view_prefix_get(context->scene, name, prefix, &ext);
     seq_multiview_name(context->scene, view_id, prefix, ext, str, FILE_MAX);
-    ibuf = IMB_loadiffname(str, flag, seq->strip->colorspace_settings.name);
+    ibuf = IMB_loadiffname_scaled(
+        str, flag, seq->strip->colorspace_settings.name, scale, r_full_size);
   }
 
   if (ibuf == NULL) {
@@ -3110,8 +3298,11 @@ static ImBuf *seq_render_image_strip(const SeqRenderData *context,
     int totviews = BKE_scene_multiview_num_views_get(&context->scene->r);
     ImBuf **ibufs_arr = MEM_callocN(sizeof(ImBuf *) * totviews, "Sequence Image Views Imbufs");
 
+    /* Views are always read at full size. */
+    int full_size[2];
     for (int view_id = 0; view_id < totfiles; view_id++) {
-      ibufs_arr[view_id] = seq_render_image_strip_view(context, seq, name, prefix, ext, view_id);
+      ibufs_arr[view_id] = seq_render_image_strip_view(
+          context, seq, name, prefix, ext, view_id, 1.0f, full_size);
     }
 
     if (ibufs_arr[0] == NULL) {
@@ -3128,7 +3319,7 @@ static ImBuf *seq_render_image_strip(const SeqRenderData *context,
 
       if (view_id != context->view_id) {
         ibufs_arr[view_id] = seq_render_preprocess_ibuf(
-            &localcontext, seq, ibufs_arr[view_id], cfra, clock(), true, false);
+            &localcontext, seq, ibufs_arr[view_id], cfra, PIL_check_seconds_timer(), true, false);
       }
     }
 
@@ -3145,7 +3336,19 @@ static ImBuf *seq_render_image_strip(const SeqRenderData *context,
     MEM_freeN(ibufs_arr);
   }
   else {
-    ibuf = seq_render_image_strip_view(context, seq, name, prefix, ext, context->view_id);
+    const float scale = seq_render_image_strip_read_scale(context, seq);
+    int full_size[2];
+    BKE_sequencer_image_readahead_update(context, seq, cfra);
+    ibuf = seq_render_image_strip_view(
+        context, seq, name, prefix, ext, context->view_id, scale, full_size);
+
+    if (ibuf != NULL && (ibuf->x != full_size[0] || ibuf->y != full_size[1])) {
+      /* Image was read at preview size, it is processed like a proxy from here. */
+      s_elem->orig_width = full_size[0];
+      s_elem->orig_height = full_size[1];
+      *r_is_proxy_image = true;
+      return ibuf;
+    }
   }
 
   if (ibuf == NULL) {
@@ -3275,7 +3478,7 @@ static ImBuf *seq_render_movie_strip(
 
       if (view_id != context->view_id) {
         ibuf_arr[view_id] = seq_render_preprocess_ibuf(
-            &localcontext, seq, ibuf_arr[view_id], cfra, clock(), true, false);
+            &localcontext, seq, ibuf_arr[view_id], cfra, PIL_check_seconds_timer(), true, false);
       }
     }
 
@@ -3840,17 +4043,18 @@ static ImBuf *do_render_strip_uncached(const SeqRenderData *context,
   return ibuf;
 }
 
-/* Estimate time spent by the program rendering the strip */
-static clock_t seq_estimate_render_cost_begin(void)
+/* Estimate time spent by the program rendering the strip.
+ * Wall time is used, processor time would include other strips rendered in parallel. */
+static double seq_estimate_render_cost_begin(void)
 {
-  return clock();
+  return PIL_check_seconds_timer();
 }
 
-static float seq_estimate_render_cost_end(Scene *scene, clock_t begin)
+static float seq_estimate_render_cost_end(Scene *scene, double begin)
 {
-  clock_t end = clock();
+  double end = PIL_check_seconds_timer();
   float time_spent = (float)(end - begin);
-  float time_max = (1.0f / scene->r.frs_sec) * CLOCKS_PER_SEC;
+  float time_max = 1.0f / scene->r.frs_sec;
 
   if (time_max != 0) {
     return time_spent / time_max;
@@ -3863,7 +4067,7 @@ static ImBuf *seq_render_preprocess_ibuf(const SeqRenderData *context,
                                          Sequence *seq,
                                          ImBuf *ibuf,
                                          float cfra,
-                                         clock_t begin,
+                                         double begin,
                                          bool use_preprocess,
                                          const bool is_proxy_image)
 {
@@ -3901,7 +4105,7 @@ static ImBuf *seq_render_strip(const SeqRenderData *context,
   bool use_preprocess = false;
   bool is_proxy_image = false;
 
-  clock_t begin = seq_estimate_render_cost_begin();
+  double begin = seq_estimate_render_cost_begin();
 
   ibuf = BKE_sequencer_cache_get(context, seq, cfra, SEQ_CACHE_STORE_PREPROCESSED, false);
   if (ibuf != NULL) {
@@ -3994,6 +4198,106 @@ static ImBuf *seq_render_strip_stack_apply_effect(
   return out;
 }
 
+/* Strips which are only read from disk and preprocessed, and don't depend on other strips or
+ * global render state, so they can be rendered in parallel with each other. */
+static bool seq_render_strip_is_independent(const Sequence *seq)
+{
+  if (!ELEM(seq->type, SEQ_TYPE_IMAGE, SEQ_TYPE_MOVIE)) {
+    return false;
+  }
+
+  /* Modifier masks render other strips. */
+  LISTBASE_FOREACH (SequenceModifierData *, smd, &seq->modifiers) {
+    if (smd->mask_sequence || smd->mask_id) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+typedef struct RenderStripInputsData {
+  const SeqRenderData *context;
+  SeqRenderState *state;
+  float cfra;
+  Sequence **seq_arr;
+  int *indices;
+  ImBuf **ibufs;
+  float *costs;
+} RenderStripInputsData;
+
+static void seq_render_strip_inputs_task(void *__restrict userdata,
+                                         const int task_index,
+                                         const TaskParallelTLS *__restrict UNUSED(tls))
+{
+  RenderStripInputsData *data = (RenderStripInputsData *)userdata;
+  const int i = data->indices[task_index];
+  double begin = seq_estimate_render_cost_begin();
+
+  data->ibufs[i] = seq_render_strip(data->context, data->state, data->seq_arr[i], data->cfra);
+  data->costs[i] = seq_estimate_render_cost_end(data->context->scene, begin);
+}
+
+/* Fetch, decode and preprocess independent strip inputs of the stack in parallel, before
+ * they are blended. Strips which are not rendered here are left NULL in r_ibufs. */
+static void seq_render_strip_stack_inputs(const SeqRenderData *context,
+                                          SeqRenderState *state,
+                                          Sequence **seq_arr,
+                                          const bool *need_render,
+                                          int count,
+                                          float cfra,
+                                          ImBuf **r_ibufs,
+                                          float *r_costs)
+{
+  int indices[MAXSEQ + 1];
+  int tot = 0;
+
+  for (int i = 0; i < count; i++) {
+    if (need_render[i] && seq_render_strip_is_independent(seq_arr[i])) {
+      indices[tot++] = i;
+    }
+  }
+
+  /* Nothing to gain from threading a single strip. */
+  if (tot < 2) {
+    return;
+  }
+
+  RenderStripInputsData data = {
+      .context = context,
+      .state = state,
+      .cfra = cfra,
+      .seq_arr = seq_arr,
+      .indices = indices,
+      .ibufs = r_ibufs,
+      .costs = r_costs,
+  };
+
+  TaskParallelSettings settings;
+  BLI_parallel_range_settings_defaults(&settings);
+  settings.min_iter_per_thread = 1;
+  BLI_task_parallel_range(0, tot, &data, seq_render_strip_inputs_task, &settings);
+}
+
+/* Render strip input of the stack, unless it was already rendered in parallel. */
+static ImBuf *seq_render_strip_stack_input(const SeqRenderData *context,
+                                           SeqRenderState *state,
+                                           Sequence **seq_arr,
+                                           ImBuf **ibufs,
+                                           float *costs,
+                                           int i,
+                                           float cfra)
+{
+  if (ibufs[i]) {
+    return ibufs[i];
+  }
+
+  double begin = seq_estimate_render_cost_begin();
+  ImBuf *ibuf = seq_render_strip(context, state, seq_arr[i], cfra);
+  costs[i] = seq_estimate_render_cost_end(context->scene, begin);
+  return ibuf;
+}
+
 static ImBuf *seq_render_strip_stack(const SeqRenderData *context,
                                      SeqRenderState *state,
                                      ListBase *seqbasep,
@@ -4001,10 +4305,13 @@ static ImBuf *seq_render_strip_stack(const SeqRenderData *context,
                                      int chanshown)
 {
   Sequence *seq_arr[MAXSEQ + 1];
+  ImBuf *ibufs[MAXSEQ + 1] = {NULL};
+  float costs[MAXSEQ + 1] = {0.0f};
+  bool need_render[MAXSEQ + 1] = {false};
   int count;
   int i;
   ImBuf *out = NULL;
-  clock_t begin;
+  double begin;
 
   count = BKE_sequencer_get_shown_sequences(seqbasep, cfra, chanshown, (Sequence **)&seq_arr);
 
@@ -4012,8 +4319,8 @@ static ImBuf *seq_render_strip_stack(const SeqRenderData *context,
     return NULL;
   }
 
+  /* Find the bottom of the stack that has to be rendered, and strips that are used as input. */
   for (i = count - 1; i >= 0; i--) {
-    int early_out;
     Sequence *seq = seq_arr[i];
 
     out = BKE_sequencer_cache_get(context, seq, cfra, SEQ_CACHE_STORE_COMPOSITE, false);
@@ -4022,63 +4329,73 @@ static ImBuf *seq_render_strip_stack(const SeqRenderData *context,
       break;
     }
     if (seq->blend_mode == SEQ_BLEND_REPLACE) {
-      out = seq_render_strip(context, state, seq, cfra);
+      need_render[i] = true;
       break;
     }
 
-    early_out = seq_get_early_out_for_blend_mode(seq);
+    int early_out = seq_get_early_out_for_blend_mode(seq);
 
-    switch (early_out) {
-      case EARLY_NO_INPUT:
-      case EARLY_USE_INPUT_2:
-        out = seq_render_strip(context, state, seq, cfra);
-        break;
-      case EARLY_USE_INPUT_1:
-        if (i == 0) {
-          out = IMB_allocImBuf(context->rectx, context->recty, 32, IB_rect);
-        }
-        break;
-      case EARLY_DO_EFFECT:
-        if (i == 0) {
-          begin = seq_estimate_render_cost_begin();
+    if (ELEM(early_out, EARLY_NO_INPUT, EARLY_USE_INPUT_2)) {
+      need_render[i] = true;
+      break;
+    }
+    if (early_out == EARLY_DO_EFFECT) {
+      need_render[i] = true;
+    }
+    if (i == 0) {
+      break;
+    }
+  }
 
-          ImBuf *ibuf1 = IMB_allocImBuf(context->rectx, context->recty, 32, IB_rect);
-          ImBuf *ibuf2 = seq_render_strip(context, state, seq, cfra);
+  const int bottom = i;
 
-          out = seq_render_strip_stack_apply_effect(context, seq, cfra, ibuf1, ibuf2);
+  seq_render_strip_stack_inputs(
+      context, state, seq_arr, need_render, count, cfra, ibufs, costs);
 
-          float cost = seq_estimate_render_cost_end(context->scene, begin);
-          BKE_sequencer_cache_put(
-              context, seq_arr[i], cfra, SEQ_CACHE_STORE_COMPOSITE, out, cost, false);
+  if (out == NULL) {
+    Sequence *seq = seq_arr[bottom];
+    int early_out = seq_get_early_out_for_blend_mode(seq);
 
-          IMB_freeImBuf(ibuf1);
-          IMB_freeImBuf(ibuf2);
-        }
-        break;
+    if (seq->blend_mode == SEQ_BLEND_REPLACE ||
+        ELEM(early_out, EARLY_NO_INPUT, EARLY_USE_INPUT_2)) {
+      out = seq_render_strip_stack_input(context, state, seq_arr, ibufs, costs, bottom, cfra);
     }
-    if (out) {
-      break;
+    else if (early_out == EARLY_USE_INPUT_1) {
+      out = IMB_allocImBuf(context->rectx, context->recty, 32, IB_rect);
+    }
+    else if (early_out == EARLY_DO_EFFECT) {
+      ImBuf *ibuf1 = IMB_allocImBuf(context->rectx, context->recty, 32, IB_rect);
+      ImBuf *ibuf2 = seq_render_strip_stack_input(
+          context, state, seq_arr, ibufs, costs, bottom, cfra);
+
+      begin = seq_estimate_render_cost_begin();
+      out = seq_render_strip_stack_apply_effect(context, seq, cfra, ibuf1, ibuf2);
+
+      float cost = costs[bottom] + seq_estimate_render_cost_end(context->scene, begin);
+      BKE_sequencer_cache_put(context, seq, cfra, SEQ_CACHE_STORE_COMPOSITE, out, cost, false);
+
+      IMB_freeImBuf(ibuf1);
+      IMB_freeImBuf(ibuf2);
     }
   }
 
-  i++;
-  for (; i < count; i++) {
-    begin = seq_estimate_render_cost_begin();
+  for (i = bottom + 1; i < count; i++) {
     Sequence *seq = seq_arr[i];
+    float cost = 0.0f;
 
     if (seq_get_early_out_for_blend_mode(seq) == EARLY_DO_EFFECT) {
       ImBuf *ibuf1 = out;
-      ImBuf *ibuf2 = seq_render_strip(context, state, seq, cfra);
+      ImBuf *ibuf2 = seq_render_strip_stack_input(context, state, seq_arr, ibufs, costs, i, cfra);
 
+      begin = seq_estimate_render_cost_begin();
       out = seq_render_strip_stack_apply_effect(context, seq, cfra, ibuf1, ibuf2);
+      cost = costs[i] + seq_estimate_render_cost_end(context->scene, begin);
 
       IMB_freeImBuf(ibuf1);
       IMB_freeImBuf(ibuf2);
     }
 
-    float cost = seq_estimate_render_cost_end(context->scene, begin);
-    BKE_sequencer_cache_put(
-        context, seq_arr[i], cfra, SEQ_CACHE_STORE_COMPOSITE, out, cost, false);
+    BKE_sequencer_cache_put(context, seq, cfra, SEQ_CACHE_STORE_COMPOSITE, out, cost, false);
   }
 
   return out;
@@ -4089,6 +4406,36 @@ static ImBuf *seq_render_strip_stack(const SeqRenderData *context,
  * you have to free after usage!
  */
 
+/* Text strips draw using the shared BLF font, scene strips render using the render pipeline
+ * and depsgraph of the scene. Strips inside meta strips are checked too. */
+static bool seq_render_uses_global_state(ListBase *seqbasep, float cfra)
+{
+  LISTBASE_FOREACH (Sequence *, seq, seqbasep) {
+    if (seq->startdisp > cfra || seq->enddisp <= cfra) {
+      continue;
+    }
+    if (ELEM(seq->type, SEQ_TYPE_TEXT, SEQ_TYPE_SCENE)) {
+      return true;
+    }
+    if (seq->type == SEQ_TYPE_META && seq_render_uses_global_state(&seq->seqbase, cfra)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+static void seq_render_lock(const bool exclusive)
+{
+  BLI_mutex_lock(&seq_render_turnstile);
+  BLI_rw_mutex_lock(&seq_render_rwlock, exclusive ? THREAD_LOCK_WRITE : THREAD_LOCK_READ);
+  BLI_mutex_unlock(&seq_render_turnstile);
+}
+
+static void seq_render_unlock(void)
+{
+  BLI_rw_mutex_unlock(&seq_render_rwlock);
+}
+
 ImBuf *BKE_sequencer_give_ibuf(const SeqRenderData *context, float cfra, int chanshown)
 {
   Scene *scene = context->scene;
@@ -4123,11 +4470,12 @@ ImBuf *BKE_sequencer_give_ibuf(const SeqRenderData *context, float cfra, int cha
 
   BKE_sequencer_cache_free_temp_cache(context->scene, context->task_id, cfra);
 
-  clock_t begin = seq_estimate_render_cost_begin();
+  double begin = seq_estimate_render_cost_begin();
   float cost = 0;
 
   if (count && !out) {
-    BLI_mutex_lock(&seq_render_mutex);
+    seq_render_lock(!context->is_prefetch_render ||
+                    seq_render_uses_global_state(seqbasep, cfra));
     out = seq_render_strip_stack(context, &state, seqbasep, cfra, chanshown);
     cost = seq_estimate_render_cost_end(context->scene, begin);
 
@@ -4139,7 +4487,7 @@ ImBuf *BKE_sequencer_give_ibuf(const SeqRenderData *context, float cfra, int cha
       BKE_sequencer_cache_put_if_possible(
           context, seq_arr[count - 1], cfra, SEQ_CACHE_STORE_FINAL_OUT, out, cost, false);
     }
-    BLI_mutex_unlock(&seq_render_mutex);
+    seq_render_unlock();
   }
 
   BKE_sequencer_prefetch_start(context, cfra, cost);
@@ -110,6 +110,10 @@ struct ImBuf *BKE_sequencer_cache_get(const SeqRenderData *context,
                                       float cfra,
                                       int type,
                                       bool skip_disk_cache);
+bool BKE_sequencer_cache_contains(const SeqRenderData *context,
+                                  struct Sequence *seq,
+                                  float cfra,
+                                  int type);
 void BKE_sequencer_cache_put(const SeqRenderData *context,
                              struct Sequence *seq,
                              float cfra,
@@ -149,6 +153,20 @@ SeqRenderData *BKE_sequencer_prefetch_get_original_context(const SeqRenderData *
 struct Sequence *BKE_sequencer_prefetch_get_original_sequence(struct Sequence *seq,
                                                               struct Scene *scene);
 
+/* **********************************************************************
+ * image_readahead.c
+ *
+ * Read-ahead of image sequence files
+ * ********************************************************************** */
+
+void BKE_sequencer_image_readahead_update(const SeqRenderData *context,
+                                          struct Sequence *seq,
+                                          float cfra);
+unsigned char *BKE_sequencer_image_readahead_read(const SeqRenderData *context,
+                                                  const char *filepath,
+                                                  size_t *r_size);
+void BKE_sequencer_image_readahead_free(struct Scene *scene);
+
 /* **********************************************************************
  * seqeffects.c
  *
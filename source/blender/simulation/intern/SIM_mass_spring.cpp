@@ -38,6 +38,8 @@
 #include "BKE_collision.h"
 #include "BKE_effect.h"
 
+#include "PIL_time.h"
+
 #include "SIM_mass_spring.h"
 #include "implicit.h"
 
@@ -720,20 +722,20 @@ static void cloth_calc_force(
                                                  "effector forces");
     float(*forcevec)[3] = is_not_hair ? winvec + mvert_num : winvec;
 
+    /* evaluate all vertices at once */
+    float(*x)[3] = (float(*)[3])MEM_mallocN(sizeof(float[3]) * mvert_num * 2, "effector points");
+    float(*v)[3] = x + mvert_num;
     for (i = 0; i < cloth->mvert_num; i++) {
-      float x[3], v[3];
-      EffectedPoint epoint;
-
-      SIM_mass_spring_get_motion_state(data, i, x, v);
-      pd_point_from_loc(scene, x, v, i, &epoint);
-      BKE_effectors_apply(effectors,
-                          NULL,
-                          clmd->sim_parms->effector_weights,
-                          &epoint,
-                          forcevec[i],
-                          winvec[i],
-                          NULL);
+      SIM_mass_spring_get_motion_state(data, i, x[i], v[i]);
+    }
 
+    EffectedPoints epoints;
+    pd_points_from_loc(scene, x, v, mvert_num, &epoints);
+    BKE_effectors_apply_points(
+        effectors, NULL, clmd->sim_parms->effector_weights, &epoints, forcevec, winvec, NULL);
+    MEM_freeN(x);
+
+    for (i = 0; i < cloth->mvert_num; i++) {
       has_wind = has_wind || !is_zero_v3(winvec[i]);
       has_force = has_force || !is_zero_v3(forcevec[i]);
     }
@@ -1216,6 +1218,8 @@ static void cloth_clear_result(ClothModifierData *clmd)
   sres->max_error = sres->min_error = sres->avg_error = 0.0f;
   sres->max_iterations = sres->min_iterations = 0;
   sres->avg_iterations = 0.0f;
+  sres->avg_time_solve = 0.0f;
+  sres->avg_time_collision_overlap = sres->avg_time_collision_response = 0.0f;
 }
 
 static void cloth_record_result(ClothModifierData *clmd, ImplicitSolverResult *result, float dt)
@@ -1309,7 +1313,10 @@ int SIM_cloth_solve(
     cloth_calc_force(scene, clmd, frame, effectors, step);
 
     /* calculate new velocity and position */
+    const double time_solve = PIL_check_seconds_timer();
     SIM_mass_spring_solve_velocities(id, dt, &result);
+    clmd->solver_result->avg_time_solve += (float)(PIL_check_seconds_timer() - time_solve) *
+                                           clmd->sim_parms->dt;
     cloth_record_result(clmd, &result, dt);
 
     /* Calculate collision impulses. */
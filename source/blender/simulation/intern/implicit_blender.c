@@ -34,6 +34,7 @@
 #  include "DNA_texture_types.h"
 
 #  include "BLI_math.h"
+#  include "BLI_task.h"
 #  include "BLI_utildefines.h"
 
 #  include "BKE_cloth.h"
@@ -42,6 +43,10 @@
 
 #  include "SIM_mass_spring.h"
 
+#  ifdef __SSE2__
+#    include <emmintrin.h>
+#  endif
+
 #  ifdef __GNUC__
 #    pragma GCC diagnostic ignored "-Wtype-limits"
 #  endif
@@ -658,6 +663,288 @@ DO_INLINE void subadd_bfmatrixS_bfmatrixS(
   }
 }
 
+///////////////////////////////////////////////////////////////////
+/* block sparse row matrix */
+///////////////////////////////////////////////////////////////////
+
+/* The big matrices store the diagonal blocks followed by blocks of the lower triangle in the
+ * order springs are added. For solving, they are converted to a compressed block sparse row
+ * matrix containing both triangles, so every row of a product can be computed independently.
+ * Blocks connecting the same vertices are not merged, so every block of the BSR matrix comes
+ * from exactly one big matrix block and they can be copied in parallel. */
+
+/* Rows are processed in chunks of fixed size, so sums are always done in the same order and
+ * simulation results don't depend on the number of threads. */
+#  define BSR_CHUNK_SIZE 1024
+
+typedef struct BSRMatrix {
+  unsigned int num_rows;
+  unsigned int num_blocks;
+
+  /* Blocks of a row are from row_offsets[row] to row_offsets[row + 1], starting with the
+   * diagonal block. */
+  unsigned int *row_offsets;
+  unsigned int *columns;
+  /* Blocks stored by columns, padded to 4 floats for SIMD. */
+  float (*values)[3][4];
+  /* Products of blocks with a long vector, summed per row afterwards. */
+  float (*block_products)[3];
+
+  /* Rows and columns of the big matrix blocks the structure was built for. */
+  unsigned int num_source_blocks, max_source_blocks;
+  unsigned int (*source_rc)[2];
+  /* Block for every big matrix block, and for its transpose if it is off-diagonal. */
+  unsigned int (*source_blocks)[2];
+} BSRMatrix;
+
+static BSRMatrix *create_bsrmatrix(void)
+{
+  return (BSRMatrix *)MEM_callocN(sizeof(BSRMatrix), "cloth_implicit_bsr_matrix");
+}
+
+static void clear_bsrmatrix(BSRMatrix *bsr)
+{
+  MEM_SAFE_FREE(bsr->row_offsets);
+  MEM_SAFE_FREE(bsr->columns);
+  MEM_SAFE_FREE(bsr->values);
+  MEM_SAFE_FREE(bsr->block_products);
+  MEM_SAFE_FREE(bsr->source_rc);
+  MEM_SAFE_FREE(bsr->source_blocks);
+  bsr->num_rows = 0;
+  bsr->num_blocks = 0;
+  bsr->num_source_blocks = 0;
+  bsr->max_source_blocks = 0;
+}
+
+static void del_bsrmatrix(BSRMatrix *bsr)
+{
+  if (bsr != NULL) {
+    clear_bsrmatrix(bsr);
+    MEM_freeN(bsr);
+  }
+}
+
+static bool bsrmatrix_structure_matches(const BSRMatrix *bsr,
+                                        const fmatrix3x3 *from,
+                                        unsigned int num_source_blocks)
+{
+  if (bsr->num_source_blocks != num_source_blocks || bsr->num_rows != from[0].vcount) {
+    return false;
+  }
+  for (unsigned int i = 0; i < num_source_blocks; i++) {
+    if (bsr->source_rc[i][0] != from[i].r || bsr->source_rc[i][1] != from[i].c) {
+      return false;
+    }
+  }
+  return true;
+}
+
+/* Build the block structure for the first num_source_blocks blocks of a big matrix. When the
+ * same springs are used as in the previous step, the existing structure is kept. */
+static void update_bsrmatrix_structure(BSRMatrix *bsr,
+                                       const fmatrix3x3 *from,
+                                       unsigned int num_source_blocks)
+{
+  if (bsrmatrix_structure_matches(bsr, from, num_source_blocks)) {
+    return;
+  }
+
+  const unsigned int num_rows = from[0].vcount;
+  const unsigned int num_blocks = 2 * num_source_blocks - num_rows;
+
+  /* The number of springs changes when they are compressed, keep the arrays as long as they
+   * are big enough. */
+  if (bsr->num_rows != num_rows || bsr->max_source_blocks < num_source_blocks) {
+    clear_bsrmatrix(bsr);
+    bsr->row_offsets = MEM_mallocN(sizeof(unsigned int) * (num_rows + 1), "bsr row offsets");
+    bsr->columns = MEM_mallocN(sizeof(unsigned int) * num_blocks, "bsr columns");
+    bsr->values = MEM_mallocN_aligned(sizeof(*bsr->values) * num_blocks, 16, "bsr values");
+    bsr->block_products = MEM_mallocN(sizeof(*bsr->block_products) * num_blocks,
+                                      "bsr block products");
+    bsr->source_rc = MEM_mallocN(sizeof(*bsr->source_rc) * num_source_blocks, "bsr source rc");
+    bsr->source_blocks = MEM_mallocN(sizeof(*bsr->source_blocks) * num_source_blocks,
+                                     "bsr source blocks");
+    bsr->num_rows = num_rows;
+    bsr->max_source_blocks = num_source_blocks;
+  }
+  bsr->num_blocks = num_blocks;
+  bsr->num_source_blocks = num_source_blocks;
+
+  /* Count blocks per row, off-diagonal blocks are added to both triangles. */
+  unsigned int *row_fill = MEM_callocN(sizeof(unsigned int) * num_rows, __func__);
+  for (unsigned int i = 0; i < num_source_blocks; i++) {
+    const unsigned int r = from[i].r, c = from[i].c;
+    BLI_assert(i >= num_rows || (r == i && c == i));
+    bsr->source_rc[i][0] = r;
+    bsr->source_rc[i][1] = c;
+    if (i >= num_rows) {
+      row_fill[r]++;
+      row_fill[c]++;
+    }
+  }
+
+  unsigned int offset = 0;
+  for (unsigned int row = 0; row < num_rows; row++) {
+    bsr->row_offsets[row] = offset;
+    /* Diagonal block comes first. */
+    bsr->columns[offset] = row;
+    bsr->source_blocks[row][0] = bsr->source_blocks[row][1] = offset;
+    offset += 1 + row_fill[row];
+    row_fill[row] = bsr->row_offsets[row] + 1;
+  }
+  bsr->row_offsets[num_rows] = offset;
+  BLI_assert(offset == num_blocks);
+
+  for (unsigned int i = num_rows; i < num_source_blocks; i++) {
+    const unsigned int r = bsr->source_rc[i][0], c = bsr->source_rc[i][1];
+    bsr->source_blocks[i][0] = row_fill[r];
+    bsr->columns[row_fill[r]++] = c;
+    bsr->source_blocks[i][1] = row_fill[c];
+    bsr->columns[row_fill[c]++] = r;
+  }
+  MEM_freeN(row_fill);
+}
+
+BLI_INLINE unsigned int bsr_num_chunks(unsigned int num_items)
+{
+  return (num_items + BSR_CHUNK_SIZE - 1) / BSR_CHUNK_SIZE;
+}
+
+BLI_INLINE void bsr_chunk_range(unsigned int num_items,
+                                int chunk,
+                                unsigned int *r_start,
+                                unsigned int *r_end)
+{
+  *r_start = (unsigned int)chunk * BSR_CHUNK_SIZE;
+  *r_end = min_ii(*r_start + BSR_CHUNK_SIZE, num_items);
+}
+
+static void bsr_parallel_chunks(unsigned int num_items, void *userdata, TaskParallelRangeFunc func)
+{
+  const unsigned int num_chunks = bsr_num_chunks(num_items);
+
+  TaskParallelSettings settings;
+  BLI_parallel_range_settings_defaults(&settings);
+  settings.use_threading = (num_chunks > 1);
+  settings.min_iter_per_thread = 1;
+  BLI_task_parallel_range(0, (int)num_chunks, userdata, func, &settings);
+}
+
+typedef struct BSRAssembleData {
+  BSRMatrix *bsr;
+  const fmatrix3x3 *const *from;
+  const float *factors;
+  int num_from;
+
+  /* Big matrix multiplied with a long vector in the same pass. */
+  const fmatrix3x3 *mul_from;
+  const lfVector *mul_vector;
+  lfVector *mul_to;
+} BSRAssembleData;
+
+static void bsr_assemble_cb(void *__restrict userdata,
+                            const int chunk,
+                            const TaskParallelTLS *__restrict UNUSED(tls))
+{
+  const BSRAssembleData *data = userdata;
+  BSRMatrix *bsr = data->bsr;
+  unsigned int start, end;
+  bsr_chunk_range(bsr->num_source_blocks, chunk, &start, &end);
+
+  /* Big matrix blocks are read in order, so memory access is mostly sequential. */
+  for (unsigned int i = start; i < end; i++) {
+    const unsigned int r = bsr->source_rc[i][0], c = bsr->source_rc[i][1];
+    const unsigned int b = bsr->source_blocks[i][0];
+    float m[3][3];
+    copy_m3_m3(m, data->from[0][i].m);
+    mul_m3_fl(m, data->factors[0]);
+    for (int k = 1; k < data->num_from; k++) {
+      madd_m3_m3fl(m, data->from[k][i].m, data->factors[k]);
+    }
+
+    for (int col = 0; col < 3; col++) {
+      copy_v3_fl3(bsr->values[b][col], m[0][col], m[1][col], m[2][col]);
+      bsr->values[b][col][3] = 0.0f;
+    }
+    mul_fmatrix_fvector(bsr->block_products[b], data->mul_from[i].m, data->mul_vector[c]);
+
+    if (i >= bsr->num_rows) {
+      const unsigned int bt = bsr->source_blocks[i][1];
+      for (int col = 0; col < 3; col++) {
+        copy_v3_v3(bsr->values[bt][col], m[col]);
+        bsr->values[bt][col][3] = 0.0f;
+      }
+      zero_v3(bsr->block_products[bt]);
+      muladd_fmatrixT_fvector(bsr->block_products[bt], data->mul_from[i].m, data->mul_vector[r]);
+    }
+  }
+}
+
+static void bsr_sum_products_cb(void *__restrict userdata,
+                                const int chunk,
+                                const TaskParallelTLS *__restrict UNUSED(tls))
+{
+  const BSRAssembleData *data = userdata;
+  const BSRMatrix *bsr = data->bsr;
+  unsigned int start, end;
+  bsr_chunk_range(bsr->num_rows, chunk, &start, &end);
+
+  for (unsigned int row = start; row < end; row++) {
+    zero_v3(data->mul_to[row]);
+    for (unsigned int b = bsr->row_offsets[row]; b < bsr->row_offsets[row + 1]; b++) {
+      add_v3_v3(data->mul_to[row], bsr->block_products[b]);
+    }
+  }
+}
+
+/* Set the values to the weighted sum of big matrices, which must have the blocks the structure
+ * was built for. The product of another big matrix with a long vector is computed along with
+ * it, since reading the big matrices is the expensive part. */
+static void assemble_bsrmatrix(BSRMatrix *bsr,
+                               const fmatrix3x3 *const *from,
+                               const float *factors,
+                               int num_from,
+                               lfVector *mul_to,
+                               const fmatrix3x3 *mul_from,
+                               const lfVector *mul_vector)
+{
+  BSRAssembleData data = {bsr, from, factors, num_from, mul_from, mul_vector, mul_to};
+  bsr_parallel_chunks(bsr->num_source_blocks, &data, bsr_assemble_cb);
+  bsr_parallel_chunks(bsr->num_rows, &data, bsr_sum_products_cb);
+}
+
+/* Multiply one row of the matrix with a long vector. */
+BLI_INLINE void bsr_mul_row(const BSRMatrix *bsr,
+                            unsigned int row,
+                            const lfVector *fLongVector,
+                            float r[3])
+{
+  const unsigned int end = bsr->row_offsets[row + 1];
+
+#  ifdef __SSE2__
+  __m128 sum = _mm_setzero_ps();
+  for (unsigned int b = bsr->row_offsets[row]; b < end; b++) {
+    const float *v = fLongVector[bsr->columns[b]];
+    const float(*m)[4] = bsr->values[b];
+    sum = _mm_add_ps(sum, _mm_mul_ps(_mm_load_ps(m[0]), _mm_set1_ps(v[0])));
+    sum = _mm_add_ps(sum, _mm_mul_ps(_mm_load_ps(m[1]), _mm_set1_ps(v[1])));
+    sum = _mm_add_ps(sum, _mm_mul_ps(_mm_load_ps(m[2]), _mm_set1_ps(v[2])));
+  }
+  float result[4];
+  _mm_storeu_ps(result, sum);
+  copy_v3_v3(r, result);
+#  else
+  zero_v3(r);
+  for (unsigned int b = bsr->row_offsets[row]; b < end; b++) {
+    const float *v = fLongVector[bsr->columns[b]];
+    const float(*m)[4] = bsr->values[b];
+    for (int i = 0; i < 3; i++) {
+      r[i] += m[0][i] * v[0] + m[1][i] * v[1] + m[2][i] * v[2];
+    }
+  }
+#  endif
+}
+
 ///////////////////////////////////////////////////////////////////
 /* simulator start */
 ///////////////////////////////////////////////////////////////////
@@ -676,8 +963,8 @@ typedef struct Implicit_Data {
   lfVector *V, *Vnew; /* velocities */
 
   /* internal solver data */
-  lfVector *B;   /* B for A*dV = B */
-  fmatrix3x3 *A; /* A for A*dV = B */
+  lfVector *B;  /* B for A*dV = B */
+  BSRMatrix *A; /* A for A*dV = B */
 
   lfVector *dV;         /* velocity change (solution of A*dV = B) */
   lfVector *z;          /* target velocity in constrained directions */
@@ -691,7 +978,7 @@ Implicit_Data *SIM_mass_spring_solver_create(int numverts, int numsprings)
 
   /* process diagonal elements */
   id->tfm = create_bfmatrix(numverts, 0);
-  id->A = create_bfmatrix(numverts, numsprings);
+  id->A = create_bsrmatrix();
   id->dFdV = create_bfmatrix(numverts, numsprings);
   id->dFdX = create_bfmatrix(numverts, numsprings);
   id->S = create_bfmatrix(numverts, 0);
@@ -716,7 +1003,7 @@ Implicit_Data *SIM_mass_spring_solver_create(int numverts, int numsprings)
 void SIM_mass_spring_solver_free(Implicit_Data *id)
 {
   del_bfmatrix(id->tfm);
-  del_bfmatrix(id->A);
+  del_bsrmatrix(id->A);
   del_bfmatrix(id->dFdV);
   del_bfmatrix(id->dFdX);
   del_bfmatrix(id->S);
@@ -850,8 +1137,129 @@ static int cg_filtered(lfVector *ldV, fmatrix3x3 *lA, lfVector *lB, lfVector *z,
 }
 #  endif
 
+/* Data for the parallel passes of the conjugate gradient solver. Each pass handles chunks of
+ * rows and sums a dot product per chunk, which are added in order afterwards. */
+typedef struct CGData {
+  const BSRMatrix *A;
+  const fmatrix3x3 *S;
+  float (*Pinv)[3][3];
+
+  lfVector *dV, *B, *r, *c, *q, *s;
+  float alpha, beta;
+
+  double (*chunk_sums)[2];
+} CGData;
+
+static void cg_sum(const CGData *data, unsigned int numverts, double r_sum[2])
+{
+  r_sum[0] = r_sum[1] = 0.0;
+  for (unsigned int chunk = 0; chunk < bsr_num_chunks(numverts); chunk++) {
+    r_sum[0] += data->chunk_sums[chunk][0];
+    r_sum[1] += data->chunk_sums[chunk][1];
+  }
+}
+
+/* Block Jacobi preconditioner, r = filter(B - A * dV), c = filter(P^-1 * r). Sums
+ * filter(B)^T * P^-1 * filter(B) and r^T * c. */
+static void cg_init_cb(void *__restrict userdata,
+                       const int chunk,
+                       const TaskParallelTLS *__restrict UNUSED(tls))
+{
+  const CGData *data = userdata;
+  unsigned int start, end;
+  bsr_chunk_range(data->A->num_rows, chunk, &start, &end);
+  double bnorm2 = 0.0, delta = 0.0;
+
+  for (unsigned int i = start; i < end; i++) {
+    const float(*diag)[4] = data->A->values[data->A->row_offsets[i]];
+    float m[3][3], fB[3], tmp[3];
+
+    for (int col = 0; col < 3; col++) {
+      m[0][col] = diag[col][0];
+      m[1][col] = diag[col][1];
+      m[2][col] = diag[col][2];
+    }
+    if (!invert_m3_m3(data->Pinv[i], m)) {
+      unit_m3(data->Pinv[i]);
+    }
+
+    mul_v3_m3v3(fB, data->S[i].m, data->B[i]);
+    mul_v3_m3v3(tmp, data->Pinv[i], fB);
+    bnorm2 += dot_v3v3(fB, tmp);
+
+    bsr_mul_row(data->A, i, data->dV, tmp);
+    sub_v3_v3v3(tmp, data->B[i], tmp);
+    mul_v3_m3v3(data->r[i], data->S[i].m, tmp);
+
+    mul_v3_m3v3(tmp, data->Pinv[i], data->r[i]);
+    mul_v3_m3v3(data->c[i], data->S[i].m, tmp);
+    delta += dot_v3v3(data->r[i], data->c[i]);
+  }
+
+  data->chunk_sums[chunk][0] = bnorm2;
+  data->chunk_sums[chunk][1] = delta;
+}
+
+/* q = filter(A * c), sums c^T * q. */
+static void cg_mul_cb(void *__restrict userdata,
+                      const int chunk,
+                      const TaskParallelTLS *__restrict UNUSED(tls))
+{
+  const CGData *data = userdata;
+  unsigned int start, end;
+  bsr_chunk_range(data->A->num_rows, chunk, &start, &end);
+  double sum = 0.0;
+
+  for (unsigned int i = start; i < end; i++) {
+    float tmp[3];
+    bsr_mul_row(data->A, i, data->c, tmp);
+    mul_v3_m3v3(data->q[i], data->S[i].m, tmp);
+    sum += dot_v3v3(data->c[i], data->q[i]);
+  }
+
+  data->chunk_sums[chunk][0] = sum;
+  data->chunk_sums[chunk][1] = 0.0;
+}
+
+/* dV += alpha * c, r -= alpha * q, s = P^-1 * r, sums r^T * s. */
+static void cg_update_cb(void *__restrict userdata,
+                         const int chunk,
+                         const TaskParallelTLS *__restrict UNUSED(tls))
+{
+  const CGData *data = userdata;
+  unsigned int start, end;
+  bsr_chunk_range(data->A->num_rows, chunk, &start, &end);
+  double sum = 0.0;
+
+  for (unsigned int i = start; i < end; i++) {
+    madd_v3_v3fl(data->dV[i], data->c[i], data->alpha);
+    madd_v3_v3fl(data->r[i], data->q[i], -data->alpha);
+    mul_v3_m3v3(data->s[i], data->Pinv[i], data->r[i]);
+    sum += dot_v3v3(data->r[i], data->s[i]);
+  }
+
+  data->chunk_sums[chunk][0] = sum;
+  data->chunk_sums[chunk][1] = 0.0;
+}
+
+/* c = filter(s + beta * c) */
+static void cg_direction_cb(void *__restrict userdata,
+                            const int chunk,
+                            const TaskParallelTLS *__restrict UNUSED(tls))
+{
+  const CGData *data = userdata;
+  unsigned int start, end;
+  bsr_chunk_range(data->A->num_rows, chunk, &start, &end);
+
+  for (unsigned int i = start; i < end; i++) {
+    float tmp[3];
+    madd_v3_v3v3fl(tmp, data->s[i], data->c[i], data->beta);
+    mul_v3_m3v3(data->c[i], data->S[i].m, tmp);
+  }
+}
+
 static int cg_filtered(lfVector *ldV,
-                       fmatrix3x3 *lA,
+                       const BSRMatrix *lA,
                        lfVector *lB,
                        lfVector *z,
                        fmatrix3x3 *S,
@@ -861,38 +1269,36 @@ static int cg_filtered(lfVector *ldV,
   unsigned int conjgrad_loopcount = 0, conjgrad_looplimit = 100;
   float conjgrad_epsilon = 0.01f;
 
-  unsigned int numverts = lA[0].vcount;
-  lfVector *fB = create_lfvector(numverts);
-  lfVector *AdV = create_lfvector(numverts);
-  lfVector *r = create_lfvector(numverts);
-  lfVector *c = create_lfvector(numverts);
-  lfVector *q = create_lfvector(numverts);
-  lfVector *s = create_lfvector(numverts);
-  float bnorm2, delta_new, delta_old, delta_target, alpha;
+  unsigned int numverts = lA->num_rows;
+  double sum[2];
+  float bnorm2, delta_new, delta_old, delta_target;
+
+  CGData data = {NULL};
+  data.A = lA;
+  data.S = S;
+  data.Pinv = MEM_mallocN(sizeof(*data.Pinv) * numverts, "cloth_implicit_cg_pinv");
+  data.dV = ldV;
+  data.B = lB;
+  data.r = create_lfvector(numverts);
+  data.c = create_lfvector(numverts);
+  data.q = create_lfvector(numverts);
+  data.s = create_lfvector(numverts);
+  data.chunk_sums = MEM_mallocN(sizeof(*data.chunk_sums) * bsr_num_chunks(numverts),
+                                "cloth_implicit_cg_sums");
 
   cp_lfvector(ldV, z, numverts);
 
-  /* d0 = filter(B)^T * P * filter(B) */
-  cp_lfvector(fB, lB, numverts);
-  filter(fB, S);
-  bnorm2 = dot_lfvector(fB, fB, numverts);
-  delta_target = conjgrad_epsilon * conjgrad_epsilon * bnorm2;
-
+  /* d0 = filter(B)^T * P^-1 * filter(B) */
   /* r = filter(B - A * dV) */
-  mul_bfmatrix_lfvector(AdV, lA, ldV);
-  sub_lfvector_lfvector(r, lB, AdV, numverts);
-  filter(r, S);
-
   /* c = filter(P^-1 * r) */
-  cp_lfvector(c, r, numverts);
-  filter(c, S);
-
   /* delta = r^T * c */
-  delta_new = dot_lfvector(r, c, numverts);
+  bsr_parallel_chunks(numverts, &data, cg_init_cb);
+  cg_sum(&data, numverts, sum);
+  bnorm2 = (float)sum[0];
+  delta_new = (float)sum[1];
+  delta_target = conjgrad_epsilon * conjgrad_epsilon * bnorm2;
 
 #  ifdef IMPLICIT_PRINT_SOLVER_INPUT_OUTPUT
-  printf("==== A ====\n");
-  print_bfmatrix(lA);
   printf("==== z ====\n");
   print_lvector(z, numverts);
   printf("==== B ====\n");
@@ -902,22 +1308,18 @@ static int cg_filtered(lfVector *ldV,
 #  endif
 
   while (delta_new > delta_target && conjgrad_loopcount < conjgrad_looplimit) {
-    mul_bfmatrix_lfvector(q, lA, c);
-    filter(q, S);
-
-    alpha = delta_new / dot_lfvector(c, q, numverts);
-
-    add_lfvector_lfvectorS(ldV, ldV, c, alpha, numverts);
+    bsr_parallel_chunks(numverts, &data, cg_mul_cb);
+    cg_sum(&data, numverts, sum);
 
-    add_lfvector_lfvectorS(r, r, q, -alpha, numverts);
+    data.alpha = delta_new / (float)sum[0];
 
-    /* s = P^-1 * r */
-    cp_lfvector(s, r, numverts);
     delta_old = delta_new;
-    delta_new = dot_lfvector(r, s, numverts);
+    bsr_parallel_chunks(numverts, &data, cg_update_cb);
+    cg_sum(&data, numverts, sum);
+    delta_new = (float)sum[0];
 
-    add_lfvector_lfvectorS(c, s, c, delta_new / delta_old, numverts);
-    filter(c, S);
+    data.beta = delta_new / delta_old;
+    bsr_parallel_chunks(numverts, &data, cg_direction_cb);
 
     conjgrad_loopcount++;
   }
@@ -928,12 +1330,12 @@ static int cg_filtered(lfVector *ldV,
   printf("========\n");
 #  endif
 
-  del_lfvector(fB);
-  del_lfvector(AdV);
-  del_lfvector(r);
-  del_lfvector(c);
-  del_lfvector(q);
-  del_lfvector(s);
+  MEM_freeN(data.Pinv);
+  MEM_freeN(data.chunk_sums);
+  del_lfvector(data.r);
+  del_lfvector(data.c);
+  del_lfvector(data.q);
+  del_lfvector(data.s);
   // printf("W/O conjgrad_loopcount: %d\n", conjgrad_loopcount);
 
   result->status = conjgrad_loopcount < conjgrad_looplimit ? SIM_SOLVER_SUCCESS :
@@ -1158,11 +1560,13 @@ bool SIM_mass_spring_solve_velocities(Implicit_Data *data, float dt, ImplicitSol
   lfVector *dFdXmV = create_lfvector(numverts);
   zero_lfvector(data->dV, numverts);
 
-  cp_bfmatrix(data->A, data->M);
-
-  subadd_bfmatrixS_bfmatrixS(data->A, data->dFdV, dt, data->dFdX, (dt * dt));
+  /* All big matrices share the blocks added for springs. */
+  update_bsrmatrix_structure(data->A, data->dFdX, numverts + data->num_blocks);
 
-  mul_bfmatrix_lfvector(dFdXmV, data->dFdX, data->V);
+  /* A = M - dt * dFdV - dt^2 * dFdX */
+  const fmatrix3x3 *A_from[3] = {data->M, data->dFdV, data->dFdX};
+  const float A_factors[3] = {1.0f, -dt, -(dt * dt)};
+  assemble_bsrmatrix(data->A, A_from, A_factors, 3, dFdXmV, data->dFdX, data->V);
 
   add_lfvectorS_lfvectorS(data->B, data->F, dt, dFdXmV, (dt * dt), numverts);
 
@@ -1296,7 +1700,6 @@ static int SIM_mass_spring_add_block(Implicit_Data *data, int v1, int v2)
   init_fmatrix(data->M + s, v1, v2);
   init_fmatrix(data->dFdX + s, v1, v2);
   init_fmatrix(data->dFdV + s, v1, v2);
-  init_fmatrix(data->A + s, v1, v2);
   init_fmatrix(data->P + s, v1, v2);
   init_fmatrix(data->Pinv + s, v1, v2);
 
@@ -0,0 +1,221 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+#include "testing/testing.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <vector>
+
+#include "BLI_task.h"
+#include "BLI_threads.h"
+
+#include "PIL_time.h"
+
+#include "SIM_mass_spring.h"
+#include "implicit.h"
+
+namespace blender::sim::tests {
+
+/* A square piece of cloth with structural, shear and bending springs, hanging from its first
+ * row of vertices. It is set up the same way as the cloth modifier does every step. */
+class ClothGrid {
+ public:
+  ClothGrid(int size, bool use_springs, bool pin_first_row)
+      : size_(size), use_springs_(use_springs), pin_first_row_(pin_first_row)
+  {
+    /* Structural, shear and bending springs for every vertex. */
+    const int num_springs = use_springs ? size * size * 6 : 0;
+    data_ = SIM_mass_spring_solver_create(size * size, num_springs);
+
+    float unit[3][3] = {{1, 0, 0}, {0, 1, 0}, {0, 0, 1}};
+    for (int y = 0; y < size; y++) {
+      for (int x = 0; x < size; x++) {
+        const int i = index(x, y);
+        /* Slightly stretched, so springs pull. */
+        const float co[3] = {x * 0.0105f, 0.0f, -y * 0.0105f};
+        const float vel[3] = {0.0f, 0.0f, 0.0f};
+        SIM_mass_spring_set_rest_transform(data_, i, unit);
+        SIM_mass_spring_set_vertex_mass(data_, i, 0.3f);
+        SIM_mass_spring_set_motion_state(data_, i, co, vel);
+      }
+    }
+  }
+
+  ~ClothGrid()
+  {
+    SIM_mass_spring_solver_free(data_);
+  }
+
+  int index(int x, int y) const
+  {
+    return y * size_ + x;
+  }
+
+  ImplicitSolverResult step(float dt)
+  {
+    const float gravity[3] = {0.0f, 0.0f, -9.81f};
+    const float zero[3] = {0.0f, 0.0f, 0.0f};
+
+    SIM_mass_spring_clear_constraints(data_);
+    SIM_mass_spring_clear_forces(data_);
+
+    for (int i = 0; i < size_ * size_; i++) {
+      SIM_mass_spring_force_gravity(data_, i, 0.3f, gravity);
+    }
+    if (pin_first_row_) {
+      for (int x = 0; x < size_; x++) {
+        SIM_mass_spring_add_constraint_ndof0(data_, index(x, 0), zero);
+      }
+    }
+    if (use_springs_) {
+      for (int y = 0; y < size_; y++) {
+        for (int x = 0; x < size_; x++) {
+          add_spring(x, y, x + 1, y, 0.01f, 15.0f);
+          add_spring(x, y, x, y + 1, 0.01f, 15.0f);
+          add_spring(x, y, x + 1, y + 1, 0.01414f, 15.0f);
+          add_spring(x + 1, y, x, y + 1, 0.01414f, 15.0f);
+          add_spring(x, y, x + 2, y, 0.02f, 0.5f);
+          add_spring(x, y, x, y + 2, 0.02f, 0.5f);
+        }
+      }
+    }
+
+    ImplicitSolverResult result;
+    SIM_mass_spring_solve_velocities(data_, dt, &result);
+    SIM_mass_spring_solve_positions(data_, dt);
+    SIM_mass_spring_apply_result(data_);
+    return result;
+  }
+
+  std::vector<float> velocities() const
+  {
+    std::vector<float> result;
+    for (int i = 0; i < size_ * size_; i++) {
+      float vel[3];
+      SIM_mass_spring_get_velocity(data_, i, vel);
+      result.insert(result.end(), vel, vel + 3);
+    }
+    return result;
+  }
+
+ private:
+  void add_spring(int x1, int y1, int x2, int y2, float restlen, float stiffness)
+  {
+    if (x2 < size_ && y2 < size_) {
+      SIM_mass_spring_force_spring_linear(data_,
+                                          index(x1, y1),
+                                          index(x2, y2),
+                                          restlen,
+                                          stiffness,
+                                          0.5f,
+                                          stiffness,
+                                          0.5f,
+                                          false,
+                                          false,
+                                          0.0f);
+    }
+  }
+
+  int size_;
+  bool use_springs_;
+  bool pin_first_row_;
+  Implicit_Data *data_;
+};
+
+static void set_num_threads(int num_threads)
+{
+  BLI_task_scheduler_exit();
+  BLI_system_num_threads_override_set(num_threads);
+  BLI_task_scheduler_init();
+}
+
+TEST(implicit_blender, FreeFall)
+{
+  ClothGrid grid(8, false, false);
+  const ImplicitSolverResult result = grid.step(0.1f);
+  EXPECT_EQ(result.status, SIM_SOLVER_SUCCESS);
+
+  for (int i = 0; i < 8 * 8; i++) {
+    EXPECT_FLOAT_EQ(grid.velocities()[i * 3 + 0], 0.0f);
+    EXPECT_FLOAT_EQ(grid.velocities()[i * 3 + 2], -0.981f);
+  }
+}
+
+TEST(implicit_blender, PinnedCloth)
+{
+  const int size = 40;
+  ClothGrid grid(size, true, true);
+  for (int step = 0; step < 5; step++) {
+    const ImplicitSolverResult result = grid.step(0.02f);
+    EXPECT_EQ(result.status, SIM_SOLVER_SUCCESS);
+  }
+
+  const std::vector<float> vel = grid.velocities();
+  for (int x = 0; x < size; x++) {
+    EXPECT_EQ(vel[grid.index(x, 0) * 3 + 2], 0.0f);
+    EXPECT_LT(vel[grid.index(x, size - 1) * 3 + 2], 0.0f);
+  }
+  /* Springs slow down falling of the vertices close to the pinned row. */
+  EXPECT_GT(vel[grid.index(size / 2, 1) * 3 + 2], vel[grid.index(size / 2, size - 1) * 3 + 2]);
+}
+
+/* Sums are split in chunks independent of the number of threads, for reproducible results. */
+TEST(implicit_blender, SameResultForAnyThreadCount)
+{
+  std::vector<float> vel[2];
+  for (int run = 0; run < 2; run++) {
+    set_num_threads(run == 0 ? 1 : 0);
+    ClothGrid grid(100, true, true);
+    for (int step = 0; step < 3; step++) {
+      grid.step(0.02f);
+    }
+    vel[run] = grid.velocities();
+  }
+  set_num_threads(0);
+
+  EXPECT_EQ(vel[0], vel[1]);
+}
+
+/* Solve a cloth system of about 200k vertices with increasing number of threads. Run with
+ * --gtest_also_run_disabled_tests. */
+TEST(implicit_blender, DISABLED_SolverPerformance)
+{
+  const int size = 450;
+  const int max_threads = std::max(1, BLI_system_thread_count());
+
+  for (int num_threads = 1;; num_threads = std::min(num_threads * 2, max_threads)) {
+    set_num_threads(num_threads);
+    ClothGrid grid(size, true, true);
+
+    const double start = PIL_check_seconds_timer();
+    int iterations = 0;
+    for (int step = 0; step < 5; step++) {
+      iterations += grid.step(0.02f).iterations;
+    }
+    printf("%d vertices, %d threads: %fs, %d iterations\n",
+           size * size,
+           num_threads,
+           PIL_check_seconds_timer() - start,
+           iterations);
+
+    if (num_threads == max_threads) {
+      break;
+    }
+  }
+  set_num_threads(0);
+}
+
+}  // namespace blender::sim::tests
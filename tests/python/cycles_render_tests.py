@@ -50,6 +50,7 @@ def create_argparse():
     parser.add_argument("-testdir", nargs=1)
     parser.add_argument("-outdir", nargs=1)
     parser.add_argument("-idiff", nargs=1)
+    parser.add_argument("-split-kernel", action="store_true")
     return parser
 
 
@@ -63,10 +64,18 @@ def main():
     output_dir = args.outdir[0]
 
     from modules import render_report
-    report = render_report.Report("Cycles", output_dir, idiff)
+
+    if args.split_kernel:
+        # Render with the CPU split kernel and compare against the megakernel references,
+        # which are never updated from split kernel renders.
+        os.environ["CYCLES_CPU_SPLIT_KERNEL"] = "1"
+        report = render_report.Report("Cycles Split Kernel", output_dir, idiff)
+        report.update = False
+    else:
+        report = render_report.Report("Cycles", output_dir, idiff)
+        report.set_compare_engines('cycles', 'eevee')
     report.set_pixelated(True)
     report.set_reference_dir("cycles_renders")
-    report.set_compare_engines('cycles', 'eevee')
 
     # Increase threshold for motion blur, see T78777.
     test_dir_name = Path(test_dir).name
@@ -0,0 +1,130 @@
+# ##### BEGIN GPL LICENSE BLOCK #####
+#
+#  This program is free software; you can redistribute it and/or
+#  modify it under the terms of the GNU General Public License
+#  as published by the Free Software Foundation; either version 2
+#  of the License, or (at your option) any later version.
+#
+#  This program is distributed in the hope that it will be useful,
+#  but WITHOUT ANY WARRANTY; without even the implied warranty of
+#  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#  GNU General Public License for more details.
+#
+#  You should have received a copy of the GNU General Public License
+#  along with this program; if not, write to the Free Software Foundation,
+#  Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+#
+# ##### END GPL LICENSE BLOCK #####
+
+# <pep8 compliant>
+
+"""
+./blender.bin --background -noaudio --factory-startup --python tests/python/physics_rigidbody.py
+
+Simulates a pile of colliding cubes with and without multi-threading. Pass --benchmark to
+simulate a much larger pile and print the timings:
+
+./blender.bin --background -noaudio --factory-startup --python tests/python/physics_rigidbody.py -- --benchmark
+"""
+
+import sys
+import time
+import unittest
+
+import bpy
+
+
+def build_pile(size, layers):
+    """Create a pile of size * size * layers cubes, dropped on a passive ground plane."""
+    bpy.ops.wm.read_factory_settings(use_empty=True)
+    scene = bpy.context.scene
+
+    bpy.ops.mesh.primitive_plane_add(size=1000.0, location=(0.0, 0.0, 0.0))
+    bpy.ops.rigidbody.object_add(type='PASSIVE')
+
+    # All cubes share a mesh, adding objects through the API is much faster than operators.
+    bpy.ops.mesh.primitive_cube_add(size=1.0)
+    cube = bpy.context.active_object
+    collection = scene.collection
+    cubes = []
+    for layer in range(layers):
+        # Offset every other layer, so the pile collapses.
+        offset = 0.5 * (layer % 2)
+        for y in range(size):
+            for x in range(size):
+                ob = bpy.data.objects.new("Cube", cube.data)
+                ob.location = (x * 1.1 + offset - size * 0.5, y * 1.1 + offset - size * 0.5, layer * 1.2 + 2.0)
+                collection.objects.link(ob)
+                cubes.append(ob)
+    bpy.data.objects.remove(cube)
+
+    bpy.ops.object.select_all(action='DESELECT')
+    for ob in cubes:
+        ob.select_set(True)
+    bpy.context.view_layer.objects.active = cubes[0]
+    bpy.ops.rigidbody.objects_add(type='ACTIVE')
+
+    return cubes
+
+
+def simulate(frames, use_multithreading):
+    """Simulate from the start frame, and return the seconds it took."""
+    scene = bpy.context.scene
+    rbw = scene.rigidbody_world
+    rbw.use_multithreading = use_multithreading
+    rbw.point_cache.frame_end = scene.frame_start + frames
+
+    scene.frame_set(scene.frame_start)
+    start = time.time()
+    for frame in range(scene.frame_start + 1, scene.frame_start + frames + 1):
+        scene.frame_set(frame)
+    return time.time() - start
+
+
+def locations(cubes):
+    depsgraph = bpy.context.evaluated_depsgraph_get()
+    return [ob.evaluated_get(depsgraph).matrix_world.translation.copy() for ob in cubes]
+
+
+@unittest.skipUnless(bpy.app.build_options.bullet, "Blender was built without Bullet")
+class RigidBodyMultiThreadingTest(unittest.TestCase):
+    def test_pile(self):
+        cubes = build_pile(10, 5)
+
+        simulate(40, False)
+        serial = locations(cubes)
+        simulate(40, True)
+        threaded = locations(cubes)
+
+        # Solving simulation islands in parallel doesn't give exactly the same result, but cubes
+        # must have fallen down to the same height of the pile.
+        for co in threaded:
+            self.assertGreater(co.z, 0.0)
+            self.assertLess(co.z, 8.0)
+        mean_serial = sum(co.z for co in serial) / len(serial)
+        mean_threaded = sum(co.z for co in threaded) / len(threaded)
+        self.assertAlmostEqual(mean_serial, mean_threaded, delta=0.5)
+
+
+def benchmark():
+    cubes = build_pile(32, 5)
+    print("%d cubes" % len(cubes))
+    for use_multithreading in (False, True):
+        seconds = simulate(50, use_multithreading)
+        print("multithreading %s: %.2fs" % (use_multithreading, seconds))
+
+
+def main():
+    if '--' in sys.argv:
+        argv = [sys.argv[0]] + sys.argv[sys.argv.index('--') + 1:]
+    else:
+        argv = sys.argv
+
+    if '--benchmark' in argv:
+        benchmark()
+    else:
+        unittest.main(argv=argv)
+
+
+if __name__ == "__main__":
+    main()